@@ -40,17 +40,21 @@ LOCAL_CFLAGS = $(DEFS) $(FLAGS)
 
 LOCAL_SRC_FILES := \
 	src/app.c \
+	src/arena.c \
 	src/async.c \
+	src/compress.c \
 	src/crypto.c \
 	src/dtls.c \
 	src/file.c \
 	src/hash.c \
+	src/hash64.c \
 	src/http.c \
 	src/image.c \
 	src/json.c \
 	src/list.c \
 	src/log.c \
 	src/memory.c \
+	src/pool.c \
 	src/queue.c \
 	src/resample.c \
 	src/system.c \
@@ -63,7 +67,6 @@ LOCAL_SRC_FILES := \
 	src/gfx/vk/vk-ctx.c \
 	src/gfx/vk/vk-ui.c \
 	src/hid/utils.c \
-	src/unix/compress.c \
 	src/unix/file.c \
 	src/unix/memory.c \
 	src/unix/system.c \
@@ -0,0 +1,29 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#pragma once
+
+#include "matoya.h"
+
+// Platform aligned allocation, returns NULL on failure
+void *mty_sys_alloc_aligned(size_t size, size_t align);
+void mty_sys_free_aligned(void *mem);
+
+// MTY_Alloc et al. with allocations counted towards a module when statistics
+// are enabled via MTY_SetAllocator. Memory is freed with MTY_Free as usual
+void *mty_alloc(size_t len, size_t size, MTY_MemoryTag tag);
+void *mty_realloc(void *mem, size_t len, size_t size, MTY_MemoryTag tag);
+void *mty_alloc_aligned(size_t size, size_t align, MTY_MemoryTag tag);
+void *mty_dup(const void *mem, size_t size, MTY_MemoryTag tag);
+char *mty_strdup(const char *str, MTY_MemoryTag tag);
+
+// MTY_ArenaCreate with the arena's chunks counted towards a module
+MTY_Arena *mty_arena_create(size_t chunkSize, MTY_MemoryTag tag);
+
+// Zeroed arena memory with an alignment of at most 16 bytes, for callers packing
+// many small objects tighter than MTY_ArenaAlloc does
+void *mty_arena_alloc(MTY_Arena *ctx, size_t size, size_t align);
+
+// Return the calling thread's cached MTY_Pool objects to their pools
+void mty_pool_release_thread(void);
@@ -0,0 +1,194 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#include "matoya.h"
+
+#include <string.h>
+
+#include "alloc.h"
+
+#define ARENA_CHUNK_DEFAULT (16 * 1024)
+#define ARENA_CHUNK_MAX     (1024 * 1024)
+
+// Positions are measured across all chunks in the order they were used, so a mark
+// is a single number that only ever increases while allocating
+
+struct arena_chunk {
+	struct arena_chunk *prev;
+	size_t base;
+	size_t size;
+	size_t used;
+};
+
+struct MTY_Arena {
+	struct arena_chunk *chunk;
+	struct arena_chunk *spare;
+	size_t chunk_size;
+	size_t total;
+	MTY_MemoryTag tag;
+};
+
+MTY_Arena *mty_arena_create(size_t chunkSize, MTY_MemoryTag tag)
+{
+	MTY_Arena *ctx = mty_alloc(1, sizeof(MTY_Arena), tag);
+	ctx->chunk_size = chunkSize > 0 ? chunkSize : ARENA_CHUNK_DEFAULT;
+	ctx->tag = tag;
+
+	return ctx;
+}
+
+MTY_Arena *MTY_ArenaCreate(size_t chunkSize)
+{
+	return mty_arena_create(chunkSize, MTY_MEMORY_TAG_NONE);
+}
+
+static void arena_free_chunks(struct arena_chunk *chunk)
+{
+	while (chunk) {
+		struct arena_chunk *prev = chunk->prev;
+		MTY_Free(chunk);
+		chunk = prev;
+	}
+}
+
+void MTY_ArenaDestroy(MTY_Arena **arena)
+{
+	if (!arena || !*arena)
+		return;
+
+	MTY_Arena *ctx = *arena;
+
+	arena_free_chunks(ctx->chunk);
+	arena_free_chunks(ctx->spare);
+
+	MTY_Free(ctx);
+	*arena = NULL;
+}
+
+static struct arena_chunk *arena_take_spare(MTY_Arena *ctx, size_t size)
+{
+	for (struct arena_chunk **c = &ctx->spare; *c; c = &(*c)->prev) {
+		if ((*c)->size >= size) {
+			struct arena_chunk *chunk = *c;
+			*c = chunk->prev;
+
+			return chunk;
+		}
+	}
+
+	return NULL;
+}
+
+static void arena_grow(MTY_Arena *ctx, size_t size)
+{
+	// The 15 extra bytes cover aligning the first allocation in the chunk
+	size += 15;
+
+	struct arena_chunk *chunk = arena_take_spare(ctx, size);
+
+	if (!chunk) {
+		size_t chunk_size = ctx->chunk_size;
+
+		// Chunks double in size as the arena grows so the number of chunks stays small
+		if (ctx->chunk) {
+			chunk_size = ctx->chunk->size * 2;
+
+			if (chunk_size > ARENA_CHUNK_MAX)
+				chunk_size = ARENA_CHUNK_MAX;
+
+			if (chunk_size < ctx->chunk_size)
+				chunk_size = ctx->chunk_size;
+		}
+
+		if (chunk_size < size)
+			chunk_size = size;
+
+		chunk = mty_alloc(sizeof(struct arena_chunk) + chunk_size, 1, ctx->tag);
+		chunk->size = chunk_size;
+		ctx->total += chunk_size;
+	}
+
+	chunk->base = ctx->chunk ? ctx->chunk->base + ctx->chunk->size : 0;
+	chunk->used = 0;
+	chunk->prev = ctx->chunk;
+	ctx->chunk = chunk;
+}
+
+static void *arena_alloc(MTY_Arena *ctx, size_t size, size_t align)
+{
+	struct arena_chunk *chunk = ctx->chunk;
+
+	if (chunk) {
+		uint8_t *data = (uint8_t *) (chunk + 1);
+		uintptr_t start = (uintptr_t) (data + chunk->used);
+		size_t offset = chunk->used + (((start + align - 1) & ~(uintptr_t) (align - 1)) - start);
+
+		if (size <= chunk->size && offset <= chunk->size - size) {
+			chunk->used = offset + size;
+			return data + offset;
+		}
+	}
+
+	arena_grow(ctx, size);
+
+	return arena_alloc(ctx, size, align);
+}
+
+void *mty_arena_alloc(MTY_Arena *ctx, size_t size, size_t align)
+{
+	void *mem = arena_alloc(ctx, size, align);
+	memset(mem, 0, size);
+
+	return mem;
+}
+
+void *MTY_ArenaAlloc(MTY_Arena *ctx, size_t len, size_t size)
+{
+	if (size > 0 && len > SIZE_MAX / size)
+		MTY_LogFatal("Arena allocation of %zu * %zu bytes overflows", len, size);
+
+	// Memory may be reused after MTY_ArenaReset, so it is zeroed here like MTY_Alloc
+	void *mem = arena_alloc(ctx, len * size, 16);
+	memset(mem, 0, len * size);
+
+	return mem;
+}
+
+void *MTY_ArenaDup(MTY_Arena *ctx, const void *mem, size_t size)
+{
+	void *dup = arena_alloc(ctx, size, 16);
+	memcpy(dup, mem, size);
+
+	return dup;
+}
+
+char *MTY_ArenaStrdup(MTY_Arena *ctx, const char *str)
+{
+	return MTY_ArenaDup(ctx, str, strlen(str) + 1);
+}
+
+size_t MTY_ArenaGetMark(MTY_Arena *ctx)
+{
+	return ctx->chunk ? ctx->chunk->base + ctx->chunk->used : 0;
+}
+
+void MTY_ArenaReset(MTY_Arena *ctx, size_t mark)
+{
+	// Chunks past the mark are kept to be reused by later allocations
+	while (ctx->chunk && ctx->chunk->base > mark) {
+		struct arena_chunk *chunk = ctx->chunk;
+		ctx->chunk = chunk->prev;
+
+		chunk->prev = ctx->spare;
+		ctx->spare = chunk;
+	}
+
+	if (ctx->chunk && mark - ctx->chunk->base < ctx->chunk->used)
+		ctx->chunk->used = mark - ctx->chunk->base;
+}
+
+size_t MTY_ArenaGetSize(MTY_Arena *ctx)
+{
+	return ctx->total;
+}
@@ -8,6 +8,7 @@
 #include <string.h>
 
 struct async_state {
+	MTY_Arena *arena;
 	MTY_Async status;
 	uint32_t timeout;
 	bool image;
@@ -36,18 +37,15 @@ static void http_async_free_state(void *opaque)
 	struct async_state *s = opaque;
 
 	if (s) {
-		if (s->req.url)
-			MTY_SecureFree(s->req.url, strlen(s->req.url));
+		MTY_SecureZero(s->req.url, strlen(s->req.url));
+		MTY_SecureZero(s->req.headers, strlen(s->req.headers));
+		MTY_SecureZero(s->req.body, s->req.body_size);
 
-		if (s->req.headers)
-			MTY_SecureFree(s->req.headers, strlen(s->req.headers));
-
-		if (s->req.body && s->req.body_size > 0)
-			MTY_SecureFree(s->req.body, s->req.body_size);
-
-		MTY_Free(s->req.method);
 		MTY_Free(s->res.body);
-		MTY_Free(s);
+
+		// The state and every request string live in the arena
+		MTY_Arena *arena = s->arena;
+		MTY_ArenaDestroy(&arena);
 	}
 }
 
@@ -102,16 +100,19 @@ void MTY_HttpAsyncRequest(uint32_t *index, const char *url, const char *method,
 	if (*index != 0)
 		MTY_ThreadPoolDetach(ASYNC_CTX, *index, http_async_free_state);
 
-	struct async_state *s = MTY_Alloc(1, sizeof(struct async_state));
+	MTY_Arena *arena = MTY_ArenaCreate(4096);
+
+	struct async_state *s = MTY_ArenaAlloc(arena, 1, sizeof(struct async_state));
+	s->arena = arena;
 	s->timeout = timeout;
 	s->image = image;
 
-	s->req.url = MTY_Strdup(url);
-	s->req.method = MTY_Strdup(method);
-	s->req.headers = headers ? MTY_Strdup(headers) : MTY_Alloc(1, 1);
+	s->req.url = MTY_ArenaStrdup(arena, url);
+	s->req.method = MTY_ArenaStrdup(arena, method);
+	s->req.headers = MTY_ArenaStrdup(arena, headers ? headers : "");
 	s->req.body_size = bodySize;
-	s->req.body = body ? MTY_Dup(body, bodySize) : NULL;
-	s->req.proxy = proxy ? MTY_Strdup(proxy) : NULL;
+	s->req.body = body ? MTY_ArenaDup(arena, body, bodySize) : NULL;
+	s->req.proxy = proxy ? MTY_ArenaStrdup(arena, proxy) : NULL;
 
 	*index = MTY_ThreadPoolDispatch(ASYNC_CTX, http_async_thread, s);
 
@@ -0,0 +1,804 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#include "matoya.h"
+
+#include <string.h>
+
+// Frame layout (all integers little-endian):
+//   header:  magic "MTYZ", u8 version, u8 level, u16 reserved, u64 content size
+//   blocks:  u32 packed size (high bit set if stored), u32 raw size, payload
+//   trailer: u32 zero end marker, u32 CRC32 of the decompressed content
+
+// Block payloads are LZ77 sequences: a token byte holding the literal length (high
+// nibble) and match length minus COMPRESS_MIN_MATCH (low nibble), extended with
+// 255 continuation bytes, followed by the literals and a u16 match offset. The
+// final sequence of a block carries only literals.
+
+#define COMPRESS_MAGIC      0x5A59544D
+#define COMPRESS_VERSION    1
+#define COMPRESS_HEADER     16
+#define COMPRESS_BLOCK      (128 * 1024)
+#define COMPRESS_BLOCK_HDR  8
+#define COMPRESS_TRAILER    8
+#define COMPRESS_STORED     0x80000000
+#define COMPRESS_UNKNOWN    UINT64_MAX
+#define COMPRESS_MIN_MATCH  4
+#define COMPRESS_MAX_OFFSET 0xFFFF
+#define COMPRESS_FAST_BITS  14
+#define COMPRESS_HIGH_BITS  15
+#define COMPRESS_HIGH_DEPTH 256
+
+struct compress_state {
+	uint32_t head[1 << COMPRESS_HIGH_BITS];
+	uint16_t chain[COMPRESS_BLOCK];
+	size_t next;
+};
+
+
+// Little-endian helpers
+
+static uint32_t compress_read32(const void *p)
+{
+	uint32_t v = 0;
+	memcpy(&v, p, 4);
+
+	return v;
+}
+
+static uint64_t compress_read64(const void *p)
+{
+	uint64_t v = 0;
+	memcpy(&v, p, 8);
+
+	return v;
+}
+
+static void compress_put_le(uint8_t *p, uint64_t v, uint8_t bytes)
+{
+	for (uint8_t x = 0; x < bytes; x++)
+		p[x] = (uint8_t) (v >> (x * 8));
+}
+
+static uint64_t compress_get_le(const uint8_t *p, uint8_t bytes)
+{
+	uint64_t v = 0;
+
+	for (uint8_t x = 0; x < bytes; x++)
+		v |= (uint64_t) p[x] << (x * 8);
+
+	return v;
+}
+
+
+// Frame
+
+static void compress_write_header(uint8_t *out, MTY_Compression method, uint64_t contentSize)
+{
+	compress_put_le(out, COMPRESS_MAGIC, 4);
+	out[4] = COMPRESS_VERSION;
+	out[5] = (uint8_t) method;
+	compress_put_le(out + 6, 0, 2);
+	compress_put_le(out + 8, contentSize, 8);
+}
+
+static bool compress_read_header(const uint8_t *in, size_t size, uint64_t *contentSize)
+{
+	if (size < COMPRESS_HEADER || compress_get_le(in, 4) != COMPRESS_MAGIC) {
+		MTY_Log("Input is not a compressed frame");
+		return false;
+	}
+
+	if (in[4] != COMPRESS_VERSION) {
+		MTY_Log("Compressed frame version %u is not supported", in[4]);
+		return false;
+	}
+
+	*contentSize = compress_get_le(in + 8, 8);
+
+	return true;
+}
+
+
+// Encoder
+
+static uint32_t compress_hash(uint32_t seq, uint8_t bits)
+{
+	return (seq * 2654435761u) >> (32 - bits);
+}
+
+static size_t compress_match_len(const uint8_t *a, const uint8_t *b, const uint8_t *end)
+{
+	const uint8_t *start = a;
+
+	while (a + 8 <= end && compress_read64(a) == compress_read64(b)) {
+		a += 8;
+		b += 8;
+	}
+
+	while (a < end && *a == *b) {
+		a++;
+		b++;
+	}
+
+	return a - start;
+}
+
+static uint8_t *compress_write_len(uint8_t *op, size_t len)
+{
+	if (len >= 15) {
+		for (len -= 15; len >= 255; len -= 255)
+			*op++ = 255;
+
+		*op++ = (uint8_t) len;
+	}
+
+	return op;
+}
+
+static uint8_t *compress_emit(uint8_t *op, const uint8_t *oend, const uint8_t *lit, size_t litLen,
+	size_t offset, size_t matchLen)
+{
+	size_t ml = matchLen > 0 ? matchLen - COMPRESS_MIN_MATCH : 0;
+	size_t need = 1 + litLen + litLen / 255 + 1 + (matchLen > 0 ? 2 + ml / 255 + 1 : 0);
+
+	if ((size_t) (oend - op) < need)
+		return NULL;
+
+	*op++ = (uint8_t) ((litLen >= 15 ? 15 : litLen) << 4 | (ml >= 15 ? 15 : ml));
+	op = compress_write_len(op, litLen);
+
+	memcpy(op, lit, litLen);
+	op += litLen;
+
+	if (matchLen > 0) {
+		compress_put_le(op, offset, 2);
+		op = compress_write_len(op + 2, ml);
+	}
+
+	return op;
+}
+
+static size_t compress_fast(struct compress_state *s, const uint8_t *in, size_t size,
+	uint8_t *out, size_t outSize)
+{
+	uint8_t *op = out;
+	const uint8_t *oend = out + outSize;
+
+	memset(s->head, 0, sizeof(uint32_t) << COMPRESS_FAST_BITS);
+
+	size_t anchor = 0;
+
+	if (size > COMPRESS_MIN_MATCH) {
+		size_t limit = size - COMPRESS_MIN_MATCH;
+		uint32_t misses = 0;
+
+		for (size_t pos = 0; pos <= limit;) {
+			uint32_t seq = compress_read32(in + pos);
+			uint32_t h = compress_hash(seq, COMPRESS_FAST_BITS);
+			size_t cand = s->head[h];
+			s->head[h] = (uint32_t) pos + 1;
+
+			if (cand-- == 0 || pos - cand > COMPRESS_MAX_OFFSET || compress_read32(in + cand) != seq) {
+				// Skip ahead faster through data that is not compressing
+				pos += 1 + (misses++ >> 6);
+				continue;
+			}
+
+			size_t len = COMPRESS_MIN_MATCH + compress_match_len(in + pos + COMPRESS_MIN_MATCH,
+				in + cand + COMPRESS_MIN_MATCH, in + size);
+
+			while (pos > anchor && cand > 0 && in[pos - 1] == in[cand - 1]) {
+				pos--;
+				cand--;
+				len++;
+			}
+
+			op = compress_emit(op, oend, in + anchor, pos - anchor, pos - cand, len);
+			if (!op)
+				return 0;
+
+			pos += len;
+			anchor = pos;
+			misses = 0;
+
+			if (pos - 2 <= limit)
+				s->head[compress_hash(compress_read32(in + pos - 2), COMPRESS_FAST_BITS)] = (uint32_t) (pos - 2) + 1;
+		}
+	}
+
+	op = compress_emit(op, oend, in + anchor, size - anchor, 0, 0);
+
+	return op ? op - out : 0;
+}
+
+static size_t compress_high_find(struct compress_state *s, const uint8_t *in, size_t pos, size_t size,
+	size_t *offset)
+{
+	// Bring the hash chains up to date with every position before this one
+	for (; s->next < pos; s->next++) {
+		uint32_t h = compress_hash(compress_read32(in + s->next), COMPRESS_HIGH_BITS);
+		size_t prev = s->head[h];
+		size_t delta = prev > 0 ? s->next - (prev - 1) : 0;
+
+		s->chain[s->next] = (uint16_t) (delta <= COMPRESS_MAX_OFFSET ? delta : 0);
+		s->head[h] = (uint32_t) s->next + 1;
+	}
+
+	size_t best = 0;
+	size_t idx = s->head[compress_hash(compress_read32(in + pos), COMPRESS_HIGH_BITS)];
+
+	for (uint32_t x = 0; idx > 0 && x < COMPRESS_HIGH_DEPTH; x++) {
+		size_t cand = idx - 1;
+
+		if (pos - cand > COMPRESS_MAX_OFFSET)
+			break;
+
+		if (in[cand + best] == in[pos + best] && compress_read32(in + cand) == compress_read32(in + pos)) {
+			size_t len = COMPRESS_MIN_MATCH + compress_match_len(in + pos + COMPRESS_MIN_MATCH,
+				in + cand + COMPRESS_MIN_MATCH, in + size);
+
+			if (len > best) {
+				best = len;
+				*offset = pos - cand;
+
+				if (pos + len == size)
+					break;
+			}
+		}
+
+		uint16_t delta = s->chain[cand];
+		idx = delta > 0 ? cand - delta + 1 : 0;
+	}
+
+	return best;
+}
+
+static size_t compress_high(struct compress_state *s, const uint8_t *in, size_t size,
+	uint8_t *out, size_t outSize)
+{
+	uint8_t *op = out;
+	const uint8_t *oend = out + outSize;
+
+	memset(s->head, 0, sizeof(s->head));
+	s->next = 0;
+
+	size_t anchor = 0;
+
+	if (size > COMPRESS_MIN_MATCH) {
+		size_t limit = size - COMPRESS_MIN_MATCH;
+
+		for (size_t pos = 0; pos <= limit;) {
+			size_t offset = 0;
+			size_t len = compress_high_find(s, in, pos, size, &offset);
+
+			if (len < COMPRESS_MIN_MATCH) {
+				pos++;
+				continue;
+			}
+
+			// Lazy evaluation: defer the match if the next position has a longer one
+			while (pos + 1 <= limit) {
+				size_t offset2 = 0;
+				size_t len2 = compress_high_find(s, in, pos + 1, size, &offset2);
+
+				if (len2 <= len)
+					break;
+
+				pos++;
+				len = len2;
+				offset = offset2;
+			}
+
+			op = compress_emit(op, oend, in + anchor, pos - anchor, offset, len);
+			if (!op)
+				return 0;
+
+			pos += len;
+			anchor = pos;
+		}
+	}
+
+	op = compress_emit(op, oend, in + anchor, size - anchor, 0, 0);
+
+	return op ? op - out : 0;
+}
+
+static size_t compress_block(struct compress_state *s, MTY_Compression method, const uint8_t *in,
+	size_t size, uint8_t *out)
+{
+	// Blocks that do not shrink are stored verbatim
+	size_t packed = size > 0 ? method == MTY_COMPRESSION_HIGH ?
+		compress_high(s, in, size, out + COMPRESS_BLOCK_HDR, size - 1) :
+		compress_fast(s, in, size, out + COMPRESS_BLOCK_HDR, size - 1) : 0;
+
+	if (packed == 0) {
+		memcpy(out + COMPRESS_BLOCK_HDR, in, size);
+		compress_put_le(out, size | COMPRESS_STORED, 4);
+
+	} else {
+		compress_put_le(out, packed, 4);
+	}
+
+	compress_put_le(out + 4, size, 4);
+
+	return COMPRESS_BLOCK_HDR + (packed > 0 ? packed : size);
+}
+
+
+// Decoder
+
+static bool decompress_read_len(const uint8_t **ip, const uint8_t *iend, size_t *len)
+{
+	for (uint8_t b = 255; b == 255; *len += b) {
+		if (*ip >= iend)
+			return false;
+
+		b = *(*ip)++;
+	}
+
+	return true;
+}
+
+static bool decompress_block(const uint8_t *in, size_t size, uint8_t *out, size_t outSize)
+{
+	const uint8_t *ip = in;
+	const uint8_t *iend = in + size;
+	uint8_t *op = out;
+	uint8_t *oend = out + outSize;
+
+	while (ip < iend) {
+		uint8_t token = *ip++;
+
+		size_t lit = token >> 4;
+		if (lit == 15 && !decompress_read_len(&ip, iend, &lit))
+			return false;
+
+		if ((size_t) (iend - ip) < lit || (size_t) (oend - op) < lit)
+			return false;
+
+		memcpy(op, ip, lit);
+		ip += lit;
+		op += lit;
+
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return false;
+
+		size_t offset = (size_t) compress_get_le(ip, 2);
+		ip += 2;
+
+		size_t len = token & 0x0F;
+		if (len == 15 && !decompress_read_len(&ip, iend, &len))
+			return false;
+
+		len += COMPRESS_MIN_MATCH;
+
+		if (offset == 0 || offset > (size_t) (op - out) || (size_t) (oend - op) < len)
+			return false;
+
+		const uint8_t *match = op - offset;
+		uint8_t *mend = op + len;
+
+		// Non-overlapping 8 byte chunks are safe to copy wholesale
+		if (offset >= 8) {
+			for (; op + 8 <= mend; op += 8, match += 8)
+				memcpy(op, match, 8);
+		}
+
+		while (op < mend)
+			*op++ = *match++;
+	}
+
+	return op == oend;
+}
+
+
+// Public
+
+void *MTY_Compress(MTY_Compression method, const void *input, size_t inputSize, size_t *outputSize)
+{
+	size_t nblocks = (inputSize + COMPRESS_BLOCK - 1) / COMPRESS_BLOCK;
+	size_t bound = COMPRESS_HEADER + nblocks * COMPRESS_BLOCK_HDR + inputSize + COMPRESS_TRAILER;
+
+	uint8_t *out = MTY_Alloc(bound, 1);
+	struct compress_state *s = MTY_Alloc(1, sizeof(struct compress_state));
+
+	compress_write_header(out, method, inputSize);
+	size_t o = COMPRESS_HEADER;
+
+	const uint8_t *in = input;
+
+	for (size_t x = 0; x < inputSize; x += COMPRESS_BLOCK) {
+		size_t size = inputSize - x < COMPRESS_BLOCK ? inputSize - x : COMPRESS_BLOCK;
+		o += compress_block(s, method, in + x, size, out + o);
+	}
+
+	compress_put_le(out + o, 0, 4);
+	compress_put_le(out + o + 4, MTY_CRC32(0, input, inputSize), 4);
+	o += COMPRESS_TRAILER;
+
+	MTY_Free(s);
+
+	*outputSize = o;
+
+	return MTY_Realloc(out, o, 1);
+}
+
+void *MTY_Decompress(const void *input, size_t inputSize, size_t *outputSize)
+{
+	const uint8_t *in = input;
+	uint64_t content = 0;
+
+	if (!compress_read_header(in, inputSize, &content))
+		return NULL;
+
+	// Validate every block header up front so the output can be allocated once
+	size_t total = 0;
+	size_t o = COMPRESS_HEADER;
+
+	while (true) {
+		if (inputSize - o < 4)
+			goto except;
+
+		uint32_t packed = (uint32_t) compress_get_le(in + o, 4);
+		if (packed == 0)
+			break;
+
+		if (inputSize - o < COMPRESS_BLOCK_HDR)
+			goto except;
+
+		uint32_t raw = (uint32_t) compress_get_le(in + o + 4, 4);
+		size_t psize = packed & ~COMPRESS_STORED;
+
+		if (raw > COMPRESS_BLOCK || ((packed & COMPRESS_STORED) && psize != raw) ||
+			inputSize - o - COMPRESS_BLOCK_HDR < psize)
+			goto except;
+
+		total += raw;
+		o += COMPRESS_BLOCK_HDR + psize;
+	}
+
+	if (inputSize - o < COMPRESS_TRAILER || (content != COMPRESS_UNKNOWN && content != total))
+		goto except;
+
+	uint8_t *out = MTY_Alloc(total + 1, 1);
+	size_t offset = 0;
+
+	o = COMPRESS_HEADER;
+
+	for (uint32_t packed = 0; (packed = (uint32_t) compress_get_le(in + o, 4)) != 0;) {
+		uint32_t raw = (uint32_t) compress_get_le(in + o + 4, 4);
+		size_t psize = packed & ~COMPRESS_STORED;
+		const uint8_t *payload = in + o + COMPRESS_BLOCK_HDR;
+
+		if (packed & COMPRESS_STORED) {
+			memcpy(out + offset, payload, raw);
+
+		} else if (!decompress_block(payload, psize, out + offset, raw)) {
+			MTY_Free(out);
+			goto except;
+		}
+
+		offset += raw;
+		o += COMPRESS_BLOCK_HDR + psize;
+	}
+
+	if (MTY_CRC32(0, out, total) != (uint32_t) compress_get_le(in + o + 4, 4)) {
+		MTY_Log("Compressed frame checksum mismatch");
+		MTY_Free(out);
+		return NULL;
+	}
+
+	*outputSize = total;
+
+	return out;
+
+	except:
+
+	MTY_Log("Compressed frame is corrupt");
+
+	return NULL;
+}
+
+
+// Streaming
+
+enum decompress_stage {
+	DECOMPRESS_HEADER  = 0,
+	DECOMPRESS_BLOCK   = 1,
+	DECOMPRESS_RAW     = 2,
+	DECOMPRESS_PAYLOAD = 3,
+	DECOMPRESS_CRC     = 4,
+	DECOMPRESS_DONE    = 5,
+	DECOMPRESS_ERROR   = 6,
+};
+
+struct MTY_Compressor {
+	MTY_Compression method;
+	struct compress_state *s;
+	uint32_t crc;
+	bool started;
+	bool finish;
+	bool done;
+
+	size_t in_len;
+	size_t out_len;
+	size_t out_pos;
+	uint8_t in[COMPRESS_BLOCK];
+	uint8_t out[COMPRESS_HEADER + COMPRESS_BLOCK_HDR + COMPRESS_BLOCK + COMPRESS_TRAILER];
+};
+
+struct MTY_Decompressor {
+	enum decompress_stage stage;
+	uint64_t content;
+	uint64_t total;
+	uint32_t crc;
+	uint32_t packed;
+	uint32_t raw;
+
+	size_t need;
+	size_t buf_len;
+	size_t out_len;
+	size_t out_pos;
+	uint8_t buf[COMPRESS_BLOCK];
+	uint8_t out[COMPRESS_BLOCK];
+};
+
+MTY_Compressor *MTY_CompressorCreate(MTY_Compression method)
+{
+	MTY_Compressor *ctx = MTY_Alloc(1, sizeof(MTY_Compressor));
+	ctx->method = method;
+	ctx->s = MTY_Alloc(1, sizeof(struct compress_state));
+
+	return ctx;
+}
+
+void MTY_CompressorDestroy(MTY_Compressor **compressor)
+{
+	if (!compressor || !*compressor)
+		return;
+
+	MTY_Compressor *ctx = *compressor;
+
+	MTY_Free(ctx->s);
+
+	MTY_Free(ctx);
+	*compressor = NULL;
+}
+
+static bool compressor_encode(MTY_Compressor *ctx)
+{
+	// Output must be fully drained before the next block is encoded
+	if (ctx->out_pos < ctx->out_len)
+		return false;
+
+	ctx->out_len = ctx->out_pos = 0;
+
+	if (!ctx->started) {
+		compress_write_header(ctx->out, ctx->method, COMPRESS_UNKNOWN);
+		ctx->out_len = COMPRESS_HEADER;
+		ctx->started = true;
+	}
+
+	if (ctx->in_len > 0) {
+		ctx->out_len += compress_block(ctx->s, ctx->method, ctx->in, ctx->in_len, ctx->out + ctx->out_len);
+		ctx->in_len = 0;
+	}
+
+	if (ctx->finish) {
+		compress_put_le(ctx->out + ctx->out_len, 0, 4);
+		compress_put_le(ctx->out + ctx->out_len + 4, ctx->crc, 4);
+		ctx->out_len += COMPRESS_TRAILER;
+		ctx->done = true;
+	}
+
+	return true;
+}
+
+size_t MTY_CompressorPush(MTY_Compressor *ctx, const void *input, size_t size)
+{
+	const uint8_t *in = input;
+	size_t consumed = 0;
+
+	while (consumed < size && !ctx->finish) {
+		if (ctx->in_len == COMPRESS_BLOCK && !compressor_encode(ctx))
+			break;
+
+		size_t n = COMPRESS_BLOCK - ctx->in_len;
+		if (n > size - consumed)
+			n = size - consumed;
+
+		memcpy(ctx->in + ctx->in_len, in + consumed, n);
+		ctx->crc = MTY_CRC32(ctx->crc, in + consumed, n);
+		ctx->in_len += n;
+		consumed += n;
+	}
+
+	return consumed;
+}
+
+size_t MTY_CompressorPull(MTY_Compressor *ctx, void *output, size_t size)
+{
+	uint8_t *out = output;
+	size_t written = 0;
+
+	while (written < size) {
+		if (ctx->out_pos == ctx->out_len) {
+			if (ctx->done || (ctx->in_len < COMPRESS_BLOCK && !ctx->finish))
+				break;
+
+			compressor_encode(ctx);
+		}
+
+		size_t n = ctx->out_len - ctx->out_pos;
+		if (n > size - written)
+			n = size - written;
+
+		memcpy(out + written, ctx->out + ctx->out_pos, n);
+		ctx->out_pos += n;
+		written += n;
+	}
+
+	return written;
+}
+
+void MTY_CompressorFlush(MTY_Compressor *ctx)
+{
+	ctx->finish = true;
+}
+
+MTY_Decompressor *MTY_DecompressorCreate(void)
+{
+	MTY_Decompressor *ctx = MTY_Alloc(1, sizeof(MTY_Decompressor));
+	ctx->need = COMPRESS_HEADER;
+
+	return ctx;
+}
+
+void MTY_DecompressorDestroy(MTY_Decompressor **decompressor)
+{
+	if (!decompressor || !*decompressor)
+		return;
+
+	MTY_Decompressor *ctx = *decompressor;
+
+	MTY_Free(ctx);
+	*decompressor = NULL;
+}
+
+static void decompressor_next(MTY_Decompressor *ctx, enum decompress_stage stage, size_t need)
+{
+	ctx->stage = stage;
+	ctx->need = need;
+	ctx->buf_len = 0;
+}
+
+static bool decompressor_process(MTY_Decompressor *ctx)
+{
+	switch (ctx->stage) {
+		case DECOMPRESS_HEADER:
+			if (!compress_read_header(ctx->buf, ctx->buf_len, &ctx->content)) {
+				ctx->stage = DECOMPRESS_ERROR;
+				break;
+			}
+
+			decompressor_next(ctx, DECOMPRESS_BLOCK, 4);
+			break;
+		case DECOMPRESS_BLOCK:
+			ctx->packed = (uint32_t) compress_get_le(ctx->buf, 4);
+			decompressor_next(ctx, ctx->packed == 0 ? DECOMPRESS_CRC : DECOMPRESS_RAW, 4);
+			break;
+		case DECOMPRESS_RAW: {
+			ctx->raw = (uint32_t) compress_get_le(ctx->buf, 4);
+			size_t psize = ctx->packed & ~COMPRESS_STORED;
+
+			if (ctx->raw > COMPRESS_BLOCK || psize > COMPRESS_BLOCK ||
+				((ctx->packed & COMPRESS_STORED) && psize != ctx->raw))
+			{
+				MTY_Log("Compressed frame is corrupt");
+				ctx->stage = DECOMPRESS_ERROR;
+				break;
+			}
+
+			decompressor_next(ctx, DECOMPRESS_PAYLOAD, psize);
+			break;
+		}
+		case DECOMPRESS_PAYLOAD:
+			if (ctx->out_pos < ctx->out_len)
+				return false;
+
+			if (ctx->packed & COMPRESS_STORED) {
+				memcpy(ctx->out, ctx->buf, ctx->raw);
+
+			} else if (!decompress_block(ctx->buf, ctx->buf_len, ctx->out, ctx->raw)) {
+				MTY_Log("Compressed frame is corrupt");
+				ctx->stage = DECOMPRESS_ERROR;
+				break;
+			}
+
+			ctx->crc = MTY_CRC32(ctx->crc, ctx->out, ctx->raw);
+			ctx->total += ctx->raw;
+			ctx->out_len = ctx->raw;
+			ctx->out_pos = 0;
+
+			decompressor_next(ctx, DECOMPRESS_BLOCK, 4);
+			break;
+		case DECOMPRESS_CRC:
+			if ((uint32_t) compress_get_le(ctx->buf, 4) != ctx->crc ||
+				(ctx->content != COMPRESS_UNKNOWN && ctx->content != ctx->total))
+			{
+				MTY_Log("Compressed frame checksum mismatch");
+				ctx->stage = DECOMPRESS_ERROR;
+				break;
+			}
+
+			decompressor_next(ctx, DECOMPRESS_DONE, 0);
+			break;
+	}
+
+	return true;
+}
+
+static void decompressor_run(MTY_Decompressor *ctx)
+{
+	while (ctx->stage < DECOMPRESS_DONE && ctx->buf_len == ctx->need)
+		if (!decompressor_process(ctx))
+			break;
+}
+
+bool MTY_DecompressorPush(MTY_Decompressor *ctx, const void *input, size_t size, size_t *consumed)
+{
+	const uint8_t *in = input;
+	*consumed = 0;
+
+	while (ctx->stage < DECOMPRESS_DONE) {
+		decompressor_run(ctx);
+
+		if (ctx->buf_len == ctx->need || *consumed == size || ctx->stage >= DECOMPRESS_DONE)
+			break;
+
+		size_t n = ctx->need - ctx->buf_len;
+		if (n > size - *consumed)
+			n = size - *consumed;
+
+		memcpy(ctx->buf + ctx->buf_len, in + *consumed, n);
+		ctx->buf_len += n;
+		*consumed += n;
+	}
+
+	return ctx->stage != DECOMPRESS_ERROR;
+}
+
+size_t MTY_DecompressorPull(MTY_Decompressor *ctx, void *output, size_t size)
+{
+	uint8_t *out = output;
+	size_t written = 0;
+
+	while (written < size) {
+		if (ctx->out_pos == ctx->out_len) {
+			decompressor_run(ctx);
+
+			if (ctx->out_pos == ctx->out_len)
+				break;
+		}
+
+		size_t n = ctx->out_len - ctx->out_pos;
+		if (n > size - written)
+			n = size - written;
+
+		memcpy(out + written, ctx->out + ctx->out_pos, n);
+		ctx->out_pos += n;
+		written += n;
+	}
+
+	return written;
+}
+
+bool MTY_DecompressorDone(MTY_Decompressor *ctx)
+{
+	return ctx->stage == DECOMPRESS_DONE && ctx->out_pos == ctx->out_len;
+}
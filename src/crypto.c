@@ -7,47 +7,45 @@
 #include <limits.h>
 #include <string.h>
 
-static const uint32_t CRYPTO_CRC_TABLE[0x100] = {
-	0xD202EF8D, 0xA505DF1B, 0x3C0C8EA1, 0x4B0BBE37, 0xD56F2B94, 0xA2681B02, 0x3B614AB8, 0x4C667A2E,
-	0xDCD967BF, 0xABDE5729, 0x32D70693, 0x45D03605, 0xDBB4A3A6, 0xACB39330, 0x35BAC28A, 0x42BDF21C,
-	0xCFB5FFE9, 0xB8B2CF7F, 0x21BB9EC5, 0x56BCAE53, 0xC8D83BF0, 0xBFDF0B66, 0x26D65ADC, 0x51D16A4A,
-	0xC16E77DB, 0xB669474D, 0x2F6016F7, 0x58672661, 0xC603B3C2, 0xB1048354, 0x280DD2EE, 0x5F0AE278,
-	0xE96CCF45, 0x9E6BFFD3, 0x0762AE69, 0x70659EFF, 0xEE010B5C, 0x99063BCA, 0x000F6A70, 0x77085AE6,
-	0xE7B74777, 0x90B077E1, 0x09B9265B, 0x7EBE16CD, 0xE0DA836E, 0x97DDB3F8, 0x0ED4E242, 0x79D3D2D4,
-	0xF4DBDF21, 0x83DCEFB7, 0x1AD5BE0D, 0x6DD28E9B, 0xF3B61B38, 0x84B12BAE, 0x1DB87A14, 0x6ABF4A82,
-	0xFA005713, 0x8D076785, 0x140E363F, 0x630906A9, 0xFD6D930A, 0x8A6AA39C, 0x1363F226, 0x6464C2B0,
-	0xA4DEAE1D, 0xD3D99E8B, 0x4AD0CF31, 0x3DD7FFA7, 0xA3B36A04, 0xD4B45A92, 0x4DBD0B28, 0x3ABA3BBE,
-	0xAA05262F, 0xDD0216B9, 0x440B4703, 0x330C7795, 0xAD68E236, 0xDA6FD2A0, 0x4366831A, 0x3461B38C,
-	0xB969BE79, 0xCE6E8EEF, 0x5767DF55, 0x2060EFC3, 0xBE047A60, 0xC9034AF6, 0x500A1B4C, 0x270D2BDA,
-	0xB7B2364B, 0xC0B506DD, 0x59BC5767, 0x2EBB67F1, 0xB0DFF252, 0xC7D8C2C4, 0x5ED1937E, 0x29D6A3E8,
-	0x9FB08ED5, 0xE8B7BE43, 0x71BEEFF9, 0x06B9DF6F, 0x98DD4ACC, 0xEFDA7A5A, 0x76D32BE0, 0x01D41B76,
-	0x916B06E7, 0xE66C3671, 0x7F6567CB, 0x0862575D, 0x9606C2FE, 0xE101F268, 0x7808A3D2, 0x0F0F9344,
-	0x82079EB1, 0xF500AE27, 0x6C09FF9D, 0x1B0ECF0B, 0x856A5AA8, 0xF26D6A3E, 0x6B643B84, 0x1C630B12,
-	0x8CDC1683, 0xFBDB2615, 0x62D277AF, 0x15D54739, 0x8BB1D29A, 0xFCB6E20C, 0x65BFB3B6, 0x12B88320,
-	0x3FBA6CAD, 0x48BD5C3B, 0xD1B40D81, 0xA6B33D17, 0x38D7A8B4, 0x4FD09822, 0xD6D9C998, 0xA1DEF90E,
-	0x3161E49F, 0x4666D409, 0xDF6F85B3, 0xA868B525, 0x360C2086, 0x410B1010, 0xD80241AA, 0xAF05713C,
-	0x220D7CC9, 0x550A4C5F, 0xCC031DE5, 0xBB042D73, 0x2560B8D0, 0x52678846, 0xCB6ED9FC, 0xBC69E96A,
-	0x2CD6F4FB, 0x5BD1C46D, 0xC2D895D7, 0xB5DFA541, 0x2BBB30E2, 0x5CBC0074, 0xC5B551CE, 0xB2B26158,
-	0x04D44C65, 0x73D37CF3, 0xEADA2D49, 0x9DDD1DDF, 0x03B9887C, 0x74BEB8EA, 0xEDB7E950, 0x9AB0D9C6,
-	0x0A0FC457, 0x7D08F4C1, 0xE401A57B, 0x930695ED, 0x0D62004E, 0x7A6530D8, 0xE36C6162, 0x946B51F4,
-	0x19635C01, 0x6E646C97, 0xF76D3D2D, 0x806A0DBB, 0x1E0E9818, 0x6909A88E, 0xF000F934, 0x8707C9A2,
-	0x17B8D433, 0x60BFE4A5, 0xF9B6B51F, 0x8EB18589, 0x10D5102A, 0x67D220BC, 0xFEDB7106, 0x89DC4190,
-	0x49662D3D, 0x3E611DAB, 0xA7684C11, 0xD06F7C87, 0x4E0BE924, 0x390CD9B2, 0xA0058808, 0xD702B89E,
-	0x47BDA50F, 0x30BA9599, 0xA9B3C423, 0xDEB4F4B5, 0x40D06116, 0x37D75180, 0xAEDE003A, 0xD9D930AC,
-	0x54D13D59, 0x23D60DCF, 0xBADF5C75, 0xCDD86CE3, 0x53BCF940, 0x24BBC9D6, 0xBDB2986C, 0xCAB5A8FA,
-	0x5A0AB56B, 0x2D0D85FD, 0xB404D447, 0xC303E4D1, 0x5D677172, 0x2A6041E4, 0xB369105E, 0xC46E20C8,
-	0x72080DF5, 0x050F3D63, 0x9C066CD9, 0xEB015C4F, 0x7565C9EC, 0x0262F97A, 0x9B6BA8C0, 0xEC6C9856,
-	0x7CD385C7, 0x0BD4B551, 0x92DDE4EB, 0xE5DAD47D, 0x7BBE41DE, 0x0CB97148, 0x95B020F2, 0xE2B71064,
-	0x6FBF1D91, 0x18B82D07, 0x81B17CBD, 0xF6B64C2B, 0x68D2D988, 0x1FD5E91E, 0x86DCB8A4, 0xF1DB8832,
-	0x616495A3, 0x1663A535, 0x8F6AF48F, 0xF86DC419, 0x660951BA, 0x110E612C, 0x88073096, 0xFF000000
-};
+#if defined(__x86_64__) || defined(_M_X64)
+	#define CRYPTO_X86
+	#include <tmmintrin.h>
+	#include <nmmintrin.h>
+	#include <wmmintrin.h>
+
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define CRYPTO_TARGET(t)
+	#else
+		#include <cpuid.h>
+		#define CRYPTO_TARGET(t) __attribute__((target(t)))
+	#endif
+
+#else
+	#if defined(__aarch64__)
+		#define CRYPTO_NEON
+		#include <arm_neon.h>
+	#endif
+
+	#if defined(__ARM_FEATURE_CRC32)
+		#define CRYPTO_CRC_ARM
+		#include <arm_acle.h>
+	#endif
+#endif
+
+#include "crypto.h"
+#include "crypto-crc.h"
+#include "file.h"
+
+#define CRYPTO_BLOCK_SIZE 64
+#define CRYPTO_FILE_CHUNK (256 * 1024)
 
 static const char CRYPTO_HEX[16] = {
 	'0', '1', '2', '3', '4', '5', '6', '7',
 	'8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
 };
 
-static const char CRYPTO_HEX_REVERSE[UCHAR_MAX] = {
+static const char CRYPTO_HEX_REVERSE[UCHAR_MAX + 1] = {
 	['0'] = 0,   ['1'] = 1,   ['2'] = 2,   ['3'] = 3,
 	['4'] = 4,   ['5'] = 5,   ['6'] = 6,   ['7'] = 7,
 	['8'] = 8,   ['9'] = 9,   ['a'] = 0xa, ['b'] = 0xb,
@@ -56,14 +54,237 @@ static const char CRYPTO_HEX_REVERSE[UCHAR_MAX] = {
 	['E'] = 0xe, ['F'] = 0xf,
 };
 
+static const char CRYPTO_BASE64[64] = {
+	'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
+	'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
+	'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
+	'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/',
+};
+
+
+// CPU features
+
+#if defined(CRYPTO_X86)
+
+#define CRYPTO_CPU_INIT  0x01
+#define CRYPTO_CPU_CLMUL 0x02 // PCLMULQDQ and SSE4.1
+#define CRYPTO_CPU_SSE42 0x04
+#define CRYPTO_CPU_SSSE3 0x08
+
+static MTY_Atomic32 CRYPTO_CPU;
+
+static uint32_t crypto_cpu(void)
+{
+	uint32_t cpu = MTY_Atomic32Get(&CRYPTO_CPU);
+
+	if (cpu == 0) {
+		uint32_t ecx = 0;
+
+		#if defined(_MSC_VER)
+			int32_t info[4] = {0};
+			__cpuid(info, 1);
+			ecx = info[2];
+		#else
+			uint32_t eax = 0, ebx = 0, edx = 0;
+			__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+		#endif
+
+		cpu = CRYPTO_CPU_INIT;
+
+		if ((ecx & (1 << 1)) && (ecx & (1 << 19)))
+			cpu |= CRYPTO_CPU_CLMUL;
+
+		if (ecx & (1 << 20))
+			cpu |= CRYPTO_CPU_SSE42;
+
+		if (ecx & (1 << 9))
+			cpu |= CRYPTO_CPU_SSSE3;
+
+		MTY_Atomic32Set(&CRYPTO_CPU, cpu);
+	}
+
+	return cpu;
+}
+
+#endif
+
+
+// CRC
+
+// Both CRCs are computed like zlib's crc32, the running value is inverted before and
+// after each call so the functions can be chained
+
+static uint32_t crypto_load32(const uint8_t *buf)
+{
+	return (uint32_t) buf[0] | (uint32_t) buf[1] << 8 | (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24;
+}
+
+static uint32_t crypto_crc_slice8(const uint32_t (*t)[256], uint32_t crc, const uint8_t *buf, size_t size)
+{
+	for (; size >= 8; size -= 8, buf += 8) {
+		uint32_t lo = crypto_load32(buf) ^ crc;
+		uint32_t hi = crypto_load32(buf + 4);
+
+		crc = t[7][lo & 0xFF] ^ t[6][lo >> 8 & 0xFF] ^ t[5][lo >> 16 & 0xFF] ^ t[4][lo >> 24] ^
+			t[3][hi & 0xFF] ^ t[2][hi >> 8 & 0xFF] ^ t[1][hi >> 16 & 0xFF] ^ t[0][hi >> 24];
+	}
+
+	for (; size > 0; size--, buf++)
+		crc = t[0][(crc ^ *buf) & 0xFF] ^ crc >> 8;
+
+	return crc;
+}
+
+#if defined(CRYPTO_X86)
+
+#define CRYPTO_CLMUL_MIN 64
+
+CRYPTO_TARGET("pclmul,sse4.1")
+static uint32_t crypto_crc32_clmul(uint32_t crc, const uint8_t *buf, size_t size)
+{
+	// Four 128-bit lanes are folded across the input in parallel, then folded into one
+	// and reduced to 32 bits with a Barrett reduction, see "Fast CRC Computation for
+	// Generic Polynomials Using PCLMULQDQ Instruction" from Intel. The size must be a
+	// multiple of 16, and at least CRYPTO_CLMUL_MIN
+
+	const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+	const __m128i k5 = _mm_set_epi64x(0, 0x0163CD6124);
+	const __m128i poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1 = _mm_loadu_si128((const __m128i *) (buf + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i *) (buf + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i *) (buf + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i *) (buf + 0x30));
+
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+
+	for (buf += 64, size -= 64; size >= 64; buf += 64, size -= 64) {
+		__m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		__m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		__m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		__m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *) (buf + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *) (buf + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *) (buf + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *) (buf + 0x30)));
+	}
+
+	// Fold the lanes into one, then any remaining 16 byte blocks
+	__m128i lanes[3] = {x2, x3, x4};
+
+	for (size_t x = 0; x < 3 + size / 16; x++) {
+		__m128i next = x < 3 ? lanes[x] : _mm_loadu_si128((const __m128i *) (buf + (x - 3) * 16));
+		__m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), next);
+	}
+
+	// 128 to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (uint32_t) _mm_extract_epi32(x1, 1);
+}
+
+CRYPTO_TARGET("sse4.2")
+static uint32_t crypto_crc32c_sse42(uint32_t crc, const uint8_t *buf, size_t size)
+{
+	uint64_t crc64 = crc;
+
+	for (; size >= 8; size -= 8, buf += 8) {
+		uint64_t v = 0;
+		memcpy(&v, buf, 8);
+
+		crc64 = _mm_crc32_u64(crc64, v);
+	}
+
+	crc = (uint32_t) crc64;
+
+	for (; size > 0; size--, buf++)
+		crc = _mm_crc32_u8(crc, *buf);
+
+	return crc;
+}
+
+#elif defined(CRYPTO_CRC_ARM)
+
+static uint32_t crypto_crc_arm(uint32_t crc, const uint8_t *buf, size_t size, bool castagnoli)
+{
+	for (; size >= 8; size -= 8, buf += 8) {
+		uint64_t v = 0;
+		memcpy(&v, buf, 8);
+
+		crc = castagnoli ? __crc32cd(crc, v) : __crc32d(crc, v);
+	}
+
+	for (; size > 0; size--, buf++)
+		crc = castagnoli ? __crc32cb(crc, *buf) : __crc32b(crc, *buf);
+
+	return crc;
+}
+
+#endif
+
 uint32_t MTY_CRC32(uint32_t crc, const void *buf, size_t size)
 {
 	const uint8_t *buf8 = buf;
+	crc = ~crc;
 
-	for (size_t x = 0; x < size; x++)
-		crc = CRYPTO_CRC_TABLE[(crc & 0xFF) ^ buf8[x]] ^ crc >> 8;
+	#if defined(CRYPTO_X86)
+		if (size >= CRYPTO_CLMUL_MIN && (crypto_cpu() & CRYPTO_CPU_CLMUL)) {
+			size_t blocks = size & ~(size_t) 0xF;
 
-	return crc;
+			crc = crypto_crc32_clmul(crc, buf8, blocks);
+			buf8 += blocks;
+			size -= blocks;
+		}
+
+		crc = crypto_crc_slice8(CRYPTO_CRC32_TABLE, crc, buf8, size);
+
+	#elif defined(CRYPTO_CRC_ARM)
+		crc = crypto_crc_arm(crc, buf8, size, false);
+
+	#else
+		crc = crypto_crc_slice8(CRYPTO_CRC32_TABLE, crc, buf8, size);
+	#endif
+
+	return ~crc;
+}
+
+uint32_t MTY_CRC32C(uint32_t crc, const void *buf, size_t size)
+{
+	crc = ~crc;
+
+	#if defined(CRYPTO_X86)
+		crc = (crypto_cpu() & CRYPTO_CPU_SSE42) ? crypto_crc32c_sse42(crc, buf, size) :
+			crypto_crc_slice8(CRYPTO_CRC32C_TABLE, crc, buf, size);
+
+	#elif defined(CRYPTO_CRC_ARM)
+		crc = crypto_crc_arm(crc, buf, size, true);
+
+	#else
+		crc = crypto_crc_slice8(CRYPTO_CRC32C_TABLE, crc, buf, size);
+	#endif
+
+	return ~crc;
 }
 
 uint32_t MTY_DJB2(const char *str)
@@ -76,30 +297,171 @@ uint32_t MTY_DJB2(const char *str)
 	return hash;
 }
 
+
+// Hex
+
+// The SIMD paths handle 16 bytes at a time and stop early on anything they can not
+// handle, the scalar code then finishes the remainder and reports errors
+
+#if defined(CRYPTO_X86)
+
+static __m128i crypto_hex_ascii_sse2(__m128i n)
+{
+	__m128i letters = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+
+	return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), letters);
+}
+
+static size_t crypto_hex_encode_sse2(const uint8_t *bytes, size_t size, char *hex)
+{
+	size_t x = 0;
+
+	for (; size - x >= 16; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (bytes + x));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+		__m128i lo = _mm_and_si128(v, _mm_set1_epi8(0x0F));
+
+		_mm_storeu_si128((__m128i *) (hex + x * 2), crypto_hex_ascii_sse2(_mm_unpacklo_epi8(hi, lo)));
+		_mm_storeu_si128((__m128i *) (hex + x * 2 + 16), crypto_hex_ascii_sse2(_mm_unpackhi_epi8(hi, lo)));
+	}
+
+	return x;
+}
+
+static __m128i crypto_hex_value_sse2(__m128i c, __m128i *valid)
+{
+	__m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+	__m128i l = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+
+	// Unsigned <= by comparing against the minimum
+	__m128i is_d = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+	__m128i is_l = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+
+	*valid = _mm_and_si128(*valid, _mm_or_si128(is_d, is_l));
+
+	return _mm_or_si128(_mm_and_si128(is_d, d), _mm_and_si128(is_l, _mm_add_epi8(l, _mm_set1_epi8(10))));
+}
+
+static __m128i crypto_hex_pairs_sse2(__m128i v)
+{
+	// Each 16-bit lane holds the high nibble in its first byte and the low in its second
+	return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0xFF)), 4), _mm_srli_epi16(v, 8));
+}
+
+static size_t crypto_hex_decode_sse2(const char *hex, uint8_t *bytes, size_t size)
+{
+	size_t x = 0;
+
+	for (; size - x >= 16; x += 16) {
+		__m128i valid = _mm_set1_epi8(-1);
+		__m128i a = crypto_hex_value_sse2(_mm_loadu_si128((const __m128i *) (hex + x * 2)), &valid);
+		__m128i b = crypto_hex_value_sse2(_mm_loadu_si128((const __m128i *) (hex + x * 2 + 16)), &valid);
+
+		if (_mm_movemask_epi8(valid) != 0xFFFF)
+			break;
+
+		_mm_storeu_si128((__m128i *) (bytes + x), _mm_packus_epi16(crypto_hex_pairs_sse2(a), crypto_hex_pairs_sse2(b)));
+	}
+
+	return x;
+}
+
+#elif defined(CRYPTO_NEON)
+
+static size_t crypto_hex_encode_neon(const uint8_t *bytes, size_t size, char *hex)
+{
+	uint8x16_t table = vld1q_u8((const uint8_t *) CRYPTO_HEX);
+	size_t x = 0;
+
+	for (; size - x >= 16; x += 16) {
+		uint8x16_t v = vld1q_u8(bytes + x);
+
+		uint8x16x2_t out;
+		out.val[0] = vqtbl1q_u8(table, vshrq_n_u8(v, 4));
+		out.val[1] = vqtbl1q_u8(table, vandq_u8(v, vdupq_n_u8(0x0F)));
+
+		vst2q_u8((uint8_t *) hex + x * 2, out);
+	}
+
+	return x;
+}
+
+static uint8x16_t crypto_hex_value_neon(uint8x16_t c)
+{
+	uint8x16_t d = vsubq_u8(c, vdupq_n_u8('0'));
+	uint8x16_t l = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+
+	uint8x16_t v = vdupq_n_u8(0xFF);
+	v = vbslq_u8(vcltq_u8(d, vdupq_n_u8(10)), d, v);
+	v = vbslq_u8(vcltq_u8(l, vdupq_n_u8(6)), vaddq_u8(l, vdupq_n_u8(10)), v);
+
+	return v;
+}
+
+static size_t crypto_hex_decode_neon(const char *hex, uint8_t *bytes, size_t size)
+{
+	size_t x = 0;
+
+	for (; size - x >= 16; x += 16) {
+		uint8x16x2_t in = vld2q_u8((const uint8_t *) hex + x * 2);
+		uint8x16_t hi = crypto_hex_value_neon(in.val[0]);
+		uint8x16_t lo = crypto_hex_value_neon(in.val[1]);
+
+		if (vmaxvq_u8(vorrq_u8(hi, lo)) > 0x0F)
+			break;
+
+		vst1q_u8(bytes + x, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+	}
+
+	return x;
+}
+
+#endif
+
 void MTY_BytesToHex(const void *bytes, size_t size, char *hex, size_t hexSize)
 {
+	if (hexSize == 0)
+		return;
+
+	if (size > (hexSize - 1) / 2) {
+		MTY_Log("'hex' not large enough, truncated");
+		size = (hexSize - 1) / 2;
+	}
+
 	const uint8_t *bytes8 = bytes;
-	size_t offset = 0;
+	size_t x = 0;
 
-	for (size_t x = 0; x < size; x++, offset += 2) {
-		if (offset + 2 >= hexSize) {
-			MTY_Log("'hex' not large enough, truncated");
-			break;
-		}
+	#if defined(CRYPTO_X86)
+		x = crypto_hex_encode_sse2(bytes8, size, hex);
 
+	#elif defined(CRYPTO_NEON)
+		x = crypto_hex_encode_neon(bytes8, size, hex);
+	#endif
+
+	for (; x < size; x++) {
 		uint8_t byte = bytes8[x];
-		hex[offset] = CRYPTO_HEX[byte >> 4];
-		hex[offset + 1] = CRYPTO_HEX[byte & 0x0F];
+		hex[x * 2] = CRYPTO_HEX[byte >> 4];
+		hex[x * 2 + 1] = CRYPTO_HEX[byte & 0x0F];
 	}
 
-	hex[offset] = '\0';
+	hex[size * 2] = '\0';
 }
 
 void MTY_HexToBytes(const char *hex, void *bytes, size_t size)
 {
 	uint8_t *bytes8 = bytes;
+	size_t len = strlen(hex);
+	size_t pairs = len / 2 < size ? len / 2 : size;
+	size_t x = 0;
+
+	#if defined(CRYPTO_X86)
+		x = crypto_hex_decode_sse2(hex, bytes8, pairs) * 2;
+
+	#elif defined(CRYPTO_NEON)
+		x = crypto_hex_decode_neon(hex, bytes8, pairs) * 2;
+	#endif
 
-	for (size_t x = 0; x < strlen(hex); x++) {
+	for (; x < len; x++) {
 		size_t i = x / 2;
 		uint8_t c = hex[x];
 		uint8_t v = CRYPTO_HEX_REVERSE[c];
@@ -118,22 +480,433 @@ void MTY_HexToBytes(const char *hex, void *bytes, size_t size)
 	}
 }
 
+
+// Base64
+
+#if defined(CRYPTO_X86)
+
+// See "Faster Base64 Encoding and Decoding Using AVX2 Instructions" by Muła and
+// Lemire, these are the 128-bit versions
+
+CRYPTO_TARGET("ssse3")
+static size_t crypto_base64_encode_ssse3(const uint8_t *bytes, size_t size, char *base64)
+{
+	const __m128i shuf = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+
+	size_t x = 0;
+	char *out = base64;
+
+	// Each iteration reads 16 bytes but only consumes 12
+	for (; size - x >= 16; x += 12, out += 16) {
+		__m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (bytes + x)), shuf);
+
+		// Split each group of 3 bytes into four 6-bit indices, one per byte
+		__m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+		__m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+		__m128i indices = _mm_or_si128(t0, t1);
+
+		// Offset from each index to its character, selected by which range it falls in
+		__m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+		range = _mm_sub_epi8(range, _mm_cmpgt_epi8(indices, _mm_set1_epi8(25)));
+
+		_mm_storeu_si128((__m128i *) out, _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range)));
+	}
+
+	return x;
+}
+
+CRYPTO_TARGET("ssse3")
+static size_t crypto_base64_decode_ssse3(const char *base64, size_t len, uint8_t *bytes, size_t size)
+{
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2f = _mm_set1_epi8(0x2F);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+	size_t x = 0;
+	size_t o = 0;
+
+	// Each iteration writes 16 bytes but only produces 12
+	for (; len - x >= 16 && size - o >= 16; x += 16, o += 12) {
+		__m128i in = _mm_loadu_si128((const __m128i *) (base64 + x));
+
+		// A character is valid when the bits selected by its low and high nibbles
+		// have nothing in common
+		__m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+		__m128i lo = _mm_shuffle_epi8(lut_lo, _mm_and_si128(in, mask_2f));
+		__m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF)
+			break;
+
+		__m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(in, mask_2f), hi_nibbles));
+		in = _mm_add_epi8(in, roll);
+
+		// Merge four 6-bit values into 3 bytes
+		in = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+		in = _mm_madd_epi16(in, _mm_set1_epi32(0x00011000));
+
+		_mm_storeu_si128((__m128i *) (bytes + o), _mm_shuffle_epi8(in, pack));
+	}
+
+	return x;
+}
+
+#elif defined(CRYPTO_NEON)
+
+static size_t crypto_base64_encode_neon(const uint8_t *bytes, size_t size, char *base64)
+{
+	const uint8_t *table8 = (const uint8_t *) CRYPTO_BASE64;
+
+	uint8x16x4_t table;
+	for (uint8_t x = 0; x < 4; x++)
+		table.val[x] = vld1q_u8(table8 + x * 16);
+
+	size_t x = 0;
+	uint8_t *out = (uint8_t *) base64;
+
+	for (; size - x >= 48; x += 48, out += 64) {
+		uint8x16x3_t in = vld3q_u8(bytes + x);
+		uint8x16_t mask = vdupq_n_u8(0x3F);
+
+		uint8x16x4_t indices;
+		indices.val[0] = vshrq_n_u8(in.val[0], 2);
+		indices.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+		indices.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+		indices.val[3] = vandq_u8(in.val[2], mask);
+
+		for (uint8_t y = 0; y < 4; y++)
+			indices.val[y] = vqtbl4q_u8(table, indices.val[y]);
+
+		vst4q_u8(out, indices);
+	}
+
+	return x;
+}
+
+static uint8x16_t crypto_base64_value_neon(uint8x16_t c)
+{
+	uint8x16_t upper = vsubq_u8(c, vdupq_n_u8('A'));
+	uint8x16_t lower = vsubq_u8(c, vdupq_n_u8('a'));
+	uint8x16_t digit = vsubq_u8(c, vdupq_n_u8('0'));
+
+	uint8x16_t v = vdupq_n_u8(0xFF);
+	v = vbslq_u8(vcltq_u8(upper, vdupq_n_u8(26)), upper, v);
+	v = vbslq_u8(vcltq_u8(lower, vdupq_n_u8(26)), vaddq_u8(lower, vdupq_n_u8(26)), v);
+	v = vbslq_u8(vcltq_u8(digit, vdupq_n_u8(10)), vaddq_u8(digit, vdupq_n_u8(52)), v);
+	v = vbslq_u8(vceqq_u8(c, vdupq_n_u8('+')), vdupq_n_u8(62), v);
+	v = vbslq_u8(vceqq_u8(c, vdupq_n_u8('/')), vdupq_n_u8(63), v);
+
+	return v;
+}
+
+static size_t crypto_base64_decode_neon(const char *base64, size_t len, uint8_t *bytes, size_t size)
+{
+	size_t x = 0;
+	size_t o = 0;
+
+	for (; len - x >= 64 && size - o >= 48; x += 64, o += 48) {
+		uint8x16x4_t in = vld4q_u8((const uint8_t *) base64 + x);
+
+		for (uint8_t y = 0; y < 4; y++)
+			in.val[y] = crypto_base64_value_neon(in.val[y]);
+
+		uint8x16_t all = vorrq_u8(vorrq_u8(in.val[0], in.val[1]), vorrq_u8(in.val[2], in.val[3]));
+		if (vmaxvq_u8(all) > 63)
+			break;
+
+		uint8x16x3_t out;
+		out.val[0] = vorrq_u8(vshlq_n_u8(in.val[0], 2), vshrq_n_u8(in.val[1], 4));
+		out.val[1] = vorrq_u8(vshlq_n_u8(in.val[1], 4), vshrq_n_u8(in.val[2], 2));
+		out.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+
+		vst3q_u8(bytes + o, out);
+	}
+
+	return x;
+}
+
+#endif
+
+static int32_t crypto_base64_value(uint8_t c)
+{
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A';
+
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 26;
+
+	if (c >= '0' && c <= '9')
+		return c - '0' + 52;
+
+	if (c == '+')
+		return 62;
+
+	if (c == '/')
+		return 63;
+
+	return -1;
+}
+
+void MTY_BytesToBase64(const void *bytes, size_t size, char *base64, size_t base64Size)
+{
+	if (base64Size == 0)
+		return;
+
+	// Only whole groups of 4 characters are written when truncating
+	size_t groups = (size + 2) / 3;
+
+	if (groups > (base64Size - 1) / 4) {
+		MTY_Log("'base64Size' is too small, truncated");
+		size = (base64Size - 1) / 4 * 3;
+	}
+
+	const uint8_t *bytes8 = bytes;
+	size_t x = 0;
+
+	#if defined(CRYPTO_X86)
+		if (crypto_cpu() & CRYPTO_CPU_SSSE3)
+			x = crypto_base64_encode_ssse3(bytes8, size, base64);
+
+	#elif defined(CRYPTO_NEON)
+		x = crypto_base64_encode_neon(bytes8, size, base64);
+	#endif
+
+	char *out = base64 + x / 3 * 4;
+
+	for (; size - x >= 3; x += 3, out += 4) {
+		uint32_t v = (uint32_t) bytes8[x] << 16 | (uint32_t) bytes8[x + 1] << 8 | bytes8[x + 2];
+
+		out[0] = CRYPTO_BASE64[v >> 18];
+		out[1] = CRYPTO_BASE64[v >> 12 & 0x3F];
+		out[2] = CRYPTO_BASE64[v >> 6 & 0x3F];
+		out[3] = CRYPTO_BASE64[v & 0x3F];
+	}
+
+	if (x < size) {
+		uint32_t v = (uint32_t) bytes8[x] << 16 | (size - x > 1 ? (uint32_t) bytes8[x + 1] << 8 : 0);
+
+		out[0] = CRYPTO_BASE64[v >> 18];
+		out[1] = CRYPTO_BASE64[v >> 12 & 0x3F];
+		out[2] = size - x > 1 ? CRYPTO_BASE64[v >> 6 & 0x3F] : '=';
+		out[3] = '=';
+		out += 4;
+	}
+
+	*out = '\0';
+}
+
+bool MTY_Base64ToBytes(const char *base64, void *bytes, size_t size, size_t *written)
+{
+	size_t len = strlen(base64);
+	size_t padded = len;
+
+	for (uint8_t x = 0; x < 2 && len > 0 && base64[len - 1] == '='; x++)
+		len--;
+
+	if (len % 4 == 1 || (padded > len && padded % 4 != 0)) {
+		MTY_Log("'base64' has an invalid length");
+		return false;
+	}
+
+	size_t needed = len / 4 * 3 + (len % 4 > 0 ? len % 4 - 1 : 0);
+
+	if (needed > size) {
+		MTY_Log("'bytes' not large enough, %zu bytes needed", needed);
+		return false;
+	}
+
+	uint8_t *bytes8 = bytes;
+	size_t x = 0;
+
+	#if defined(CRYPTO_X86)
+		if (crypto_cpu() & CRYPTO_CPU_SSSE3)
+			x = crypto_base64_decode_ssse3(base64, len, bytes8, size);
+
+	#elif defined(CRYPTO_NEON)
+		x = crypto_base64_decode_neon(base64, len, bytes8, size);
+	#endif
+
+	uint8_t *out = bytes8 + x / 4 * 3;
+
+	for (; x < len; x += 4) {
+		size_t n = len - x < 4 ? len - x : 4;
+		uint32_t v = 0;
+
+		for (size_t y = 0; y < n; y++) {
+			int32_t c = crypto_base64_value(base64[x + y]);
+
+			if (c < 0) {
+				MTY_Log("Invalid base64 character %d", base64[x + y]);
+				return false;
+			}
+
+			v |= (uint32_t) c << (18 - y * 6);
+		}
+
+		for (size_t y = 0; y < n - 1; y++)
+			*out++ = (uint8_t) (v >> (16 - y * 8));
+	}
+
+	if (written)
+		*written = needed;
+
+	return true;
+}
+
+
+// Hash context
+
+// HMAC is built on top of the platform digests: H((key ^ opad) || H((key ^ ipad) || input))
+
+struct MTY_HashCtx {
+	MTY_Algorithm algo;
+	size_t size;
+	bool hex;
+	bool hmac;
+
+	struct digest *inner;
+	struct digest *outer;
+	uint8_t ipad[CRYPTO_BLOCK_SIZE];
+	uint8_t opad[CRYPTO_BLOCK_SIZE];
+};
+
+MTY_HashCtx *MTY_HashCtxCreate(MTY_Algorithm algo, const void *key, size_t keySize)
+{
+	MTY_HashCtx *ctx = MTY_Alloc(1, sizeof(MTY_HashCtx));
+	ctx->hex = algo == MTY_ALGORITHM_SHA1_HEX || algo == MTY_ALGORITHM_SHA256_HEX;
+	ctx->algo = algo == MTY_ALGORITHM_SHA1 || algo == MTY_ALGORITHM_SHA1_HEX ?
+		MTY_ALGORITHM_SHA1 : MTY_ALGORITHM_SHA256;
+	ctx->size = ctx->algo == MTY_ALGORITHM_SHA1 ? MTY_SHA1_SIZE : MTY_SHA256_SIZE;
+	ctx->hmac = key && keySize > 0;
+
+	ctx->inner = mty_digest_create(ctx->algo);
+	if (!ctx->inner)
+		goto except;
+
+	if (ctx->hmac) {
+		ctx->outer = mty_digest_create(ctx->algo);
+		if (!ctx->outer)
+			goto except;
+
+		// Keys longer than the block size are hashed first
+		uint8_t block[CRYPTO_BLOCK_SIZE] = {0};
+
+		if (keySize > CRYPTO_BLOCK_SIZE) {
+			mty_digest_update(ctx->inner, key, keySize);
+			mty_digest_final(ctx->inner, block);
+
+		} else {
+			memcpy(block, key, keySize);
+		}
+
+		for (uint8_t x = 0; x < CRYPTO_BLOCK_SIZE; x++) {
+			ctx->ipad[x] = block[x] ^ 0x36;
+			ctx->opad[x] = block[x] ^ 0x5C;
+		}
+
+		mty_digest_update(ctx->inner, ctx->ipad, CRYPTO_BLOCK_SIZE);
+	}
+
+	return ctx;
+
+	except:
+
+	MTY_HashCtxDestroy(&ctx);
+
+	return NULL;
+}
+
+void MTY_HashCtxDestroy(MTY_HashCtx **hashCtx)
+{
+	if (!hashCtx || !*hashCtx)
+		return;
+
+	MTY_HashCtx *ctx = *hashCtx;
+
+	mty_digest_destroy(&ctx->inner);
+	mty_digest_destroy(&ctx->outer);
+
+	MTY_Free(ctx);
+	*hashCtx = NULL;
+}
+
+void MTY_HashCtxUpdate(MTY_HashCtx *ctx, const void *input, size_t inputSize)
+{
+	mty_digest_update(ctx->inner, input, inputSize);
+}
+
+void MTY_HashCtxFinal(MTY_HashCtx *ctx, void *output, size_t outputSize)
+{
+	uint8_t bytes[MTY_SHA256_SIZE];
+	mty_digest_final(ctx->inner, bytes);
+
+	if (ctx->hmac) {
+		mty_digest_update(ctx->outer, ctx->opad, CRYPTO_BLOCK_SIZE);
+		mty_digest_update(ctx->outer, bytes, ctx->size);
+		mty_digest_final(ctx->outer, bytes);
+
+		mty_digest_update(ctx->inner, ctx->ipad, CRYPTO_BLOCK_SIZE);
+	}
+
+	if (ctx->hex) {
+		MTY_BytesToHex(bytes, ctx->size, output, outputSize);
+
+	} else if (outputSize < ctx->size) {
+		MTY_Log("'outputSize' must be at least %zu", ctx->size);
+
+	} else {
+		memcpy(output, bytes, ctx->size);
+	}
+}
+
 bool MTY_CryptoHashFile(MTY_Algorithm algo, const char *path, const void *key, size_t keySize,
 	void *output, size_t outputSize)
 {
-	size_t size = 0;
-	void *input = MTY_ReadFile(path, &size);
+	FILE *f = mty_file_open(path, "rb");
+	if (!f)
+		return false;
 
-	if (input) {
-		MTY_CryptoHash(algo, input, size, key, keySize, output, outputSize);
-		MTY_Free(input);
+	bool r = true;
+	uint8_t *buf = NULL;
 
-		return true;
+	MTY_HashCtx *ctx = MTY_HashCtxCreate(algo, key, keySize);
+	if (!ctx) {
+		r = false;
+		goto except;
 	}
 
-	return false;
+	// The file is hashed in fixed size chunks so memory use does not depend on its size,
+	// sequential reads let the OS read ahead while the previous chunk is being hashed
+	buf = MTY_Alloc(CRYPTO_FILE_CHUNK, 1);
+
+	for (size_t n = 0; (n = fread(buf, 1, CRYPTO_FILE_CHUNK, f)) > 0;)
+		MTY_HashCtxUpdate(ctx, buf, n);
+
+	if (ferror(f)) {
+		MTY_Log("'fread' failed with ferror %d", ferror(f));
+		r = false;
+		goto except;
+	}
+
+	MTY_HashCtxFinal(ctx, output, outputSize);
+
+	except:
+
+	MTY_HashCtxDestroy(&ctx);
+	MTY_Free(buf);
+	fclose(f);
+
+	return r;
 }
 
+
+// Random
+
 uint32_t MTY_GetRandomUInt(uint32_t minVal, uint32_t maxVal)
 {
 	if (minVal >= maxVal) {
@@ -146,3 +919,97 @@ uint32_t MTY_GetRandomUInt(uint32_t minVal, uint32_t maxVal)
 
 	return val % (maxVal - minVal) + minVal;
 }
+
+
+// AES-GCM
+
+bool mty_crypto_equal(const void *a, const void *b, size_t size)
+{
+	const uint8_t *a8 = a;
+	const uint8_t *b8 = b;
+	uint8_t diff = 0;
+
+	for (size_t x = 0; x < size; x++)
+		diff |= a8[x] ^ b8[x];
+
+	return diff == 0;
+}
+
+static bool aesgcm_packet_valid(const MTY_AESGCMPacket *pkt)
+{
+	if (!pkt->nonce || !pkt->tag) {
+		MTY_Log("'nonce' and 'tag' can not be NULL");
+		return false;
+	}
+
+	if (pkt->tagSize < 12 || pkt->tagSize > 16) {
+		MTY_Log("'tagSize' must be between 12 and 16");
+		return false;
+	}
+
+	if (pkt->aadSize > 0 && !pkt->aad) {
+		MTY_Log("'aad' can not be NULL if 'aadSize' is not 0");
+		return false;
+	}
+
+	return true;
+}
+
+static bool aesgcm_batch(MTY_AESGCM *ctx, bool encrypt, MTY_AESGCMPacket *packets, uint32_t count)
+{
+	bool r = true;
+
+	// A failed packet does not stop the rest of the batch
+	for (uint32_t x = 0; x < count; x++) {
+		MTY_AESGCMPacket *pkt = &packets[x];
+
+		pkt->ok = aesgcm_packet_valid(pkt) && mty_aesgcm_packet(ctx, encrypt, pkt);
+		r = r && pkt->ok;
+	}
+
+	return r;
+}
+
+bool MTY_AESGCMEncryptBatch(MTY_AESGCM *ctx, MTY_AESGCMPacket *packets, uint32_t count)
+{
+	return aesgcm_batch(ctx, true, packets, count);
+}
+
+bool MTY_AESGCMDecryptBatch(MTY_AESGCM *ctx, MTY_AESGCMPacket *packets, uint32_t count)
+{
+	return aesgcm_batch(ctx, false, packets, count);
+}
+
+size_t mty_iov_size(const MTY_IOVec *iov, uint32_t iovLen)
+{
+	size_t size = 0;
+
+	for (uint32_t x = 0; x < iovLen; x++)
+		size += iov[x].size;
+
+	return size;
+}
+
+void mty_iov_gather(const MTY_IOVec *iov, uint32_t iovLen, void *buf)
+{
+	uint8_t *buf8 = buf;
+
+	for (uint32_t x = 0; x < iovLen; x++) {
+		if (iov[x].size > 0)
+			memcpy(buf8, iov[x].data, iov[x].size);
+
+		buf8 += iov[x].size;
+	}
+}
+
+void mty_iov_scatter(const MTY_IOVec *iov, uint32_t iovLen, const void *buf)
+{
+	const uint8_t *buf8 = buf;
+
+	for (uint32_t x = 0; x < iovLen; x++) {
+		if (iov[x].size > 0)
+			memcpy(iov[x].data, buf8, iov[x].size);
+
+		buf8 += iov[x].size;
+	}
+}
@@ -0,0 +1,31 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#pragma once
+
+#include "matoya.h"
+
+// Platform hash functions without HMAC, `algo` is MTY_ALGORITHM_SHA1 or
+// MTY_ALGORITHM_SHA256. mty_digest_final writes the full digest then resets the
+// digest so it can be reused
+
+struct digest *mty_digest_create(MTY_Algorithm algo);
+void mty_digest_destroy(struct digest **digest);
+void mty_digest_update(struct digest *ctx, const void *input, size_t inputSize);
+void mty_digest_final(struct digest *ctx, void *output);
+
+// Shared by the platform AES-GCM implementations. mty_crypto_equal takes the same
+// time no matter where `a` and `b` differ, the iov functions treat the buffers as
+// one contiguous range
+
+bool mty_crypto_equal(const void *a, const void *b, size_t size);
+size_t mty_iov_size(const MTY_IOVec *iov, uint32_t iovLen);
+void mty_iov_gather(const MTY_IOVec *iov, uint32_t iovLen, void *buf);
+void mty_iov_scatter(const MTY_IOVec *iov, uint32_t iovLen, const void *buf);
+
+// Implemented by each platform AES-GCM backend, encrypts or decrypts a single packet
+// in place. The packet has already been validated by MTY_AESGCMEncryptBatch or
+// MTY_AESGCMDecryptBatch
+
+bool mty_aesgcm_packet(MTY_AESGCM *ctx, bool encrypt, const MTY_AESGCMPacket *pkt);
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <errno.h>
 
+#include "file.h"
 #include "fsutil.h"
 #include "tlocal.h"
 
@@ -55,6 +56,11 @@ bool MTY_WriteFile(const char *path, const void *buf, size_t size)
 	return r;
 }
 
+FILE *mty_file_open(const char *path, const char *mode)
+{
+	return fsutil_open(path, mode);
+}
+
 static bool file_vfprintf(const char *path, const char *mode, const char *fmt, va_list args)
 {
 	FILE *f = fsutil_open(path, mode);
@@ -96,30 +102,71 @@ bool MTY_AppendTextToFile(const char *path, const char *fmt, ...)
 	return r;
 }
 
+// The list, its entries, and every string they reference live in one arena that
+// is released in a single call
+
+struct file_list {
+	MTY_FileList fl;
+	MTY_Arena *arena;
+	uint32_t size;
+};
+
+MTY_FileList *mty_file_list_create(void)
+{
+	MTY_Arena *arena = MTY_ArenaCreate(0);
+
+	struct file_list *ctx = MTY_ArenaAlloc(arena, 1, sizeof(struct file_list));
+	ctx->arena = arena;
+
+	return &ctx->fl;
+}
+
+void mty_file_list_append(MTY_FileList *fl, const char *name, const char *path, bool dir,
+	uint64_t size)
+{
+	struct file_list *ctx = (struct file_list *) fl;
+
+	if (fl->len == ctx->size) {
+		ctx->size = ctx->size > 0 ? ctx->size * 2 : 64;
+
+		MTY_FileDesc *files = MTY_ArenaAlloc(ctx->arena, ctx->size, sizeof(MTY_FileDesc));
+
+		if (fl->len > 0)
+			memcpy(files, fl->files, fl->len * sizeof(MTY_FileDesc));
+
+		fl->files = files;
+	}
+
+	MTY_FileDesc *desc = &fl->files[fl->len++];
+	desc->name = MTY_ArenaStrdup(ctx->arena, name);
+	desc->path = MTY_ArenaStrdup(ctx->arena, path);
+	desc->dir = dir;
+	desc->size = size;
+}
+
 void MTY_FreeFileList(MTY_FileList **fileList)
 {
 	if (!fileList || !*fileList)
 		return;
 
-	for (uint32_t x = 0; x < (*fileList)->len; x++) {
-		MTY_Free((*fileList)->files[x].name);
-		MTY_Free((*fileList)->files[x].path);
-	}
-
-	MTY_Free((*fileList)->files);
+	struct file_list *ctx = (struct file_list *) *fileList;
+	MTY_Arena *arena = ctx->arena;
 
-	MTY_Free(*fileList);
+	MTY_ArenaDestroy(&arena);
 	*fileList = NULL;
 }
 
 const char *MTY_JoinPath(const char *path0, const char *path1)
 {
-	char *path = MTY_SprintfD("%s%c%s", path0, FSUTIL_DELIM, path1);
-	char *local = mty_tlocal_strcpy(path);
+	size_t len0 = strlen(path0);
+	size_t len1 = strlen(path1);
 
-	MTY_Free(path);
+	char *path = mty_tlocal(len0 + len1 + 2);
+	memcpy(path, path0, len0);
+	path[len0] = FSUTIL_DELIM;
+	memcpy(path + len0 + 1, path1, len1);
 
-	return local;
+	return path;
 }
 
 const char *MTY_GetFileName(const char *path, bool extension)
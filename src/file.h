@@ -0,0 +1,14 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#pragma once
+
+#include <stdio.h>
+
+#include "matoya.h"
+
+FILE *mty_file_open(const char *path, const char *mode);
+MTY_FileList *mty_file_list_create(void);
+void mty_file_list_append(MTY_FileList *fl, const char *name, const char *path, bool dir,
+	uint64_t size);
@@ -14,6 +14,7 @@ GFX_UI_PROTOTYPES(_gl_)
 #include <math.h>
 
 #include "glproc.c"
+#include "alloc.h"
 
 #include "shaders/vsui.h"
 #include "shaders/fsui.h"
@@ -44,7 +45,7 @@ static void gl_ui_log_shader_errors(GLuint shader)
 	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &n);
 
 	if (n > 0) {
-		char *log = MTY_Alloc(n, 1);
+		char *log = mty_alloc(n, 1, MTY_MEMORY_TAG_GFX);
 
 		glGetShaderInfoLog(shader, n, NULL, log);
 		MTY_Log("%s", log);
@@ -57,7 +58,7 @@ struct gfx_ui *mty_gl_ui_create(MTY_Device *device)
 	if (!glproc_global_init())
 		return NULL;
 
-	struct gl_ui *ctx = MTY_Alloc(1, sizeof(struct gl_ui));
+	struct gl_ui *ctx = mty_alloc(1, sizeof(struct gl_ui), MTY_MEMORY_TAG_GFX);
 
 	bool r = true;
 
@@ -11,6 +11,7 @@ GFX_PROTOTYPES(_gl_)
 #include "gfx/fmt.h"
 #include "glproc.c"
 #include "fmt-gl.h"
+#include "alloc.h"
 
 #include "shaders/vs.h"
 #include "shaders/fs.h"
@@ -56,7 +57,7 @@ static void gl_log_shader_errors(GLuint shader)
 	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &n);
 
 	if (n > 0) {
-		char *log = MTY_Alloc(n, 1);
+		char *log = mty_alloc(n, 1, MTY_MEMORY_TAG_GFX);
 
 		glGetShaderInfoLog(shader, n, NULL, log);
 		MTY_Log("%s", log);
@@ -69,7 +70,7 @@ struct gfx *mty_gl_create(MTY_Device *device, uint8_t layer)
 	if (!glproc_global_init())
 		return NULL;
 
-	struct gl *ctx = MTY_Alloc(1, sizeof(struct gl));
+	struct gl *ctx = mty_alloc(1, sizeof(struct gl), MTY_MEMORY_TAG_GFX);
 
 	bool r = true;
 
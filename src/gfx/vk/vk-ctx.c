@@ -9,6 +9,7 @@ GFX_CTX_PROTOTYPES(_vk_)
 #include <string.h>
 
 #include "vkproc.c"
+#include "alloc.h"
 
 #if defined(MTY_VK_ANDROID)
 	#include "app-os.h"
@@ -325,7 +326,7 @@ static VkBool32 VKAPI_PTR vk_ctx_debug_callback(VkDebugUtilsMessageSeverityFlagB
 
 struct gfx_ctx *mty_vk_ctx_create(void *native_window, bool vsync)
 {
-	struct vk_ctx *ctx = MTY_Alloc(1, sizeof(struct vk_ctx));
+	struct vk_ctx *ctx = mty_alloc(1, sizeof(struct vk_ctx), MTY_MEMORY_TAG_GFX);
 	ctx->vsync = vsync;
 
 	bool r = true;
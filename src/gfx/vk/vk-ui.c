@@ -8,6 +8,7 @@ GFX_UI_PROTOTYPES(_vk_)
 #include <math.h>
 
 #include "vk-common.h"
+#include "alloc.h"
 
 static
 #include "shaders/fsui.h"
@@ -49,7 +50,7 @@ struct vk_ui {
 
 struct gfx_ui *mty_vk_ui_create(MTY_Device *device)
 {
-	struct vk_ui *ctx = MTY_Alloc(1, sizeof(struct vk_ui));
+	struct vk_ui *ctx = mty_alloc(1, sizeof(struct vk_ui), MTY_MEMORY_TAG_GFX);
 
 	bool r = true;
 
@@ -281,7 +282,7 @@ struct gfx_ui *mty_vk_ui_create(MTY_Device *device)
 	}
 
 	// Dummy image for empty binding
-	void *rgba = MTY_Alloc(256 * 256, 4);
+	void *rgba = mty_alloc(256 * 256, 4, MTY_MEMORY_TAG_GFX);
 	ctx->clear_img = mty_vk_ui_create_texture((struct gfx_ui *) ctx, device, rgba, 256, 256);
 	MTY_Free(rgba);
 
@@ -317,7 +318,7 @@ static bool vk_ui_resize_buffer(struct vk_ui_buffer *uibuf, const VkPhysicalDevi
 		vk_destroy_buffer(device, &uibuf->buf);
 
 		uibuf->len = len + incr;
-		uibuf->sys = MTY_Realloc(uibuf->sys, uibuf->len, element_size);
+		uibuf->sys = mty_realloc(uibuf->sys, uibuf->len, element_size, MTY_MEMORY_TAG_GFX);
 
 		return vk_allocate_buffer(pdprops, device, usage,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, uibuf->len * element_size, &uibuf->buf);
@@ -507,7 +508,7 @@ void *mty_vk_ui_create_texture(struct gfx_ui *gfx_ui, MTY_Device *device, const
 	const VkPhysicalDeviceMemoryProperties *pdprops = dobjs->physicalDeviceMemoryProperties;
 	VkDevice _device = dobjs->device;
 
-	struct vk_ui_image *uiimg = MTY_Alloc(1, sizeof(struct vk_ui_image));
+	struct vk_ui_image *uiimg = mty_alloc(1, sizeof(struct vk_ui_image), MTY_MEMORY_TAG_GFX);
 	bool r = vk_create_image(pdprops, _device, VK_FORMAT_R8G8B8A8_UNORM, width, width, height, 4, &uiimg->img);
 	if (!r)
 		goto except;
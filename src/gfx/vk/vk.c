@@ -11,6 +11,7 @@ GFX_PROTOTYPES(_vk_)
 #include "gfx/fmt.h"
 #include "vk-common.h"
 #include "fmt-vk.h"
+#include "alloc.h"
 
 static
 #include "shaders/fs.h"
@@ -67,7 +68,7 @@ static bool vk_one_shot_buffer(const VkPhysicalDeviceMemoryProperties *pdprops,
 
 struct gfx *mty_vk_create(MTY_Device *device, uint8_t layer)
 {
-	struct vk *ctx = MTY_Alloc(1, sizeof(struct vk));
+	struct vk *ctx = mty_alloc(1, sizeof(struct vk), MTY_MEMORY_TAG_GFX);
 
 	MTY_VkDeviceObjects *dobjs = (MTY_VkDeviceObjects *) device;
 	const VkPhysicalDeviceMemoryProperties *pdprops = dobjs->physicalDeviceMemoryProperties;
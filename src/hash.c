@@ -4,34 +4,79 @@
 
 #include "matoya.h"
 
-#include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
-#include <inttypes.h>
+
+#include "alloc.h"
 
 #define HASH_DEFAULT_BUCKETS 100
+#define HASH_MIN_INDEX       8
+#define HASH_MIGRATE_STEP    64
+#define HASH_INT_MIN_SLOTS   16
+
+#define HASH_SLOT_EMPTY 0
+#define HASH_SLOT_LIVE  1
+#define HASH_SLOT_DEAD  2
 
-struct hash_node {
+struct hash_entry {
+	uint64_t hash;
 	char *key;
 	void *val;
 };
 
-struct hash_bucket {
-	uint32_t num_nodes;
-	struct hash_node *nodes;
+struct hash_index {
+	uint32_t size;
+	uint32_t *slots;
+};
+
+struct hash_slot {
+	int64_t key;
+	void *val;
 };
 
 struct MTY_Hash {
-	uint32_t num_buckets;
-	struct hash_bucket *buckets;
+	// String keys are kept in insertion order in a compact entries array, with
+	// popped entries left as tombstones (NULL key) until the array is compacted
+	uint32_t num_entries;
+	uint32_t max_entries;
+	uint32_t num_dead;
+	struct hash_entry *entries;
+
+	// Open addressing index storing entry positions + 1. While growing, lookups
+	// fall back to the old index until every entry below 'migrate_end' is moved.
+	// Only MTY_HashSet and MTY_HashPop advance the migration
+	struct hash_index index;
+	struct hash_index old_index;
+	uint32_t migrate;
+	uint32_t migrate_end;
+
+	// Integer keys live in a separate open addressing table
+	uint32_t num_slots;
+	uint32_t num_live;
+	uint32_t num_used;
+	uint8_t *states;
+	struct hash_slot *slots;
 };
 
+static uint32_t hash_pow2(uint32_t n)
+{
+	// The largest power of two that fits in a uint32_t is 2^31
+	if (n > 0x80000000)
+		n = 0x80000000;
+
+	uint32_t r = HASH_MIN_INDEX;
+
+	while (r < n)
+		r *= 2;
+
+	return r;
+}
+
 MTY_Hash *MTY_HashCreate(uint32_t numBuckets)
 {
-	MTY_Hash *ctx = MTY_Alloc(1, sizeof(MTY_Hash));
-	ctx->num_buckets = numBuckets == 0 ? HASH_DEFAULT_BUCKETS : numBuckets;
+	MTY_Hash *ctx = mty_alloc(1, sizeof(MTY_Hash), MTY_MEMORY_TAG_HASH);
 
-	ctx->buckets = MTY_Alloc(ctx->num_buckets, sizeof(struct hash_bucket));
+	ctx->index.size = hash_pow2(numBuckets == 0 ? HASH_DEFAULT_BUCKETS : numBuckets);
+	ctx->index.slots = mty_alloc(ctx->index.size, sizeof(uint32_t), MTY_MEMORY_TAG_HASH);
 
 	return ctx;
 }
@@ -43,153 +88,342 @@ void MTY_HashDestroy(MTY_Hash **hash, MTY_FreeFunc freeFunc)
 
 	MTY_Hash *ctx = *hash;
 
-	for (uint32_t x = 0; x < ctx->num_buckets; x++) {
-		struct hash_bucket *b = &ctx->buckets[x];
+	for (uint32_t x = 0; x < ctx->num_entries; x++) {
+		struct hash_entry *e = &ctx->entries[x];
 
-		for (uint32_t y = 0; y < b->num_nodes; y++) {
-			struct hash_node *n = &b->nodes[y];
+		if (!e->key)
+			continue;
 
-			MTY_Free(n->key);
+		MTY_Free(e->key);
 
-			if (freeFunc && n->val)
-				freeFunc((void *) n->val);
-		}
-
-		MTY_Free(b->nodes);
+		if (freeFunc && e->val)
+			freeFunc(e->val);
 	}
 
-	MTY_Free(ctx->buckets);
+	for (uint32_t x = 0; x < ctx->num_slots; x++)
+		if (ctx->states[x] == HASH_SLOT_LIVE && freeFunc && ctx->slots[x].val)
+			freeFunc(ctx->slots[x].val);
+
+	MTY_Free(ctx->entries);
+	MTY_Free(ctx->index.slots);
+	MTY_Free(ctx->old_index.slots);
+	MTY_Free(ctx->states);
+	MTY_Free(ctx->slots);
 
 	MTY_Free(ctx);
 	*hash = NULL;
 }
 
-static void *hash_get(MTY_Hash *ctx, const char *key, bool pop)
+
+// String hashing
+
+static uint64_t hash_string(const char *key)
 {
-	struct hash_bucket *b = &ctx->buckets[MTY_DJB2(key) % ctx->num_buckets];
+	return MTY_Hash64(key, strlen(key), 0);
+}
 
-	for (uint32_t x = 0; x < b->num_nodes; x++) {
-		struct hash_node *n = &b->nodes[x];
 
-		if (n->key && !strcmp(key, n->key)) {
-			void *r = n->val;
+// String keys
 
-			if (pop) {
-				MTY_Free(n->key);
-				n->key = NULL;
-				n->val = NULL;
-			}
+static void hash_index_insert(struct hash_index *index, uint64_t hash, uint32_t entry)
+{
+	uint32_t mask = index->size - 1;
+	uint32_t x = (uint32_t) hash & mask;
 
-			return r;
-		}
+	while (index->slots[x] != 0)
+		x = (x + 1) & mask;
+
+	index->slots[x] = entry + 1;
+}
+
+static int64_t hash_index_find(const MTY_Hash *ctx, const struct hash_index *index, const char *key,
+	uint64_t hash)
+{
+	uint32_t mask = index->size - 1;
+
+	for (uint32_t x = (uint32_t) hash & mask; index->slots[x] != 0; x = (x + 1) & mask) {
+		uint32_t y = index->slots[x] - 1;
+		struct hash_entry *e = &ctx->entries[y];
+
+		// The stored hash avoids a string comparison on nearly every mismatch
+		if (e->hash == hash && e->key && !strcmp(e->key, key))
+			return y;
 	}
 
-	return NULL;
+	return -1;
 }
 
-void *MTY_HashGet(MTY_Hash *ctx, const char *key)
+static void hash_migrate(MTY_Hash *ctx, uint32_t steps)
 {
-	return hash_get(ctx, key, false);
+	if (!ctx->old_index.slots)
+		return;
+
+	for (uint32_t x = 0; x < steps && ctx->migrate < ctx->migrate_end; x++, ctx->migrate++) {
+		struct hash_entry *e = &ctx->entries[ctx->migrate];
+
+		if (e->key)
+			hash_index_insert(&ctx->index, e->hash, ctx->migrate);
+	}
+
+	if (ctx->migrate == ctx->migrate_end) {
+		MTY_Free(ctx->old_index.slots);
+		memset(&ctx->old_index, 0, sizeof(struct hash_index));
+	}
 }
 
-void *MTY_HashGetInt(MTY_Hash *ctx, int64_t key)
+static int64_t hash_find(const MTY_Hash *ctx, const char *key, uint64_t hash)
 {
-	char key_str[32];
-	snprintf(key_str, 32, "#%" PRIx64, key);
+	int64_t r = hash_index_find(ctx, &ctx->index, key, hash);
 
-	return hash_get(ctx, key_str, false);
+	if (r < 0 && ctx->old_index.slots)
+		r = hash_index_find(ctx, &ctx->old_index, key, hash);
+
+	return r;
 }
 
-void *MTY_HashSet(MTY_Hash *ctx, const char *key, void *value)
+static void hash_compact(MTY_Hash *ctx)
 {
-	struct hash_bucket *b = &ctx->buckets[MTY_DJB2(key) % ctx->num_buckets];
-	struct hash_node *n = NULL;
+	uint32_t n = 0;
 
-	for (uint32_t x = 0; x < b->num_nodes; x++) {
-		struct hash_node *this_n = &b->nodes[x];
+	for (uint32_t x = 0; x < ctx->num_entries; x++)
+		if (ctx->entries[x].key)
+			ctx->entries[n++] = ctx->entries[x];
 
-		if (!this_n->key) {
-			n = this_n;
+	ctx->num_entries = n;
+	ctx->num_dead = 0;
 
-		} else if (this_n->key && !strcmp(this_n->key, key)) {
-			void *r = this_n->val;
-			this_n->val = value;
+	// Entry positions have moved, so the index is rebuilt in one pass
+	MTY_Free(ctx->old_index.slots);
+	memset(&ctx->old_index, 0, sizeof(struct hash_index));
 
-			return r;
-		}
+	memset(ctx->index.slots, 0, ctx->index.size * sizeof(uint32_t));
+
+	for (uint32_t x = 0; x < n; x++)
+		hash_index_insert(&ctx->index, ctx->entries[x].hash, x);
+}
+
+static void hash_grow(MTY_Hash *ctx)
+{
+	// A previous migration must be complete before starting another
+	hash_migrate(ctx, UINT32_MAX);
+
+	ctx->old_index = ctx->index;
+	ctx->index.size *= 2;
+	ctx->index.slots = mty_alloc(ctx->index.size, sizeof(uint32_t), MTY_MEMORY_TAG_HASH);
+
+	ctx->migrate = 0;
+	ctx->migrate_end = ctx->num_entries;
+}
+
+void *MTY_HashGet(MTY_Hash *ctx, const char *key)
+{
+	int64_t x = hash_find(ctx, key, hash_string(key));
+
+	return x >= 0 ? ctx->entries[x].val : NULL;
+}
+
+void *MTY_HashSet(MTY_Hash *ctx, const char *key, void *value)
+{
+	// Migration only happens on writes so lookups never modify the table
+	hash_migrate(ctx, HASH_MIGRATE_STEP);
+
+	uint64_t hash = hash_string(key);
+	int64_t x = hash_find(ctx, key, hash);
+
+	if (x >= 0) {
+		void *r = ctx->entries[x].val;
+		ctx->entries[x].val = value;
+
+		return r;
 	}
 
-	if (!n) {
-		b->nodes = MTY_Realloc(b->nodes, ++b->num_nodes, sizeof(struct hash_node));
-		n = &b->nodes[b->num_nodes - 1];
+	// Compact once tombstones make up half of the entries array
+	if (ctx->num_dead >= HASH_MIN_INDEX && ctx->num_dead * 2 >= ctx->num_entries)
+		hash_compact(ctx);
+
+	// Keep the index under a 3/4 load factor, counting tombstones
+	if ((ctx->num_entries + 1) * 4 > ctx->index.size * 3)
+		hash_grow(ctx);
+
+	if (ctx->num_entries == ctx->max_entries) {
+		ctx->max_entries = ctx->max_entries > 0 ? ctx->max_entries * 2 : HASH_MIN_INDEX;
+		ctx->entries = mty_realloc(ctx->entries, ctx->max_entries, sizeof(struct hash_entry), MTY_MEMORY_TAG_HASH);
 	}
 
-	n->key = MTY_Strdup(key);
-	n->val = value;
+	struct hash_entry *e = &ctx->entries[ctx->num_entries];
+	e->hash = hash;
+	e->key = mty_strdup(key, MTY_MEMORY_TAG_HASH);
+	e->val = value;
+
+	hash_index_insert(&ctx->index, hash, ctx->num_entries++);
 
 	return NULL;
 }
 
-void *MTY_HashSetInt(MTY_Hash *ctx, int64_t key, void *value)
+void *MTY_HashPop(MTY_Hash *ctx, const char *key)
 {
-	char key_str[32];
-	snprintf(key_str, 32, "#%" PRIx64, key);
+	hash_migrate(ctx, HASH_MIGRATE_STEP);
+
+	int64_t x = hash_find(ctx, key, hash_string(key));
+
+	if (x < 0)
+		return NULL;
+
+	// The entry stays in place as a tombstone so iteration is unaffected
+	struct hash_entry *e = &ctx->entries[x];
+	void *r = e->val;
 
-	return MTY_HashSet(ctx, key_str, value);
+	MTY_Free(e->key);
+	e->key = NULL;
+	e->val = NULL;
+	ctx->num_dead++;
+
+	return r;
 }
 
-void *MTY_HashPop(MTY_Hash *ctx, const char *key)
+bool MTY_HashGetNextKey(MTY_Hash *ctx, uint64_t *iter, const char **key)
 {
-	return hash_get(ctx, key, true);
+	*key = NULL;
+
+	for (; *iter < ctx->num_entries; (*iter)++) {
+		struct hash_entry *e = &ctx->entries[*iter];
+
+		if (e->key) {
+			*key = e->key;
+			(*iter)++;
+			break;
+		}
+	}
+
+	return *key != NULL;
 }
 
-void *MTY_HashPopInt(MTY_Hash *ctx, int64_t key)
+
+// Integer keys
+
+static uint32_t hash_int(int64_t key)
 {
-	char key_str[32];
-	snprintf(key_str, 32, "#%" PRIx64, key);
+	uint64_t h = (uint64_t) key;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
 
-	return hash_get(ctx, key_str, true);
+	return (uint32_t) h;
 }
 
-bool MTY_HashGetNextKey(MTY_Hash *ctx, uint64_t *iter, const char **key)
+static int64_t hash_find_int(MTY_Hash *ctx, int64_t key)
 {
-	*key = NULL;
+	if (ctx->num_slots == 0)
+		return -1;
 
-	uint32_t *bucket = (uint32_t *) iter;
-	uint32_t *node = (uint32_t *) iter + 1;
+	uint32_t mask = ctx->num_slots - 1;
 
-	for (; *bucket < ctx->num_buckets; (*bucket)++) {
-		struct hash_bucket *b = &ctx->buckets[*bucket];
+	for (uint32_t x = hash_int(key) & mask; ctx->states[x] != HASH_SLOT_EMPTY; x = (x + 1) & mask)
+		if (ctx->states[x] == HASH_SLOT_LIVE && ctx->slots[x].key == key)
+			return x;
 
-		for (; *node < b->num_nodes; (*node)++) {
-			struct hash_node *n = &b->nodes[*node];
+	return -1;
+}
 
-			if (n->key) {
-				*key = n->key;
-				(*node)++;
-				break;
-			}
-		}
+static void hash_resize_int(MTY_Hash *ctx, uint32_t num_slots)
+{
+	uint8_t *states = ctx->states;
+	struct hash_slot *slots = ctx->slots;
+	uint32_t old_slots = ctx->num_slots;
 
-		if (*key)
-			break;
+	ctx->num_slots = num_slots;
+	ctx->num_used = ctx->num_live;
+	ctx->states = mty_alloc(num_slots, sizeof(uint8_t), MTY_MEMORY_TAG_HASH);
+	ctx->slots = mty_alloc(num_slots, sizeof(struct hash_slot), MTY_MEMORY_TAG_HASH);
+
+	uint32_t mask = num_slots - 1;
+
+	for (uint32_t x = 0; x < old_slots; x++) {
+		if (states[x] != HASH_SLOT_LIVE)
+			continue;
+
+		uint32_t y = hash_int(slots[x].key) & mask;
 
-		if (*node == b->num_nodes)
-			*node = 0;
+		while (ctx->states[y] != HASH_SLOT_EMPTY)
+			y = (y + 1) & mask;
+
+		ctx->states[y] = HASH_SLOT_LIVE;
+		ctx->slots[y] = slots[x];
 	}
 
-	return *key != NULL;
+	MTY_Free(states);
+	MTY_Free(slots);
 }
 
-bool MTY_HashGetNextKeyInt(MTY_Hash *ctx, uint64_t *iter, int64_t *key)
+void *MTY_HashGetInt(MTY_Hash *ctx, int64_t key)
+{
+	int64_t x = hash_find_int(ctx, key);
+
+	return x >= 0 ? ctx->slots[x].val : NULL;
+}
+
+void *MTY_HashSetInt(MTY_Hash *ctx, int64_t key, void *value)
+{
+	int64_t x = hash_find_int(ctx, key);
+
+	if (x >= 0) {
+		void *r = ctx->slots[x].val;
+		ctx->slots[x].val = value;
+
+		return r;
+	}
+
+	// Keep live entries plus tombstones under a 3/4 load factor
+	if ((ctx->num_used + 1) * 4 > ctx->num_slots * 3) {
+		uint32_t num_slots = ctx->num_slots > 0 ? ctx->num_slots : HASH_INT_MIN_SLOTS;
+
+		while ((ctx->num_live + 1) * 2 > num_slots)
+			num_slots *= 2;
+
+		hash_resize_int(ctx, num_slots);
+	}
+
+	uint32_t mask = ctx->num_slots - 1;
+	uint32_t y = hash_int(key) & mask;
+
+	while (ctx->states[y] == HASH_SLOT_LIVE)
+		y = (y + 1) & mask;
+
+	if (ctx->states[y] == HASH_SLOT_EMPTY)
+		ctx->num_used++;
+
+	ctx->states[y] = HASH_SLOT_LIVE;
+	ctx->slots[y].key = key;
+	ctx->slots[y].val = value;
+	ctx->num_live++;
+
+	return NULL;
+}
+
+void *MTY_HashPopInt(MTY_Hash *ctx, int64_t key)
 {
-	const char *key_str;
-	bool r = MTY_HashGetNextKey(ctx, iter, &key_str);
+	int64_t x = hash_find_int(ctx, key);
 
-	r = r && key_str[0] == '#';
+	if (x < 0)
+		return NULL;
 
-	if (r)
-		*key = strtoll(key_str + 1, NULL, 16);
+	// Tombstones keep probe chains and iteration positions intact
+	void *r = ctx->slots[x].val;
+	ctx->states[x] = HASH_SLOT_DEAD;
+	ctx->slots[x].val = NULL;
+	ctx->num_live--;
 
 	return r;
 }
+
+bool MTY_HashGetNextKeyInt(MTY_Hash *ctx, uint64_t *iter, int64_t *key)
+{
+	for (; *iter < ctx->num_slots; (*iter)++) {
+		if (ctx->states[*iter] == HASH_SLOT_LIVE) {
+			*key = ctx->slots[(*iter)++].key;
+			return true;
+		}
+	}
+
+	return false;
+}
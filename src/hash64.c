@@ -0,0 +1,695 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#include "matoya.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+	#define HASH64_AVX2
+	#include <immintrin.h>
+
+#elif defined(__SSE2__) || defined(_M_X64)
+	#define HASH64_SSE2
+	#include <emmintrin.h>
+
+#elif defined(__aarch64__)
+	#define HASH64_NEON
+	#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+// This is XXH3 from xxHash 0.8, the outputs of MTY_Hash64 and MTY_Hash128 match
+// XXH3_64bits_withSeed and XXH3_128bits_withSeed. Inputs up to 240 bytes are mixed
+// with 64x64 -> 128 bit multiplies, longer inputs are run through eight 64 bit lanes
+// that map directly onto SIMD registers
+
+#define HASH64_P32_1 0x9E3779B1u
+#define HASH64_P32_2 0x85EBCA77u
+#define HASH64_P32_3 0xC2B2AE3Du
+#define HASH64_P64_1 0x9E3779B185EBCA87ull
+#define HASH64_P64_2 0xC2B2AE3D27D4EB4Full
+#define HASH64_P64_3 0x165667B19E3779F9ull
+#define HASH64_P64_4 0x85EBCA77C2B2AE63ull
+#define HASH64_P64_5 0x27D4EB2F165667C5ull
+#define HASH64_MX_1  0x165667919E3779F9ull
+#define HASH64_MX_2  0x9FB21C651E98DF25ull
+
+#define HASH64_SECRET_SIZE  192
+#define HASH64_STRIPE       64
+#define HASH64_BLOCK        1024
+#define HASH64_MID_MAX      240
+#define HASH64_BUFFER       256
+#define HASH64_LAST_OFFSET  7
+#define HASH64_MERGE_OFFSET 11
+
+// Stripes are fed with the secret shifted 8 bytes at a time, a block is as many
+// stripes as fit in the secret before the accumulators are scrambled
+#define HASH64_BLOCK_STRIPES ((HASH64_SECRET_SIZE - HASH64_STRIPE) / 8)
+
+static const uint8_t HASH64_SECRET[HASH64_SECRET_SIZE] = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+	0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+	0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+	0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+	0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+struct MTY_HashStream {
+	uint64_t acc[8];
+	uint8_t secret[HASH64_SECRET_SIZE];
+	uint8_t buffer[HASH64_BUFFER];
+	size_t buffered;
+	size_t stripes;
+	uint64_t total;
+	uint64_t seed;
+};
+
+
+// Primitives
+
+static uint32_t hash64_read32(const uint8_t *p)
+{
+	return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint64_t hash64_read64(const uint8_t *p)
+{
+	return (uint64_t) hash64_read32(p) | (uint64_t) hash64_read32(p + 4) << 32;
+}
+
+static void hash64_write64(uint8_t *p, uint64_t v)
+{
+	for (uint8_t x = 0; x < 8; x++)
+		p[x] = (uint8_t) (v >> x * 8);
+}
+
+static uint32_t hash64_swap32(uint32_t v)
+{
+	return v >> 24 | (v >> 8 & 0xFF00) | (v << 8 & 0xFF0000) | v << 24;
+}
+
+static uint64_t hash64_swap64(uint64_t v)
+{
+	return (uint64_t) hash64_swap32((uint32_t) v) << 32 | hash64_swap32((uint32_t) (v >> 32));
+}
+
+static uint64_t hash64_rotl64(uint64_t v, uint8_t r)
+{
+	return v << r | v >> (64 - r);
+}
+
+static void hash64_mul128(uint64_t a, uint64_t b, uint64_t *lo, uint64_t *hi)
+{
+	#if defined(__SIZEOF_INT128__)
+		__uint128_t r = (__uint128_t) a * b;
+		*lo = (uint64_t) r;
+		*hi = (uint64_t) (r >> 64);
+
+	#elif defined(_MSC_VER) && defined(_M_X64)
+		*lo = _umul128(a, b, hi);
+
+	#else
+		uint64_t lolo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+		uint64_t hilo = (a >> 32) * (b & 0xFFFFFFFF);
+		uint64_t lohi = (a & 0xFFFFFFFF) * (b >> 32);
+		uint64_t hihi = (a >> 32) * (b >> 32);
+
+		uint64_t cross = (lolo >> 32) + (hilo & 0xFFFFFFFF) + lohi;
+		*hi = (hilo >> 32) + (cross >> 32) + hihi;
+		*lo = (cross << 32) | (lolo & 0xFFFFFFFF);
+	#endif
+}
+
+static uint64_t hash64_fold(uint64_t a, uint64_t b)
+{
+	uint64_t lo = 0;
+	uint64_t hi = 0;
+	hash64_mul128(a, b, &lo, &hi);
+
+	return lo ^ hi;
+}
+
+static uint64_t hash64_avalanche(uint64_t h)
+{
+	h ^= h >> 37;
+	h *= HASH64_MX_1;
+
+	return h ^ h >> 32;
+}
+
+static uint64_t hash64_avalanche_xxh64(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= HASH64_P64_2;
+	h ^= h >> 29;
+	h *= HASH64_P64_3;
+
+	return h ^ h >> 32;
+}
+
+static uint64_t hash64_rrmxmx(uint64_t h, uint64_t len)
+{
+	h ^= hash64_rotl64(h, 49) ^ hash64_rotl64(h, 24);
+	h *= HASH64_MX_2;
+	h ^= (h >> 35) + len;
+	h *= HASH64_MX_2;
+
+	return h ^ h >> 28;
+}
+
+static uint64_t hash64_mix16(const uint8_t *p, const uint8_t *secret, uint64_t seed)
+{
+	return hash64_fold(hash64_read64(p) ^ (hash64_read64(secret) + seed),
+		hash64_read64(p + 8) ^ (hash64_read64(secret + 8) - seed));
+}
+
+static void hash64_mix32(uint64_t h[2], const uint8_t *p0, const uint8_t *p1,
+	const uint8_t *secret, uint64_t seed)
+{
+	h[0] += hash64_mix16(p0, secret, seed);
+	h[0] ^= hash64_read64(p1) + hash64_read64(p1 + 8);
+	h[1] += hash64_mix16(p1, secret + 16, seed);
+	h[1] ^= hash64_read64(p0) + hash64_read64(p0 + 8);
+}
+
+static void hash64_init_secret(uint8_t *secret, uint64_t seed)
+{
+	for (uint8_t x = 0; x < HASH64_SECRET_SIZE; x += 16) {
+		hash64_write64(secret + x, hash64_read64(HASH64_SECRET + x) + seed);
+		hash64_write64(secret + x + 8, hash64_read64(HASH64_SECRET + x + 8) - seed);
+	}
+}
+
+
+// Long input lanes
+
+// Each stripe adds the input to the neighbouring lane and the product of the low and
+// high halves of input ^ secret to its own lane. Scrambling after every block keeps
+// the lanes from saturating
+
+static void hash64_accumulate(uint64_t *acc, const uint8_t *input, const uint8_t *secret,
+	size_t stripes)
+{
+	#if defined(HASH64_AVX2)
+		__m256i a[2];
+
+		for (uint8_t x = 0; x < 2; x++)
+			a[x] = _mm256_loadu_si256((const __m256i *) acc + x);
+
+		for (size_t n = 0; n < stripes; n++, input += HASH64_STRIPE, secret += 8) {
+			for (uint8_t x = 0; x < 2; x++) {
+				__m256i d = _mm256_loadu_si256((const __m256i *) input + x);
+				__m256i k = _mm256_xor_si256(d, _mm256_loadu_si256((const __m256i *) secret + x));
+				__m256i p = _mm256_mul_epu32(k, _mm256_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1)));
+
+				a[x] = _mm256_add_epi64(a[x], _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+				a[x] = _mm256_add_epi64(a[x], p);
+			}
+		}
+
+		for (uint8_t x = 0; x < 2; x++)
+			_mm256_storeu_si256((__m256i *) acc + x, a[x]);
+
+	#elif defined(HASH64_SSE2)
+		__m128i a[4];
+
+		for (uint8_t x = 0; x < 4; x++)
+			a[x] = _mm_loadu_si128((const __m128i *) acc + x);
+
+		for (size_t n = 0; n < stripes; n++, input += HASH64_STRIPE, secret += 8) {
+			for (uint8_t x = 0; x < 4; x++) {
+				__m128i d = _mm_loadu_si128((const __m128i *) input + x);
+				__m128i k = _mm_xor_si128(d, _mm_loadu_si128((const __m128i *) secret + x));
+				__m128i p = _mm_mul_epu32(k, _mm_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1)));
+
+				a[x] = _mm_add_epi64(a[x], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+				a[x] = _mm_add_epi64(a[x], p);
+			}
+		}
+
+		for (uint8_t x = 0; x < 4; x++)
+			_mm_storeu_si128((__m128i *) acc + x, a[x]);
+
+	#elif defined(HASH64_NEON)
+		uint64x2_t a[4];
+
+		for (uint8_t x = 0; x < 4; x++)
+			a[x] = vld1q_u64(acc + x * 2);
+
+		for (size_t n = 0; n < stripes; n++, input += HASH64_STRIPE, secret += 8) {
+			for (uint8_t x = 0; x < 4; x++) {
+				uint64x2_t d = vreinterpretq_u64_u8(vld1q_u8(input + x * 16));
+				uint64x2_t k = veorq_u64(d, vreinterpretq_u64_u8(vld1q_u8(secret + x * 16)));
+
+				a[x] = vaddq_u64(a[x], vextq_u64(d, d, 1));
+				a[x] = vmlal_u32(a[x], vmovn_u64(k), vshrn_n_u64(k, 32));
+			}
+		}
+
+		for (uint8_t x = 0; x < 4; x++)
+			vst1q_u64(acc + x * 2, a[x]);
+
+	#else
+		for (size_t n = 0; n < stripes; n++, input += HASH64_STRIPE, secret += 8) {
+			for (uint8_t x = 0; x < 8; x++) {
+				uint64_t d = hash64_read64(input + x * 8);
+				uint64_t k = d ^ hash64_read64(secret + x * 8);
+
+				acc[x ^ 1] += d;
+				acc[x] += (k & 0xFFFFFFFF) * (k >> 32);
+			}
+		}
+	#endif
+}
+
+static void hash64_scramble(uint64_t *acc, const uint8_t *secret)
+{
+	#if defined(HASH64_AVX2)
+		const __m256i prime = _mm256_set1_epi32((int32_t) HASH64_P32_1);
+
+		for (uint8_t x = 0; x < 2; x++) {
+			__m256i a = _mm256_loadu_si256((const __m256i *) acc + x);
+			a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+			a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i *) secret + x));
+
+			__m256i lo = _mm256_mul_epu32(a, prime);
+			__m256i hi = _mm256_mul_epu32(_mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+
+			_mm256_storeu_si256((__m256i *) acc + x, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+		}
+
+	#elif defined(HASH64_SSE2)
+		const __m128i prime = _mm_set1_epi32((int32_t) HASH64_P32_1);
+
+		for (uint8_t x = 0; x < 4; x++) {
+			__m128i a = _mm_loadu_si128((const __m128i *) acc + x);
+			a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+			a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *) secret + x));
+
+			__m128i lo = _mm_mul_epu32(a, prime);
+			__m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+
+			_mm_storeu_si128((__m128i *) acc + x, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+		}
+
+	#elif defined(HASH64_NEON)
+		const uint32x2_t prime = vdup_n_u32(HASH64_P32_1);
+
+		for (uint8_t x = 0; x < 4; x++) {
+			uint64x2_t a = vld1q_u64(acc + x * 2);
+			a = veorq_u64(a, vshrq_n_u64(a, 47));
+			a = veorq_u64(a, vreinterpretq_u64_u8(vld1q_u8(secret + x * 16)));
+
+			uint64x2_t hi = vshlq_n_u64(vmull_u32(vshrn_n_u64(a, 32), prime), 32);
+
+			vst1q_u64(acc + x * 2, vmlal_u32(hi, vmovn_u64(a), prime));
+		}
+
+	#else
+		for (uint8_t x = 0; x < 8; x++) {
+			uint64_t a = acc[x];
+			a ^= a >> 47;
+			a ^= hash64_read64(secret + x * 8);
+
+			acc[x] = a * HASH64_P32_1;
+		}
+	#endif
+}
+
+static void hash64_acc_init(uint64_t *acc)
+{
+	acc[0] = HASH64_P32_3;
+	acc[1] = HASH64_P64_1;
+	acc[2] = HASH64_P64_2;
+	acc[3] = HASH64_P64_3;
+	acc[4] = HASH64_P64_4;
+	acc[5] = HASH64_P32_2;
+	acc[6] = HASH64_P64_5;
+	acc[7] = HASH64_P32_1;
+}
+
+static void hash64_long(uint64_t *acc, const uint8_t *input, size_t len, const uint8_t *secret)
+{
+	hash64_acc_init(acc);
+
+	size_t blocks = (len - 1) / HASH64_BLOCK;
+
+	for (size_t n = 0; n < blocks; n++) {
+		hash64_accumulate(acc, input + n * HASH64_BLOCK, secret, HASH64_BLOCK_STRIPES);
+		hash64_scramble(acc, secret + HASH64_SECRET_SIZE - HASH64_STRIPE);
+	}
+
+	size_t stripes = (len - 1 - blocks * HASH64_BLOCK) / HASH64_STRIPE;
+	hash64_accumulate(acc, input + blocks * HASH64_BLOCK, secret, stripes);
+
+	// The last stripe always ends at the end of the input, overlapping the stripe before
+	hash64_accumulate(acc, input + len - HASH64_STRIPE,
+		secret + HASH64_SECRET_SIZE - HASH64_STRIPE - HASH64_LAST_OFFSET, 1);
+}
+
+static uint64_t hash64_merge(const uint64_t *acc, const uint8_t *secret, uint64_t start)
+{
+	for (uint8_t x = 0; x < 4; x++)
+		start += hash64_fold(acc[x * 2] ^ hash64_read64(secret + x * 16),
+			acc[x * 2 + 1] ^ hash64_read64(secret + x * 16 + 8));
+
+	return hash64_avalanche(start);
+}
+
+
+// 64 bit
+
+static uint64_t hash64_short(const uint8_t *p, size_t len, const uint8_t *s, uint64_t seed)
+{
+	if (len > 8) {
+		uint64_t lo = hash64_read64(p) ^ ((hash64_read64(s + 24) ^ hash64_read64(s + 32)) + seed);
+		uint64_t hi = hash64_read64(p + len - 8) ^ ((hash64_read64(s + 40) ^ hash64_read64(s + 48)) - seed);
+
+		return hash64_avalanche(len + hash64_swap64(lo) + hi + hash64_fold(lo, hi));
+	}
+
+	if (len >= 4) {
+		seed ^= (uint64_t) hash64_swap32((uint32_t) seed) << 32;
+
+		uint64_t v = hash64_read32(p + len - 4) + ((uint64_t) hash64_read32(p) << 32);
+
+		return hash64_rrmxmx(v ^ ((hash64_read64(s + 8) ^ hash64_read64(s + 16)) - seed), len);
+	}
+
+	if (len > 0) {
+		uint32_t v = (uint32_t) p[0] << 16 | (uint32_t) p[len >> 1] << 24 | p[len - 1] | (uint32_t) len << 8;
+
+		return hash64_avalanche_xxh64(v ^ ((uint64_t) (hash64_read32(s) ^ hash64_read32(s + 4)) + seed));
+	}
+
+	return hash64_avalanche_xxh64(seed ^ hash64_read64(s + 56) ^ hash64_read64(s + 64));
+}
+
+static uint64_t hash64_mid(const uint8_t *p, size_t len, const uint8_t *s, uint64_t seed)
+{
+	uint64_t acc = len * HASH64_P64_1;
+
+	if (len <= 128) {
+		// Pairs of 16 byte reads from both ends meet in the middle
+		for (size_t x = 0; x <= (len - 1) / 32; x++) {
+			acc += hash64_mix16(p + 16 * x, s + 32 * x, seed);
+			acc += hash64_mix16(p + len - 16 * (x + 1), s + 32 * x + 16, seed);
+		}
+
+		return hash64_avalanche(acc);
+	}
+
+	for (size_t x = 0; x < 8; x++)
+		acc += hash64_mix16(p + 16 * x, s + 16 * x, seed);
+
+	acc = hash64_avalanche(acc);
+
+	for (size_t x = 8; x < len / 16; x++)
+		acc += hash64_mix16(p + 16 * x, s + 16 * (x - 8) + 3, seed);
+
+	acc += hash64_mix16(p + len - 16, s + 136 - 17, seed);
+
+	return hash64_avalanche(acc);
+}
+
+uint64_t MTY_Hash64(const void *buf, size_t size, uint64_t seed)
+{
+	const uint8_t *p = buf;
+
+	if (size <= 16)
+		return hash64_short(p, size, HASH64_SECRET, seed);
+
+	if (size <= HASH64_MID_MAX)
+		return hash64_mid(p, size, HASH64_SECRET, seed);
+
+	uint8_t secret[HASH64_SECRET_SIZE];
+	const uint8_t *s = HASH64_SECRET;
+
+	if (seed != 0) {
+		hash64_init_secret(secret, seed);
+		s = secret;
+	}
+
+	uint64_t acc[8];
+	hash64_long(acc, p, size, s);
+
+	return hash64_merge(acc, s + HASH64_MERGE_OFFSET, size * HASH64_P64_1);
+}
+
+
+// 128 bit
+
+static void hash64_short128(const uint8_t *p, size_t len, const uint8_t *s, uint64_t seed, uint64_t h[2])
+{
+	if (len > 8) {
+		uint64_t lo = hash64_read64(p);
+		uint64_t hi = hash64_read64(p + len - 8);
+
+		uint64_t mlo = 0;
+		uint64_t mhi = 0;
+		hash64_mul128(lo ^ hi ^ ((hash64_read64(s + 32) ^ hash64_read64(s + 40)) - seed), HASH64_P64_1, &mlo, &mhi);
+
+		mlo += (uint64_t) (len - 1) << 54;
+		hi ^= (hash64_read64(s + 48) ^ hash64_read64(s + 56)) + seed;
+		mhi += hi + (uint64_t) (uint32_t) hi * (HASH64_P32_2 - 1);
+		mlo ^= hash64_swap64(mhi);
+
+		hash64_mul128(mlo, HASH64_P64_2, &h[0], &h[1]);
+		h[1] += mhi * HASH64_P64_2;
+
+		h[0] = hash64_avalanche(h[0]);
+		h[1] = hash64_avalanche(h[1]);
+
+	} else if (len >= 4) {
+		seed ^= (uint64_t) hash64_swap32((uint32_t) seed) << 32;
+
+		uint64_t v = hash64_read32(p) + ((uint64_t) hash64_read32(p + len - 4) << 32);
+		v ^= (hash64_read64(s + 16) ^ hash64_read64(s + 24)) + seed;
+
+		hash64_mul128(v, HASH64_P64_1 + (len << 2), &h[0], &h[1]);
+
+		h[1] += h[0] << 1;
+		h[0] ^= h[1] >> 3;
+		h[0] ^= h[0] >> 35;
+		h[0] *= HASH64_MX_2;
+		h[0] ^= h[0] >> 28;
+		h[1] = hash64_avalanche(h[1]);
+
+	} else if (len > 0) {
+		uint32_t lo = (uint32_t) p[0] << 16 | (uint32_t) p[len >> 1] << 24 | p[len - 1] | (uint32_t) len << 8;
+		uint32_t hi = hash64_swap32(lo);
+		hi = hi << 13 | hi >> 19;
+
+		h[0] = hash64_avalanche_xxh64(lo ^ ((uint64_t) (hash64_read32(s) ^ hash64_read32(s + 4)) + seed));
+		h[1] = hash64_avalanche_xxh64(hi ^ ((uint64_t) (hash64_read32(s + 8) ^ hash64_read32(s + 12)) - seed));
+
+	} else {
+		h[0] = hash64_avalanche_xxh64(seed ^ hash64_read64(s + 64) ^ hash64_read64(s + 72));
+		h[1] = hash64_avalanche_xxh64(seed ^ hash64_read64(s + 80) ^ hash64_read64(s + 88));
+	}
+}
+
+static void hash64_mid128(const uint8_t *p, size_t len, const uint8_t *s, uint64_t seed, uint64_t h[2])
+{
+	uint64_t acc[2] = {len * HASH64_P64_1, 0};
+
+	if (len <= 128) {
+		for (size_t x = (len - 1) / 32 + 1; x > 0; x--)
+			hash64_mix32(acc, p + 16 * (x - 1), p + len - 16 * x, s + 32 * (x - 1), seed);
+
+	} else {
+		for (size_t x = 32; x < 160; x += 32)
+			hash64_mix32(acc, p + x - 32, p + x - 16, s + x - 32, seed);
+
+		acc[0] = hash64_avalanche(acc[0]);
+		acc[1] = hash64_avalanche(acc[1]);
+
+		for (size_t x = 160; x <= len; x += 32)
+			hash64_mix32(acc, p + x - 32, p + x - 16, s + 3 + x - 160, seed);
+
+		hash64_mix32(acc, p + len - 16, p + len - 32, s + 136 - 17 - 16, 0 - seed);
+	}
+
+	h[0] = hash64_avalanche(acc[0] + acc[1]);
+	h[1] = 0 - hash64_avalanche(acc[0] * HASH64_P64_1 + acc[1] * HASH64_P64_4 + (len - seed) * HASH64_P64_2);
+}
+
+static void hash64_merge128(const uint64_t *acc, const uint8_t *s, uint64_t len, uint64_t h[2])
+{
+	h[0] = hash64_merge(acc, s + HASH64_MERGE_OFFSET, len * HASH64_P64_1);
+	h[1] = hash64_merge(acc, s + HASH64_SECRET_SIZE - 64 - HASH64_MERGE_OFFSET, ~(len * HASH64_P64_2));
+}
+
+void MTY_Hash128(const void *buf, size_t size, uint64_t seed, uint64_t hash[2])
+{
+	const uint8_t *p = buf;
+
+	if (size <= 16) {
+		hash64_short128(p, size, HASH64_SECRET, seed, hash);
+
+	} else if (size <= HASH64_MID_MAX) {
+		hash64_mid128(p, size, HASH64_SECRET, seed, hash);
+
+	} else {
+		uint8_t secret[HASH64_SECRET_SIZE];
+		const uint8_t *s = HASH64_SECRET;
+
+		if (seed != 0) {
+			hash64_init_secret(secret, seed);
+			s = secret;
+		}
+
+		uint64_t acc[8];
+		hash64_long(acc, p, size, s);
+		hash64_merge128(acc, s, size, hash);
+	}
+}
+
+
+// Streaming
+
+MTY_HashStream *MTY_HashStreamCreate(uint64_t seed)
+{
+	MTY_HashStream *ctx = MTY_Alloc(1, sizeof(MTY_HashStream));
+	MTY_HashStreamReset(ctx, seed);
+
+	return ctx;
+}
+
+void MTY_HashStreamDestroy(MTY_HashStream **hashStream)
+{
+	if (!hashStream || !*hashStream)
+		return;
+
+	MTY_HashStream *ctx = *hashStream;
+
+	MTY_Free(ctx);
+	*hashStream = NULL;
+}
+
+void MTY_HashStreamReset(MTY_HashStream *ctx, uint64_t seed)
+{
+	hash64_acc_init(ctx->acc);
+	hash64_init_secret(ctx->secret, seed);
+
+	ctx->buffered = 0;
+	ctx->stripes = 0;
+	ctx->total = 0;
+	ctx->seed = seed;
+}
+
+static void hash64_consume(uint64_t *acc, size_t *stripes_so_far, const uint8_t *input,
+	size_t stripes, const uint8_t *secret)
+{
+	// Picks up partway through a block, scrambling each time one is completed
+	while (stripes > 0) {
+		size_t n = HASH64_BLOCK_STRIPES - *stripes_so_far;
+		if (n > stripes)
+			n = stripes;
+
+		hash64_accumulate(acc, input, secret + *stripes_so_far * 8, n);
+
+		input += n * HASH64_STRIPE;
+		stripes -= n;
+		*stripes_so_far += n;
+
+		if (*stripes_so_far == HASH64_BLOCK_STRIPES) {
+			hash64_scramble(acc, secret + HASH64_SECRET_SIZE - HASH64_STRIPE);
+			*stripes_so_far = 0;
+		}
+	}
+}
+
+void MTY_HashStreamUpdate(MTY_HashStream *ctx, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+	const uint8_t *end = p + size;
+
+	ctx->total += size;
+
+	if (size <= HASH64_BUFFER - ctx->buffered) {
+		memcpy(ctx->buffer + ctx->buffered, p, size);
+		ctx->buffered += size;
+		return;
+	}
+
+	// At least one byte is always left buffered so the final stripe can be handled in
+	// the same way as the one-shot functions
+	if (ctx->buffered > 0) {
+		size_t n = HASH64_BUFFER - ctx->buffered;
+		memcpy(ctx->buffer + ctx->buffered, p, n);
+		p += n;
+
+		hash64_consume(ctx->acc, &ctx->stripes, ctx->buffer, HASH64_BUFFER / HASH64_STRIPE, ctx->secret);
+		ctx->buffered = 0;
+	}
+
+	if ((size_t) (end - p) > HASH64_BUFFER) {
+		size_t stripes = (size_t) (end - 1 - p) / HASH64_STRIPE;
+		hash64_consume(ctx->acc, &ctx->stripes, p, stripes, ctx->secret);
+		p += stripes * HASH64_STRIPE;
+
+		// Keep the previous stripe for when fewer than HASH64_STRIPE bytes remain
+		memcpy(ctx->buffer + HASH64_BUFFER - HASH64_STRIPE, p - HASH64_STRIPE, HASH64_STRIPE);
+	}
+
+	memcpy(ctx->buffer, p, end - p);
+	ctx->buffered = end - p;
+}
+
+static void hash64_stream_long(MTY_HashStream *ctx, uint64_t *acc)
+{
+	memcpy(acc, ctx->acc, sizeof(ctx->acc));
+
+	uint8_t last[HASH64_STRIPE];
+	const uint8_t *last_ptr = last;
+
+	if (ctx->buffered >= HASH64_STRIPE) {
+		size_t stripes_so_far = ctx->stripes;
+		hash64_consume(acc, &stripes_so_far, ctx->buffer, (ctx->buffered - 1) / HASH64_STRIPE, ctx->secret);
+
+		last_ptr = ctx->buffer + ctx->buffered - HASH64_STRIPE;
+
+	} else {
+		size_t n = HASH64_STRIPE - ctx->buffered;
+		memcpy(last, ctx->buffer + HASH64_BUFFER - n, n);
+		memcpy(last + n, ctx->buffer, ctx->buffered);
+	}
+
+	hash64_accumulate(acc, last_ptr, ctx->secret + HASH64_SECRET_SIZE - HASH64_STRIPE - HASH64_LAST_OFFSET, 1);
+}
+
+uint64_t MTY_HashStreamGet64(MTY_HashStream *ctx)
+{
+	if (ctx->total <= HASH64_MID_MAX)
+		return MTY_Hash64(ctx->buffer, (size_t) ctx->total, ctx->seed);
+
+	uint64_t acc[8];
+	hash64_stream_long(ctx, acc);
+
+	return hash64_merge(acc, ctx->secret + HASH64_MERGE_OFFSET, ctx->total * HASH64_P64_1);
+}
+
+void MTY_HashStreamGet128(MTY_HashStream *ctx, uint64_t hash[2])
+{
+	if (ctx->total <= HASH64_MID_MAX) {
+		MTY_Hash128(ctx->buffer, (size_t) ctx->total, ctx->seed, hash);
+		return;
+	}
+
+	uint64_t acc[8];
+	hash64_stream_long(ctx, acc);
+	hash64_merge128(acc, ctx->secret, ctx->total, hash);
+}
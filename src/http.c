@@ -4,13 +4,14 @@
 
 #include "matoya.h"
 #include "http.h"
+#include "alloc.h"
 
 #include <string.h>
 
 void mty_http_parse_headers(const char *all,
 	void (*func)(const char *key, const char *val, void *opaque), void *opaque)
 {
-	char *dup = MTY_Strdup(all);
+	char *dup = mty_strdup(all, MTY_MEMORY_TAG_HTTP);
 
 	char *ptr = NULL;
 	char *tok = MTY_Strtok(dup, "\n", &ptr);
@@ -49,12 +50,12 @@ char *mty_http_fix_scheme(const char *url)
 	}
 
 	if (scheme) {
-		char *furl = MTY_Alloc(strlen(url) + 3, 1);
+		char *furl = mty_alloc(strlen(url) + 3, 1, MTY_MEMORY_TAG_HTTP);
 		memcpy(furl + 2, url, strlen(url));
 		memcpy(furl, scheme, strlen(scheme));
 
 		return furl;
 	}
 
-	return MTY_Strdup(url);
+	return mty_strdup(url, MTY_MEMORY_TAG_HTTP);
 }
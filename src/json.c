@@ -4,48 +4,231 @@
 
 #include "matoya.h"
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
 
+#if defined(__AVX2__)
+	#define JSON_SCAN_AVX2
+	#include <immintrin.h>
+
+#elif defined(__SSE2__) || defined(_M_X64)
+	#define JSON_SCAN_SSE2
+	#include <emmintrin.h>
+
+#elif defined(__aarch64__)
+	#define JSON_SCAN_NEON
+	#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+#include "alloc.h"
+#include "file.h"
+#include "json-pow.h"
+
+struct json_item {
+	union {
+		char *key;
+
+		// While parsing, numbers and booleans in arrays are held here with `value`
+		// set to NULL and their JSON_PACK_* kind in `hash` until the array closes
+		double number;
+		int64_t integer;
+		bool boolean;
+	};
+
+	MTY_JSON *value;
+	uint32_t hash;
+};
+
+struct json_packed {
+	MTY_JSON **values; // Items created on demand by MTY_JSONArrayGetItem
+	MTY_Atomic32 ready; // Set once 'values' is complete
+};
+
+// Creating the items of a packed array is the only write a reader makes, and
+// arena documents share one arena, so creation is serialized process wide
+static MTY_Atomic32 JSON_PACKED_LOCK;
+
 struct MTY_JSON {
-	MTY_JSONType type;
+	uint8_t type;
+	uint8_t flags;
+	bool isint;
+	uint8_t pack;  // Arrays stored as a buffer of plain values, JSON_PACK_*
+	uint32_t iter; // Position of a container during traversal
 	MTY_JSON *parent;
-	uint8_t stage;
 
 	union {
 		bool boolean;
-		struct {
-			bool isint;
-			double value;
-		} number;
+		double number;
+		int64_t integer;
 		char *string;
 		struct json_array {
-			MTY_JSON **values;
+			union {
+				MTY_JSON **values;
+				struct json_packed *packed; // Followed by the values
+			};
 			uint32_t len;
 			uint32_t size;
-			uint32_t index;
 		} array;
 		struct json_object {
-			MTY_Hash *hash;
-			uint64_t iter;
+			struct json_item *items;
+			uint32_t len;
+			uint32_t size;
 		} object;
 	};
 };
 
+#define JSON_FLAG_ARENA 0x01 // Allocated from an arena, the item is read-only
+#define JSON_FLAG_DOC   0x02 // The root of an arena document, owns the arena
 
-// Parse
+#define JSON_PACK_NONE   0
+#define JSON_PACK_NUMBER 1 // double
+#define JSON_PACK_INT    2 // int64_t
+#define JSON_PACK_BOOL   3 // bool
+
+#define JSON_MAX_SAFE_INT ((int64_t) 1 << 53)
+
+struct json_doc {
+	MTY_JSON root;
+	MTY_Arena *arena;
+};
+
+// Size of a scalar item in an arena document, which ends after its value
+#define JSON_SCALAR_SIZE (offsetof(MTY_JSON, number) + sizeof(double))
+
+static void json_delete_item(MTY_JSON *j);
+
+
+// Object
+
+#define JSON_OBJECT_FLAT 8
+
+// Items are kept in insertion order. Objects with room for more than JSON_OBJECT_FLAT
+// items are followed in the same allocation by an open addressed index of item
+// positions, smaller ones are searched linearly
+
+static uint32_t json_hash(const char *key, size_t len)
+{
+	uint32_t h = 0x811C9DC5;
+
+	for (size_t x = 0; x < len; x++)
+		h = (h ^ (uint8_t) key[x]) * 0x01000193;
+
+	return h;
+}
+
+static uint32_t json_obj_index_size(uint32_t size)
+{
+	if (size <= JSON_OBJECT_FLAT)
+		return 0;
+
+	uint32_t index_size = 16;
+
+	while (index_size < size * 2)
+		index_size *= 2;
+
+	return index_size;
+}
+
+static size_t json_obj_alloc_size(uint32_t size)
+{
+	return size * sizeof(struct json_item) + json_obj_index_size(size) * sizeof(uint32_t);
+}
+
+static uint32_t *json_obj_index(const struct json_object *o, uint32_t *mask)
+{
+	*mask = json_obj_index_size(o->size) - 1;
+
+	return o->size > JSON_OBJECT_FLAT ? (uint32_t *) (o->items + o->size) : NULL;
+}
+
+static uint32_t json_obj_find(const struct json_object *o, const char *key, uint32_t hash)
+{
+	uint32_t mask = 0;
+	const uint32_t *index = json_obj_index(o, &mask);
+
+	if (index) {
+		for (uint32_t x = hash & mask; index[x] != 0; x = (x + 1) & mask) {
+			const struct json_item *item = &o->items[index[x] - 1];
+
+			if (item->hash == hash && !strcmp(item->key, key))
+				return index[x] - 1;
+		}
+
+	} else {
+		for (uint32_t x = 0; x < o->len; x++) {
+			const struct json_item *item = &o->items[x];
+
+			if (item->hash == hash && !strcmp(item->key, key))
+				return x;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+static void json_obj_index_add(struct json_object *o, uint32_t pos)
+{
+	uint32_t mask = 0;
+	uint32_t *index = json_obj_index(o, &mask);
+
+	if (!index)
+		return;
+
+	uint32_t x = o->items[pos].hash & mask;
 
-#define JSON_ARRAY_PAD  64
-#define JSON_STRING_PAD 64
+	while (index[x] != 0)
+		x = (x + 1) & mask;
 
-#define JSON_NONE   0
-#define JSON_OPEN   1
-#define JSON_KEY    2
-#define JSON_COLON  3
-#define JSON_CLOSED 4
+	index[x] = pos + 1;
+}
+
+static void json_obj_index_build(struct json_object *o)
+{
+	uint32_t mask = 0;
+	uint32_t *index = json_obj_index(o, &mask);
+
+	if (!index)
+		return;
+
+	memset(index, 0, (mask + 1) * sizeof(uint32_t));
+
+	for (uint32_t x = 0; x < o->len; x++)
+		json_obj_index_add(o, x);
+}
+
+static void json_obj_grow(struct json_object *o)
+{
+	o->size = o->size > 0 ? o->size * 2 : JSON_OBJECT_FLAT;
+	o->items = mty_realloc(o->items, json_obj_alloc_size(o->size), 1, MTY_MEMORY_TAG_JSON);
+
+	json_obj_index_build(o);
+}
+
+static MTY_JSON *json_obj_remove(struct json_object *o, uint32_t pos)
+{
+	MTY_JSON *value = o->items[pos].value;
+	MTY_Free(o->items[pos].key);
+
+	memmove(&o->items[pos], &o->items[pos + 1], (o->len - pos - 1) * sizeof(struct json_item));
+	o->len--;
+
+	json_obj_index_build(o);
+
+	return value;
+}
+
+
+// Parse
+
+#define JSON_STACK_PAD 64
 
 static const char JSON_UNESCAPE[UINT8_MAX] = {
 	['"']  = '"',
@@ -78,657 +261,3020 @@ static const uint8_t JSON_CHARS[UINT8_MAX] = {
 	['\0'] = 10,
 };
 
-static MTY_JSON *json_parse_null(const char *input, size_t len, uint32_t *p)
+// Parsing happens in two stages. The structural scan classifies the input 64 bytes at
+// a time and sets a bit for every bracket, colon, comma, quote and the first character
+// of every number or literal that is outside of a string. The tree builder then jumps
+// from one set bit to the next, so it never looks at white space or the contents of
+// strings that do not need unescaping. The scan works one window ahead of the tree
+// builder so its output stays in cache.
+
+// Children of containers that are still open are collected on the item stack, and
+// copied into an exactly sized array when the container closes. With an arena,
+// strings are terminated and unescaped in place in `buf`
+
+#define JSON_SCAN_BLOCK  64
+#define JSON_SCAN_WINDOW 256 // Blocks per window, 16 KB of input
+
+struct json_frame {
+	MTY_JSON *node;
+	uint32_t start;
+};
+
+struct json_parse {
+	const char *input;
+	char *buf;
+	size_t len;
+	size_t p;
+
+	MTY_Arena *arena;
+	struct json_doc *doc;
+
+	struct json_item *items;
+	uint32_t num_items;
+	uint32_t max_items;
+
+	struct json_frame *frames;
+	uint32_t depth;
+	uint32_t max_depth;
+
+	// Structural scan, one bit per input byte of the current window
+	uint64_t blocks[JSON_SCAN_WINDOW];
+	uint64_t backslashes[JSON_SCAN_WINDOW];
+	uint32_t num_blocks;
+	uint32_t block;
+	uint64_t bits;
+	size_t window;
+	size_t scan_p;
+	uint64_t prev_escaped;
+	uint64_t prev_in_string;
+	uint64_t prev_scalar;
+	bool scan_error;
+};
+
+
+// Structural scan
+
+#define JSON_SCAN_QUOTE     0x01
+#define JSON_SCAN_BACKSLASH 0x02
+#define JSON_SCAN_WS        0x04
+#define JSON_SCAN_OP        0x08
+#define JSON_SCAN_CTRL      0x10
+
+struct json_block {
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t ws;
+	uint64_t op;
+	uint64_t ctrl;
+};
+
+#if defined(JSON_SCAN_AVX2)
+
+static void json_classify(const uint8_t *in, struct json_block *b)
 {
-	if (len - *p >= 4 && !memcmp(input + *p, "null", 4)) {
-		*p += 3;
-		return MTY_JSONNullCreate();
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i lf = _mm256_set1_epi8('\n');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i lower = _mm256_set1_epi8(0x20);
+	const __m256i open = _mm256_set1_epi8('{');
+	const __m256i close = _mm256_set1_epi8('}');
+	const __m256i colon = _mm256_set1_epi8(':');
+	const __m256i comma = _mm256_set1_epi8(',');
+	const __m256i ctrl = _mm256_set1_epi8(0x1F);
+
+	for (uint8_t x = 0; x < 2; x++) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (in + x * 32));
+
+		// '[' and ']' differ from '{' and '}' only by the 0x20 bit
+		__m256i vl = _mm256_or_si256(v, lower);
+
+		__m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr)));
+
+		__m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(vl, open), _mm256_cmpeq_epi8(vl, close)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+
+		uint8_t shift = x * 32;
+		b->quote |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)) << shift;
+		b->backslash |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)) << shift;
+		b->ws |= (uint64_t) (uint32_t) _mm256_movemask_epi8(ws) << shift;
+		b->op |= (uint64_t) (uint32_t) _mm256_movemask_epi8(op) << shift;
+		b->ctrl |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, ctrl), ctrl)) << shift;
 	}
-
-	return NULL;
 }
 
-static MTY_JSON *json_parse_bool(const char *input, size_t len, uint32_t *p)
+#elif defined(JSON_SCAN_SSE2)
+
+static void json_classify(const uint8_t *in, struct json_block *b)
 {
-	if (len - *p >= 4 && !memcmp(input + *p, "true", 4)) {
-		*p += 3;
-		return MTY_JSONBoolCreate(true);
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lower = _mm_set1_epi8(0x20);
+	const __m128i open = _mm_set1_epi8('{');
+	const __m128i close = _mm_set1_epi8('}');
+	const __m128i colon = _mm_set1_epi8(':');
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i ctrl = _mm_set1_epi8(0x1F);
+
+	for (uint8_t x = 0; x < 4; x++) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + x * 16));
+
+		// '[' and ']' differ from '{' and '}' only by the 0x20 bit
+		__m128i vl = _mm_or_si128(v, lower);
+
+		__m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+			_mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+
+		__m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(vl, open), _mm_cmpeq_epi8(vl, close)),
+			_mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+
+		uint8_t shift = x * 16;
+		b->quote |= (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << shift;
+		b->backslash |= (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)) << shift;
+		b->ws |= (uint64_t) _mm_movemask_epi8(ws) << shift;
+		b->op |= (uint64_t) _mm_movemask_epi8(op) << shift;
+		b->ctrl |= (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl)) << shift;
 	}
+}
 
-	if (len - *p >= 5 && !memcmp(input + *p, "false", 5)) {
-		*p += 4;
-		return MTY_JSONBoolCreate(false);
+#elif defined(JSON_SCAN_NEON)
+
+static uint64_t json_neon_mask(const uint8x16_t *m)
+{
+	// NEON has no movemask, each lane keeps one bit and pairwise adds fold them together
+	const uint8x16_t bits = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+		0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+
+	uint8x16_t s0 = vpaddq_u8(vandq_u8(m[0], bits), vandq_u8(m[1], bits));
+	uint8x16_t s1 = vpaddq_u8(vandq_u8(m[2], bits), vandq_u8(m[3], bits));
+	s0 = vpaddq_u8(s0, s1);
+	s0 = vpaddq_u8(s0, s0);
+
+	return vgetq_lane_u64(vreinterpretq_u64_u8(s0), 0);
+}
+
+static void json_classify(const uint8_t *in, struct json_block *b)
+{
+	uint8x16_t quote[4];
+	uint8x16_t backslash[4];
+	uint8x16_t ws[4];
+	uint8x16_t op[4];
+	uint8x16_t ctrl[4];
+
+	for (uint8_t x = 0; x < 4; x++) {
+		uint8x16_t v = vld1q_u8(in + x * 16);
+
+		// '[' and ']' differ from '{' and '}' only by the 0x20 bit
+		uint8x16_t vl = vorrq_u8(v, vdupq_n_u8(0x20));
+
+		quote[x] = vceqq_u8(v, vdupq_n_u8('"'));
+		backslash[x] = vceqq_u8(v, vdupq_n_u8('\\'));
+		ws[x] = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+			vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))));
+		op[x] = vorrq_u8(vorrq_u8(vceqq_u8(vl, vdupq_n_u8('{')), vceqq_u8(vl, vdupq_n_u8('}'))),
+			vorrq_u8(vceqq_u8(v, vdupq_n_u8(':')), vceqq_u8(v, vdupq_n_u8(','))));
+		ctrl[x] = vcleq_u8(v, vdupq_n_u8(0x1F));
 	}
 
-	return NULL;
+	b->quote = json_neon_mask(quote);
+	b->backslash = json_neon_mask(backslash);
+	b->ws = json_neon_mask(ws);
+	b->op = json_neon_mask(op);
+	b->ctrl = json_neon_mask(ctrl);
 }
 
-static bool json_validate_number(const char *number, uint32_t len)
+#else
+
+static const uint8_t JSON_SCAN_CLASS[256] = {
+	[0x00] = JSON_SCAN_CTRL, [0x01] = JSON_SCAN_CTRL, [0x02] = JSON_SCAN_CTRL, [0x03] = JSON_SCAN_CTRL,
+	[0x04] = JSON_SCAN_CTRL, [0x05] = JSON_SCAN_CTRL, [0x06] = JSON_SCAN_CTRL, [0x07] = JSON_SCAN_CTRL,
+	[0x08] = JSON_SCAN_CTRL, [0x0B] = JSON_SCAN_CTRL, [0x0C] = JSON_SCAN_CTRL, [0x0E] = JSON_SCAN_CTRL,
+	[0x0F] = JSON_SCAN_CTRL, [0x10] = JSON_SCAN_CTRL, [0x11] = JSON_SCAN_CTRL, [0x12] = JSON_SCAN_CTRL,
+	[0x13] = JSON_SCAN_CTRL, [0x14] = JSON_SCAN_CTRL, [0x15] = JSON_SCAN_CTRL, [0x16] = JSON_SCAN_CTRL,
+	[0x17] = JSON_SCAN_CTRL, [0x18] = JSON_SCAN_CTRL, [0x19] = JSON_SCAN_CTRL, [0x1A] = JSON_SCAN_CTRL,
+	[0x1B] = JSON_SCAN_CTRL, [0x1C] = JSON_SCAN_CTRL, [0x1D] = JSON_SCAN_CTRL, [0x1E] = JSON_SCAN_CTRL,
+	[0x1F] = JSON_SCAN_CTRL,
+
+	['\t'] = JSON_SCAN_WS | JSON_SCAN_CTRL,
+	['\n'] = JSON_SCAN_WS | JSON_SCAN_CTRL,
+	['\r'] = JSON_SCAN_WS | JSON_SCAN_CTRL,
+	[' ']  = JSON_SCAN_WS,
+
+	['"']  = JSON_SCAN_QUOTE,
+	['\\'] = JSON_SCAN_BACKSLASH,
+
+	['{'] = JSON_SCAN_OP, ['}'] = JSON_SCAN_OP,
+	['['] = JSON_SCAN_OP, [']'] = JSON_SCAN_OP,
+	[':'] = JSON_SCAN_OP, [','] = JSON_SCAN_OP,
+};
+
+static void json_classify(const uint8_t *in, struct json_block *b)
 {
-	if (len >= 1 && number[len - 1] == '.')
-		return false;
+	for (uint8_t x = 0; x < JSON_SCAN_BLOCK; x++) {
+		uint64_t bit = (uint64_t) 1 << x;
+		uint8_t c = JSON_SCAN_CLASS[in[x]];
 
-	if (len >= 2 && number[0] == '0' && isdigit(number[1]))
-		return false;
+		if (c & JSON_SCAN_QUOTE)
+			b->quote |= bit;
 
-	if (len >= 2 && number[0] == '-' && number[1] == '.')
-		return false;
+		if (c & JSON_SCAN_BACKSLASH)
+			b->backslash |= bit;
 
-	if (len >= 3 && number[0] == '-' && number[1] == '0' && isdigit(number[2]))
-		return false;
+		if (c & JSON_SCAN_WS)
+			b->ws |= bit;
 
-	if (len >= 3 && isdigit(number[0]) && number[1] == '.' && (number[2] == 'e' || number[2] == 'E'))
-		return false;
+		if (c & JSON_SCAN_OP)
+			b->op |= bit;
 
-	return true;
+		if (c & JSON_SCAN_CTRL)
+			b->ctrl |= bit;
+	}
 }
 
-static MTY_JSON *json_parse_number(const char *input, size_t len, uint32_t *p)
-{
-	char number[96];
+#endif
 
-	// We allow this to scan up to len + 1 for the '\0' character
-	for (uint32_t x = 0; *p < len + 1 && x < 96; (*p)++, x++) {
-		char c = number[x] = input[*p];
+static uint32_t json_ctz64(uint64_t v)
+{
+	#if defined(_MSC_VER)
+		unsigned long index = 0;
+		_BitScanForward64(&index, v);
 
-		switch (JSON_CHARS[(uint8_t) c]) {
-			case 2:
-			case 5:
-			case 10:
-				(*p)--;
-				number[x] = '\0';
+		return index;
 
-				if (!json_validate_number(number, x))
-					return NULL;
+	#else
+		return __builtin_ctzll(v);
+	#endif
+}
 
-				char *end = NULL;
-				int64_t ival = strtoll(number, &end, 10);
+static uint64_t json_prefix_xor(uint64_t v)
+{
+	v ^= v << 1;
+	v ^= v << 2;
+	v ^= v << 4;
+	v ^= v << 8;
+	v ^= v << 16;
+	v ^= v << 32;
+
+	return v;
+}
 
-				if (!*end && ival >= INT32_MIN && ival <= INT32_MAX)
-					return MTY_JSONIntCreate((int32_t) ival);
+static uint64_t json_escaped(struct json_parse *ps, uint64_t backslash)
+{
+	const uint64_t odd = 0xAAAAAAAAAAAAAAAA;
 
-				double val = strtod(number, &end);
+	if (backslash == 0) {
+		uint64_t escaped = ps->prev_escaped;
+		ps->prev_escaped = 0;
 
-				return *end ? NULL : MTY_JSONNumberCreate(val);
-			case 8:
-			case 9:
-				break;
-			default:
-				return NULL;
-		}
+		return escaped;
 	}
 
-	return NULL;
+	// Subtracting the start of each run of backslashes carries through the run, which
+	// leaves the character after every odd length run marked as escaped
+	uint64_t start = backslash & ~ps->prev_escaped;
+	uint64_t code = (((start << 1) | odd) - start) ^ odd;
+	uint64_t escaped = code ^ (backslash | ps->prev_escaped);
+
+	ps->prev_escaped = (code & backslash) >> 63;
+
+	return escaped;
 }
 
-static size_t json_utf16_to_utf8(uint32_t code, char *str)
+static uint64_t json_structurals(struct json_parse *ps, const uint8_t *in, uint64_t *backslash)
 {
-	size_t x = 0;
+	struct json_block b = {0};
+	json_classify(in, &b);
 
-	if (code <= 0x7F) {
-		str[x++] = code & 0x7F;
+	*backslash = b.backslash;
 
-	} else {
-		if (code > 0xFFFF) {
-			str[x++] = (code >> 18 & 0x07) | 0xF0;
-			str[x++] = (code >> 12 & 0x3F) | 0x80;
+	uint64_t quote = b.quote & ~json_escaped(ps, b.backslash);
 
-		} else if (code > 0x07FF) {
-			str[x++] = (code >> 12 & 0x0F) | 0xE0;
-		}
+	// Bits are set from each opening quote up to, but not including, its closing quote
+	uint64_t in_string = json_prefix_xor(quote) ^ ps->prev_in_string;
+	ps->prev_in_string = (uint64_t) ((int64_t) in_string >> 63);
 
-		if (code > 0x07FF) {
-			str[x++] = (code >> 6 & 0x3F) | 0x80;
+	if (b.ctrl & in_string & ~quote)
+		ps->scan_error = true;
+
+	// Numbers and literals are recorded by their first character
+	uint64_t scalar = ~(b.op | b.ws);
+	uint64_t nonquote_scalar = scalar & ~quote;
+	uint64_t follows_scalar = nonquote_scalar << 1 | ps->prev_scalar;
+	ps->prev_scalar = nonquote_scalar >> 63;
+
+	uint64_t string_tail = in_string ^ quote;
+
+	return ((b.op | (scalar & ~follows_scalar)) & ~string_tail) | quote;
+}
+
+static bool json_scan(struct json_parse *ps)
+{
+	if (ps->scan_error || ps->scan_p >= ps->len)
+		return false;
+
+	const uint8_t *input = (const uint8_t *) ps->input;
+
+	ps->window = ps->scan_p;
+	ps->num_blocks = 0;
+
+	while (ps->num_blocks < JSON_SCAN_WINDOW && ps->scan_p < ps->len) {
+		uint32_t x = ps->num_blocks++;
+
+		if (ps->len - ps->scan_p >= JSON_SCAN_BLOCK) {
+			ps->blocks[x] = json_structurals(ps, input + ps->scan_p, &ps->backslashes[x]);
 
 		} else {
-			str[x++] = (code >> 6 & 0x1F) | 0xC0;
+			// The final partial block is padded with white space
+			uint8_t tail[JSON_SCAN_BLOCK];
+			memset(tail, ' ', JSON_SCAN_BLOCK);
+			memcpy(tail, input + ps->scan_p, ps->len - ps->scan_p);
+
+			ps->blocks[x] = json_structurals(ps, tail, &ps->backslashes[x]);
 		}
 
-		str[x++] = (code >> 0 & 0x3F) | 0x80;
+		ps->scan_p += JSON_SCAN_BLOCK;
 	}
 
-	return x;
+	// A control character inside a string invalidates everything after it
+	if (ps->scan_error)
+		ps->num_blocks = 0;
+
+	ps->block = 0;
+	ps->bits = ps->num_blocks > 0 ? ps->blocks[0] : 0;
+
+	return true;
 }
 
-static uint32_t json_parse_hex(const char *input)
+static bool json_next_block(struct json_parse *ps)
 {
-	char hex[5] = {0};
-	memcpy(hex, input, 4);
+	while (ps->bits == 0) {
+		if (ps->block + 1 < ps->num_blocks) {
+			ps->bits = ps->blocks[++ps->block];
 
-	char *end = NULL;
-	uint32_t code = strtoul(hex, &end, 16);
+		} else if (!json_scan(ps)) {
+			return false;
+		}
+	}
 
-	return *end ? 0x10000 : code;
+	return true;
 }
 
-static bool json_utf16(const char *input, size_t len, uint32_t *p, char *str, size_t *out)
+static inline size_t json_peek(struct json_parse *ps)
 {
-	if (*p + 5 >= len)
-		return false;
+	// The next recorded position, or the end of the input
+	if (ps->bits == 0 && !json_next_block(ps))
+		return ps->len;
 
-	uint32_t code = json_parse_hex(input + *p + 1);
-	if (code > 0xFFFF || (code >= 0xDC00 && code <= 0xDFFF))
-		return false;
+	return ps->window + ps->block * JSON_SCAN_BLOCK + json_ctz64(ps->bits);
+}
 
-	*p += 4;
+static bool json_has_backslash(struct json_parse *ps, size_t start, size_t end)
+{
+	// Strings that began in an earlier window are searched directly
+	if (start < ps->window)
+		return memchr(ps->input + start, '\\', end - start) != NULL;
 
-	// Surrogate pair, we expect another code to follow
-	if (code >= 0xD800 && code <= 0xDBFF) {
-		if (*p + 7 >= len || input[*p + 1] != '\\' || input[*p + 2] != 'u')
-			return false;
+	size_t first = (start - ps->window) / JSON_SCAN_BLOCK;
+	size_t last = (end - ps->window) / JSON_SCAN_BLOCK;
 
-		uint32_t code2 = json_parse_hex(input + *p + 3);
-		if (code2 < 0xDC00 || code2 > 0xDFFF)
-			return false;
+	for (size_t x = first; x <= last; x++) {
+		uint64_t mask = ps->backslashes[x];
 
-		*p += 6;
+		if (x == first)
+			mask &= UINT64_MAX << (start % JSON_SCAN_BLOCK);
 
-		code = 0x10000 | (code & 0x3FF) << 10 | (code2 & 0x3FF);
-	}
+		if (x == last)
+			mask &= ((uint64_t) 1 << (end % JSON_SCAN_BLOCK)) - 1;
 
-	*out += json_utf16_to_utf8(code, str + *out);
+		if (mask != 0)
+			return true;
+	}
 
-	return true;
+	return false;
 }
 
-static char *json_parse_string(const char *input, size_t len, uint32_t *p)
+static inline size_t json_next(struct json_parse *ps)
 {
-	size_t out = 0;
-	size_t slen = 0;
-	char *str = NULL;
+	size_t p = json_peek(ps);
 
-	for ((*p)++; *p < len; (*p)++) {
-		char c = input[*p];
+	// Clear the lowest bit, the position has been consumed
+	ps->bits &= ps->bits - 1;
 
-		if (c > 0 && c < 0x20)
-			break;
+	return p;
+}
 
-		if (out + 4 >= slen) {
-			slen += JSON_STRING_PAD;
-			str = MTY_Realloc(str, slen, 1);
-		}
+static void *json_alloc(struct json_parse *ps, size_t len, size_t size)
+{
+	if (len == 0)
+		return NULL;
 
-		if (c == '"') {
-			str[out] = '\0';
-			return str;
+	if (!ps->arena)
+		return mty_alloc(len, size, MTY_MEMORY_TAG_JSON);
 
-		} else if (c == '\\') {
-			if (++(*p) >= len)
-				break;
+	if (len > SIZE_MAX / size)
+		MTY_LogFatal("Arena allocation of %zu * %zu bytes overflows", len, size);
 
-			c = input[*p];
+	// Nothing in a document needs more than pointer alignment
+	return mty_arena_alloc(ps->arena, len * size, sizeof(void *));
+}
 
-			if (c == 'u') {
-				if (!json_utf16(input, len, p, str, &out))
-					break;
+static MTY_JSON *json_new(struct json_parse *ps, MTY_JSONType type)
+{
+	MTY_JSON *j = NULL;
 
-				continue;
+	if (ps->arena) {
+		// The first item created is the root of the document
+		if (!ps->doc) {
+			ps->doc = MTY_ArenaAlloc(ps->arena, 1, sizeof(struct json_doc));
+			ps->doc->arena = ps->arena;
 
-			} else {
-				c = JSON_UNESCAPE[(uint8_t) c];
-				if (c == 0)
-					break;
-			}
+			j = &ps->doc->root;
+			j->flags = JSON_FLAG_DOC;
+
+		} else {
+			// Scalars never touch the fields of a container, so they are allocated
+			// without them
+			bool scalar = type != MTY_JSON_OBJECT && type != MTY_JSON_ARRAY;
+			j = mty_arena_alloc(ps->arena, scalar ? JSON_SCALAR_SIZE : sizeof(MTY_JSON), sizeof(void *));
 		}
 
-		str[out++] = c;
+		j->flags |= JSON_FLAG_ARENA;
+
+	} else {
+		j = mty_alloc(1, sizeof(MTY_JSON), MTY_MEMORY_TAG_JSON);
 	}
 
-	MTY_Free(str);
+	j->type = type;
 
-	return NULL;
+	return j;
 }
 
-static bool json_attach_to_array(MTY_JSON *parent, MTY_JSON *j)
+static void json_token(struct json_parse *ps)
 {
-	struct json_array *a = &parent->array;
-
-	if (parent->stage > JSON_OPEN)
-		return false;
+	// White space is never recorded by the scan, so the next token is at the next position
+	ps->p = json_next(ps);
+}
 
-	if (a->len == a->size) {
-		a->size += JSON_ARRAY_PAD;
-		a->values = MTY_Realloc(a->values, a->size, sizeof(MTY_JSON *));
+static bool json_literal_end(const char *input, size_t len)
+{
+	// The scan only records the start of a literal, trailing characters are checked here
+	switch (JSON_CHARS[(uint8_t) input[len]]) {
+		case 1: case 2: case 4: case 5: case 6: case 10:
+			return true;
 	}
 
-	j->parent = parent;
-	a->values[a->len++] = j;
-
-	return true;
+	return false;
 }
 
-static bool json_attach_to_object(MTY_JSON *parent, char **key, MTY_JSON *j)
+static MTY_JSON *json_parse_null(struct json_parse *ps)
 {
-	if (!*key || parent->stage != JSON_COLON)
-		return false;
-
-	MTY_JSONObjSetItem(parent, *key, j);
+	const char *input = ps->input + ps->p;
 
-	MTY_Free(*key);
-	*key = NULL;
+	if (ps->len - ps->p >= 4 && !memcmp(input, "null", 4) && json_literal_end(input, 4)) {
+		ps->p += 4;
+		return json_new(ps, MTY_JSON_NULL);
+	}
 
-	return true;
+	return NULL;
 }
 
-static bool json_attach_item(MTY_JSON **root, MTY_JSON *parent, char **key, MTY_JSON *j)
+static bool json_parse_literal(struct json_parse *ps, struct json_item *item)
 {
-	if (!j)
-		return false;
+	const char *input = ps->input + ps->p;
+	size_t left = ps->len - ps->p;
 
-	if (!parent) {
-		if (*root) {
-			MTY_JSONDestroy(&j);
-			return false;
-		}
+	bool t = left >= 4 && !memcmp(input, "true", 4) && json_literal_end(input, 4);
+
+	if (t || (left >= 5 && !memcmp(input, "false", 5) && json_literal_end(input, 5))) {
+		ps->p += t ? 4 : 5;
+
+		item->hash = JSON_PACK_BOOL;
+		item->boolean = t;
 
-		*root = j;
 		return true;
 	}
 
-	bool r = parent->type == MTY_JSON_ARRAY ?
-		json_attach_to_array(parent, j) :
-		json_attach_to_object(parent, key, j);
+	return false;
+}
+
+// Numbers are parsed in a single pass. Up to 19 significant digits are collected into
+// an integer, which is converted exactly with a multiplication when it is small enough,
+// and otherwise with the Eisel-Lemire algorithm using 128-bit powers of five. Only
+// numbers with more than 19 significant digits that fall right between two doubles
+// take the big integer slow path, which unlike `strtod` ignores the current locale
 
-	parent->stage = JSON_CLOSED;
+#define JSON_DIGITS_MAX 19
 
-	if (!r)
-		MTY_JSONDestroy(&j);
+static const double JSON_POW10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
 
-	return r;
+struct json_number {
+	double number;
+	int64_t integer;
+	bool isint;
+};
+
+static uint32_t json_clz64(uint64_t v)
+{
+	#if defined(_MSC_VER)
+		unsigned long index = 0;
+		_BitScanReverse64(&index, v);
+
+		return 63 - index;
+
+	#else
+		return __builtin_clzll(v);
+	#endif
 }
 
-MTY_JSON *MTY_JSONParse(const char *input)
+static uint64_t json_mul128(uint64_t a, uint64_t b, uint64_t *lo)
 {
-	size_t len = strlen(input);
+	#if defined(__SIZEOF_INT128__)
+		__uint128_t r = (__uint128_t) a * b;
+		*lo = (uint64_t) r;
 
-	MTY_JSON *root = NULL;
-	MTY_JSON *parent = NULL;
-	int32_t nest = 0;
-	char *key = NULL;
+		return (uint64_t) (r >> 64);
 
-	uint32_t p = 0;
+	#elif defined(_M_X64)
+		uint64_t hi = 0;
+		*lo = _umul128(a, b, &hi);
 
-	for (; p < len; p++) {
-		char c = input[p];
+		return hi;
 
-		switch (JSON_CHARS[(uint8_t) c]) {
-			case 1: {
-				MTY_JSON *j = c == '{' ? MTY_JSONObjCreate() : MTY_JSONArrayCreate(0);
+	#elif defined(_M_ARM64)
+		*lo = a * b;
 
-				if (!json_attach_item(&root, parent, &key, j))
-					goto except;
+		return __umulh(a, b);
 
-				parent = j;
-				nest++;
-				break;
-			}
-			case 2: {
-				MTY_JSONType type = c == '}' ? MTY_JSON_OBJECT : MTY_JSON_ARRAY;
-				nest--;
+	#else
+		uint64_t a0 = (uint32_t) a, a1 = a >> 32;
+		uint64_t b0 = (uint32_t) b, b1 = b >> 32;
+		uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+		uint64_t mid = (p00 >> 32) + (uint32_t) p01 + (uint32_t) p10;
 
-				if (!parent || nest < 0 || parent->type != type)
-					goto except;
+		*lo = (mid << 32) | (uint32_t) p00;
 
-				if (parent->stage != JSON_NONE && parent->stage != JSON_CLOSED)
-					goto except;
+		return p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+	#endif
+}
 
-				parent = parent->parent;
-				break;
-			}
-			case 4:
-				if (!parent || parent->stage != JSON_KEY)
-					goto except;
+static bool json_eight_digits(const char *s)
+{
+	uint64_t v = 0;
+	memcpy(&v, s, 8);
 
-				parent->stage = JSON_COLON;
-				break;
-			case 5:
-				if (!parent || parent->stage != JSON_CLOSED)
-					goto except;
+	return ((v & 0xF0F0F0F0F0F0F0F0) | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))
+		== 0x3333333333333333;
+}
 
-				parent->stage = JSON_OPEN;
-				break;
-			case 6: {
-				char *str = json_parse_string(input, len, &p);
-				if (!str)
-					goto except;
+static uint32_t json_parse_eight(const char *s)
+{
+	// Pairs, then quads, then the full eight digits are combined with multiplications
+	uint64_t v = 0;
+	memcpy(&v, s, 8);
 
-				if (parent && parent->type == MTY_JSON_OBJECT && parent->stage <= JSON_OPEN) {
-					key = str;
-					parent->stage = JSON_KEY;
+	v -= 0x3030303030303030;
+	v = (v * 10) + (v >> 8);
+	v = (((v & 0x000000FF000000FF) * 0x000F424000000064) +
+		(((v >> 16) & 0x000000FF000000FF) * 0x0000271000000001)) >> 32;
 
-				} else {
-					MTY_JSON *j = MTY_Alloc(1, sizeof(MTY_JSON));
-					j->type = MTY_JSON_STRING;
-					j->string = str;
+	return (uint32_t) v;
+}
 
-					if (!json_attach_item(&root, parent, &key, j))
-						goto except;
+static uint64_t json_eisel_lemire(uint64_t w, int64_t q)
+{
+	// Returns the bits of the double nearest to w * 10^q, w must not be 0
+	if (q < JSON_POW5_MIN)
+		return 0;
+
+	if (q > JSON_POW5_MAX)
+		return 0x7FF0000000000000;
+
+	uint32_t lz = json_clz64(w);
+	w <<= lz;
+
+	// The product is truncated to 128 bits, the second multiplication is only needed
+	// when the bits below the mantissa might carry
+	const uint64_t *pow5 = JSON_POW5[q - JSON_POW5_MIN];
+	uint64_t lo = 0;
+	uint64_t hi = json_mul128(w, pow5[0], &lo);
+
+	if ((hi & 0x1FF) == 0x1FF) {
+		uint64_t lo2 = 0;
+		uint64_t hi2 = json_mul128(w, pow5[1], &lo2);
+
+		lo += hi2;
+		if (hi2 > lo)
+			hi++;
+	}
+
+	uint32_t upper = (uint32_t) (hi >> 63);
+	uint32_t shift = upper + 9;
+	uint64_t mantissa = hi >> shift;
+	int64_t power2 = (((152170 + 65536) * q) >> 16) + 63 + upper - lz + 1023;
+
+	// Subnormal, rounding may still carry it into the smallest normal exponent
+	if (power2 <= 0) {
+		if (-power2 + 1 >= 64)
+			return 0;
+
+		mantissa >>= -power2 + 1;
+		mantissa += mantissa & 1;
+		mantissa >>= 1;
+
+		return mantissa;
+	}
+
+	// Exactly halfway between two doubles, round to even
+	if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == hi)
+		mantissa &= ~(uint64_t) 1;
+
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+
+	if (mantissa >= (uint64_t) 2 << 52) {
+		mantissa = (uint64_t) 1 << 52;
+		power2++;
+	}
+
+	if (power2 >= 0x7FF)
+		return 0x7FF0000000000000;
+
+	return (mantissa & ~((uint64_t) 1 << 52)) | ((uint64_t) power2 << 52);
+}
+
+// Slow path for long numbers: the input is compared exactly against the point halfway
+// between the two candidate doubles using big integers. 800 significant digits plus a
+// sticky digit for the rest decide every case, which keeps both sides below 4096 bits
+
+#define JSON_BIG_LIMBS  128
+#define JSON_BIG_DIGITS 800
+
+struct json_big {
+	uint32_t limb[JSON_BIG_LIMBS];
+	uint32_t len;
+};
+
+static void json_big_mul_add(struct json_big *b, uint32_t mul, uint32_t add)
+{
+	uint64_t carry = add;
+
+	for (uint32_t x = 0; x < b->len; x++) {
+		uint64_t v = (uint64_t) b->limb[x] * mul + carry;
+		b->limb[x] = (uint32_t) v;
+		carry = v >> 32;
+	}
+
+	if (carry > 0 && b->len < JSON_BIG_LIMBS)
+		b->limb[b->len++] = (uint32_t) carry;
+}
+
+static void json_big_pow5(struct json_big *b, int64_t e)
+{
+	// 5^13 is the largest power of five that fits in 32 bits
+	for (; e >= 13; e -= 13)
+		json_big_mul_add(b, 1220703125, 0);
+
+	uint32_t mul = 1;
+
+	for (; e > 0; e--)
+		mul *= 5;
+
+	json_big_mul_add(b, mul, 0);
+}
+
+static void json_big_shl(struct json_big *b, int64_t n)
+{
+	if (b->len == 0)
+		return;
+
+	int64_t words = n / 32;
+	uint32_t bits = (uint32_t) (n % 32);
+	int64_t len = b->len + words + 1;
+
+	if (len > JSON_BIG_LIMBS)
+		len = JSON_BIG_LIMBS;
+
+	// Top down so every source limb is read before it is overwritten
+	for (int64_t x = len - 1; x >= 0; x--) {
+		int64_t src = x - words;
+		uint64_t hi = src >= 0 && src < b->len ? b->limb[src] : 0;
+		uint64_t lo = src >= 1 && src - 1 < b->len ? b->limb[src - 1] : 0;
+
+		b->limb[x] = bits > 0 ? (uint32_t) ((hi << bits) | (lo >> (32 - bits))) : (uint32_t) hi;
+	}
+
+	while (len > 0 && b->limb[len - 1] == 0)
+		len--;
+
+	b->len = (uint32_t) len;
+}
+
+static int32_t json_big_cmp(const struct json_big *a, const struct json_big *b)
+{
+	if (a->len != b->len)
+		return a->len > b->len ? 1 : -1;
+
+	for (uint32_t x = a->len; x > 0; x--) {
+		if (a->limb[x - 1] != b->limb[x - 1])
+			return a->limb[x - 1] > b->limb[x - 1] ? 1 : -1;
+	}
+
+	return 0;
+}
+
+static double json_to_double_slow(const char *input, uint64_t bits, bool neg)
+{
+	// The input is D * 10^k, `bits` is the double below it
+	struct json_big d = {0};
+	bool frac = false;
+	bool sticky = false;
+	int64_t k = 0;
+	uint32_t n = 0;
+
+	const char *p = input + (*input == '-');
+
+	for (; (*p >= '0' && *p <= '9') || *p == '.'; p++) {
+		if (*p == '.') {
+			frac = true;
+
+		} else if (n == 0 && *p == '0') {
+			if (frac)
+				k--;
+
+		} else if (n < JSON_BIG_DIGITS) {
+			json_big_mul_add(&d, 10, *p - '0');
+			n++;
+
+			if (frac)
+				k--;
+
+		} else {
+			if (!frac)
+				k++;
+
+			if (*p != '0')
+				sticky = true;
+		}
+	}
+
+	if (*p == 'e' || *p == 'E') {
+		p++;
+
+		bool eneg = *p == '-';
+
+		if (*p == '-' || *p == '+')
+			p++;
+
+		int64_t e = 0;
+
+		for (; *p >= '0' && *p <= '9'; p++) {
+			if (e < 0x10000)
+				e = e * 10 + (*p - '0');
+		}
+
+		k += eneg ? -e : e;
+	}
+
+	if (sticky) {
+		json_big_mul_add(&d, 10, 1);
+		k--;
+	}
+
+	// The halfway point is H * 2^e2 with H = 2 * mantissa + 1
+	uint64_t exp2 = bits >> 52;
+	uint64_t mantissa = bits & (((uint64_t) 1 << 52) - 1);
+	int64_t e2 = exp2 > 0 ? (int64_t) exp2 - 1076 : -1075;
+
+	if (exp2 > 0)
+		mantissa |= (uint64_t) 1 << 52;
+
+	uint64_t h = 2 * mantissa + 1;
+
+	struct json_big hb = {0};
+	hb.limb[0] = (uint32_t) h;
+	hb.limb[1] = (uint32_t) (h >> 32);
+	hb.len = hb.limb[1] > 0 ? 2 : 1;
+
+	// D * 5^k * 2^k against H * 2^e2, powers of five and two are moved to one side
+	if (k >= 0) {
+		json_big_pow5(&d, k);
+
+	} else {
+		json_big_pow5(&hb, -k);
+	}
+
+	if (k > e2) {
+		json_big_shl(&d, k - e2);
+
+	} else {
+		json_big_shl(&hb, e2 - k);
+	}
+
+	int32_t cmp = json_big_cmp(&d, &hb);
+
+	// Ties go to the even mantissa
+	if (cmp > 0 || (cmp == 0 && (bits & 1)))
+		bits++;
+
+	bits |= (uint64_t) neg << 63;
+
+	double value = 0;
+	memcpy(&value, &bits, sizeof(double));
+
+	return value;
+}
+
+static double json_to_double(const char *input, uint64_t m, int64_t q, bool neg, bool trunc)
+{
+	double value = 0;
+
+	if (m == 0)
+		return neg ? -value : value;
+
+	// Both m and 10^q are exact doubles, so a single rounding gives the right answer
+	if (!trunc && q >= -22 && q <= 22 && m <= (uint64_t) 1 << 53) {
+		value = (double) m;
+		value = q < 0 ? value / JSON_POW10[-q] : value * JSON_POW10[q];
+
+		return neg ? -value : value;
+	}
+
+	uint64_t bits = json_eisel_lemire(m, q);
+
+	// Dropped digits might push the value to the next double
+	if (trunc && bits != json_eisel_lemire(m + 1, q))
+		return json_to_double_slow(input, bits, neg);
+
+	bits |= (uint64_t) neg << 63;
+	memcpy(&value, &bits, sizeof(double));
+
+	return value;
+}
+
+static void json_truncate_digits(const char *digits, const char *end, uint64_t *m, int64_t *q, bool *trunc)
+{
+	// Collect the first JSON_DIGITS_MAX significant digits, remembering if any of the
+	// remaining ones were not zero
+	bool frac = false;
+	uint32_t n = 0;
+
+	*m = 0;
+	*q = 0;
+
+	for (const char *p = digits; p < end; p++) {
+		if (*p == '.') {
+			frac = true;
+
+		} else if (n == 0 && *p == '0') {
+			if (frac)
+				(*q)--;
+
+		} else if (n < JSON_DIGITS_MAX) {
+			*m = *m * 10 + (*p - '0');
+			n++;
+
+			if (frac)
+				(*q)--;
+
+		} else {
+			if (!frac)
+				(*q)++;
+
+			if (*p != '0')
+				*trunc = true;
+		}
+	}
+}
+
+static const char *json_read_number(const char *input, const char *end, struct json_number *num)
+{
+	// `input` must be terminated by a character that is not part of the number,
+	// `end` only bounds reading eight digits at a time
+	const char *p = input;
+	bool neg = *p == '-';
+
+	if (neg)
+		p++;
+
+	const char *digits = p;
+	uint64_t m = 0;
+
+	if (*p == '0') {
+		p++;
+
+	} else {
+		for (; *p >= '0' && *p <= '9'; p++)
+			m = m * 10 + (*p - '0');
+	}
+
+	if (p == digits)
+		return NULL;
+
+	size_t n = p - digits;
+	int64_t q = 0;
+	int64_t exp = 0;
+	bool isint = true;
+
+	if (*p == '.') {
+		const char *frac = ++p;
+
+		for (; end - p >= 8 && json_eight_digits(p); p += 8)
+			m = m * 100000000 + json_parse_eight(p);
+
+		for (; *p >= '0' && *p <= '9'; p++)
+			m = m * 10 + (*p - '0');
+
+		if (p == frac)
+			return NULL;
+
+		n += p - frac;
+		q = frac - p;
+		isint = false;
+	}
+
+	const char *mantissa_end = p;
+
+	if (*p == 'e' || *p == 'E') {
+		bool eneg = *++p == '-';
+
+		if (*p == '-' || *p == '+')
+			p++;
+
+		if (*p < '0' || *p > '9')
+			return NULL;
+
+		// Anything this large is already zero or infinity
+		int64_t e = 0;
+
+		for (; *p >= '0' && *p <= '9'; p++) {
+			if (e < 0x10000)
+				e = e * 10 + (*p - '0');
+		}
+
+		exp = eneg ? -e : e;
+		isint = false;
+	}
+
+	bool trunc = false;
+
+	if (n > JSON_DIGITS_MAX) {
+		json_truncate_digits(digits, mantissa_end, &m, &q, &trunc);
+		isint = false;
+	}
+
+	q += exp;
+
+	num->isint = isint && (neg ? m <= (uint64_t) INT64_MAX + 1 : m <= INT64_MAX);
+
+	if (num->isint) {
+		num->integer = neg ? -(int64_t) (m - 1) - 1 : (int64_t) m;
+		num->number = (double) num->integer;
+
+	} else {
+		num->number = json_to_double(input, m, q, neg, trunc);
+	}
+
+	return p;
+}
+
+static bool json_parse_number(struct json_parse *ps, struct json_item *item)
+{
+	struct json_number num;
+	const char *end = json_read_number(ps->input + ps->p, ps->input + ps->len, &num);
+
+	if (!end)
+		return false;
+
+	// The scan only records the start of a number, like a literal
+	switch (JSON_CHARS[(uint8_t) *end]) {
+		case 2: case 5: case 10:
+			break;
+		default:
+			return false;
+	}
+
+	ps->p = end - ps->input;
+
+	if (num.isint) {
+		item->hash = JSON_PACK_INT;
+		item->integer = num.integer;
+
+	} else {
+		item->hash = JSON_PACK_NUMBER;
+		item->number = num.number;
+	}
+
+	return true;
+}
+
+static void json_set_scalar(MTY_JSON *j, uint8_t kind, const void *value)
+{
+	switch (kind) {
+		case JSON_PACK_NUMBER:
+			j->type = MTY_JSON_NUMBER;
+			memcpy(&j->number, value, sizeof(double));
+			break;
+		case JSON_PACK_INT:
+			j->type = MTY_JSON_NUMBER;
+			j->isint = true;
+			memcpy(&j->integer, value, sizeof(int64_t));
+			break;
+		case JSON_PACK_BOOL:
+			j->type = MTY_JSON_BOOL;
+			memcpy(&j->boolean, value, sizeof(bool));
+			break;
+	}
+}
+
+static MTY_JSON *json_new_scalar(struct json_parse *ps, const struct json_item *item)
+{
+	MTY_JSON *j = json_new(ps, MTY_JSON_NULL);
+	json_set_scalar(j, (uint8_t) item->hash, &item->number);
+
+	return j;
+}
+
+static size_t json_utf16_to_utf8(uint32_t code, char *str)
+{
+	size_t x = 0;
+
+	if (code <= 0x7F) {
+		str[x++] = code & 0x7F;
+
+	} else {
+		if (code > 0xFFFF) {
+			str[x++] = (code >> 18 & 0x07) | 0xF0;
+			str[x++] = (code >> 12 & 0x3F) | 0x80;
+
+		} else if (code > 0x07FF) {
+			str[x++] = (code >> 12 & 0x0F) | 0xE0;
+		}
+
+		if (code > 0x07FF) {
+			str[x++] = (code >> 6 & 0x3F) | 0x80;
+
+		} else {
+			str[x++] = (code >> 6 & 0x1F) | 0xC0;
+		}
+
+		str[x++] = (code >> 0 & 0x3F) | 0x80;
+	}
+
+	return x;
+}
+
+static uint32_t json_parse_hex(const char *input)
+{
+	uint32_t code = 0;
+
+	for (uint8_t x = 0; x < 4; x++) {
+		char c = input[x];
+		code <<= 4;
+
+		if (c >= '0' && c <= '9') {
+			code |= c - '0';
+
+		} else if (c >= 'a' && c <= 'f') {
+			code |= c - 'a' + 10;
+
+		} else if (c >= 'A' && c <= 'F') {
+			code |= c - 'A' + 10;
+
+		} else {
+			return 0x10000;
+		}
+	}
+
+	return code;
+}
+
+static bool json_utf16(const char *input, size_t len, size_t *p, char *str, size_t *out)
+{
+	if (*p + 4 >= len)
+		return false;
+
+	uint32_t code = json_parse_hex(input + *p + 1);
+	if (code > 0xFFFF || (code >= 0xDC00 && code <= 0xDFFF))
+		return false;
+
+	*p += 4;
+
+	// Surrogate pair, we expect another code to follow
+	if (code >= 0xD800 && code <= 0xDBFF) {
+		if (*p + 6 >= len || input[*p + 1] != '\\' || input[*p + 2] != 'u')
+			return false;
+
+		uint32_t code2 = json_parse_hex(input + *p + 3);
+		if (code2 < 0xDC00 || code2 > 0xDFFF)
+			return false;
+
+		*p += 6;
+
+		code = 0x10000 | (code & 0x3FF) << 10 | (code2 & 0x3FF);
+	}
+
+	*out += json_utf16_to_utf8(code, str + *out);
+
+	return true;
+}
+
+static bool json_unescape(const char *input, size_t len, char *str, size_t *out)
+{
+	// The output is never longer than the input, so `str` may be `input`
+	for (size_t x = 0; x < len; x++) {
+		char c = input[x];
+
+		if (c == '\\') {
+			c = input[++x];
+
+			if (c == 'u') {
+				if (!json_utf16(input, len, &x, str, out))
+					return false;
+
+				continue;
+			}
+
+			c = JSON_UNESCAPE[(uint8_t) c];
+			if (c == 0)
+				return false;
+		}
+
+		str[(*out)++] = c;
+	}
+
+	return true;
+}
+
+static char *json_parse_string(struct json_parse *ps, size_t *len)
+{
+	// The closing quote is the next recorded position after the opening quote
+	size_t start = ps->p + 1;
+	size_t end = json_next(ps);
+
+	if (end >= ps->len || ps->input[end] != '"')
+		return NULL;
+
+	ps->p = end + 1;
+	*len = end - start;
+
+	bool escaped = json_has_backslash(ps, start, end);
+
+	char *str = ps->buf ? ps->buf + start : ps->arena ? mty_arena_alloc(ps->arena, *len + 1, 1) :
+		mty_alloc(*len + 1, 1, MTY_MEMORY_TAG_JSON);
+
+	if (escaped) {
+		size_t out = 0;
+
+		if (!json_unescape(ps->input + start, *len, str, &out)) {
+			if (!ps->buf && !ps->arena)
+				MTY_Free(str);
+
+			return NULL;
+		}
+
+		*len = out;
+
+	} else if (!ps->buf) {
+		memcpy(str, ps->input + start, *len);
+	}
+
+	str[*len] = '\0';
+
+	return str;
+}
+
+static void json_push_item(struct json_parse *ps, char *key, uint32_t hash, MTY_JSON *value)
+{
+	if (ps->num_items == ps->max_items) {
+		ps->max_items += ps->max_items + JSON_STACK_PAD;
+		ps->items = mty_realloc(ps->items, ps->max_items, sizeof(struct json_item), MTY_MEMORY_TAG_JSON);
+	}
+
+	struct json_item *item = &ps->items[ps->num_items++];
+	item->key = key;
+	item->hash = hash;
+	item->value = value;
+}
+
+static void json_push_frame(struct json_parse *ps, MTY_JSON *node)
+{
+	if (ps->depth == ps->max_depth) {
+		ps->max_depth += ps->max_depth + JSON_STACK_PAD;
+		ps->frames = mty_realloc(ps->frames, ps->max_depth, sizeof(struct json_frame), MTY_MEMORY_TAG_JSON);
+	}
+
+	struct json_frame *f = &ps->frames[ps->depth++];
+	f->node = node;
+	f->start = ps->num_items;
+}
+
+static bool json_parse_key(struct json_parse *ps)
+{
+	json_token(ps);
+
+	if (ps->input[ps->p] != '"')
+		return false;
+
+	size_t len = 0;
+	char *key = json_parse_string(ps, &len);
+	if (!key)
+		return false;
+
+	// The value is filled in once it has been parsed
+	json_push_item(ps, key, json_hash(key, len), NULL);
+	json_token(ps);
+
+	if (ps->input[ps->p] != ':')
+		return false;
+
+	ps->p++;
+
+	return true;
+}
+
+static size_t json_pack_size(uint8_t pack)
+{
+	switch (pack) {
+		case JSON_PACK_NUMBER: return sizeof(double);
+		case JSON_PACK_INT:    return sizeof(int64_t);
+		case JSON_PACK_BOOL:   return sizeof(bool);
+	}
+
+	return 0;
+}
+
+static uint8_t json_pack_kind(const struct json_item *items, uint32_t n)
+{
+	uint8_t pack = JSON_PACK_NONE;
+
+	for (uint32_t x = 0; x < n; x++) {
+		uint8_t kind = (uint8_t) items[x].hash;
+
+		if (items[x].value || kind == JSON_PACK_NONE)
+			return JSON_PACK_NONE;
+
+		if (pack == JSON_PACK_NONE || pack == kind)
+			pack = kind;
+
+		// Integers and doubles mix only when the integers convert exactly
+		else if (pack == JSON_PACK_BOOL || kind == JSON_PACK_BOOL)
+			return JSON_PACK_NONE;
+
+		else
+			pack = JSON_PACK_NUMBER;
+	}
+
+	if (pack == JSON_PACK_NUMBER) {
+		for (uint32_t x = 0; x < n; x++) {
+			int64_t v = items[x].integer;
+
+			if (items[x].hash == JSON_PACK_INT && (v > JSON_MAX_SAFE_INT || v < -JSON_MAX_SAFE_INT))
+				return JSON_PACK_NONE;
+		}
+	}
+
+	return pack;
+}
+
+static bool json_pack(struct json_parse *ps, MTY_JSON *j, const struct json_item *items, uint32_t n)
+{
+	uint8_t pack = n > 0 ? json_pack_kind(items, n) : JSON_PACK_NONE;
+
+	if (pack == JSON_PACK_NONE)
+		return false;
+
+	struct json_array *a = &j->array;
+	a->packed = json_alloc(ps, sizeof(struct json_packed) + n * json_pack_size(pack), 1);
+	a->len = a->size = n;
+	j->pack = pack;
+
+	void *data = a->packed + 1;
+
+	for (uint32_t x = 0; x < n; x++) {
+		switch (pack) {
+			case JSON_PACK_NUMBER:
+				((double *) data)[x] = items[x].hash == JSON_PACK_INT ?
+					(double) items[x].integer : items[x].number;
+				break;
+			case JSON_PACK_INT:
+				((int64_t *) data)[x] = items[x].integer;
+				break;
+			case JSON_PACK_BOOL:
+				((bool *) data)[x] = items[x].boolean;
+				break;
+		}
+	}
+
+	return true;
+}
+
+static MTY_JSON *json_close(struct json_parse *ps)
+{
+	struct json_frame *f = &ps->frames[--ps->depth];
+	struct json_item *items = ps->items + f->start;
+	uint32_t n = ps->num_items - f->start;
+	MTY_JSON *j = f->node;
+
+	if (j->type == MTY_JSON_ARRAY) {
+		if (!json_pack(ps, j, items, n)) {
+			struct json_array *a = &j->array;
+			a->values = json_alloc(ps, n, sizeof(MTY_JSON *));
+			a->len = a->size = n;
+
+			for (uint32_t x = 0; x < n; x++) {
+				a->values[x] = items[x].value ? items[x].value : json_new_scalar(ps, &items[x]);
+				a->values[x]->parent = j;
+			}
+		}
+
+	} else {
+		struct json_object *o = &j->object;
+		o->items = json_alloc(ps, json_obj_alloc_size(n), 1);
+		o->size = n;
+
+		for (uint32_t x = 0; x < n; x++) {
+			struct json_item *item = &items[x];
+			item->value->parent = j;
+
+			uint32_t pos = json_obj_find(o, item->key, item->hash);
+
+			// Duplicate keys, the last value wins
+			if (pos != UINT32_MAX) {
+				if (!ps->arena) {
+					json_delete_item(o->items[pos].value);
+					MTY_Free(item->key);
+				}
+
+				o->items[pos].value = item->value;
+
+			} else {
+				o->items[o->len] = *item;
+				json_obj_index_add(o, o->len++);
+			}
+		}
+	}
+
+	ps->num_items = f->start;
+
+	return j;
+}
+
+static void json_parse_cleanup(struct json_parse *ps, MTY_JSON *root)
+{
+	if (ps->arena) {
+		MTY_ArenaDestroy(&ps->arena);
+
+	} else {
+		for (uint32_t x = 0; x < ps->depth; x++) {
+			struct json_frame *f = &ps->frames[x];
+			uint32_t end = x + 1 < ps->depth ? ps->frames[x + 1].start : ps->num_items;
+
+			// Array items have no key, but may hold a number in its place
+			for (uint32_t y = f->start; y < end; y++) {
+				if (f->node->type == MTY_JSON_OBJECT)
+					MTY_Free(ps->items[y].key);
+
+				json_delete_item(ps->items[y].value);
+			}
+
+			// Open containers have no children attached yet
+			MTY_Free(f->node);
+		}
+
+		json_delete_item(root);
+	}
+}
+
+static MTY_JSON *json_parse(struct json_parse *ps)
+{
+	MTY_JSON *root = NULL;
+
+	while (true) {
+		json_token(ps);
+
+		MTY_JSON *j = NULL;
+		struct json_item scalar = {0};
+		char c = ps->input[ps->p];
+
+		switch (c) {
+			case '{':
+			case '[': {
+				j = json_new(ps, c == '{' ? MTY_JSON_OBJECT : MTY_JSON_ARRAY);
+				json_push_frame(ps, j);
+
+				if (ps->input[json_peek(ps)] == (c == '{' ? '}' : ']')) {
+					ps->p = json_next(ps) + 1;
+					j = json_close(ps);
+					break;
 				}
+
+				if (c == '{' && !json_parse_key(ps))
+					goto except;
+
+				continue;
+			}
+			case '"': {
+				size_t len = 0;
+				char *str = json_parse_string(ps, &len);
+				if (!str)
+					goto except;
+
+				j = json_new(ps, MTY_JSON_STRING);
+				j->string = str;
+				break;
+			}
+			case 'n':
+				j = json_parse_null(ps);
+				break;
+			default: {
+				bool r = c == 't' || c == 'f' ? json_parse_literal(ps, &scalar) :
+					JSON_CHARS[(uint8_t) c] == 8 && json_parse_number(ps, &scalar);
+
+				if (!r)
+					goto except;
+
+				// Numbers and booleans in arrays stay on the item stack until the array
+				// closes, in case it can be packed
+				if (ps->depth == 0 || ps->frames[ps->depth - 1].node->type != MTY_JSON_ARRAY)
+					j = json_new_scalar(ps, &scalar);
+				break;
+			}
+		}
+
+		if (!j && scalar.hash == JSON_PACK_NONE)
+			goto except;
+
+		// Attach the value to its container, closing containers as they end
+		while (true) {
+			if (ps->depth == 0) {
+				root = j;
+				json_token(ps);
+
+				if (ps->p != ps->len || ps->scan_error)
+					goto except;
+
+				goto end;
+			}
+
+			struct json_frame *f = &ps->frames[ps->depth - 1];
+			bool obj = f->node->type == MTY_JSON_OBJECT;
+
+			if (obj) {
+				ps->items[ps->num_items - 1].value = j;
+
+			} else if (j) {
+				json_push_item(ps, NULL, 0, j);
+
+			} else {
+				json_push_item(ps, NULL, 0, NULL);
+				ps->items[ps->num_items - 1] = scalar;
+			}
+
+			json_token(ps);
+			c = ps->input[ps->p++];
+
+			if (c == ',') {
+				if (obj && !json_parse_key(ps))
+					goto except;
+
+				break;
+			}
+
+			if (c != (obj ? '}' : ']'))
+				goto except;
+
+			j = json_close(ps);
+		}
+	}
+
+	except:
+
+	MTY_Log("Parse error at position %zu", ps->p);
+
+	json_parse_cleanup(ps, root);
+	root = NULL;
+
+	end:
+
+	MTY_Free(ps->items);
+	MTY_Free(ps->frames);
+
+	return root;
+}
+
+MTY_JSON *MTY_JSONParse(const char *input)
+{
+	struct json_parse ps = {
+		.input = input,
+		.len = strlen(input),
+	};
+
+	return json_parse(&ps);
+}
+
+MTY_JSON *MTY_JSONParseArena(const char *input)
+{
+	// Only strings are copied into the arena, not the whole input
+	struct json_parse ps = {
+		.input = input,
+		.len = strlen(input),
+		.arena = mty_arena_create(0, MTY_MEMORY_TAG_JSON),
+	};
+
+	return json_parse(&ps);
+}
+
+MTY_JSON *MTY_JSONParseInPlace(char *input)
+{
+	struct json_parse ps = {
+		.input = input,
+		.buf = input,
+		.len = strlen(input),
+		.arena = mty_arena_create(0, MTY_MEMORY_TAG_JSON),
+	};
+
+	return json_parse(&ps);
+}
+
+MTY_JSON *MTY_JSONReadFile(const char *path)
+{
+	MTY_JSON *j = NULL;
+	char *jstr = MTY_ReadFile(path, NULL);
+
+	if (jstr)
+		j = MTY_JSONParse(jstr);
+
+	MTY_Free(jstr);
+
+	return j;
+}
+
+MTY_JSON *MTY_JSONDuplicate(const MTY_JSON *json)
+{
+	if (!json)
+		return MTY_JSONNullCreate();
+
+	char *tmp = MTY_JSONSerialize(json);
+	MTY_JSON *dup = MTY_JSONParse(tmp);
+
+	MTY_Free(tmp);
+
+	return dup;
+}
+
+MTY_JSONType MTY_JSONGetType(const MTY_JSON *json)
+{
+	if (!json)
+		return MTY_JSON_NULL;
+
+	return json->type;
+}
+
+
+// Reader
+
+#define JSON_READER_CHUNK (64 * 1024)
+
+// The reader is a byte at a time state machine. Keys, strings, numbers and literals
+// are collected in a token buffer that only grows to the size of the largest token,
+// so memory use does not depend on the size of the input
+
+enum json_reader_state {
+	JSON_READER_NEXT        = 0, // After a value, expecting a delimiter or a new top level value
+	JSON_READER_VALUE       = 1, // After a ':' or an array ','
+	JSON_READER_FIRST_VALUE = 2, // After a '['
+	JSON_READER_KEY         = 3, // After an object ','
+	JSON_READER_FIRST_KEY   = 4, // After a '{'
+	JSON_READER_COLON       = 5, // After a key
+	JSON_READER_STRING      = 6,
+	JSON_READER_NUMBER      = 7,
+	JSON_READER_LITERAL     = 8,
+	JSON_READER_ERROR       = 9,
+};
+
+struct MTY_JSONReader {
+	MTY_JSONEventFunc func;
+	void *opaque;
+
+	enum json_reader_state state;
+	bool key;
+	bool escape;
+	size_t pos;
+
+	char *stack;
+	uint32_t depth;
+	uint32_t stack_size;
+
+	char *tok;
+	size_t tok_len;
+	size_t tok_size;
+};
+
+MTY_JSONReader *MTY_JSONReaderCreate(MTY_JSONEventFunc func, void *opaque)
+{
+	MTY_JSONReader *ctx = mty_alloc(1, sizeof(MTY_JSONReader), MTY_MEMORY_TAG_JSON);
+	ctx->func = func;
+	ctx->opaque = opaque;
+
+	return ctx;
+}
+
+void MTY_JSONReaderDestroy(MTY_JSONReader **reader)
+{
+	if (!reader || !*reader)
+		return;
+
+	MTY_JSONReader *ctx = *reader;
+
+	MTY_Free(ctx->stack);
+	MTY_Free(ctx->tok);
+
+	MTY_Free(ctx);
+	*reader = NULL;
+}
+
+static void json_reader_append(MTY_JSONReader *ctx, const char *data, size_t size)
+{
+	// One extra byte is kept for the null character
+	if (ctx->tok_len + size >= ctx->tok_size) {
+		while (ctx->tok_len + size >= ctx->tok_size)
+			ctx->tok_size += ctx->tok_size + JSON_STACK_PAD;
+
+		ctx->tok = mty_realloc(ctx->tok, ctx->tok_size, 1, MTY_MEMORY_TAG_JSON);
+	}
+
+	memcpy(ctx->tok + ctx->tok_len, data, size);
+	ctx->tok_len += size;
+}
+
+static bool json_reader_event(MTY_JSONReader *ctx, MTY_JSONEvent *evt)
+{
+	if (!ctx->func(evt, ctx->opaque)) {
+		ctx->state = JSON_READER_ERROR;
+		return false;
+	}
+
+	return true;
+}
+
+static bool json_reader_value(MTY_JSONReader *ctx, MTY_JSONEvent *evt)
+{
+	evt->type = MTY_JSON_EVENT_VALUE;
+	evt->depth = ctx->depth;
+	ctx->state = JSON_READER_NEXT;
+
+	return json_reader_event(ctx, evt);
+}
+
+static bool json_reader_string_end(MTY_JSONReader *ctx)
+{
+	size_t len = 0;
+
+	if (!json_unescape(ctx->tok, ctx->tok_len, ctx->tok, &len))
+		return false;
+
+	ctx->tok[len] = '\0';
+
+	MTY_JSONEvent evt = {
+		.value = MTY_JSON_STRING,
+		.string = ctx->tok,
+		.length = len,
+	};
+
+	if (ctx->key) {
+		evt.type = MTY_JSON_EVENT_KEY;
+		evt.depth = ctx->depth;
+		ctx->state = JSON_READER_COLON;
+
+		return json_reader_event(ctx, &evt);
+	}
+
+	return json_reader_value(ctx, &evt);
+}
+
+static bool json_reader_scalar_end(MTY_JSONReader *ctx)
+{
+	ctx->tok[ctx->tok_len] = '\0';
+
+	MTY_JSONEvent evt = {
+		.string = ctx->tok,
+		.length = ctx->tok_len,
+	};
+
+	if (ctx->state == JSON_READER_NUMBER) {
+		struct json_number num;
+
+		if (json_read_number(ctx->tok, ctx->tok + ctx->tok_len, &num) != ctx->tok + ctx->tok_len)
+			return false;
+
+		evt.value = MTY_JSON_NUMBER;
+		evt.number = num.number;
+		evt.integer = num.integer;
+		evt.isint = num.isint;
+
+	} else if (!strcmp(ctx->tok, "null")) {
+		evt.value = MTY_JSON_NULL;
+
+	} else if (!strcmp(ctx->tok, "true") || !strcmp(ctx->tok, "false")) {
+		evt.value = MTY_JSON_BOOL;
+		evt.boolean = ctx->tok[0] == 't';
+
+	} else {
+		return false;
+	}
+
+	return json_reader_value(ctx, &evt);
+}
+
+static bool json_reader_begin(MTY_JSONReader *ctx, char c)
+{
+	if (ctx->depth == ctx->stack_size) {
+		ctx->stack_size += ctx->stack_size + JSON_STACK_PAD;
+		ctx->stack = mty_realloc(ctx->stack, ctx->stack_size, 1, MTY_MEMORY_TAG_JSON);
+	}
+
+	MTY_JSONEvent evt = {
+		.type = c == '{' ? MTY_JSON_EVENT_OBJECT_BEGIN : MTY_JSON_EVENT_ARRAY_BEGIN,
+		.value = c == '{' ? MTY_JSON_OBJECT : MTY_JSON_ARRAY,
+		.depth = ctx->depth,
+	};
+
+	ctx->stack[ctx->depth++] = c;
+	ctx->state = c == '{' ? JSON_READER_FIRST_KEY : JSON_READER_FIRST_VALUE;
+
+	return json_reader_event(ctx, &evt);
+}
+
+static bool json_reader_end(MTY_JSONReader *ctx, char c)
+{
+	char open = c == '}' ? '{' : c == ']' ? '[' : '\0';
+
+	if (open == '\0' || ctx->depth == 0 || ctx->stack[ctx->depth - 1] != open)
+		return false;
+
+	ctx->depth--;
+
+	MTY_JSONEvent evt = {
+		.type = c == '}' ? MTY_JSON_EVENT_OBJECT_END : MTY_JSON_EVENT_ARRAY_END,
+		.value = c == '}' ? MTY_JSON_OBJECT : MTY_JSON_ARRAY,
+		.depth = ctx->depth,
+	};
+
+	ctx->state = JSON_READER_NEXT;
+
+	return json_reader_event(ctx, &evt);
+}
+
+static bool json_reader_start(MTY_JSONReader *ctx, char c)
+{
+	ctx->tok_len = 0;
+
+	switch (JSON_CHARS[(uint8_t) c]) {
+		case 1:
+			return json_reader_begin(ctx, c);
+		case 6:
+			ctx->state = JSON_READER_STRING;
+			ctx->key = false;
+			return true;
+		case 8:
+			ctx->state = JSON_READER_NUMBER;
+			json_reader_append(ctx, &c, 1);
+			return true;
+		case 3:
+		case 7:
+			ctx->state = JSON_READER_LITERAL;
+			json_reader_append(ctx, &c, 1);
+			return true;
+	}
+
+	return false;
+}
+
+static bool json_reader_string(MTY_JSONReader *ctx, const char *in, size_t size, size_t *x)
+{
+	// Runs of ordinary characters are appended at once, escapes are resolved when
+	// the string ends
+	size_t start = *x;
+
+	for (; *x < size; (*x)++) {
+		char c = in[*x];
+
+		if (ctx->escape) {
+			ctx->escape = false;
+
+		} else if (c == '\\') {
+			ctx->escape = true;
+
+		} else if (c == '"') {
+			break;
+
+		} else if ((uint8_t) c < 0x20) {
+			(*x)++;
+			return false;
+		}
+	}
+
+	json_reader_append(ctx, in + start, *x - start);
+
+	if (*x == size)
+		return true;
+
+	(*x)++;
+
+	return json_reader_string_end(ctx);
+}
+
+static bool json_reader_char(MTY_JSONReader *ctx, char c)
+{
+	bool ws = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	uint8_t type = JSON_CHARS[(uint8_t) c];
+
+	switch (ctx->state) {
+		case JSON_READER_NUMBER:
+		case JSON_READER_LITERAL:
+			if (ctx->state == JSON_READER_NUMBER ? type == 8 || type == 9 : c >= 'a' && c <= 'z') {
+				// No literal is longer than "false"
+				if (ctx->state == JSON_READER_LITERAL && ctx->tok_len == 5)
+					return false;
+
+				json_reader_append(ctx, &c, 1);
+				return true;
+			}
+
+			// The same characters that may follow a literal in the parser
+			if (!ws && type != 1 && type != 2 && type != 4 && type != 5 && type != 6)
+				return false;
+
+			if (!json_reader_scalar_end(ctx))
+				return false;
+
+			return json_reader_char(ctx, c);
+		case JSON_READER_NEXT:
+			if (ws)
+				return true;
+
+			if (ctx->depth == 0)
+				return json_reader_start(ctx, c);
+
+			if (c == ',') {
+				ctx->state = ctx->stack[ctx->depth - 1] == '{' ? JSON_READER_KEY : JSON_READER_VALUE;
+				return true;
+			}
+
+			// Anything else between values is an error, not the end of the container
+			if (c == ']' || c == '}')
+				return json_reader_end(ctx, c);
+
+			return false;
+		case JSON_READER_FIRST_VALUE:
+			if (c == ']')
+				return json_reader_end(ctx, c);
+			// fallthrough
+		case JSON_READER_VALUE:
+			return ws || json_reader_start(ctx, c);
+		case JSON_READER_FIRST_KEY:
+			if (c == '}')
+				return json_reader_end(ctx, c);
+			// fallthrough
+		case JSON_READER_KEY:
+			if (ws)
+				return true;
+
+			if (c != '"')
+				return false;
+
+			ctx->state = JSON_READER_STRING;
+			ctx->key = true;
+			ctx->tok_len = 0;
+			return true;
+		case JSON_READER_COLON:
+			if (ws)
+				return true;
+
+			if (c != ':')
+				return false;
+
+			ctx->state = JSON_READER_VALUE;
+			return true;
+		default:
+			break;
+	}
+
+	return false;
+}
+
+bool MTY_JSONReaderPush(MTY_JSONReader *ctx, const void *input, size_t size)
+{
+	const char *in = input;
+
+	for (size_t x = 0; x < size && ctx->state != JSON_READER_ERROR;) {
+		bool r = ctx->state == JSON_READER_STRING ? json_reader_string(ctx, in, size, &x) :
+			json_reader_char(ctx, in[x++]);
+
+		// The state is already set if the callback stopped the reader
+		if (!r && ctx->state != JSON_READER_ERROR) {
+			MTY_Log("Parse error at position %zu", ctx->pos + x - 1);
+			ctx->state = JSON_READER_ERROR;
+		}
+	}
+
+	ctx->pos += size;
+
+	return ctx->state != JSON_READER_ERROR;
+}
+
+bool MTY_JSONReaderFinish(MTY_JSONReader *ctx)
+{
+	// A number or literal is only complete once something follows it
+	bool r = MTY_JSONReaderPush(ctx, " ", 1);
+
+	if (r && (ctx->state != JSON_READER_NEXT || ctx->depth > 0)) {
+		MTY_Log("Unexpected end of input at position %zu", ctx->pos - 1);
+		r = false;
+	}
+
+	ctx->state = JSON_READER_NEXT;
+	ctx->escape = false;
+	ctx->depth = 0;
+	ctx->pos = 0;
+
+	return r;
+}
+
+bool MTY_JSONReaderReadFile(MTY_JSONReader *ctx, const char *path)
+{
+	FILE *f = mty_file_open(path, "rb");
+	if (!f)
+		return false;
+
+	char *buf = mty_alloc(JSON_READER_CHUNK, 1, MTY_MEMORY_TAG_JSON);
+	bool r = true;
+
+	for (size_t n = JSON_READER_CHUNK; n == JSON_READER_CHUNK && r;) {
+		n = fread(buf, 1, JSON_READER_CHUNK, f);
+		r = MTY_JSONReaderPush(ctx, buf, n);
+	}
+
+	if (r && ferror(f)) {
+		MTY_Log("'fread' failed to read '%s'", MTY_GetFileName(path, true));
+		r = false;
+	}
+
+	r = MTY_JSONReaderFinish(ctx) && r;
+
+	MTY_Free(buf);
+	fclose(f);
+
+	return r;
+}
+
+
+// Packed arrays
+
+static void json_unpack(MTY_JSON *j)
+{
+	// Items already created keep their place, the rest are NULL
+	struct json_array *a = &j->array;
+	struct json_packed *p = a->packed;
+
+	a->values = p->values;
+	if (!a->values)
+		a->len = a->size = 0;
+
+	j->pack = JSON_PACK_NONE;
+	MTY_Free(p);
+}
+
+static MTY_JSON **json_packed_values(const MTY_JSON *json)
+{
+	const struct json_array *a = &json->array;
+	struct json_packed *p = a->packed;
+
+	if (MTY_Atomic32Get(&p->ready))
+		return p->values;
+
+	MTY_GlobalLock(&JSON_PACKED_LOCK);
+
+	if (!p->values) {
+		// Items in an arena document are allocated from the arena owned by its root.
+		// An arena document may itself be attached to a heap item, so the walk stops
+		// at the first item that owns an arena
+		struct json_parse ps = {0};
+
+		if (json->flags & JSON_FLAG_ARENA) {
+			const MTY_JSON *root = json;
+			while (!(root->flags & JSON_FLAG_DOC))
+				root = root->parent;
+
+			ps.doc = (struct json_doc *) root;
+			ps.arena = ps.doc->arena;
+		}
+
+		MTY_JSON **values = json_alloc(&ps, a->len, sizeof(MTY_JSON *));
+		size_t size = json_pack_size(json->pack);
+		const uint8_t *data = (const uint8_t *) (p + 1);
+
+		for (uint32_t x = 0; x < a->len; x++) {
+			values[x] = json_new(&ps, MTY_JSON_NULL);
+			values[x]->parent = (MTY_JSON *) json;
+			json_set_scalar(values[x], json->pack, data + x * size);
+		}
+
+		p->values = values;
+		MTY_Atomic32Set(&p->ready, 1);
+	}
+
+	MTY_GlobalUnlock(&JSON_PACKED_LOCK);
+
+	return p->values;
+}
+
+
+// Destroy
+
+static void json_delete_item(MTY_JSON *j)
+{
+	for (MTY_JSON *root = j; j;) {
+		MTY_JSON *parent = j != root ? j->parent : NULL;
+
+		// Arena documents are freed all at once
+		if (j->flags & JSON_FLAG_ARENA) {
+			if (j->flags & JSON_FLAG_DOC) {
+				MTY_Arena *arena = ((struct json_doc *) j)->arena;
+				MTY_ArenaDestroy(&arena);
+			}
+
+			j = parent;
+			continue;
+		}
+
+		switch (j->type) {
+			case MTY_JSON_NULL:
+			case MTY_JSON_BOOL:
+			case MTY_JSON_NUMBER:
+				break;
+			case MTY_JSON_STRING:
+				MTY_Free(j->string);
+				break;
+			case MTY_JSON_ARRAY: {
+				struct json_array *a = &j->array;
+				MTY_JSON *top = j;
+
+				// Items handed out from a packed array are freed like regular items
+				if (j->pack != JSON_PACK_NONE)
+					json_unpack(j);
+
+				for (j = NULL; !j && top->iter < a->len; top->iter++)
+					j = a->values[top->iter];
+
+				if (j)
+					continue;
+
+				j = top;
+				MTY_Free(a->values);
 				break;
 			}
-			case 3:
-				if (!json_attach_item(&root, parent, &key, json_parse_bool(input, len, &p)))
-					goto except;
+			case MTY_JSON_OBJECT: {
+				struct json_object *o = &j->object;
+
+				if (j->iter < o->len) {
+					j = o->items[j->iter++].value;
+					continue;
+				}
+
+				for (uint32_t x = 0; x < o->len; x++)
+					MTY_Free(o->items[x].key);
+
+				MTY_Free(o->items);
 				break;
-			case 7:
-				if (!json_attach_item(&root, parent, &key, json_parse_null(input, len, &p)))
-					goto except;
+			}
+		}
+
+		MTY_Free(j);
+		j = parent;
+	}
+}
+
+void MTY_JSONDestroy(MTY_JSON **json)
+{
+	if (!json || !*json)
+		return;
+
+	if ((*json)->parent) {
+		MTY_Log("Attempted to destroy child item");
+		return;
+	}
+
+	json_delete_item(*json);
+	*json = NULL;
+}
+
+
+// Serialize
+
+#define JSON_SERIAL_PAD 512
+
+// Output is appended to a growing string, or handed straight to an MTY_JSONWriter
+// when `w` is set
+
+struct json_serial {
+	MTY_JSONWriter *w;
+	char *str;
+	size_t size;
+	size_t cur;
+	bool pretty;
+	uint32_t indent;
+};
+
+static void json_writer_write(MTY_JSONWriter *ctx, const void *data, size_t size);
+static void json_writer_char(MTY_JSONWriter *ctx, char c);
+
+static const char JSON_ESCAPE[UINT8_MAX] = {
+	['"']  = '"',
+	['\\'] = '\\',
+	['\b'] = 'b',
+	['\f'] = 'f',
+	['\n'] = 'n',
+	['\r'] = 'r',
+	['\t'] = 't',
+};
+
+static size_t json_escape(char c, char *out)
+{
+	char ec = JSON_ESCAPE[(uint8_t) c];
+
+	if (ec != 0) {
+		out[0] = '\\';
+		out[1] = ec;
+
+		return 2;
+	}
+
+	if (c > 0 && c < 0x20) {
+		snprintf(out, 7, "\\u%04x", c);
+
+		return 6;
+	}
+
+	out[0] = c;
+
+	return 1;
+}
+
+// Doubles are printed with Grisu2, which finds the shortest digits that read back as
+// the same double in nearly all cases, and digits that still round trip otherwise.
+// The notation follows "%.15g": plain between 1e-4 and 1e15, exponential outside
+
+struct json_diyfp {
+	uint64_t f;
+	int32_t e;
+};
+
+static struct json_diyfp json_diyfp_mul(struct json_diyfp x, struct json_diyfp y)
+{
+	uint64_t lo = 0;
+	uint64_t hi = json_mul128(x.f, y.f, &lo);
+
+	// Round the upper 64 bits
+	struct json_diyfp r = {hi + (lo >> 63), x.e + y.e + 64};
+
+	return r;
+}
+
+static struct json_diyfp json_diyfp_normalize(struct json_diyfp x)
+{
+	uint32_t lz = json_clz64(x.f);
+
+	x.f <<= lz;
+	x.e -= lz;
+
+	return x;
+}
+
+static uint32_t json_grisu2_digits(struct json_diyfp m_minus, struct json_diyfp w,
+	struct json_diyfp m_plus, char *buf, int32_t *k)
+{
+	uint64_t delta = m_plus.f - m_minus.f;
+	uint64_t dist = m_plus.f - w.f;
+
+	// The cached power puts the exponent in [-60, -32], so the integral part of
+	// m_plus fits in 32 bits
+	uint32_t shift = -m_plus.e;
+	uint64_t one = (uint64_t) 1 << shift;
+	uint32_t p1 = (uint32_t) (m_plus.f >> shift);
+	uint64_t p2 = m_plus.f & (one - 1);
+	uint32_t len = 0;
+
+	uint32_t pow10 = 1000000000;
+	int32_t n = 10;
+
+	while (pow10 > p1 && n > 1) {
+		pow10 /= 10;
+		n--;
+	}
+
+	uint64_t rest = 0;
+	uint64_t ten = 0;
+
+	while (true) {
+		if (n > 0) {
+			buf[len++] = (char) ('0' + p1 / pow10);
+			p1 %= pow10;
+			n--;
+
+			rest = ((uint64_t) p1 << shift) + p2;
+
+			if (rest <= delta) {
+				*k += n;
+				ten = (uint64_t) pow10 << shift;
 				break;
-			case 8:
-				if (!json_attach_item(&root, parent, &key, json_parse_number(input, len, &p)))
-					goto except;
+			}
+
+			pow10 /= 10;
+
+		} else {
+			p2 *= 10;
+			buf[len++] = (char) ('0' + (p2 >> shift));
+			p2 &= one - 1;
+			(*k)--;
+
+			delta *= 10;
+			dist *= 10;
+
+			if (p2 <= delta) {
+				rest = p2;
+				ten = one;
 				break;
-			case 10:
+			}
+		}
+	}
+
+	// Move the last digit towards w while staying within the boundaries
+	while (rest < dist && delta - rest >= ten && (rest + ten < dist || dist - rest > rest + ten - dist)) {
+		buf[len - 1]--;
+		rest += ten;
+	}
+
+	return len;
+}
+
+static uint32_t json_grisu2(double value, char *buf, int32_t *k)
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &value, sizeof(double));
+
+	uint64_t f = bits & (((uint64_t) 1 << 52) - 1);
+	int32_t e = (int32_t) (bits >> 52);
+
+	struct json_diyfp v = e == 0 ? (struct json_diyfp) {f, -1074} :
+		(struct json_diyfp) {f | (uint64_t) 1 << 52, e - 1075};
+
+	// Halfway points to the neighboring doubles, the lower one is closer at a power of 2
+	struct json_diyfp m_plus = {2 * v.f + 1, v.e - 1};
+	struct json_diyfp m_minus = f == 0 && e > 1 ? (struct json_diyfp) {4 * v.f - 1, v.e - 2} :
+		(struct json_diyfp) {2 * v.f - 1, v.e - 1};
+
+	m_plus = json_diyfp_normalize(m_plus);
+	m_minus.f <<= m_minus.e - m_plus.e;
+	m_minus.e = m_plus.e;
+	v = json_diyfp_normalize(v);
+
+	// Pick the cached power of ten c = 10^-k that scales m_plus into [2^-60, 2^-32)
+	int32_t x = -61 - m_plus.e;
+	int32_t dk = (x * 78913) / (1 << 18) + (x > 0);
+	uint32_t index = (-JSON_CACHED_MIN + dk + (JSON_CACHED_STEP - 1)) / JSON_CACHED_STEP;
+
+	const struct json_cached_power *cp = &JSON_CACHED_POWERS[index];
+	struct json_diyfp c = {cp->f, cp->e};
+
+	*k = -(JSON_CACHED_MIN + (int32_t) index * JSON_CACHED_STEP);
+
+	struct json_diyfp w = json_diyfp_mul(v, c);
+	struct json_diyfp w_minus = json_diyfp_mul(m_minus, c);
+	struct json_diyfp w_plus = json_diyfp_mul(m_plus, c);
+
+	// Shrink the boundaries by the rounding error of the multiplications
+	w_minus.f++;
+	w_plus.f--;
+
+	return json_grisu2_digits(w_minus, w, w_plus, buf, k);
+}
+
+static size_t json_format_int(int64_t value, char *out)
+{
+	char tmp[20];
+	uint64_t u = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+	size_t len = 0;
+	size_t n = 0;
+
+	do {
+		tmp[n++] = (char) ('0' + u % 10);
+		u /= 10;
+	} while (u > 0);
+
+	if (value < 0)
+		out[len++] = '-';
+
+	while (n > 0)
+		out[len++] = tmp[--n];
+
+	out[len] = '\0';
+
+	return len;
+}
+
+static uint32_t json_shorten(double value, char *digits, uint32_t len, int32_t *k)
+{
+	// Grisu2 leaves out a sliver at the edges of the rounding interval, so a shorter
+	// result is occasionally missed. The neighbors with one digit less are read back
+	// with the parser, which is exact, until neither of them gives `value`
+	uint64_t bits = 0;
+	memcpy(&bits, &value, sizeof(double));
+
+	while (len > 1) {
+		uint64_t m = 0;
+
+		for (uint32_t x = 0; x < len - 1; x++)
+			m = m * 10 + (digits[x] - '0');
+
+		bool up = digits[len - 1] >= '5';
+		uint64_t c = up ? m + 1 : m;
+		double d = json_to_double(NULL, c, *k + 1, false, false);
+
+		if (memcmp(&d, &bits, sizeof(double))) {
+			c = up ? m : m + 1;
+			d = json_to_double(NULL, c, *k + 1, false, false);
+
+			if (memcmp(&d, &bits, sizeof(double)))
 				break;
-			default:
-				goto except;
 		}
+
+		for ((*k)++; c % 10 == 0; c /= 10)
+			(*k)++;
+
+		len = (uint32_t) json_format_int((int64_t) c, digits);
 	}
 
-	except:
+	return len;
+}
 
-	if (key || nest != 0 || p != len) {
-		MTY_Log("Parse error at position %u", p);
-		MTY_JSONDestroy(&root);
+static size_t json_format_double(double value, char *out)
+{
+	// JSON has no representation for infinity or NaN
+	if (isnan(value) || isinf(value)) {
+		memcpy(out, "null", 5);
+		return 4;
 	}
 
-	MTY_Free(key);
+	char *o = out;
 
-	return root;
+	if (signbit(value)) {
+		*o++ = '-';
+		value = -value;
+	}
+
+	if (value == 0) {
+		memcpy(o, "0", 2);
+		return o + 1 - out;
+	}
+
+	char digits[20];
+	int32_t k = 0;
+	uint32_t len = json_grisu2(value, digits, &k);
+	len = json_shorten(value, digits, len, &k);
+
+	// The value is digits * 10^k, n is the position of the decimal point
+	int32_t n = (int32_t) len + k;
+
+	if (k >= 0 && n <= 15) {
+		memcpy(o, digits, len);
+		memset(o + len, '0', k);
+		o += n;
+
+	} else if (n > 0 && n <= 15) {
+		memcpy(o, digits, n);
+		o[n] = '.';
+		memcpy(o + n + 1, digits + n, len - n);
+		o += len + 1;
+
+	} else if (n > -4 && n <= 0) {
+		o[0] = '0';
+		o[1] = '.';
+		memset(o + 2, '0', -n);
+		memcpy(o + 2 - n, digits, len);
+		o += 2 - n + len;
+
+	} else {
+		*o++ = digits[0];
+
+		if (len > 1) {
+			*o++ = '.';
+			memcpy(o, digits + 1, len - 1);
+			o += len - 1;
+		}
+
+		int32_t e = n - 1;
+
+		*o++ = 'e';
+		*o++ = e < 0 ? '-' : '+';
+
+		if (e < 0)
+			e = -e;
+
+		if (e >= 100)
+			*o++ = (char) ('0' + e / 100);
+
+		*o++ = (char) ('0' + e / 10 % 10);
+		*o++ = (char) ('0' + e % 10);
+	}
+
+	*o = '\0';
+
+	return o - out;
 }
 
-MTY_JSON *MTY_JSONReadFile(const char *path)
+static void json_append_char(struct json_serial *s, char c)
 {
-	MTY_JSON *j = NULL;
-	char *jstr = MTY_ReadFile(path, NULL);
-
-	if (jstr)
-		j = MTY_JSONParse(jstr);
+	if (s->w) {
+		json_writer_char(s->w, c);
+		return;
+	}
 
-	MTY_Free(jstr);
+	if (s->cur == s->size) {
+		s->size += JSON_SERIAL_PAD;
+		s->str = mty_realloc(s->str, s->size + 1, 1, MTY_MEMORY_TAG_JSON);
+	}
 
-	return j;
+	s->str[s->cur++] = c;
 }
 
-MTY_JSON *MTY_JSONDuplicate(const MTY_JSON *json)
+static void json_append_data(struct json_serial *s, const char *add, size_t len)
 {
-	if (!json)
-		return MTY_JSONNullCreate();
+	if (s->w) {
+		json_writer_write(s->w, add, len);
+		return;
+	}
 
-	char *tmp = MTY_JSONSerialize(json);
-	MTY_JSON *dup = MTY_JSONParse(tmp);
+	if (s->size - s->cur < len) {
+		s->size += len + JSON_SERIAL_PAD;
+		s->str = mty_realloc(s->str, s->size + 1, 1, MTY_MEMORY_TAG_JSON);
+	}
 
-	MTY_Free(tmp);
+	memcpy(s->str + s->cur, add, len);
+	s->cur += len;
+}
 
-	return dup;
+static void json_append_string(struct json_serial *s, const char *add)
+{
+	size_t len = strlen(add);
+
+	for (size_t x = 0; x < len; x++) {
+		char esc[8];
+		size_t n = json_escape(add[x], esc);
+
+		for (size_t y = 0; y < n; y++)
+			json_append_char(s, esc[y]);
+	}
 }
 
-MTY_JSONType MTY_JSONGetType(const MTY_JSON *json)
+static void json_append_pretty(struct json_serial *s)
 {
-	if (!json)
-		return MTY_JSON_NULL;
+	if (s->pretty) {
+		json_append_char(s, '\n');
 
-	return json->type;
+		for (uint32_t x = 0; x < s->indent; x++)
+			json_append_char(s, '\t');
+	}
 }
 
+static void json_serialize_packed(struct json_serial *s, const MTY_JSON *j)
+{
+	const struct json_array *a = &j->array;
+	const void *data = a->packed + 1;
+
+	json_append_char(s, '[');
+	s->indent++;
 
-// Destroy
+	for (uint32_t x = 0; x < a->len; x++) {
+		if (x > 0)
+			json_append_char(s, ',');
 
-static void json_delete_item(MTY_JSON *j)
+		json_append_pretty(s);
+
+		char number[32];
+		size_t len = 0;
+
+		switch (j->pack) {
+			case JSON_PACK_NUMBER:
+				len = json_format_double(((const double *) data)[x], number);
+				json_append_data(s, number, len);
+				break;
+			case JSON_PACK_INT:
+				len = json_format_int(((const int64_t *) data)[x], number);
+				json_append_data(s, number, len);
+				break;
+			case JSON_PACK_BOOL:
+				json_append_string(s, ((const bool *) data)[x] ? "true" : "false");
+				break;
+		}
+	}
+
+	s->indent--;
+	json_append_pretty(s);
+	json_append_char(s, ']');
+}
+
+static void json_serialize_item(struct json_serial *s, MTY_JSON *j)
 {
+	if (!j)
+		json_append_string(s, "null");
+
 	for (MTY_JSON *root = j; j;) {
 		MTY_JSON *parent = j != root ? j->parent : NULL;
 
 		switch (j->type) {
 			case MTY_JSON_NULL:
+				json_append_string(s, "null");
+				break;
 			case MTY_JSON_BOOL:
-			case MTY_JSON_NUMBER:
+				json_append_string(s, j->boolean ? "true" : "false");
+				break;
+			case MTY_JSON_NUMBER: {
+				char number[32];
+				size_t len = j->isint ? json_format_int(j->integer, number) :
+					json_format_double(j->number, number);
+
+				json_append_data(s, number, len);
 				break;
+			}
 			case MTY_JSON_STRING:
-				MTY_Free(j->string);
+				json_append_char(s, '"');
+				json_append_string(s, j->string);
+				json_append_char(s, '"');
 				break;
 			case MTY_JSON_ARRAY: {
 				struct json_array *a = &j->array;
 				MTY_JSON *top = j;
+				uint32_t index = top->iter;
+
+				// Packed arrays are written straight from their buffer
+				if (j->pack != JSON_PACK_NONE) {
+					json_serialize_packed(s, j);
+					break;
+				}
 
-				for (j = NULL; !j && a->index < a->len; a->index++)
-					j = a->values[a->index];
+				if (index == 0) {
+					json_append_char(s, '[');
+					s->indent++;
+				}
 
-				if (j)
+				for (j = NULL; !j && top->iter < a->len; top->iter++)
+					j = a->values[top->iter];
+
+				if (j) {
+					if (index > 0)
+						json_append_char(s, ',');
+
+					json_append_pretty(s);
 					continue;
+				}
 
-				j = top;
-				MTY_Free(a->values);
+				s->indent--;
+				json_append_pretty(s);
+				json_append_char(s, ']');
+				top->iter = 0;
 				break;
 			}
 			case MTY_JSON_OBJECT: {
 				struct json_object *o = &j->object;
+				uint32_t iter = j->iter;
+
+				if (iter == 0) {
+					json_append_char(s, '{');
+					s->indent++;
+				}
+
+				if (j->iter < o->len) {
+					struct json_item *item = &o->items[j->iter++];
+
+					if (iter > 0)
+						json_append_char(s, ',');
 
-				const char *key = NULL;
+					json_append_pretty(s);
+					json_append_char(s, '"');
+					json_append_string(s, item->key);
+					json_append_char(s, '"');
+					json_append_char(s, ':');
+					if (s->pretty)
+						json_append_char(s, ' ');
 
-				if (MTY_HashGetNextKey(o->hash, &o->iter, &key)) {
-					j = MTY_HashGet(o->hash, key);
+					j = item->value;
 					continue;
 				}
 
-				MTY_HashDestroy(&o->hash, NULL);
+				s->indent--;
+				json_append_pretty(s);
+				json_append_char(s, '}');
+				j->iter = 0;
 				break;
 			}
 		}
 
-		MTY_Free(j);
 		j = parent;
 	}
 }
 
-void MTY_JSONDestroy(MTY_JSON **json)
+static char *json_serialize(MTY_JSON *j, bool pretty)
 {
-	if (!json || !*json)
-		return;
+	struct json_serial s = {
+		.str = mty_alloc(JSON_SERIAL_PAD + 1, 1, MTY_MEMORY_TAG_JSON),
+		.size = JSON_SERIAL_PAD,
+		.pretty = pretty,
+	};
 
-	if ((*json)->parent) {
-		MTY_Log("Attempted to destroy child item");
-		return;
-	}
+	json_serialize_item(&s, j);
+	s.str[s.cur] = '\0';
 
-	json_delete_item(*json);
-	*json = NULL;
+	return s.str;
+}
+
+char *MTY_JSONSerialize(const MTY_JSON *json)
+{
+	return json_serialize((MTY_JSON *) json, false);
 }
 
+bool MTY_JSONWriteFile(const char *path, const MTY_JSON *json)
+{
+	char *jstr = json_serialize((MTY_JSON *) json, true);
 
-// Serialize
+	bool r = MTY_WriteFile(path, jstr, strlen(jstr));
+	MTY_Free(jstr);
 
-#define JSON_SERIAL_PAD 512
+	return r;
+}
 
-struct json_serial {
-	char *str;
+
+// Writer
+
+#define JSON_WRITER_STAGE 4096
+
+#define JSON_WRITER_OBJECT 0x01
+#define JSON_WRITER_FIRST  0x02 // Nothing has been written to the container yet
+#define JSON_WRITER_KEY    0x04 // A key is waiting for its value
+
+// Output goes straight into the caller's buffer, or is staged and handed to the
+// function or file each time the stage fills. The container stack only holds a few
+// flags per level, so nothing is ever built in memory
+
+struct MTY_JSONWriter {
+	MTY_JSONWriteFunc func;
+	void *opaque;
+	FILE *f;
+
+	char *buf;
 	size_t size;
 	size_t cur;
-	bool pretty;
-	uint32_t indent;
+	size_t total;
+	bool staged;
+	bool error;
+	bool top;
+
+	uint8_t *stack;
+	uint32_t depth;
+	uint32_t stack_size;
 };
 
-static const char JSON_ESCAPE[UINT8_MAX] = {
-	['"']  = '"',
-	['\\'] = '\\',
-	['\b'] = 'b',
-	['\f'] = 'f',
-	['\n'] = 'n',
-	['\r'] = 'r',
-	['\t'] = 't',
-};
+static MTY_JSONWriter *json_writer_create(MTY_JSONWriteFunc func, void *opaque, FILE *f)
+{
+	MTY_JSONWriter *ctx = mty_alloc(1, sizeof(MTY_JSONWriter), MTY_MEMORY_TAG_JSON);
+	ctx->func = func;
+	ctx->opaque = opaque;
+	ctx->f = f;
+	ctx->buf = mty_alloc(JSON_WRITER_STAGE, 1, MTY_MEMORY_TAG_JSON);
+	ctx->size = JSON_WRITER_STAGE;
+	ctx->staged = true;
+
+	return ctx;
+}
 
-static void json_append_char(struct json_serial *s, char c)
+MTY_JSONWriter *MTY_JSONWriterCreate(MTY_JSONWriteFunc func, void *opaque)
 {
-	if (s->cur == s->size) {
-		s->size += JSON_SERIAL_PAD;
-		s->str = MTY_Realloc(s->str, s->size + 1, 1);
+	return json_writer_create(func, opaque, NULL);
+}
+
+MTY_JSONWriter *MTY_JSONWriterCreateBuffer(void *buf, size_t size)
+{
+	MTY_JSONWriter *ctx = mty_alloc(1, sizeof(MTY_JSONWriter), MTY_MEMORY_TAG_JSON);
+	ctx->buf = size > 0 ? buf : NULL;
+
+	// Room is always left for the null character
+	ctx->size = size > 0 ? size - 1 : 0;
+
+	return ctx;
+}
+
+MTY_JSONWriter *MTY_JSONWriterCreateFile(const char *path, bool append)
+{
+	FILE *f = mty_file_open(path, append ? "ab" : "wb");
+	if (!f)
+		return NULL;
+
+	return json_writer_create(NULL, NULL, f);
+}
+
+static bool json_writer_flush(MTY_JSONWriter *ctx)
+{
+	if (!ctx->staged || ctx->cur == 0)
+		return !ctx->error;
+
+	if (!ctx->error) {
+		bool r = ctx->f ? fwrite(ctx->buf, 1, ctx->cur, ctx->f) == ctx->cur :
+			ctx->func(ctx->buf, ctx->cur, ctx->opaque);
+
+		if (!r)
+			ctx->error = true;
 	}
 
-	s->str[s->cur++] = c;
+	ctx->cur = 0;
+
+	return !ctx->error;
+}
+
+void MTY_JSONWriterDestroy(MTY_JSONWriter **writer)
+{
+	if (!writer || !*writer)
+		return;
+
+	MTY_JSONWriter *ctx = *writer;
+
+	if (ctx->staged) {
+		json_writer_flush(ctx);
+		MTY_Free(ctx->buf);
+	}
+
+	if (ctx->f)
+		fclose(ctx->f);
+
+	MTY_Free(ctx->stack);
+
+	MTY_Free(ctx);
+	*writer = NULL;
+}
+
+static void json_writer_write(MTY_JSONWriter *ctx, const void *data, size_t size)
+{
+	const char *in = data;
+
+	while (size > 0 && !ctx->error) {
+		size_t n = ctx->size - ctx->cur;
+
+		if (n == 0) {
+			if (!ctx->staged) {
+				MTY_Log("Output buffer is too small");
+				ctx->error = true;
+			}
+
+			json_writer_flush(ctx);
+			continue;
+		}
+
+		if (n > size)
+			n = size;
+
+		memcpy(ctx->buf + ctx->cur, in, n);
+		ctx->cur += n;
+		ctx->total += n;
+		in += n;
+		size -= n;
+	}
+}
+
+static void json_writer_char(MTY_JSONWriter *ctx, char c)
+{
+	if (ctx->cur < ctx->size) {
+		ctx->buf[ctx->cur++] = c;
+		ctx->total++;
+
+	} else {
+		json_writer_write(ctx, &c, 1);
+	}
+}
+
+static void json_writer_string(MTY_JSONWriter *ctx, const char *str)
+{
+	const char *run = str;
+
+	json_writer_char(ctx, '"');
+
+	for (; *str; str++) {
+		char esc[8];
+		size_t n = json_escape(*str, esc);
+
+		if (n > 1) {
+			json_writer_write(ctx, run, str - run);
+			json_writer_write(ctx, esc, n);
+			run = str + 1;
+		}
+	}
+
+	json_writer_write(ctx, run, str - run);
+	json_writer_char(ctx, '"');
+}
+
+static bool json_writer_value(MTY_JSONWriter *ctx)
+{
+	if (ctx->depth == 0) {
+		if (ctx->top)
+			json_writer_char(ctx, '\n');
+
+		ctx->top = true;
+
+		return true;
+	}
+
+	uint8_t *flags = &ctx->stack[ctx->depth - 1];
+
+	if (*flags & JSON_WRITER_OBJECT) {
+		if (!(*flags & JSON_WRITER_KEY))
+			return false;
+
+	} else if (!(*flags & JSON_WRITER_FIRST)) {
+		json_writer_char(ctx, ',');
+	}
+
+	*flags &= ~(JSON_WRITER_FIRST | JSON_WRITER_KEY);
+
+	return true;
+}
+
+static bool json_writer_begin(MTY_JSONWriter *ctx, bool obj)
+{
+	if (!json_writer_value(ctx))
+		return false;
+
+	if (ctx->depth == ctx->stack_size) {
+		ctx->stack_size += ctx->stack_size + JSON_STACK_PAD;
+		ctx->stack = mty_realloc(ctx->stack, ctx->stack_size, 1, MTY_MEMORY_TAG_JSON);
+	}
+
+	ctx->stack[ctx->depth++] = JSON_WRITER_FIRST | (obj ? JSON_WRITER_OBJECT : 0);
+	json_writer_char(ctx, obj ? '{' : '[');
+
+	return true;
 }
 
-static void json_append_string(struct json_serial *s, const char *add)
+static bool json_writer_end(MTY_JSONWriter *ctx, bool obj)
 {
-	size_t len = strlen(add);
+	if (ctx->depth == 0)
+		return false;
 
-	for (size_t x = 0; x < len; x++) {
-		char c = add[x];
-		char ec = JSON_ESCAPE[(uint8_t) c];
+	uint8_t flags = ctx->stack[ctx->depth - 1];
 
-		if (ec == 0 && c > 0 && c < 0x20) {
-			char hex[3] = {0};
-			snprintf(hex, 3, "%02x", c);
+	if (!(flags & JSON_WRITER_OBJECT) != !obj || (flags & JSON_WRITER_KEY))
+		return false;
 
-			json_append_char(s, '\\');
-			json_append_char(s, 'u');
-			json_append_char(s, '0');
-			json_append_char(s, '0');
-			json_append_char(s, hex[0]);
-			json_append_char(s, hex[1]);
+	ctx->depth--;
+	json_writer_char(ctx, obj ? '}' : ']');
 
-		} else {
-			if (ec != 0) {
-				json_append_char(s, '\\');
-				c = ec;
-			}
+	return true;
+}
 
-			json_append_char(s, c);
-		}
-	}
+bool MTY_JSONWriterObjectBegin(MTY_JSONWriter *ctx)
+{
+	return json_writer_begin(ctx, true);
 }
 
-static void json_append_pretty(struct json_serial *s)
+bool MTY_JSONWriterObjectEnd(MTY_JSONWriter *ctx)
 {
-	if (s->pretty) {
-		json_append_char(s, '\n');
+	return json_writer_end(ctx, true);
+}
 
-		for (uint32_t x = 0; x < s->indent; x++)
-			json_append_char(s, '\t');
-	}
+bool MTY_JSONWriterArrayBegin(MTY_JSONWriter *ctx)
+{
+	return json_writer_begin(ctx, false);
 }
 
-static char *json_serialize(MTY_JSON *j, bool pretty)
+bool MTY_JSONWriterArrayEnd(MTY_JSONWriter *ctx)
 {
-	struct json_serial s = {
-		.str = MTY_Alloc(JSON_SERIAL_PAD + 1, 1),
-		.size = JSON_SERIAL_PAD,
-		.pretty = pretty,
-	};
+	return json_writer_end(ctx, false);
+}
 
-	if (!j)
-		json_append_string(&s, "null");
+bool MTY_JSONWriterKey(MTY_JSONWriter *ctx, const char *key)
+{
+	if (ctx->depth == 0)
+		return false;
 
-	for (MTY_JSON *root = j; j;) {
-		MTY_JSON *parent = j != root ? j->parent : NULL;
+	uint8_t *flags = &ctx->stack[ctx->depth - 1];
 
-		switch (j->type) {
-			case MTY_JSON_NULL:
-				json_append_string(&s, "null");
-				break;
-			case MTY_JSON_BOOL:
-				json_append_string(&s, j->boolean ? "true" : "false");
-				break;
-			case MTY_JSON_NUMBER: {
-				char number[32] = {0};
+	if (!(*flags & JSON_WRITER_OBJECT) || (*flags & JSON_WRITER_KEY))
+		return false;
 
-				if (j->number.isint) {
-					snprintf(number, 32, "%ld", lrint(j->number.value));
+	if (!(*flags & JSON_WRITER_FIRST))
+		json_writer_char(ctx, ',');
 
-				} else {
-					snprintf(number, 32, "%.15g", j->number.value);
-				}
+	*flags = (*flags & ~JSON_WRITER_FIRST) | JSON_WRITER_KEY;
 
-				json_append_string(&s, number);
-				break;
-			}
-			case MTY_JSON_STRING:
-				json_append_char(&s, '"');
-				json_append_string(&s, j->string);
-				json_append_char(&s, '"');
-				break;
-			case MTY_JSON_ARRAY: {
-				struct json_array *a = &j->array;
-				uint32_t index = a->index;
+	json_writer_string(ctx, key);
+	json_writer_char(ctx, ':');
 
-				if (index == 0) {
-					json_append_char(&s, '[');
-					s.indent++;
-				}
+	return true;
+}
 
-				for (j = NULL; !j && a->index < a->len; a->index++)
-					j = a->values[a->index];
+bool MTY_JSONWriterNull(MTY_JSONWriter *ctx)
+{
+	if (!json_writer_value(ctx))
+		return false;
 
-				if (j) {
-					if (index > 0)
-						json_append_char(&s, ',');
+	json_writer_write(ctx, "null", 4);
 
-					json_append_pretty(&s);
-					continue;
-				}
+	return true;
+}
 
-				s.indent--;
-				json_append_pretty(&s);
-				json_append_char(&s, ']');
-				a->index = 0;
-				break;
-			}
-			case MTY_JSON_OBJECT: {
-				struct json_object *o = &j->object;
-				uint64_t iter = o->iter;
+bool MTY_JSONWriterBool(MTY_JSONWriter *ctx, bool value)
+{
+	if (!json_writer_value(ctx))
+		return false;
 
-				if (iter == 0) {
-					json_append_char(&s, '{');
-					s.indent++;
-				}
+	json_writer_write(ctx, value ? "true" : "false", value ? 4 : 5);
 
-				const char *key = NULL;
+	return true;
+}
 
-				if (MTY_HashGetNextKey(o->hash, &o->iter, &key)) {
-					if (iter > 0)
-						json_append_char(&s, ',');
+bool MTY_JSONWriterNumber(MTY_JSONWriter *ctx, double value)
+{
+	if (!json_writer_value(ctx))
+		return false;
 
-					json_append_pretty(&s);
-					json_append_char(&s, '"');
-					json_append_string(&s, key);
-					json_append_char(&s, '"');
-					json_append_char(&s, ':');
-					if (s.pretty)
-						json_append_char(&s, ' ');
+	char number[32];
+	json_writer_write(ctx, number, json_format_double(value, number));
 
-					j = MTY_HashGet(o->hash, key);
-					continue;
-				}
+	return true;
+}
 
-				s.indent--;
-				json_append_pretty(&s);
-				json_append_char(&s, '}');
-				o->iter = 0;
-				break;
-			}
-		}
+bool MTY_JSONWriterInt(MTY_JSONWriter *ctx, int32_t value)
+{
+	return MTY_JSONWriterInt64(ctx, value);
+}
 
-		j = parent;
-	}
+bool MTY_JSONWriterInt64(MTY_JSONWriter *ctx, int64_t value)
+{
+	if (!json_writer_value(ctx))
+		return false;
 
-	s.str[s.cur] = '\0';
+	char number[32];
+	json_writer_write(ctx, number, json_format_int(value, number));
 
-	return s.str;
+	return true;
 }
 
-char *MTY_JSONSerialize(const MTY_JSON *json)
+bool MTY_JSONWriterString(MTY_JSONWriter *ctx, const char *value)
 {
-	return json_serialize((MTY_JSON *) json, false);
+	if (!json_writer_value(ctx))
+		return false;
+
+	json_writer_string(ctx, value);
+
+	return true;
 }
 
-bool MTY_JSONWriteFile(const char *path, const MTY_JSON *json)
+bool MTY_JSONWriterItem(MTY_JSONWriter *ctx, const MTY_JSON *json)
 {
-	char *jstr = json_serialize((MTY_JSON *) json, true);
+	if (!json_writer_value(ctx))
+		return false;
 
-	bool r = MTY_WriteFile(path, jstr, strlen(jstr));
-	MTY_Free(jstr);
+	// The item is written as it is walked, never serialized in memory first
+	struct json_serial s = {.w = ctx};
+	json_serialize_item(&s, (MTY_JSON *) json);
 
-	return r;
+	return true;
+}
+
+bool MTY_JSONWriterFinish(MTY_JSONWriter *ctx)
+{
+	bool r = json_writer_flush(ctx);
+
+	if (ctx->f && fflush(ctx->f) != 0)
+		r = false;
+
+	if (!ctx->staged && ctx->buf)
+		ctx->buf[ctx->cur] = '\0';
+
+	return r && ctx->depth == 0;
+}
+
+size_t MTY_JSONWriterGetSize(MTY_JSONWriter *ctx)
+{
+	return ctx->total;
 }
 
 
@@ -736,7 +3282,7 @@ bool MTY_JSONWriteFile(const char *path, const MTY_JSON *json)
 
 MTY_JSON *MTY_JSONNullCreate(void)
 {
-	MTY_JSON *j = MTY_Alloc(1, sizeof(MTY_JSON));
+	MTY_JSON *j = mty_alloc(1, sizeof(MTY_JSON), MTY_MEMORY_TAG_JSON);
 	j->type = MTY_JSON_NULL;
 
 	return j;
@@ -747,7 +3293,7 @@ MTY_JSON *MTY_JSONNullCreate(void)
 
 MTY_JSON *MTY_JSONBoolCreate(bool value)
 {
-	MTY_JSON *j = MTY_Alloc(1, sizeof(MTY_JSON));
+	MTY_JSON *j = mty_alloc(1, sizeof(MTY_JSON), MTY_MEMORY_TAG_JSON);
 	j->type = MTY_JSON_BOOL;
 	j->boolean = value;
 
@@ -769,19 +3315,26 @@ bool MTY_JSONBool(const MTY_JSON *json, bool *value)
 
 MTY_JSON *MTY_JSONNumberCreate(double value)
 {
-	MTY_JSON *j = MTY_Alloc(1, sizeof(MTY_JSON));
+	MTY_JSON *j = mty_alloc(1, sizeof(MTY_JSON), MTY_MEMORY_TAG_JSON);
 	j->type = MTY_JSON_NUMBER;
 
 	if (!isnan(value) && !isinf(value))
-		j->number.value = value;
+		j->number = value;
 
 	return j;
 }
 
 MTY_JSON *MTY_JSONIntCreate(int32_t value)
 {
-	MTY_JSON *j = MTY_JSONNumberCreate(value);
-	j->number.isint = true;
+	return MTY_JSONInt64Create(value);
+}
+
+MTY_JSON *MTY_JSONInt64Create(int64_t value)
+{
+	MTY_JSON *j = mty_alloc(1, sizeof(MTY_JSON), MTY_MEMORY_TAG_JSON);
+	j->type = MTY_JSON_NUMBER;
+	j->isint = true;
+	j->integer = value;
 
 	return j;
 }
@@ -791,37 +3344,48 @@ bool MTY_JSONNumber(const MTY_JSON *json, double *value)
 	if (!json || json->type != MTY_JSON_NUMBER)
 		return false;
 
-	*value = json->number.value;
+	*value = json->isint ? (double) json->integer : json->number;
 
 	return true;
 }
 
 bool MTY_JSONInt8(const MTY_JSON *json, int8_t *value)
 {
-	double v = 0;
-	bool r = MTY_JSONNumber(json, &v);
+	int64_t v = 0;
+	bool r = MTY_JSONInt64(json, &v);
 
-	*value = (int8_t) lrint(v);
+	*value = (int8_t) v;
 
 	return r;
 }
 
 bool MTY_JSONInt16(const MTY_JSON *json, int16_t *value)
 {
-	double v = 0;
-	bool r = MTY_JSONNumber(json, &v);
+	int64_t v = 0;
+	bool r = MTY_JSONInt64(json, &v);
 
-	*value = (int16_t) lrint(v);
+	*value = (int16_t) v;
 
 	return r;
 }
 
 bool MTY_JSONInt32(const MTY_JSON *json, int32_t *value)
+{
+	int64_t v = 0;
+	bool r = MTY_JSONInt64(json, &v);
+
+	*value = (int32_t) v;
+
+	return r;
+}
+
+bool MTY_JSONInt64(const MTY_JSON *json, int64_t *value)
 {
 	double v = 0;
 	bool r = MTY_JSONNumber(json, &v);
 
-	*value = lrint(v);
+	// Integers are exact, anything else is rounded
+	*value = r && json->isint ? json->integer : llrint(v);
 
 	return r;
 }
@@ -841,9 +3405,9 @@ bool MTY_JSONFloat(const MTY_JSON *json, float *value)
 
 MTY_JSON *MTY_JSONStringCreate(const char *value)
 {
-	MTY_JSON *j = MTY_Alloc(1, sizeof(MTY_JSON));
+	MTY_JSON *j = mty_alloc(1, sizeof(MTY_JSON), MTY_MEMORY_TAG_JSON);
 	j->type = MTY_JSON_STRING;
-	j->string = MTY_Strdup(value);
+	j->string = mty_strdup(value, MTY_MEMORY_TAG_JSON);
 
 	return j;
 }
@@ -871,9 +3435,9 @@ const char *MTY_JSONStringPtr(const MTY_JSON *json)
 
 MTY_JSON *MTY_JSONArrayCreate(uint32_t len)
 {
-	MTY_JSON *j = MTY_Alloc(1, sizeof(MTY_JSON));
+	MTY_JSON *j = mty_alloc(1, sizeof(MTY_JSON), MTY_MEMORY_TAG_JSON);
 	j->type = MTY_JSON_ARRAY;
-	j->array.values = MTY_Alloc(len, sizeof(MTY_JSON *));
+	j->array.values = mty_alloc(len, sizeof(MTY_JSON *), MTY_MEMORY_TAG_JSON);
 	j->array.len = j->array.size = len;
 
 	return j;
@@ -889,15 +3453,49 @@ uint32_t MTY_JSONArrayGetLength(const MTY_JSON *json)
 
 const MTY_JSON *MTY_JSONArrayGetItem(const MTY_JSON *json, uint32_t index)
 {
-	if (!json || json->type != MTY_JSON_ARRAY)
+	if (!json || json->type != MTY_JSON_ARRAY || index >= json->array.len)
+		return NULL;
+
+	if (json->pack != JSON_PACK_NONE)
+		return json_packed_values(json)[index];
+
+	return json->array.values[index];
+}
+
+static const void *json_packed_data(const MTY_JSON *json, uint8_t pack, uint32_t *len)
+{
+	if (!json || json->type != MTY_JSON_ARRAY || json->pack != pack)
 		return NULL;
 
-	return index < json->array.len ? json->array.values[index] : NULL;
+	*len = json->array.len;
+
+	return json->array.packed + 1;
+}
+
+bool MTY_JSONArrayGetNumbers(const MTY_JSON *json, const double **values, uint32_t *len)
+{
+	*values = json_packed_data(json, JSON_PACK_NUMBER, len);
+
+	return *values != NULL;
+}
+
+bool MTY_JSONArrayGetInt64s(const MTY_JSON *json, const int64_t **values, uint32_t *len)
+{
+	*values = json_packed_data(json, JSON_PACK_INT, len);
+
+	return *values != NULL;
+}
+
+bool MTY_JSONArrayGetBools(const MTY_JSON *json, const bool **values, uint32_t *len)
+{
+	*values = json_packed_data(json, JSON_PACK_BOOL, len);
+
+	return *values != NULL;
 }
 
 bool MTY_JSONArraySetItem(MTY_JSON *json, uint32_t index, MTY_JSON *value)
 {
-	if (!json || json->type != MTY_JSON_ARRAY)
+	if (!json || json->type != MTY_JSON_ARRAY || (json->flags & JSON_FLAG_ARENA))
 		return false;
 
 	struct json_array *a = &json->array;
@@ -912,6 +3510,12 @@ bool MTY_JSONArraySetItem(MTY_JSON *json, uint32_t index, MTY_JSON *value)
 		value->parent = json;
 	}
 
+	// Changing an item turns a packed array back into a regular one
+	if (json->pack != JSON_PACK_NONE) {
+		json_packed_values(json);
+		json_unpack(json);
+	}
+
 	json_delete_item(a->values[index]);
 	a->values[index] = value;
 
@@ -923,19 +3527,20 @@ bool MTY_JSONArraySetItem(MTY_JSON *json, uint32_t index, MTY_JSON *value)
 
 MTY_JSON *MTY_JSONObjCreate(void)
 {
-	MTY_JSON *j = MTY_Alloc(1, sizeof(MTY_JSON));
+	MTY_JSON *j = mty_alloc(1, sizeof(MTY_JSON), MTY_MEMORY_TAG_JSON);
 	j->type = MTY_JSON_OBJECT;
-	j->object.hash = MTY_HashCreate(64);
 
 	return j;
 }
 
 bool MTY_JSONObjGetNextKey(const MTY_JSON *json, uint64_t *iter, const char **key)
 {
-	if (!json || json->type != MTY_JSON_OBJECT)
+	if (!json || json->type != MTY_JSON_OBJECT || *iter >= json->object.len)
 		return false;
 
-	return MTY_HashGetNextKey(json->object.hash, iter, key);
+	*key = json->object.items[(*iter)++].key;
+
+	return true;
 }
 
 const MTY_JSON *MTY_JSONObjGetItem(const MTY_JSON *json, const char *key)
@@ -943,24 +3548,256 @@ const MTY_JSON *MTY_JSONObjGetItem(const MTY_JSON *json, const char *key)
 	if (!json || json->type != MTY_JSON_OBJECT)
 		return NULL;
 
-	return MTY_HashGet(json->object.hash, key);
+	const struct json_object *o = &json->object;
+	uint32_t pos = json_obj_find(o, key, json_hash(key, strlen(key)));
+
+	return pos != UINT32_MAX ? o->items[pos].value : NULL;
 }
 
 bool MTY_JSONObjSetItem(MTY_JSON *json, const char *key, MTY_JSON *value)
 {
-	if (!json || json->type != MTY_JSON_OBJECT)
+	if (!json || json->type != MTY_JSON_OBJECT || (json->flags & JSON_FLAG_ARENA))
 		return false;
 
+	struct json_object *o = &json->object;
+	uint32_t hash = json_hash(key, strlen(key));
+	uint32_t pos = json_obj_find(o, key, hash);
+
 	if (value) {
 		if (value->parent)
 			return false;
 
 		value->parent = json;
-		json_delete_item(MTY_HashSet(json->object.hash, key, value));
 
-	} else {
-		json_delete_item(MTY_HashPop(json->object.hash, key));
+		if (pos != UINT32_MAX) {
+			json_delete_item(o->items[pos].value);
+			o->items[pos].value = value;
+
+			return true;
+		}
+
+		if (o->len == o->size)
+			json_obj_grow(o);
+
+		struct json_item *item = &o->items[o->len];
+		item->key = mty_strdup(key, MTY_MEMORY_TAG_JSON);
+		item->value = value;
+		item->hash = hash;
+
+		json_obj_index_add(o, o->len++);
+
+	} else if (pos != UINT32_MAX) {
+		json_delete_item(json_obj_remove(o, pos));
+	}
+
+	return true;
+}
+
+
+// Path
+
+// Paths compiled together share a tree of segments so a common prefix is only looked
+// up once. A segment always comes after its parent, so the tree is evaluated in a
+// single pass over the segments
+
+#define JSON_PATH_STACK 64
+
+struct json_path_node {
+	char *key;
+	uint32_t hash;
+	uint32_t index; // UINT32_MAX if the segment is not an array index
+	uint32_t parent;
+};
+
+struct MTY_JSONPath {
+	struct json_path_node *nodes; // The first node is the whole document
+	uint32_t num_nodes;
+	uint32_t *ends; // The last node of each path
+	uint32_t num_paths;
+};
+
+static uint32_t json_path_index(const char *key, size_t len)
+{
+	// Array indexes have no sign or leading zeros, "-" is past the end and never exists
+	if (len == 0 || len > 10 || (key[0] == '0' && len > 1))
+		return UINT32_MAX;
+
+	uint64_t index = 0;
+
+	for (size_t x = 0; x < len; x++) {
+		if (key[x] < '0' || key[x] > '9')
+			return UINT32_MAX;
+
+		index = index * 10 + (key[x] - '0');
+	}
+
+	return index < UINT32_MAX ? (uint32_t) index : UINT32_MAX;
+}
+
+static char *json_path_segment(const char *path, size_t *len)
+{
+	char *key = mty_alloc(strcspn(path, "/") + 1, 1, MTY_MEMORY_TAG_JSON);
+	size_t x = 0;
+
+	for (; path[x] && path[x] != '/'; x++) {
+		char c = path[x];
+
+		if (c == '~') {
+			c = path[x + 1] == '0' ? '~' : path[x + 1] == '1' ? '/' : '\0';
+
+			if (c == '\0') {
+				MTY_Free(key);
+				return NULL;
+			}
+
+			x++;
+		}
+
+		key[(*len)++] = c;
+	}
+
+	return key;
+}
+
+static uint32_t json_path_add(MTY_JSONPath *ctx, uint32_t parent, char *key, size_t len)
+{
+	uint32_t hash = json_hash(key, len);
+
+	for (uint32_t x = parent + 1; x < ctx->num_nodes; x++) {
+		struct json_path_node *n = &ctx->nodes[x];
+
+		if (n->parent == parent && n->hash == hash && !strcmp(n->key, key)) {
+			MTY_Free(key);
+			return x;
+		}
+	}
+
+	if ((ctx->num_nodes & (ctx->num_nodes - 1)) == 0)
+		ctx->nodes = mty_realloc(ctx->nodes, ctx->num_nodes * 2, sizeof(struct json_path_node),
+			MTY_MEMORY_TAG_JSON);
+
+	struct json_path_node *n = &ctx->nodes[ctx->num_nodes];
+	n->key = key;
+	n->hash = hash;
+	n->index = json_path_index(key, len);
+	n->parent = parent;
+
+	return ctx->num_nodes++;
+}
+
+static bool json_path_compile(MTY_JSONPath *ctx, const char *path, uint32_t *end)
+{
+	// JSON Pointer, RFC 6901
+	if (path[0] != '\0' && path[0] != '/') {
+		MTY_Log("Path '%s' does not start with '/'", path);
+		return false;
+	}
+
+	*end = 0;
+
+	for (const char *p = path; *p == '/';) {
+		size_t len = 0;
+		char *key = json_path_segment(++p, &len);
+
+		if (!key) {
+			MTY_Log("Path '%s' has an invalid escape sequence", path);
+			return false;
+		}
+
+		*end = json_path_add(ctx, *end, key, len);
+		p += strcspn(p, "/");
 	}
 
 	return true;
 }
+
+MTY_JSONPath *MTY_JSONPathCompileBatch(const char **paths, uint32_t count)
+{
+	MTY_JSONPath *ctx = mty_alloc(1, sizeof(MTY_JSONPath), MTY_MEMORY_TAG_JSON);
+	ctx->nodes = mty_alloc(1, sizeof(struct json_path_node), MTY_MEMORY_TAG_JSON);
+	ctx->num_nodes = 1;
+	ctx->ends = mty_alloc(count, sizeof(uint32_t), MTY_MEMORY_TAG_JSON);
+	ctx->num_paths = count;
+
+	for (uint32_t x = 0; x < count; x++) {
+		if (!json_path_compile(ctx, paths[x], &ctx->ends[x])) {
+			MTY_JSONPathDestroy(&ctx);
+			break;
+		}
+	}
+
+	return ctx;
+}
+
+MTY_JSONPath *MTY_JSONPathCompile(const char *path)
+{
+	return MTY_JSONPathCompileBatch(&path, 1);
+}
+
+void MTY_JSONPathDestroy(MTY_JSONPath **path)
+{
+	if (!path || !*path)
+		return;
+
+	MTY_JSONPath *ctx = *path;
+
+	for (uint32_t x = 0; x < ctx->num_nodes; x++)
+		MTY_Free(ctx->nodes[x].key);
+
+	MTY_Free(ctx->nodes);
+	MTY_Free(ctx->ends);
+
+	MTY_Free(ctx);
+	*path = NULL;
+}
+
+static const MTY_JSON *json_path_step(const MTY_JSON *j, const struct json_path_node *n)
+{
+	if (j->type == MTY_JSON_OBJECT) {
+		uint32_t pos = json_obj_find(&j->object, n->key, n->hash);
+
+		return pos != UINT32_MAX ? j->object.items[pos].value : NULL;
+	}
+
+	return MTY_JSONArrayGetItem(j, n->index);
+}
+
+const MTY_JSON *MTY_JSONPathGetItem(const MTY_JSON *json, const MTY_JSONPath *path)
+{
+	if (path->num_paths == 0)
+		return NULL;
+
+	// The segments of the first path are the first ones in the tree
+	for (uint32_t x = 1; x <= path->ends[0] && json; x++)
+		json = json_path_step(json, &path->nodes[x]);
+
+	return json;
+}
+
+uint32_t MTY_JSONPathGetItems(const MTY_JSON *json, const MTY_JSONPath *path, const MTY_JSON **items)
+{
+	const MTY_JSON *stack[JSON_PATH_STACK];
+	const MTY_JSON **found = path->num_nodes <= JSON_PATH_STACK ? stack :
+		mty_alloc(path->num_nodes, sizeof(MTY_JSON *), MTY_MEMORY_TAG_JSON);
+
+	found[0] = json;
+
+	for (uint32_t x = 1; x < path->num_nodes; x++) {
+		const MTY_JSON *parent = found[path->nodes[x].parent];
+		found[x] = parent ? json_path_step(parent, &path->nodes[x]) : NULL;
+	}
+
+	uint32_t n = 0;
+
+	for (uint32_t x = 0; x < path->num_paths; x++) {
+		items[x] = found[path->ends[x]];
+
+		if (items[x])
+			n++;
+	}
+
+	if (found != stack)
+		MTY_Free(found);
+
+	return n;
+}
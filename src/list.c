@@ -5,6 +5,7 @@
 #include "matoya.h"
 
 struct MTY_List {
+	MTY_Pool *pool;
 	MTY_ListNode *first;
 	MTY_ListNode *last;
 };
@@ -14,6 +15,32 @@ MTY_List *MTY_ListCreate(void)
 	return MTY_Alloc(1, sizeof(MTY_List));
 }
 
+MTY_List *MTY_ListCreateFromPool(MTY_Pool *pool)
+{
+	if (MTY_PoolGetSize(pool) < sizeof(MTY_ListNode))
+		MTY_LogFatal("MTY_Pool objects are too small for MTY_ListNode");
+
+	MTY_List *ctx = MTY_ListCreate();
+	ctx->pool = pool;
+
+	return ctx;
+}
+
+static MTY_ListNode *list_alloc_node(MTY_List *ctx)
+{
+	return ctx->pool ? MTY_PoolAlloc(ctx->pool) : MTY_Alloc(1, sizeof(MTY_ListNode));
+}
+
+static void list_free_node(MTY_List *ctx, MTY_ListNode *node)
+{
+	if (ctx->pool) {
+		MTY_PoolFree(ctx->pool, node);
+
+	} else {
+		MTY_Free(node);
+	}
+}
+
 void MTY_ListDestroy(MTY_List **list, MTY_FreeFunc freeFunc)
 {
 	if (!list || !*list)
@@ -27,7 +54,7 @@ void MTY_ListDestroy(MTY_List **list, MTY_FreeFunc freeFunc)
 		if (freeFunc)
 			freeFunc(n->value);
 
-		MTY_Free(n);
+		list_free_node(ctx, n);
 		n = next;
 	}
 
@@ -42,7 +69,7 @@ MTY_ListNode *MTY_ListGetFirst(MTY_List *ctx)
 
 void MTY_ListAppend(MTY_List *ctx, void *value)
 {
-	MTY_ListNode *node = MTY_Alloc(1, sizeof(MTY_ListNode));
+	MTY_ListNode *node = list_alloc_node(ctx);
 	node->value = value;
 
 	if (!ctx->first) {
@@ -73,7 +100,7 @@ void *MTY_ListRemove(MTY_List *ctx, MTY_ListNode *node)
 
 	void *r = node->value;
 
-	MTY_Free(node);
+	list_free_node(ctx, node);
 
 	return r;
 }
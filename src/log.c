@@ -15,6 +15,8 @@ static MTY_Atomic32 LOG_DISABLED;
 static MTY_LogFunc LOG_FUNC = log_none;
 static void *LOG_OPAQUE;
 
+// Kept apart from other thread local memory so popping a scope can not free it, the
+// last message is replaced by the next one and freed when the thread exits
 static TLOCAL char *LOG_MSG;
 static TLOCAL bool LOG_PREVENT_RECURSIVE;
 
@@ -30,11 +32,14 @@ static void log_internal(const char *func, const char *fmt, va_list args)
 	char *fmt_name = MTY_SprintfD("%s: %s", func, fmt);
 	char *msg = MTY_VsprintfD(fmt_name, args);
 
-	LOG_MSG = mty_tlocal_strcpy(msg);
-
-	MTY_Free(msg);
 	MTY_Free(fmt_name);
 
+	if (!LOG_MSG)
+		mty_tlocal_track_thread();
+
+	MTY_Free(LOG_MSG);
+	LOG_MSG = msg;
+
 	if (!MTY_Atomic32Get(&LOG_DISABLED)) {
 		LOG_PREVENT_RECURSIVE = true;
 		LOG_FUNC(LOG_MSG, LOG_OPAQUE);
@@ -42,6 +47,12 @@ static void log_internal(const char *func, const char *fmt, va_list args)
 	}
 }
 
+void mty_log_destroy(void)
+{
+	MTY_Free(LOG_MSG);
+	LOG_MSG = NULL;
+}
+
 const char *MTY_GetLog(void)
 {
 	return LOG_MSG ? LOG_MSG : "";
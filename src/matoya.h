@@ -1504,21 +1504,34 @@ MTY_ResamplerReset(MTY_Resampler *ctx);
 
 //- #module Compression
 //- #mbrief Basic compression.
-//- #mdetails These functions are platform specific and any data compressed with
-//-   these functions should only be decompressed on the same platform.
+//- #mdetails These functions use a built-in LZ codec and wrap their output in a
+//-   self-describing frame, so data compressed on one platform can be decompressed
+//-   on any other.
 
-/// @brief Compress data with a balanced algorithm.
+typedef struct MTY_Compressor MTY_Compressor;
+typedef struct MTY_Decompressor MTY_Decompressor;
+
+/// @brief Compression methods.
+typedef enum {
+	MTY_COMPRESSION_FAST    = 0, ///< Greedy matching favoring speed over ratio.
+	MTY_COMPRESSION_HIGH    = 1, ///< Deeper match search favoring ratio over speed.
+	MTY_COMPRESSION_MAKE_32 = INT32_MAX,
+} MTY_Compression;
+
+/// @brief Compress data.
+/// @param method The compression method.
 /// @param input Uncompressed input buffer.
 /// @param inputSize Size in bytes of `input`.
 /// @param outputSize Set to the size in bytes of the returned compressed buffer.
 /// @returns On failure, NULL is returned. Call MTY_GetLog for details.\n\n
 ///   The returned buffer must be destroyed with MTY_Free.
 MTY_EXPORT void *
-MTY_Compress(const void *input, size_t inputSize, size_t *outputSize);
+MTY_Compress(MTY_Compression method, const void *input, size_t inputSize, size_t *outputSize);
 
 /// @brief Decompress data compressed with MTY_Compress.
-/// @details This function should only be called on the same platform that originally
-///   called MTY_Compress.
+/// @details The method used during compression is recorded in the frame and does not
+///   need to be specified. The frame carries a checksum of the original content
+///   that is verified before returning.
 /// @param input Compressed input buffer.
 /// @param inputSize Size in bytes of `input`.
 /// @param outputSize Set to the size in bytes of the returned decompressed buffer.
@@ -1527,6 +1540,85 @@ MTY_Compress(const void *input, size_t inputSize, size_t *outputSize);
 MTY_EXPORT void *
 MTY_Decompress(const void *input, size_t inputSize, size_t *outputSize);
 
+/// @brief Create an MTY_Compressor for streaming compression.
+/// @details The streaming compressor produces the same frame format as MTY_Compress,
+///   so its output can be decompressed with either MTY_Decompress or an
+///   MTY_Decompressor. Working memory is fixed regardless of the size of the input.
+/// @param method The compression method.
+/// @returns The returned MTY_Compressor must be destroyed with MTY_CompressorDestroy.
+MTY_EXPORT MTY_Compressor *
+MTY_CompressorCreate(MTY_Compression method);
+
+/// @brief Destroy an MTY_Compressor.
+/// @param compressor Passed by reference and set to NULL after being destroyed.
+MTY_EXPORT void
+MTY_CompressorDestroy(MTY_Compressor **compressor);
+
+/// @brief Push uncompressed data into an MTY_Compressor.
+/// @details Input is buffered internally and compressed one block at a time. Once
+///   a compressed block is waiting to be pulled, no further input is accepted until
+///   it has been drained with MTY_CompressorPull.
+/// @param ctx An MTY_Compressor.
+/// @param input Uncompressed input buffer.
+/// @param size Size in bytes of `input`.
+/// @returns The number of bytes consumed from `input`, which may be less than `size`.
+MTY_EXPORT size_t
+MTY_CompressorPush(MTY_Compressor *ctx, const void *input, size_t size);
+
+/// @brief Pull compressed data out of an MTY_Compressor.
+/// @param ctx An MTY_Compressor.
+/// @param output Output buffer to receive compressed data.
+/// @param size Size in bytes of `output`.
+/// @returns The number of bytes written to `output`. Zero is returned when no more
+///   compressed data is available until more input is pushed or the stream is flushed.
+MTY_EXPORT size_t
+MTY_CompressorPull(MTY_Compressor *ctx, void *output, size_t size);
+
+/// @brief Finish the stream, compressing any buffered input and writing the frame trailer.
+/// @details After this call no further input is accepted. Call MTY_CompressorPull
+///   until it returns zero to collect the remaining output.
+/// @param ctx An MTY_Compressor.
+MTY_EXPORT void
+MTY_CompressorFlush(MTY_Compressor *ctx);
+
+/// @brief Create an MTY_Decompressor for streaming decompression.
+/// @returns The returned MTY_Decompressor must be destroyed with MTY_DecompressorDestroy.
+MTY_EXPORT MTY_Decompressor *
+MTY_DecompressorCreate(void);
+
+/// @brief Destroy an MTY_Decompressor.
+/// @param decompressor Passed by reference and set to NULL after being destroyed.
+MTY_EXPORT void
+MTY_DecompressorDestroy(MTY_Decompressor **decompressor);
+
+/// @brief Push compressed data into an MTY_Decompressor.
+/// @details Once a decompressed block is waiting to be pulled, no further input is
+///   accepted until it has been drained with MTY_DecompressorPull.
+/// @param ctx An MTY_Decompressor.
+/// @param input Compressed input buffer.
+/// @param size Size in bytes of `input`.
+/// @param consumed Set to the number of bytes consumed from `input`.
+/// @returns Returns false if the stream is corrupt, otherwise true. Call MTY_GetLog
+///   for details.
+MTY_EXPORT bool
+MTY_DecompressorPush(MTY_Decompressor *ctx, const void *input, size_t size, size_t *consumed);
+
+/// @brief Pull decompressed data out of an MTY_Decompressor.
+/// @param ctx An MTY_Decompressor.
+/// @param output Output buffer to receive decompressed data.
+/// @param size Size in bytes of `output`.
+/// @returns The number of bytes written to `output`. Zero is returned when no more
+///   decompressed data is available until more input is pushed.
+MTY_EXPORT size_t
+MTY_DecompressorPull(MTY_Decompressor *ctx, void *output, size_t size);
+
+/// @brief Check if an MTY_Decompressor has reached the end of the stream.
+/// @param ctx An MTY_Decompressor.
+/// @returns Returns true if the frame trailer has been verified and all decompressed
+///   data has been pulled, otherwise false.
+MTY_EXPORT bool
+MTY_DecompressorDone(MTY_Decompressor *ctx);
+
 
 //- #module Crypto
 //- #mbrief Common cryptography tasks.
@@ -1537,6 +1629,8 @@ MTY_Decompress(const void *input, size_t inputSize, size_t *outputSize);
 #define MTY_SHA256_HEX_MAX 72 ///< Comfortable buffer size for a hex string SHA-256 digest.
 
 typedef struct MTY_AESGCM MTY_AESGCM;
+typedef struct MTY_HashCtx MTY_HashCtx;
+typedef struct MTY_HashStream MTY_HashStream;
 
 /// @brief Hash algorithms.
 typedef enum {
@@ -1547,20 +1641,119 @@ typedef enum {
 	MTY_ALGORITHM_MAKE_32    = INT32_MAX,
 } MTY_Algorithm;
 
+/// @brief A buffer used for scatter/gather operations.
+typedef struct {
+	void *data;  ///< Start of the buffer.
+	size_t size; ///< Size in bytes of `data`.
+} MTY_IOVec;
+
+/// @brief A packet encrypted or decrypted in place by MTY_AESGCMEncryptBatch and
+///   MTY_AESGCMDecryptBatch.
+/// @details On Android the data plus `tagSize`, and `aadSize` on its own, may each be
+///   at most 8 KB. Larger packets fail with `ok` set to false.
+typedef struct {
+	const void *nonce;    ///< 12 byte nonce. It MUST be different for every packet encrypted
+	                      ///<   using the same MTY_AESGCM context.
+	const void *aad;      ///< Additional data that is authenticated but not encrypted. May be
+	                      ///<   NULL if `aadSize` is 0.
+	size_t aadSize;       ///< Size in bytes of `aad`.
+	const MTY_IOVec *iov; ///< Buffers holding the data, processed as one contiguous range.
+	uint32_t iovLen;      ///< Number of elements in `iov`.
+	void *tag;            ///< GCM tag, written when encrypting and authenticated when
+	                      ///<   decrypting.
+	uint8_t tagSize;      ///< Size in bytes of `tag`, from 12 to 16.
+	bool ok;              ///< Set to true if the packet was processed successfully.
+} MTY_AESGCMPacket;
+
 /// @brief CRC32 checksum.
-/// @details This CRC32 implementation uses the reverse polynomial `0xEDB88320`.
-/// @param crc CRC32 seed value.
+/// @details This CRC32 implementation uses the reverse polynomial `0xEDB88320`, and
+///   matches zlib's `crc32`. CPU instructions are used when available.
+/// @param crc CRC32 seed value, 0 to begin or the result of a previous call to
+///   continue.
 /// @param buf Input buffer.
 /// @param size Size in bytes of `buf`.
 MTY_EXPORT uint32_t
 MTY_CRC32(uint32_t crc, const void *buf, size_t size);
 
+/// @brief CRC32C (Castagnoli) checksum.
+/// @details This CRC32C implementation uses the reverse polynomial `0x82F63B78`, as
+///   used by iSCSI, SCTP, and ext4. CPU instructions are used when available.
+/// @param crc CRC32C seed value, 0 to begin or the result of a previous call to
+///   continue.
+/// @param buf Input buffer.
+/// @param size Size in bytes of `buf`.
+MTY_EXPORT uint32_t
+MTY_CRC32C(uint32_t crc, const void *buf, size_t size);
+
 /// @brief Daniel J. Bernstein's classic string hash function.
 /// @param str String to hash.
 /// @returns Hash value.
 MTY_EXPORT uint32_t
 MTY_DJB2(const char *str);
 
+/// @brief Fast non-cryptographic 64-bit hash.
+/// @details This is the XXH3 algorithm, the output matches `XXH3_64bits_withSeed` from
+///   xxHash. It is far faster than MTY_DJB2 and suitable for hash tables, content
+///   deduplication, and cache keys, but must not be used where an attacker controls the
+///   input and could benefit from collisions.
+/// @param buf Input buffer.
+/// @param size Size in bytes of `buf`.
+/// @param seed Seed value, 0 for the default.
+/// @returns Hash value.
+MTY_EXPORT uint64_t
+MTY_Hash64(const void *buf, size_t size, uint64_t seed);
+
+/// @brief Fast non-cryptographic 128-bit hash.
+/// @details The output matches `XXH3_128bits_withSeed` from xxHash.
+/// @param buf Input buffer.
+/// @param size Size in bytes of `buf`.
+/// @param seed Seed value, 0 for the default.
+/// @param hash Set to the low 64 bits of the hash in `hash[0]` and the high 64 bits
+///   in `hash[1]`.
+MTY_EXPORT void
+MTY_Hash128(const void *buf, size_t size, uint64_t seed, uint64_t hash[2]);
+
+/// @brief Create an MTY_HashStream to compute MTY_Hash64 or MTY_Hash128 incrementally.
+/// @param seed Seed value, 0 for the default.
+/// @returns The returned MTY_HashStream must be destroyed with MTY_HashStreamDestroy.
+MTY_EXPORT MTY_HashStream *
+MTY_HashStreamCreate(uint64_t seed);
+
+/// @brief Destroy an MTY_HashStream.
+/// @param hashStream Passed by reference and set to NULL after being destroyed.
+MTY_EXPORT void
+MTY_HashStreamDestroy(MTY_HashStream **hashStream);
+
+/// @brief Discard all data added to an MTY_HashStream and set a new seed.
+/// @param ctx An MTY_HashStream.
+/// @param seed Seed value, 0 for the default.
+MTY_EXPORT void
+MTY_HashStreamReset(MTY_HashStream *ctx, uint64_t seed);
+
+/// @brief Add data to an MTY_HashStream.
+/// @param ctx An MTY_HashStream.
+/// @param buf Input buffer.
+/// @param size Size in bytes of `buf`.
+MTY_EXPORT void
+MTY_HashStreamUpdate(MTY_HashStream *ctx, const void *buf, size_t size);
+
+/// @brief Get the 64-bit hash of all data added to an MTY_HashStream.
+/// @details The result is the same as MTY_Hash64 on all the data at once. More data
+///   may be added afterwards.
+/// @param ctx An MTY_HashStream.
+/// @returns Hash value.
+MTY_EXPORT uint64_t
+MTY_HashStreamGet64(MTY_HashStream *ctx);
+
+/// @brief Get the 128-bit hash of all data added to an MTY_HashStream.
+/// @details The result is the same as MTY_Hash128 on all the data at once. More data
+///   may be added afterwards.
+/// @param ctx An MTY_HashStream.
+/// @param hash Set to the low 64 bits of the hash in `hash[0]` and the high 64 bits
+///   in `hash[1]`.
+MTY_EXPORT void
+MTY_HashStreamGet128(MTY_HashStream *ctx, uint64_t hash[2]);
+
 /// @brief Convert bytes to a hex string.
 /// @details This function will safely truncate overflows with a null character.
 /// @param bytes Input buffer.
@@ -1586,6 +1779,18 @@ MTY_HexToBytes(const char *hex, void *bytes, size_t size);
 MTY_EXPORT void
 MTY_BytesToBase64(const void *bytes, size_t size, char *base64, size_t base64Size);
 
+/// @brief Convert a Base64 string to bytes.
+/// @details Trailing `=` padding is optional. The result is at most 3 bytes for every
+///   4 characters of `base64`, nothing is written if `bytes` is smaller than that.
+/// @param base64 Base64 string input buffer.
+/// @param bytes Output buffer.
+/// @param size Size in bytes of `bytes`.
+/// @param written Set to the number of bytes written to `bytes`. May be NULL.
+/// @returns Returns true on success, false if `base64` is not valid Base64 or `bytes`
+///   is too small. Call MTY_GetLog for details.
+MTY_EXPORT bool
+MTY_Base64ToBytes(const char *base64, void *bytes, size_t size, size_t *written);
+
 /// @brief Run a hash algorithm on a buffer with optional HMAC key.
 /// @param algo Hash algorithm to use.
 /// @param input Input buffer.
@@ -1600,6 +1805,8 @@ MTY_CryptoHash(MTY_Algorithm algo, const void *input, size_t inputSize, const vo
 	size_t keySize, void *output, size_t outputSize);
 
 /// @brief Run a hash algorithm on the contents of a file with optional HMAC key.
+/// @details The file is read and hashed in fixed size chunks, so memory use does not
+///   depend on the size of the file.
 /// @param algo Hash algorithm to use.
 /// @param path Path to the input file.
 /// @param key HMAC key to use. May be NULL, in which case HMAC is not used.
@@ -1612,6 +1819,43 @@ MTY_EXPORT bool
 MTY_CryptoHashFile(MTY_Algorithm algo, const char *path, const void *key, size_t keySize,
 	void *output, size_t outputSize);
 
+/// @brief Create an MTY_HashCtx to hash data incrementally with optional HMAC key.
+/// @details Hashing a buffer in several calls to MTY_HashCtxUpdate produces the
+///   same output as a single call to MTY_CryptoHash with the whole buffer.
+/// @param algo Hash algorithm to use.
+/// @param key HMAC key to use. May be NULL, in which case HMAC is not used.
+/// @param keySize Size in bytes of `key`, or 0 if `key` is NULL.
+/// @returns On failure, NULL is returned. Call MTY_GetLog for details.\n\n
+///   The returned MTY_HashCtx must be destroyed with MTY_HashCtxDestroy.
+//- #support Windows macOS Android Linux
+MTY_EXPORT MTY_HashCtx *
+MTY_HashCtxCreate(MTY_Algorithm algo, const void *key, size_t keySize);
+
+/// @brief Destroy an MTY_HashCtx.
+/// @param hashCtx Passed by reference and set to NULL after being destroyed.
+//- #support Windows macOS Android Linux
+MTY_EXPORT void
+MTY_HashCtxDestroy(MTY_HashCtx **hashCtx);
+
+/// @brief Add data to an MTY_HashCtx.
+/// @param ctx An MTY_HashCtx.
+/// @param input Input buffer.
+/// @param inputSize Size in bytes of `input`.
+//- #support Windows macOS Android Linux
+MTY_EXPORT void
+MTY_HashCtxUpdate(MTY_HashCtx *ctx, const void *input, size_t inputSize);
+
+/// @brief Output the hash of all data added since the MTY_HashCtx was created or
+///   last finalized.
+/// @details The MTY_HashCtx is reset afterwards and can be used to hash new data with
+///   the same algorithm and key.
+/// @param ctx An MTY_HashCtx.
+/// @param output Output buffer.
+/// @param outputSize Size in bytes of `output`.
+//- #support Windows macOS Android Linux
+MTY_EXPORT void
+MTY_HashCtxFinal(MTY_HashCtx *ctx, void *output, size_t outputSize);
+
 /// @brief Generate cryptographically strong random bytes.
 /// @param buf Output buffer.
 /// @param size Size in bytes of `buf`.
@@ -1671,6 +1915,33 @@ MTY_EXPORT bool
 MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherText,
 	size_t size, const void *tag, void *plainText);
 
+/// @brief Encrypt a batch of packets in place using AES-GCM-128.
+/// @details Each packet has its own nonce, optional additional authenticated data, and
+///   tag. A failed packet does not stop the remaining packets from being encrypted.
+/// @param ctx An MTY_AESGCM context.
+/// @param packets Array of packets to encrypt. The `ok` member of each packet is set
+///   to the result for that packet.
+/// @param count Number of elements in `packets`.
+/// @returns Returns true if every packet was encrypted, otherwise false. Call
+///   MTY_GetLog for details.
+//- #support Windows macOS Android Linux
+MTY_EXPORT bool
+MTY_AESGCMEncryptBatch(MTY_AESGCM *ctx, MTY_AESGCMPacket *packets, uint32_t count);
+
+/// @brief Decrypt and authenticate a batch of packets in place using AES-GCM-128.
+/// @details Each packet must use the nonce, additional authenticated data, and tag
+///   size it was encrypted with. The data of a packet that fails authentication is
+///   undefined and must not be used.
+/// @param ctx An MTY_AESGCM context.
+/// @param packets Array of packets to decrypt. The `ok` member of each packet is set
+///   to the result for that packet.
+/// @param count Number of elements in `packets`.
+/// @returns Returns true if every packet was decrypted and authenticated, otherwise
+///   false. Call MTY_GetLog for details.
+//- #support Windows macOS Android Linux
+MTY_EXPORT bool
+MTY_AESGCMDecryptBatch(MTY_AESGCM *ctx, MTY_AESGCMPacket *packets, uint32_t count);
+
 
 //- #module Dialog
 //- #mbrief Stock dialog boxes provided by the OS.
@@ -1971,6 +2242,53 @@ typedef enum {
 } MTY_JSONType;
 
 typedef struct MTY_JSON MTY_JSON;
+typedef struct MTY_JSONReader MTY_JSONReader;
+typedef struct MTY_JSONWriter MTY_JSONWriter;
+typedef struct MTY_JSONPath MTY_JSONPath;
+
+/// @brief Events reported by an MTY_JSONReader.
+typedef enum {
+	MTY_JSON_EVENT_OBJECT_BEGIN = 0, ///< An object has been opened.
+	MTY_JSON_EVENT_OBJECT_END   = 1, ///< The innermost object has been closed.
+	MTY_JSON_EVENT_ARRAY_BEGIN  = 2, ///< An array has been opened.
+	MTY_JSON_EVENT_ARRAY_END    = 3, ///< The innermost array has been closed.
+	MTY_JSON_EVENT_KEY          = 4, ///< An object key, the next event is its value.
+	MTY_JSON_EVENT_VALUE        = 5, ///< A null, boolean, number, or string value.
+	MTY_JSON_EVENT_MAKE_32      = INT32_MAX,
+} MTY_JSONEventType;
+
+/// @brief An event reported by an MTY_JSONReader.
+typedef struct {
+	MTY_JSONEventType type; ///< The type of event.
+	MTY_JSONType value;     ///< For MTY_JSON_EVENT_VALUE, the type of the value.
+	const char *string;     ///< The key, the string value, or the text of a number. Only
+	                        ///<   valid for the duration of the callback.
+	size_t length;          ///< Size in bytes of `string`, which may contain null
+	                        ///<   characters if the JSON escaped them.
+	double number;          ///< For MTY_JSON_NUMBER values, the value.
+	int64_t integer;        ///< For MTY_JSON_NUMBER values with `isint` set, the exact value.
+	bool isint;             ///< The number was written without a fraction or exponent
+	                        ///<   and fits in an int64_t.
+	bool boolean;           ///< For MTY_JSON_BOOL values, the value.
+	uint32_t depth;         ///< Number of containers enclosing the event. A top level
+	                        ///<   value, and the begin and end events of a top level
+	                        ///<   container, have a depth of 0.
+} MTY_JSONEvent;
+
+/// @brief Function called for each event found by an MTY_JSONReader.
+/// @param evt The MTY_JSONEvent.
+/// @param opaque Pointer set via MTY_JSONReaderCreate.
+/// @returns Return true to continue reading, false to stop. Once stopped, the reader
+///   rejects further input.
+typedef bool (*MTY_JSONEventFunc)(const MTY_JSONEvent *evt, void *opaque);
+
+/// @brief Function called when an MTY_JSONWriter has output ready.
+/// @param buf The serialized JSON.
+/// @param size Size in bytes of `buf`.
+/// @param opaque Pointer set via MTY_JSONWriterCreate.
+/// @returns Return true on success, false on failure. Returning false will cause
+///   MTY_JSONWriterFinish to return false.
+typedef bool (*MTY_JSONWriteFunc)(const void *buf, size_t size, void *opaque);
 
 /// @brief Parse a string into an MTY_JSON item.
 /// @param input Serialized JSON string.
@@ -1980,6 +2298,31 @@ typedef struct MTY_JSON MTY_JSON;
 MTY_EXPORT MTY_JSON *
 MTY_JSONParse(const char *input);
 
+/// @brief Parse a string into a read-only MTY_JSON document held in a single arena.
+/// @details Items and strings are packed into the arena rather than allocated
+///   separately, and objects with only a few keys are stored as flat arrays. This is
+///   faster than MTY_JSONParse for large documents and uses slightly less memory.\n\n
+///   Items in the document can not be modified, MTY_JSONArraySetItem and
+///   MTY_JSONObjSetItem return false. The whole document may still be attached to
+///   another item.
+/// @param input Serialized JSON string.
+/// @returns On failure, NULL is returned. Call MTY_GetLog for details.\n\n
+///   The returned MTY_JSON item should be destroyed with MTY_JSONDestroy if it
+///   remains the root item in the hierarchy, which frees the whole document.
+MTY_EXPORT MTY_JSON *
+MTY_JSONParseArena(const char *input);
+
+/// @brief Parse a string in place into a read-only MTY_JSON document.
+/// @details The same as MTY_JSONParseArena, except strings are terminated and
+///   unescaped directly in `input` instead of being copied into the arena.
+/// @param input Serialized JSON string. It is modified by the parser, even on
+///   failure, and must remain valid until the document is destroyed.
+/// @returns On failure, NULL is returned. Call MTY_GetLog for details.\n\n
+///   The returned MTY_JSON item should be destroyed with MTY_JSONDestroy if it
+///   remains the root item in the hierarchy.
+MTY_EXPORT MTY_JSON *
+MTY_JSONParseInPlace(char *input);
+
 /// @brief Parse the contents of a file into an MTY_JSON item.
 /// @param path Path to the serialized JSON file.
 /// @returns On failure, NULL is returned. Call MTY_GetLog for details.\n\n
@@ -2049,13 +2392,21 @@ MTY_JSONBool(const MTY_JSON *json, bool *value);
 MTY_EXPORT MTY_JSON *
 MTY_JSONNumberCreate(double value);
 
-/// @brief Create a new MTY_JSON number, internally represented as a 32-bit integer.
+/// @brief Create a new MTY_JSON number, internally represented as an integer.
 /// @param value The initialization value.
 /// @returns The returned MTY_JSON item should be destroyed with MTY_JSONDestroy if it
 ///   remains the root item in the hierarchy.
 MTY_EXPORT MTY_JSON *
 MTY_JSONIntCreate(int32_t value);
 
+/// @brief Create a new MTY_JSON number, internally represented as a 64-bit integer.
+/// @details Unlike MTY_JSONNumberCreate, values beyond 2^53 are kept exactly.
+/// @param value The initialization value.
+/// @returns The returned MTY_JSON item should be destroyed with MTY_JSONDestroy if it
+///   remains the root item in the hierarchy.
+MTY_EXPORT MTY_JSON *
+MTY_JSONInt64Create(int64_t value);
+
 /// @brief Get the double value from an MTY_JSON number.
 /// @param json An MTY_JSON number.
 /// @param value The double value from `json`.
@@ -2084,6 +2435,16 @@ MTY_JSONInt16(const MTY_JSON *json, int16_t *value);
 MTY_EXPORT bool
 MTY_JSONInt32(const MTY_JSON *json, int32_t *value);
 
+/// @brief Get the int64_t value from an MTY_JSON number.
+/// @details Parsed numbers written without a fraction or exponent that fit in 64
+///   bits, and numbers created with MTY_JSONIntCreate or MTY_JSONInt64Create, are
+///   exact. Other numbers are rounded to the nearest integer.
+/// @param json An MTY_JSON number.
+/// @param value The int64_t value from `json`.
+/// @returns Returns true on success, false if the type of `json` is not MTY_JSON_NUMBER.
+MTY_EXPORT bool
+MTY_JSONInt64(const MTY_JSON *json, int64_t *value);
+
 /// @brief Get the float value from an MTY_JSON number.
 /// @param json An MTY_JSON number.
 /// @param value The float value from `json`.
@@ -2127,6 +2488,9 @@ MTY_EXPORT uint32_t
 MTY_JSONArrayGetLength(const MTY_JSON *json);
 
 /// @brief Get an item from an MTY_JSON array.
+/// @details Items of a packed array are created the first time any of them is
+///   requested. This is safe while other threads read the same document. See
+///   MTY_JSONArrayGetNumbers.
 /// @param json An MTY_JSON array.
 /// @param index Index to lookup.
 /// @returns If the `index` exists, the item at that index is returned. This reference
@@ -2136,6 +2500,8 @@ MTY_EXPORT const MTY_JSON *
 MTY_JSONArrayGetItem(const MTY_JSON *json, uint32_t index);
 
 /// @brief Set an item in an MTY_JSON array.
+/// @details A packed array becomes a regular array, items previously returned by
+///   MTY_JSONArrayGetItem remain valid.
 /// @param json An MTY_JSON array.
 /// @param index The array index where `value` will be stored.
 /// @param value Item to set at `index`.
@@ -2143,6 +2509,38 @@ MTY_JSONArrayGetItem(const MTY_JSON *json, uint32_t index);
 MTY_EXPORT bool
 MTY_JSONArraySetItem(MTY_JSON *json, uint32_t index, MTY_JSON *value);
 
+/// @brief Get the values of a packed MTY_JSON array of numbers.
+/// @details When parsing, arrays holding only numbers or only booleans are stored as
+///   a packed buffer of plain values rather than an item per value. Arrays of
+///   numbers that are all integers are packed as int64_t, see
+///   MTY_JSONArrayGetInt64s. Integers mixed with other numbers are packed as double
+///   only if they can be represented exactly.
+/// @param json An MTY_JSON array.
+/// @param values Set to the packed values. This reference is valid only as long as
+///   the `json` item is valid and has not been modified.
+/// @param len Set to the number of `values`.
+/// @returns Returns true if `json` is an array packed as double, otherwise false.
+MTY_EXPORT bool
+MTY_JSONArrayGetNumbers(const MTY_JSON *json, const double **values, uint32_t *len);
+
+/// @brief Get the values of a packed MTY_JSON array of integers.
+/// @param json An MTY_JSON array.
+/// @param values Set to the packed values. This reference is valid only as long as
+///   the `json` item is valid and has not been modified.
+/// @param len Set to the number of `values`.
+/// @returns Returns true if `json` is an array packed as int64_t, otherwise false.
+MTY_EXPORT bool
+MTY_JSONArrayGetInt64s(const MTY_JSON *json, const int64_t **values, uint32_t *len);
+
+/// @brief Get the values of a packed MTY_JSON array of booleans.
+/// @param json An MTY_JSON array.
+/// @param values Set to the packed values. This reference is valid only as long as
+///   the `json` item is valid and has not been modified.
+/// @param len Set to the number of `values`.
+/// @returns Returns true if `json` is an array packed as bool, otherwise false.
+MTY_EXPORT bool
+MTY_JSONArrayGetBools(const MTY_JSON *json, const bool **values, uint32_t *len);
+
 /// @brief Create a new MTY_JSON object.
 /// @returns The returned MTY_JSON item should be destroyed with MTY_JSONDestroy if it
 ///   remains the root item in the hierarchy.
@@ -2176,6 +2574,228 @@ MTY_JSONObjGetItem(const MTY_JSON *json, const char *key);
 MTY_EXPORT bool
 MTY_JSONObjSetItem(MTY_JSON *json, const char *key, MTY_JSON *value);
 
+/// @brief Compile a JSON Pointer into an MTY_JSONPath.
+/// @details Paths follow RFC 6901, such as "/a/b/3/c". Each segment is an object key
+///   or an array index, with "~0" standing for '~' and "~1" for '/'. An empty path
+///   refers to the whole document.\n\n
+///   A compiled path can be evaluated against any number of documents, and key
+///   hashes are computed only once.
+/// @param path JSON Pointer to compile.
+/// @returns On failure, NULL is returned. Call MTY_GetLog for details.\n\n
+///   The returned MTY_JSONPath must be destroyed with MTY_JSONPathDestroy.
+MTY_EXPORT MTY_JSONPath *
+MTY_JSONPathCompile(const char *path);
+
+/// @brief Compile several JSON Pointers into a single MTY_JSONPath.
+/// @details Paths sharing a common prefix share its lookups, so all of them are
+///   found with a single traversal by MTY_JSONPathGetItems.
+/// @param paths Array of JSON Pointers to compile, see MTY_JSONPathCompile.
+/// @param count Number of `paths`.
+/// @returns On failure, NULL is returned. Call MTY_GetLog for details.\n\n
+///   The returned MTY_JSONPath must be destroyed with MTY_JSONPathDestroy.
+MTY_EXPORT MTY_JSONPath *
+MTY_JSONPathCompileBatch(const char **paths, uint32_t count);
+
+/// @brief Destroy an MTY_JSONPath.
+/// @param path Passed by reference and set to NULL after being destroyed.
+MTY_EXPORT void
+MTY_JSONPathDestroy(MTY_JSONPath **path);
+
+/// @brief Get the item an MTY_JSONPath refers to.
+/// @param json An MTY_JSON item to search.
+/// @param path A compiled path. If it was compiled from several paths, only the
+///   first one is used.
+/// @returns If the item exists, it is returned. This reference is valid only as long
+///   as the `json` item is also valid.\n\n
+///   If the item does not exist, NULL is returned.
+MTY_EXPORT const MTY_JSON *
+MTY_JSONPathGetItem(const MTY_JSON *json, const MTY_JSONPath *path);
+
+/// @brief Get the items for every path compiled into an MTY_JSONPath.
+/// @param json An MTY_JSON item to search.
+/// @param path A compiled path.
+/// @param items Array with room for one item per compiled path, set in the order the
+///   paths were given. Items that do not exist are set to NULL. These references are
+///   valid only as long as the `json` item is also valid.
+/// @returns The number of items that exist.
+MTY_EXPORT uint32_t
+MTY_JSONPathGetItems(const MTY_JSON *json, const MTY_JSONPath *path, const MTY_JSON **items);
+
+/// @brief Create an MTY_JSONReader to read JSON as a stream of events.
+/// @details The reader never builds a document, its memory use depends only on the
+///   nesting depth and the size of the largest key, string, or number.\n\n
+///   A stream may contain any number of top level values separated by white
+///   space, such as line-delimited JSON. Each one is complete once an event with a
+///   `depth` of 0 has been reported for it.
+/// @param func Function called for each event.
+/// @param opaque Passed to `func`.
+/// @returns The returned MTY_JSONReader must be destroyed with MTY_JSONReaderDestroy.
+MTY_EXPORT MTY_JSONReader *
+MTY_JSONReaderCreate(MTY_JSONEventFunc func, void *opaque);
+
+/// @brief Destroy an MTY_JSONReader.
+/// @param reader Passed by reference and set to NULL after being destroyed.
+MTY_EXPORT void
+MTY_JSONReaderDestroy(MTY_JSONReader **reader);
+
+/// @brief Push serialized JSON into an MTY_JSONReader.
+/// @details `input` may be split at any byte, events are reported as soon as they
+///   are complete. A number or literal at the very end of the stream is only
+///   reported by MTY_JSONReaderFinish.
+/// @param ctx An MTY_JSONReader.
+/// @param input Serialized JSON.
+/// @param size Size in bytes of `input`.
+/// @returns Returns false if the JSON is invalid or the callback stopped the reader,
+///   otherwise true. Call MTY_GetLog for details.
+MTY_EXPORT bool
+MTY_JSONReaderPush(MTY_JSONReader *ctx, const void *input, size_t size);
+
+/// @brief Finish reading, reporting any value still pending at the end of the stream.
+/// @param ctx An MTY_JSONReader.
+/// @returns Returns true if every value in the stream was complete and valid,
+///   otherwise false.
+MTY_EXPORT bool
+MTY_JSONReaderFinish(MTY_JSONReader *ctx);
+
+/// @brief Read a file through an MTY_JSONReader in fixed size chunks.
+/// @details The file is never held in memory at once. MTY_JSONReaderFinish is called
+///   once the whole file has been pushed.
+/// @param ctx An MTY_JSONReader.
+/// @param path Path to the serialized JSON file.
+/// @returns Returns true if the file was read and every value in it was valid,
+///   otherwise false. Call MTY_GetLog for details.
+MTY_EXPORT bool
+MTY_JSONReaderReadFile(MTY_JSONReader *ctx, const char *path);
+
+/// @brief Create an MTY_JSONWriter that hands its output to a function.
+/// @details Output is staged in a small internal buffer and passed to `func` each
+///   time the buffer fills, and by MTY_JSONWriterFinish.\n\n
+///   Consecutive top level values are separated by a newline, producing
+///   line-delimited JSON.
+/// @param func Function called with serialized output.
+/// @param opaque Passed to `func`.
+/// @returns The returned MTY_JSONWriter must be destroyed with MTY_JSONWriterDestroy.
+MTY_EXPORT MTY_JSONWriter *
+MTY_JSONWriterCreate(MTY_JSONWriteFunc func, void *opaque);
+
+/// @brief Create an MTY_JSONWriter that writes into a caller supplied buffer.
+/// @param buf Output buffer. MTY_JSONWriterFinish null terminates the output.
+/// @param size Size in bytes of `buf`. Output that does not fit, including the null
+///   character, causes MTY_JSONWriterFinish to return false.
+/// @returns The returned MTY_JSONWriter must be destroyed with MTY_JSONWriterDestroy.
+MTY_EXPORT MTY_JSONWriter *
+MTY_JSONWriterCreateBuffer(void *buf, size_t size);
+
+/// @brief Create an MTY_JSONWriter that writes to a file.
+/// @param path Path to the file.
+/// @param append Append to the end of the file instead of replacing it.
+/// @returns On failure, NULL is returned. Call MTY_GetLog for details.\n\n
+///   The returned MTY_JSONWriter must be destroyed with MTY_JSONWriterDestroy.
+MTY_EXPORT MTY_JSONWriter *
+MTY_JSONWriterCreateFile(const char *path, bool append);
+
+/// @brief Destroy an MTY_JSONWriter.
+/// @details Any staged output is written before a file is closed. Call
+///   MTY_JSONWriterFinish first to find out if all output was written successfully.
+/// @param writer Passed by reference and set to NULL after being destroyed.
+MTY_EXPORT void
+MTY_JSONWriterDestroy(MTY_JSONWriter **writer);
+
+/// @brief Open an object.
+/// @param ctx An MTY_JSONWriter.
+/// @returns Returns false if a value is not allowed at this position, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterObjectBegin(MTY_JSONWriter *ctx);
+
+/// @brief Close the innermost object.
+/// @param ctx An MTY_JSONWriter.
+/// @returns Returns false if the innermost container is not an object or a key is
+///   waiting for its value, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterObjectEnd(MTY_JSONWriter *ctx);
+
+/// @brief Open an array.
+/// @param ctx An MTY_JSONWriter.
+/// @returns Returns false if a value is not allowed at this position, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterArrayBegin(MTY_JSONWriter *ctx);
+
+/// @brief Close the innermost array.
+/// @param ctx An MTY_JSONWriter.
+/// @returns Returns false if the innermost container is not an array, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterArrayEnd(MTY_JSONWriter *ctx);
+
+/// @brief Write an object key, the next value written belongs to it.
+/// @param ctx An MTY_JSONWriter.
+/// @param key The key.
+/// @returns Returns false if the innermost container is not an object or a key is
+///   already waiting for its value, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterKey(MTY_JSONWriter *ctx, const char *key);
+
+/// @brief Write a null value.
+/// @param ctx An MTY_JSONWriter.
+/// @returns Returns false if a value is not allowed at this position, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterNull(MTY_JSONWriter *ctx);
+
+/// @brief Write a boolean value.
+/// @param ctx An MTY_JSONWriter.
+/// @param value The value.
+/// @returns Returns false if a value is not allowed at this position, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterBool(MTY_JSONWriter *ctx, bool value);
+
+/// @brief Write a number value.
+/// @param ctx An MTY_JSONWriter.
+/// @param value The value.
+/// @returns Returns false if a value is not allowed at this position, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterNumber(MTY_JSONWriter *ctx, double value);
+
+/// @brief Write a 32-bit integer value.
+/// @param ctx An MTY_JSONWriter.
+/// @param value The value.
+/// @returns Returns false if a value is not allowed at this position, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterInt(MTY_JSONWriter *ctx, int32_t value);
+
+/// @brief Write a 64-bit integer value.
+/// @param ctx An MTY_JSONWriter.
+/// @param value The value.
+/// @returns Returns false if a value is not allowed at this position, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterInt64(MTY_JSONWriter *ctx, int64_t value);
+
+/// @brief Write a string value.
+/// @param ctx An MTY_JSONWriter.
+/// @param value The value.
+/// @returns Returns false if a value is not allowed at this position, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterString(MTY_JSONWriter *ctx, const char *value);
+
+/// @brief Write an MTY_JSON item as a value.
+/// @details The item is written as its hierarchy is walked, so no serialized copy
+///   of it is held in memory.
+/// @param ctx An MTY_JSONWriter.
+/// @param json The MTY_JSON item to serialize.
+/// @returns Returns false if a value is not allowed at this position, otherwise true.
+MTY_EXPORT bool
+MTY_JSONWriterItem(MTY_JSONWriter *ctx, const MTY_JSON *json);
+
+/// @brief Write out any staged output.
+/// @param ctx An MTY_JSONWriter.
+/// @returns Returns true if every container was closed and all output was written,
+///   otherwise false.
+MTY_EXPORT bool
+MTY_JSONWriterFinish(MTY_JSONWriter *ctx);
+
+/// @brief Get the number of bytes written by an MTY_JSONWriter.
+/// @param ctx An MTY_JSONWriter.
+MTY_EXPORT size_t
+MTY_JSONWriterGetSize(MTY_JSONWriter *ctx);
+
 #define MTY_JSONObjGetBool(json, key, val) \
 	MTY_JSONBool(MTY_JSONObjGetItem(json, key), val)
 
@@ -2188,6 +2808,9 @@ MTY_JSONObjSetItem(MTY_JSON *json, const char *key, MTY_JSON *value);
 #define MTY_JSONObjGetInt(json, key, val) \
 	MTY_JSONInt32(MTY_JSONObjGetItem(json, key), val)
 
+#define MTY_JSONObjGetInt64(json, key, val) \
+	MTY_JSONInt64(MTY_JSONObjGetItem(json, key), val)
+
 #define MTY_JSONObjGetFloat(json, key, val) \
 	MTY_JSONFloat(MTY_JSONObjGetItem(json, key), val)
 
@@ -2206,6 +2829,9 @@ MTY_JSONObjSetItem(MTY_JSON *json, const char *key, MTY_JSON *value);
 #define MTY_JSONObjSetInt(json, key, val) \
 	MTY_JSONObjSetItem(json, key, MTY_JSONIntCreate(val))
 
+#define MTY_JSONObjSetInt64(json, key, val) \
+	MTY_JSONObjSetItem(json, key, MTY_JSONInt64Create(val))
+
 #define MTY_JSONObjSetString(json, key, val) \
 	MTY_JSONObjSetItem(json, key, MTY_JSONStringCreate(val))
 
@@ -2229,6 +2855,7 @@ typedef void (*MTY_LogFunc)(const char *msg, void *opaque);
 
 /// @brief Get the most recent log message on the thread.
 /// @returns This buffer is allocated in thread local storage and must not be freed.
+///   It stays valid until the next message is logged on the same thread.
 MTY_EXPORT const char *
 MTY_GetLog(void);
 
@@ -2284,6 +2911,43 @@ MTY_LogFatalParams(const char *func, const char *fmt, ...) MTY_FMT(2, 3);
 #define MTY_ALIGN32(v) \
 	((v) + 0x1F & ~((uintptr_t) 0x1F))
 
+typedef struct MTY_Arena MTY_Arena;
+typedef struct MTY_Pool MTY_Pool;
+
+/// @brief Modules tracked by memory statistics.
+typedef enum {
+	MTY_MEMORY_TAG_NONE    = 0, ///< Everything not attributed to another module, including
+	                            ///<   memory allocated with MTY_Alloc et al.
+	MTY_MEMORY_TAG_JSON    = 1, ///< The JSON module.
+	MTY_MEMORY_TAG_HASH    = 2, ///< MTY_Hash.
+	MTY_MEMORY_TAG_QUEUE   = 3, ///< MTY_Queue.
+	MTY_MEMORY_TAG_HTTP    = 4, ///< The Net module.
+	MTY_MEMORY_TAG_GFX     = 5, ///< Graphics contexts and renderers.
+	MTY_MEMORY_TAG_MAX     = 6, ///< Maximum number of memory tags.
+	MTY_MEMORY_TAG_MAKE_32 = INT32_MAX,
+} MTY_MemoryTag;
+
+/// @brief Memory allocation functions used by libmatoya.
+/// @details Each function receives the `opaque` member as its last argument. The
+///   functions must be thread safe and may only return NULL on failure.
+typedef struct {
+	void *(*alloc)(size_t size, void *opaque);                      ///< Allocate `size` bytes.
+	void *(*realloc)(void *mem, size_t size, void *opaque);         ///< Resize a block, `mem` may be NULL.
+	void (*free)(void *mem, void *opaque);                          ///< Free a block, `mem` may be NULL.
+	void *(*allocAligned)(size_t size, size_t align, void *opaque); ///< Allocate `size` bytes aligned
+	                                                                ///<   to `align`.
+	void (*freeAligned)(void *mem, void *opaque);                   ///< Free an aligned block.
+	void *opaque;                                                   ///< Passed to each function.
+} MTY_Allocator;
+
+/// @brief Memory usage of a module.
+typedef struct {
+	size_t live;     ///< Bytes currently allocated.
+	size_t peak;     ///< Highest value `live` has reached.
+	uint64_t allocs; ///< Number of allocations made.
+	uint64_t frees;  ///< Number of allocations freed.
+} MTY_MemoryStats;
+
 /// @brief Function called while running MTY_Sort.
 /// @param e0 An element evaluated during MTY_Sort.
 /// @param e1 An element evaluated during MTY_Sort.
@@ -2330,6 +2994,30 @@ MTY_Free(void *mem);
 MTY_EXPORT void
 MTY_FreeAligned(void *mem);
 
+/// @brief Replace the system allocator and optionally enable memory statistics.
+/// @details All memory libmatoya allocates, including MTY_Alloc, MTY_Realloc,
+///   MTY_AllocAligned and their free functions, is routed through `allocator`.\n\n
+///   With statistics enabled, allocations are counted per module and can be read
+///   with MTY_GetMemoryStats.\n\n
+///   This function may be called at any time. Every allocation records the allocator
+///   and `stats` setting it was made with, and is freed or reallocated the same way,
+///   so an allocator must remain usable until everything it allocated is freed. At
+///   most 7 different allocators can be set during the life of the process.
+/// @param allocator Allocation functions, all of which must be set. This is copied
+///   and may be NULL to use the system allocator.
+/// @param stats Track memory statistics per MTY_MemoryTag.
+MTY_EXPORT void
+MTY_SetAllocator(const MTY_Allocator *allocator, bool stats);
+
+/// @brief Get the memory usage of a module.
+/// @details Only allocations made while statistics were enabled are counted.
+/// @param tag The module to query.
+/// @param stats Set to the module's current memory usage.
+/// @returns Returns true if statistics were enabled with MTY_SetAllocator, otherwise
+///   false and `stats` is zeroed.
+MTY_EXPORT bool
+MTY_GetMemoryStats(MTY_MemoryTag tag, MTY_MemoryStats *stats);
+
 /// @brief Guarantee allocated memory is zeroed before it is freed.
 /// @param mem Dynamically allocated memory.
 /// @param size Size in bytes of `mem`.
@@ -2362,6 +3050,111 @@ MTY_Dup(const void *mem, size_t size);
 MTY_EXPORT char *
 MTY_Strdup(const char *str);
 
+/// @brief Create an MTY_Arena for allocations that are freed all at once.
+/// @details Allocations are carved sequentially out of large chunks, so allocating
+///   is a pointer bump and individual allocations are never freed. Everything is
+///   released together with MTY_ArenaReset or MTY_ArenaDestroy. An MTY_Arena is
+///   not thread safe.
+/// @param chunkSize Size in bytes of the first chunk. Later chunks grow
+///   geometrically. Specifying 0 chooses a reasonable default.
+/// @returns This function can not return NULL. It will call `abort()` on failure.\n\n
+///   The returned MTY_Arena must be destroyed with MTY_ArenaDestroy.
+MTY_EXPORT MTY_Arena *
+MTY_ArenaCreate(size_t chunkSize);
+
+/// @brief Destroy an MTY_Arena and all memory allocated from it.
+/// @param arena Passed by reference and set to NULL after being destroyed.
+MTY_EXPORT void
+MTY_ArenaDestroy(MTY_Arena **arena);
+
+/// @brief Allocate zeroed memory from an arena.
+/// @param ctx An MTY_Arena.
+/// @param len Number of elements requested.
+/// @param size Size in bytes of each element.
+/// @returns The zeroed buffer, aligned to 16 bytes.\n\n
+///   This function can not return NULL. It will call `abort()` on failure.\n\n
+///   The returned buffer is valid until the arena is reset past it or destroyed.
+MTY_EXPORT void *
+MTY_ArenaAlloc(MTY_Arena *ctx, size_t len, size_t size);
+
+/// @brief Duplicate a buffer into an arena.
+/// @param ctx An MTY_Arena.
+/// @param mem Buffer to duplicate.
+/// @param size Size in bytes of `mem`.
+/// @returns This function can not return NULL. It will call `abort()` on failure.\n\n
+///   The returned buffer is valid until the arena is reset past it or destroyed.
+MTY_EXPORT void *
+MTY_ArenaDup(MTY_Arena *ctx, const void *mem, size_t size);
+
+/// @brief Duplicate a string into an arena.
+/// @param ctx An MTY_Arena.
+/// @param str String to duplicate.
+/// @returns This function can not return NULL. It will call `abort()` on failure.\n\n
+///   The returned string is valid until the arena is reset past it or destroyed.
+MTY_EXPORT char *
+MTY_ArenaStrdup(MTY_Arena *ctx, const char *str);
+
+/// @brief Get the current position of an arena.
+/// @param ctx An MTY_Arena.
+/// @returns A mark that can be passed to MTY_ArenaReset to free everything allocated
+///   after this call.
+MTY_EXPORT size_t
+MTY_ArenaGetMark(MTY_Arena *ctx);
+
+/// @brief Free everything allocated from an arena after a mark.
+/// @details Chunks are kept and reused by later allocations rather than being
+///   returned to the system.
+/// @param ctx An MTY_Arena.
+/// @param mark A value returned by MTY_ArenaGetMark, or 0 to free everything.
+MTY_EXPORT void
+MTY_ArenaReset(MTY_Arena *ctx, size_t mark);
+
+/// @brief Get the total amount of memory an arena has reserved from the system.
+/// @param ctx An MTY_Arena.
+MTY_EXPORT size_t
+MTY_ArenaGetSize(MTY_Arena *ctx);
+
+/// @brief Create an MTY_Pool for many objects of the same size.
+/// @details Freed objects are kept on free lists and handed back out by later
+///   allocations. Each thread caches up to 128 free objects per pool, so most
+///   allocations and frees never take a lock. An MTY_Pool is thread safe, and objects
+///   may be freed on a different thread than the one that allocated them.\n\n
+///   A thread caches at most 16 pools at once. Objects cached by a thread that exits,
+///   or that moves on to other pools, are returned to the pool.
+/// @param size Size in bytes of each object.
+/// @param align Alignment of each object, rounded up to a power of 2. Specifying 0
+///   aligns to 16 bytes, 64 keeps each object on its own cache line.
+/// @returns This function can not return NULL. It will call `abort()` on failure.\n\n
+///   The returned MTY_Pool must be destroyed with MTY_PoolDestroy.
+MTY_EXPORT MTY_Pool *
+MTY_PoolCreate(size_t size, size_t align);
+
+/// @brief Destroy an MTY_Pool and all objects allocated from it.
+/// @details No other thread may be using the pool while it is destroyed.
+/// @param pool Passed by reference and set to NULL after being destroyed.
+MTY_EXPORT void
+MTY_PoolDestroy(MTY_Pool **pool);
+
+/// @brief Allocate a zeroed object from a pool.
+/// @param ctx An MTY_Pool.
+/// @returns This function can not return NULL. It will call `abort()` on failure.\n\n
+///   The returned object should be freed with MTY_PoolFree, or is freed when the
+///   pool is destroyed.
+MTY_EXPORT void *
+MTY_PoolAlloc(MTY_Pool *ctx);
+
+/// @brief Return an object to a pool.
+/// @param ctx The MTY_Pool `obj` was allocated from.
+/// @param obj Object returned by MTY_PoolAlloc. This may be NULL.
+MTY_EXPORT void
+MTY_PoolFree(MTY_Pool *ctx, void *obj);
+
+/// @brief Get the size of each object in a pool.
+/// @param ctx An MTY_Pool.
+/// @returns The object size after it has been padded to the pool's alignment.
+MTY_EXPORT size_t
+MTY_PoolGetSize(MTY_Pool *ctx);
+
 /// @brief Append to a string.
 /// @details For more information, see `strcat_s` from the C standard library.
 /// @param dst Destination string.
@@ -2401,6 +3194,25 @@ MTY_SprintfD(const char *fmt, ...) MTY_FMT(1, 2);
 MTY_EXPORT const char *
 MTY_SprintfDL(const char *fmt, ...) MTY_FMT(1, 2);
 
+/// @brief Begin a scope for buffers allocated in thread local storage.
+/// @details Buffers returned by functions that allocate in thread local storage,
+///   such as MTY_SprintfDL and MTY_JoinPath, normally remain valid until at least
+///   8 KB of later buffers have been allocated on the same thread. Inside a scope,
+///   every buffer allocated since the scope began remains valid until it ends, no
+///   matter how many or how large.\n\n
+///   Scopes may be nested, and must be ended on the same thread in reverse order.
+///   A thread's thread local storage is allocated when it is first used and freed
+///   when the thread exits.
+/// @returns A mark to be passed to MTY_PopThreadLocal.
+MTY_EXPORT size_t
+MTY_PushThreadLocal(void);
+
+/// @brief End a scope begun with MTY_PushThreadLocal.
+/// @details Buffers allocated in thread local storage since the scope began are freed.
+/// @param mark The value returned by the matching MTY_PushThreadLocal.
+MTY_EXPORT void
+MTY_PopThreadLocal(size_t mark);
+
 /// @brief Search a string for a list of substrings.
 /// @param a String to be searched.
 /// @param b List of substrings delimited by `delim`.
@@ -2555,11 +3367,18 @@ typedef struct MTY_Cond MTY_Cond;
 typedef struct MTY_RWLock MTY_RWLock;
 typedef struct MTY_Waitable MTY_Waitable;
 typedef struct MTY_ThreadPool MTY_ThreadPool;
+typedef struct MTY_TaskGraph MTY_TaskGraph;
 
 /// @brief Function that takes a single opaque argument.
 /// @param opaque Pointer set via various MTY_ThreadPool related functions.
 typedef void (*MTY_AnonFunc)(void *opaque);
 
+/// @brief Function that processes a slice of a range via MTY_ParallelFor.
+/// @param begin First index of the slice.
+/// @param end One past the last index of the slice.
+/// @param opaque Pointer set via MTY_ParallelFor.
+typedef void (*MTY_RangeFunc)(size_t begin, size_t end, void *opaque);
+
 /// @brief Function that is executed on a thread.
 /// @param opaque Pointer set via MTY_ThreadCreate or MTY_ThreadDetach.
 /// @returns An opaque pointer that gets returned by MTY_ThreadDestroy if the thread
@@ -2624,6 +3443,17 @@ MTY_MutexCreate(void);
 MTY_EXPORT void
 MTY_MutexDestroy(MTY_Mutex **mutex);
 
+/// @brief Let a mutex spin before blocking when it is contended.
+/// @details Spinning avoids putting the thread to sleep when the lock is only held
+///   briefly. The number of spins adapts to how long the lock has recently taken to
+///   acquire, so a lock that is held for long periods quickly stops spinning. Mutexes
+///   do not spin by default.
+/// @param ctx An MTY_Mutex.
+/// @param spin Maximum number of times to retry the lock before blocking, or 0 to
+///   disable spinning.
+MTY_EXPORT void
+MTY_MutexSetSpin(MTY_Mutex *ctx, uint32_t spin);
+
 /// @brief Wait to acquire a lock on the mutex.
 /// @param ctx An MTY_Mutex.
 MTY_EXPORT void
@@ -2674,12 +3504,22 @@ MTY_CondSignalAll(MTY_Cond *ctx);
 
 /// @brief Create an MTY_RWLock that allows concurrent read access.
 /// @details An MTY_RWLock allows recursive locking from readers, and will prioritize
-///   writers when they are waiting.
+///   writers when they are waiting. There is no limit on the number of MTY_RWLock
+///   objects, but a single thread may hold at most 64 of them at once.
 /// @returns This function can not return NULL. It will call `abort()` on failure.\n\n
 ///   The returned MTY_RWLock must be destroyed with MTY_RWLockDestroy.
 MTY_EXPORT MTY_RWLock *
 MTY_RWLockCreate(void);
 
+/// @brief Create an MTY_RWLock optimized for data that is rarely written.
+/// @details Readers are spread across separate counters so concurrent readers do not
+///   contend on the same cache line. In exchange, taking the write lock is more
+///   expensive than with MTY_RWLockCreate. The locking semantics are otherwise identical.
+/// @returns This function can not return NULL. It will call `abort()` on failure.\n\n
+///   The returned MTY_RWLock must be destroyed with MTY_RWLockDestroy.
+MTY_EXPORT MTY_RWLock *
+MTY_RWLockCreateSharded(void);
+
 /// @brief Destroy an MTY_RWLock.
 /// @param rwlock Passed by reference and set to NULL after being destroyed.
 MTY_EXPORT void
@@ -2732,19 +3572,24 @@ MTY_WaitableWait(MTY_Waitable *ctx, int32_t timeout);
 
 /// @brief Signal a waitable object on a single blocked thread.
 /// @details If multiple threads are waiting on the waitable object, exactly one thread
-///   will become unblocked and return true, the others will continue waiting.
+///   will become unblocked and return true, the others will continue waiting. When no
+///   thread is waiting, this function does not make a system call.
 /// @param ctx An MTY_Waitable object.
 MTY_EXPORT void
 MTY_WaitableSignal(MTY_Waitable *ctx);
 
 /// @brief Create an MTY_ThreadPool for asynchronously executing tasks.
-/// @param maxThreads Maximum number of threads that can be simultaneously executing.
+/// @details Worker threads are created on demand and reused for subsequent tasks.
+///   Tasks dispatched while every worker is busy wait in a queue and run in the
+///   order they were dispatched.
+/// @param maxThreads Maximum number of worker threads that can be simultaneously executing.
 /// @returns This function can not return NULL. It will call `abort()` on failure.\n\n
 ///   The returned MTY_ThreadPool object must be destroyed with MTY_ThreadPoolDestroy.
 MTY_EXPORT MTY_ThreadPool *
 MTY_ThreadPoolCreate(uint32_t maxThreads);
 
 /// @brief Destroy an MTY_ThreadPool.
+/// @details Any queued tasks are run to completion before the workers exit.
 /// @param pool Passed by reference and set to NULL after being destroyed.
 /// @param detach Function called to clean up `opaque` thread state set via
 ///   MTY_ThreadPoolDispatch after threads are done executing. May be NULL if not
@@ -2756,8 +3601,7 @@ MTY_ThreadPoolDestroy(MTY_ThreadPool **pool, MTY_AnonFunc detach);
 /// @param ctx An MTY_ThreadPool.
 /// @param func Function executed on a thread in the pool.
 /// @param opaque Passed to `func` when it is called.
-/// @returns On success, the index of the scheduled thread which must be greater than 0.
-///   If there is no room left in the pool, 0 is returned. Call MTY_GetLog for details.
+/// @returns The index of the scheduled task, which is always greater than 0.
 MTY_EXPORT uint32_t
 MTY_ThreadPoolDispatch(MTY_ThreadPool *ctx, MTY_AnonFunc func, void *opaque);
 
@@ -2784,6 +3628,55 @@ MTY_ThreadPoolDetach(MTY_ThreadPool *ctx, uint32_t index, MTY_AnonFunc detach);
 MTY_EXPORT MTY_Async
 MTY_ThreadPoolPoll(MTY_ThreadPool *ctx, uint32_t index, void **opaque);
 
+/// @brief Split a range of work across the threads of a pool and wait for it to finish.
+/// @details The range is divided into chunks of `grain` indexes. Each participating
+///   thread starts with an even share of the chunks, and threads that run out steal
+///   half of the remaining chunks from another thread. The calling thread participates
+///   as well, so this function may safely be called from a task running in the same
+///   pool.
+/// @param ctx An MTY_ThreadPool.
+/// @param len Number of indexes in the range, starting at 0.
+/// @param grain Number of indexes processed per call to `func`. Larger values
+///   reduce scheduling overhead, smaller values improve load balancing.
+/// @param func Function called on each chunk of the range, possibly concurrently.
+/// @param opaque Passed to `func` when it is called.
+MTY_EXPORT void
+MTY_ParallelFor(MTY_ThreadPool *ctx, size_t len, size_t grain, MTY_RangeFunc func,
+	void *opaque);
+
+/// @brief Create an MTY_TaskGraph for running tasks with dependencies.
+/// @details A task graph is built once with MTY_TaskGraphAdd and may then be run
+///   any number of times with MTY_TaskGraphRun.
+/// @param pool An MTY_ThreadPool where the tasks will be executed.
+/// @returns The returned MTY_TaskGraph must be destroyed with MTY_TaskGraphDestroy.
+MTY_EXPORT MTY_TaskGraph *
+MTY_TaskGraphCreate(MTY_ThreadPool *pool);
+
+/// @brief Destroy an MTY_TaskGraph.
+/// @param graph Passed by reference and set to NULL after being destroyed.
+MTY_EXPORT void
+MTY_TaskGraphDestroy(MTY_TaskGraph **graph);
+
+/// @brief Add a task to an MTY_TaskGraph.
+/// @param ctx An MTY_TaskGraph.
+/// @param func Function executed once all of the task's dependencies have finished.
+/// @param opaque Passed to `func` when it is called.
+/// @param deps Array of task identifiers returned by previous calls to this function
+///   that must finish before this task starts. May be NULL if `numDeps` is 0.
+/// @param numDeps Number of elements in `deps`.
+/// @returns The identifier of the task, used in the `deps` of later tasks.
+MTY_EXPORT uint32_t
+MTY_TaskGraphAdd(MTY_TaskGraph *ctx, MTY_AnonFunc func, void *opaque, const uint32_t *deps,
+	uint32_t numDeps);
+
+/// @brief Run all tasks in an MTY_TaskGraph and wait for them to finish.
+/// @details Tasks without dependencies are dispatched to the pool immediately. As
+///   each task finishes, its join counter is decremented in every dependent task, and
+///   dependent tasks are started once their counter reaches zero.
+/// @param ctx An MTY_TaskGraph.
+MTY_EXPORT void
+MTY_TaskGraphRun(MTY_TaskGraph *ctx);
+
 /// @brief Set a 32-bit integer atomically.
 /// @details All atomic operations in libmatoya create a full memory barrier.
 /// @param atomic An MTY_Atomic32.
@@ -2848,7 +3741,6 @@ MTY_Atomic64CAS(MTY_Atomic64 *atomic, int64_t oldValue, int64_t newValue);
 
 /// @brief Globally lock via an atomic.
 /// @details All atomic operations in libmatoya create a full memory barrier.\n\n
-///   Warning: There is a process wide maximum of UINT8_MAX global locks.\n\n
 ///   The global lock should be statically initialized to zero.
 /// @param lock An MTY_Atomic32.
 MTY_EXPORT void
@@ -3012,10 +3904,26 @@ typedef struct MTY_ListNode {
 	void *value;               ///< The value associated with the node.
 } MTY_ListNode;
 
+/// @brief MTY_Queue producer modes.
+typedef enum {
+	MTY_QUEUE_FLAG_NONE    = 0x00, ///< Multiple producers, serialized with a mutex held from
+	                               ///<   MTY_QueueGetInputBuffer until MTY_QueuePush.
+	MTY_QUEUE_FLAG_SPSC    = 0x01, ///< A single producer thread, wait-free on both sides.
+	MTY_QUEUE_FLAG_MPSC    = 0x02, ///< Multiple producers that claim buffers lock-free. Each
+	                               ///<   thread may hold up to 8 input buffers at once.
+	MTY_QUEUE_FLAG_RING    = 0x04, ///< Buffers are variable sized spans of one shared byte
+	                               ///<   ring of `bufSize` bytes, reserved with MTY_QueueReserve.
+	                               ///<   May be combined with MTY_QUEUE_FLAG_SPSC, otherwise
+	                               ///<   producers are serialized with a mutex.
+	MTY_QUEUE_FLAG_MAKE_32 = INT32_MAX,
+} MTY_QueueFlag;
+
 /// @brief Create an MTY_Hash for key/value lookup.
-/// @param numBuckets The number of buckets to use. The more buckets, the larger
-///   the memory usage but less chance of collision. Specifying 0 chooses a reasonable
-///   default.
+/// @details String keys and integer keys are stored separately, so the same hash
+///   can hold both without collision. Both use open addressing tables that grow
+///   automatically as keys are added. String keys are iterated in insertion order.
+/// @param numBuckets The initial capacity for string keys. Specifying 0 chooses a
+///   reasonable default.
 /// @returns The returned MTY_Hash must be destroyed with MTY_HashDestroy.
 MTY_EXPORT MTY_Hash *
 MTY_HashCreate(uint32_t numBuckets);
@@ -3074,6 +3982,9 @@ MTY_EXPORT void *
 MTY_HashPopInt(MTY_Hash *ctx, int64_t key);
 
 /// @brief Iterate through string key/value pairs in a hash.
+/// @details Keys are returned in the order they were first set. It is safe to call
+///   MTY_HashPop during iteration, but calling MTY_HashSet with a new key may reorder
+///   the remaining keys.
 /// @param ctx An MTY_Hash.
 /// @param iter Iterator that keeps track of the position in the hash. Set this to
 ///   0 before the fist call to this function.
@@ -3083,6 +3994,9 @@ MTY_EXPORT bool
 MTY_HashGetNextKey(MTY_Hash *ctx, uint64_t *iter, const char **key);
 
 /// @brief Iterate through integer key/value pairs in a hash.
+/// @details Only integer keys are returned. It is safe to call MTY_HashPopInt
+///   during iteration, but calling MTY_HashSetInt with a new key may reorder the
+///   remaining keys.
 /// @param ctx An MTY_Hash.
 /// @param iter Iterator that keeps track of the position in the hash. Set this to
 ///   0 before the fist call to this function.
@@ -3094,13 +4008,16 @@ MTY_HashGetNextKeyInt(MTY_Hash *ctx, uint64_t *iter, int64_t *key);
 /// @brief Create an MTY_Queue for thread safe serialization.
 /// @details The queue is a multi-producer single-consumer style queue, meaning
 ///   multiple threads can submit to the queue safely, but only a single thread can
-///   pop from it.
+///   pop from it. Buffers are handed over without locking on the consumer side, which
+///   spins briefly before sleeping when the queue is empty.
 /// @param len The number of buffers in the queue.
 /// @param bufSize The preallocated size of each buffer in the queue. If only pushing
-///   via MTY_QueuePushPtr, this can be set to 0.
+///   via MTY_QueuePushPtr, this can be set to 0. With MTY_QUEUE_FLAG_RING, this is the
+///   total size of the ring shared by all buffers.
+/// @param flags How producers are synchronized, see MTY_QueueFlag.
 /// @returns The returned MTY_Queue must be destroyed with MTY_QueueDestroy.
 MTY_EXPORT MTY_Queue *
-MTY_QueueCreate(uint32_t len, size_t bufSize);
+MTY_QueueCreate(uint32_t len, size_t bufSize, MTY_QueueFlag flags);
 
 /// @brief Destroy an MTY_Queue.
 /// @param queue Passed by reference and set to NULL after being destroyed.
@@ -3116,10 +4033,22 @@ MTY_QueueGetLength(MTY_Queue *ctx);
 
 /// @brief Lock and retrieve the next available input buffer from the queue.
 /// @param ctx An MTY_Queue.
-/// @returns If there are no input buffers available, NULL is returned.
+/// @returns If there are no input buffers available, NULL is returned. Queues
+///   created with MTY_QUEUE_FLAG_RING always return NULL, use MTY_QueueReserve instead.
 MTY_EXPORT void *
 MTY_QueueGetInputBuffer(MTY_Queue *ctx);
 
+/// @brief Lock and retrieve an input buffer of at least `size` bytes from the queue.
+/// @details With MTY_QUEUE_FLAG_RING, the buffer is a contiguous span of the ring and
+///   only the amount passed to MTY_QueuePush stays in use. Otherwise this behaves like
+///   MTY_QueueGetInputBuffer, failing if `size` is larger than the buffer size.
+/// @param ctx An MTY_Queue.
+/// @param size Number of bytes to reserve.
+/// @returns If there is not enough space available, NULL is returned.\n\n
+///   The buffer must be submitted with MTY_QueuePush.
+MTY_EXPORT void *
+MTY_QueueReserve(MTY_Queue *ctx, size_t size);
+
 /// @brief Push and unlock the most recently acquired input buffer.
 /// @param ctx An MTY_Queue.
 /// @param size The amount of data filled in the most recently locked buffer. If this
@@ -3127,6 +4056,19 @@ MTY_QueueGetInputBuffer(MTY_Queue *ctx);
 MTY_EXPORT void
 MTY_QueuePush(MTY_Queue *ctx, size_t size);
 
+/// @brief Copy several buffers into a queue at once.
+/// @details All buffers are claimed and published with a single synchronization, and
+///   the consumer is woken at most once.
+/// @param ctx An MTY_Queue.
+/// @param buffers Array of `count` buffers to copy.
+/// @param sizes Array of `count` sizes in bytes, one for each of `buffers`.
+/// @param count Number of buffers to push.
+/// @returns The number of buffers pushed, which is less than `count` if the queue
+///   filled up. Buffers are always pushed in order.
+MTY_EXPORT uint32_t
+MTY_QueuePushBatch(MTY_Queue *ctx, const void * const *buffers, const size_t *sizes,
+	uint32_t count);
+
 /// @brief Lock and retrieve the next available output buffer from the queue.
 /// @param ctx An MTY_Queue.
 /// @param timeout Time to wait in milliseconds for an output buffer to become available.
@@ -3154,6 +4096,26 @@ MTY_QueueGetLastOutputBuffer(MTY_Queue *ctx, int32_t timeout, void **buffer,
 MTY_EXPORT void
 MTY_QueuePop(MTY_Queue *ctx);
 
+/// @brief Retrieve several output buffers from the queue at once without copying.
+/// @param ctx An MTY_Queue.
+/// @param timeout Time to wait in milliseconds for the first output buffer to become
+///   available. A negative value will not timeout.
+/// @param buffers Array of at least `max` entries set to the output buffers.
+/// @param sizes Array of at least `max` entries set to the size of each output buffer.
+/// @param max Maximum number of buffers to retrieve.
+/// @returns The number of buffers retrieved, 0 on timeout.\n\n
+///   The buffers remain valid until they are released with MTY_QueuePopBatch.
+MTY_EXPORT uint32_t
+MTY_QueueGetOutputBuffers(MTY_Queue *ctx, int32_t timeout, void **buffers,
+	size_t *sizes, uint32_t max);
+
+/// @brief Release several output buffers and mark them as empty.
+/// @param ctx An MTY_Queue.
+/// @param count Number of buffers to release, usually the value returned by
+///   MTY_QueueGetOutputBuffers.
+MTY_EXPORT void
+MTY_QueuePopBatch(MTY_Queue *ctx, uint32_t count);
+
 /// @brief Push a pointer allocated by the caller to a queue.
 /// @param ctx An MTY_Queue.
 /// @param opaque Value you allocated and are responsible for freeing.
@@ -3187,6 +4149,15 @@ MTY_QueueFlush(MTY_Queue *ctx, MTY_FreeFunc freeFunc);
 MTY_EXPORT MTY_List *
 MTY_ListCreate(void);
 
+/// @brief Create an MTY_List whose nodes are allocated from an MTY_Pool.
+/// @details Many lists can share one pool, which avoids a heap allocation for
+///   each appended item.
+/// @param pool An MTY_Pool created with a size of at least `sizeof(MTY_ListNode)`.
+///   It must outlive the list.
+/// @returns The returned MTY_List must be destroyed with MTY_ListDestroy.
+MTY_EXPORT MTY_List *
+MTY_ListCreateFromPool(MTY_Pool *pool);
+
 /// @brief Destroy an MTY_List.
 /// @param queue Passed by reference and set to NULL after being destroyed.
 /// @param freeFunc Function called on each remaining value in the list to give you
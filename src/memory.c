@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <wchar.h>
 
+#include "alloc.h"
 #include "tlocal.h"
 
 static volatile void *(*MEMORY_MEMSET)(void *s, int c, size_t n) = (void *) memset;
@@ -21,50 +22,293 @@ void MTY_SecureZero(void *mem, size_t size)
 		MEMORY_MEMSET(mem, 0, size);
 }
 
-void *MTY_Alloc(size_t len, size_t size)
+// Allocator
+
+// Every block starts with a header recording its size, tag, which allocator it came
+// from and whether it is counted in the statistics, the pointer handed out is just
+// past it. Blocks are freed the way they were allocated, so the allocator and the
+// statistics setting can be changed at any time
+
+#define MEMORY_MAGIC          0xA7
+#define MEMORY_ALLOCATORS_MAX 8
+
+struct memory_header {
+	uint64_t size;
+	uint32_t offset;
+	uint8_t tag;
+	uint8_t allocator;
+	uint8_t stats;
+	uint8_t magic;
+};
+
+struct memory_stats {
+	MTY_Atomic64 live;
+	MTY_Atomic64 peak;
+	MTY_Atomic64 allocs;
+	MTY_Atomic64 frees;
+};
+
+// Allocators are never removed, index 0 is the system allocator
+static MTY_Atomic32 MEMORY_LOCK;
+static MTY_Allocator MEMORY_ALLOCATORS[MEMORY_ALLOCATORS_MAX];
+static uint8_t MEMORY_NUM_ALLOCATORS = 1;
+
+static MTY_Atomic32 MEMORY_CURRENT;
+static MTY_Atomic32 MEMORY_STATS;
+static struct memory_stats MEMORY_TAGS[MTY_MEMORY_TAG_MAX];
+
+void MTY_SetAllocator(const MTY_Allocator *allocator, bool stats)
 {
-	void *mem = calloc(len, size);
+	MTY_GlobalLock(&MEMORY_LOCK);
 
-	if (!mem)
-		MTY_LogFatal("'calloc' failed with errno %d", errno);
+	uint8_t index = 0;
+
+	if (allocator) {
+		for (index = 1; index < MEMORY_NUM_ALLOCATORS; index++)
+			if (!memcmp(&MEMORY_ALLOCATORS[index], allocator, sizeof(MTY_Allocator)))
+				break;
+
+		if (index == MEMORY_NUM_ALLOCATORS && index < MEMORY_ALLOCATORS_MAX)
+			MEMORY_ALLOCATORS[MEMORY_NUM_ALLOCATORS++] = *allocator;
+	}
+
+	bool full = index == MEMORY_ALLOCATORS_MAX;
 
-	return mem;
+	if (!full) {
+		MTY_Atomic32Set(&MEMORY_CURRENT, index);
+		MTY_Atomic32Set(&MEMORY_STATS, stats);
+	}
+
+	MTY_GlobalUnlock(&MEMORY_LOCK);
+
+	if (full)
+		MTY_Log("No more than %d different allocators can be set", MEMORY_ALLOCATORS_MAX - 1);
 }
 
-void MTY_Free(void *mem)
+bool MTY_GetMemoryStats(MTY_MemoryTag tag, MTY_MemoryStats *stats)
 {
-	free(mem);
+	memset(stats, 0, sizeof(MTY_MemoryStats));
+
+	if (!MTY_Atomic32Get(&MEMORY_STATS) || tag < 0 || tag >= MTY_MEMORY_TAG_MAX)
+		return false;
+
+	struct memory_stats *s = &MEMORY_TAGS[tag];
+	stats->live = (size_t) MTY_Atomic64Get(&s->live);
+	stats->peak = (size_t) MTY_Atomic64Get(&s->peak);
+	stats->allocs = (uint64_t) MTY_Atomic64Get(&s->allocs);
+	stats->frees = (uint64_t) MTY_Atomic64Get(&s->frees);
+
+	return true;
 }
 
-void MTY_SecureFree(void *mem, size_t size)
+static void memory_count_alloc(MTY_MemoryTag tag, int64_t size)
 {
-	MTY_SecureZero(mem, size);
-	MTY_Free(mem);
+	struct memory_stats *s = &MEMORY_TAGS[tag];
+
+	int64_t live = MTY_Atomic64Add(&s->live, size);
+	MTY_Atomic64Add(&s->allocs, 1);
+
+	for (int64_t peak = MTY_Atomic64Get(&s->peak); live > peak; peak = MTY_Atomic64Get(&s->peak))
+		if (MTY_Atomic64CAS(&s->peak, peak, live))
+			break;
 }
 
-void *MTY_Realloc(void *mem, size_t len, size_t size)
+static void memory_count_free(struct memory_header *h)
+{
+	struct memory_stats *s = &MEMORY_TAGS[h->tag];
+
+	MTY_Atomic64Add(&s->live, -(int64_t) h->size);
+	MTY_Atomic64Add(&s->frees, 1);
+}
+
+static size_t memory_total(size_t len, size_t size, size_t extra)
+{
+	if (size > 0 && len > (SIZE_MAX - extra) / size)
+		MTY_LogFatal("Allocation of %zu * %zu bytes overflows", len, size);
+
+	return len * size + extra;
+}
+
+static void *memory_header_init(uint8_t *base, uint32_t offset, size_t size, MTY_MemoryTag tag,
+	uint8_t allocator, bool stats)
+{
+	struct memory_header *h = (struct memory_header *) (base + offset) - 1;
+	h->size = size;
+	h->offset = offset;
+	h->tag = (uint8_t) tag;
+	h->allocator = allocator;
+	h->stats = stats;
+	h->magic = MEMORY_MAGIC;
+
+	if (stats)
+		memory_count_alloc(tag, size);
+
+	return base + offset;
+}
+
+static struct memory_header *memory_header(void *mem)
+{
+	struct memory_header *h = (struct memory_header *) mem - 1;
+
+	if (h->magic != MEMORY_MAGIC)
+		MTY_LogFatal("Memory at %p was not allocated by libmatoya", mem);
+
+	if (h->stats)
+		memory_count_free(h);
+
+	return h;
+}
+
+static const MTY_Allocator *memory_allocator(uint8_t index)
+{
+	return index > 0 ? &MEMORY_ALLOCATORS[index] : NULL;
+}
+
+void *mty_alloc(size_t len, size_t size, MTY_MemoryTag tag)
 {
-	size_t total = size * len;
+	uint8_t index = (uint8_t) MTY_Atomic32Get(&MEMORY_CURRENT);
+	const MTY_Allocator *a = memory_allocator(index);
+
+	size_t extra = sizeof(struct memory_header);
+	size_t total = memory_total(len, size, extra);
+	void *mem = NULL;
+
+	if (a) {
+		mem = a->alloc(total, a->opaque);
+
+		if (!mem)
+			MTY_LogFatal("Custom allocator failed to allocate %zu bytes", total);
+
+		memset(mem, 0, total);
 
-	void *new_mem = realloc(mem, total);
+	} else {
+		mem = calloc(total, 1);
+
+		if (!mem)
+			MTY_LogFatal("'calloc' failed with errno %d", errno);
+	}
+
+	return memory_header_init(mem, (uint32_t) extra, total - extra, tag, index,
+		MTY_Atomic32Get(&MEMORY_STATS));
+}
+
+void *mty_realloc(void *mem, size_t len, size_t size, MTY_MemoryTag tag)
+{
+	if (!mem)
+		return mty_alloc(len, size, tag);
 
-	if (!new_mem && total > 0)
+	// The block stays with the allocator it came from
+	struct memory_header *h = memory_header(mem);
+	uint8_t index = h->allocator;
+	const MTY_Allocator *a = memory_allocator(index);
+	tag = h->tag;
+
+	size_t extra = sizeof(struct memory_header);
+	size_t total = memory_total(len, size, extra);
+
+	void *new_mem = a ? a->realloc(h, total, a->opaque) : realloc(h, total);
+
+	if (!new_mem)
 		MTY_LogFatal("'realloc' failed with errno %d", errno);
 
-	return new_mem;
+	return memory_header_init(new_mem, (uint32_t) extra, total - extra, tag, index,
+		MTY_Atomic32Get(&MEMORY_STATS));
 }
 
-void *MTY_Dup(const void *mem, size_t size)
+void *mty_alloc_aligned(size_t size, size_t align, MTY_MemoryTag tag)
 {
-	void *dup = MTY_Alloc(size, 1);
+	uint8_t index = (uint8_t) MTY_Atomic32Get(&MEMORY_CURRENT);
+	const MTY_Allocator *a = memory_allocator(index);
+
+	// The header takes a whole alignment unit so the returned pointer stays aligned
+	size_t extra = MTY_MAX(align, sizeof(struct memory_header));
+	size_t total = memory_total(size, 1, extra);
+
+	void *mem = a ? a->allocAligned(total, align, a->opaque) : mty_sys_alloc_aligned(total, align);
+
+	if (!mem)
+		MTY_LogFatal("Aligned allocation of %zu bytes failed", total);
+
+	memset(mem, 0, total);
+
+	return memory_header_init(mem, (uint32_t) extra, size, tag, index, MTY_Atomic32Get(&MEMORY_STATS));
+}
+
+void *mty_dup(const void *mem, size_t size, MTY_MemoryTag tag)
+{
+	void *dup = mty_alloc(size, 1, tag);
 	memcpy(dup, mem, size);
 
 	return dup;
 }
 
+char *mty_strdup(const char *str, MTY_MemoryTag tag)
+{
+	return mty_dup(str, strlen(str) + 1, tag);
+}
+
+void *MTY_Alloc(size_t len, size_t size)
+{
+	return mty_alloc(len, size, MTY_MEMORY_TAG_NONE);
+}
+
+void *MTY_AllocAligned(size_t size, size_t align)
+{
+	return mty_alloc_aligned(size, align, MTY_MEMORY_TAG_NONE);
+}
+
+void MTY_Free(void *mem)
+{
+	if (!mem)
+		return;
+
+	struct memory_header *h = memory_header(mem);
+	const MTY_Allocator *a = memory_allocator(h->allocator);
+
+	if (a) {
+		a->free(h, a->opaque);
+
+	} else {
+		free(h);
+	}
+}
+
+void MTY_FreeAligned(void *mem)
+{
+	if (!mem)
+		return;
+
+	struct memory_header *h = memory_header(mem);
+	const MTY_Allocator *a = memory_allocator(h->allocator);
+	mem = (uint8_t *) mem - h->offset;
+
+	if (a) {
+		a->freeAligned(mem, a->opaque);
+
+	} else {
+		mty_sys_free_aligned(mem);
+	}
+}
+
+void MTY_SecureFree(void *mem, size_t size)
+{
+	MTY_SecureZero(mem, size);
+	MTY_Free(mem);
+}
+
+void *MTY_Realloc(void *mem, size_t len, size_t size)
+{
+	return mty_realloc(mem, len, size, MTY_MEMORY_TAG_NONE);
+}
+
+void *MTY_Dup(const void *mem, size_t size)
+{
+	return mty_dup(mem, size, MTY_MEMORY_TAG_NONE);
+}
+
 char *MTY_Strdup(const char *str)
 {
-	return MTY_Dup(str, strlen(str) + 1);
+	return mty_strdup(str, MTY_MEMORY_TAG_NONE);
 }
 
 void MTY_Strcat(char *dst, size_t size, const char *src)
@@ -113,14 +357,11 @@ const char *MTY_SprintfDL(const char *fmt, ...)
 	va_list args;
 	va_start(args, fmt);
 
-	char *str = MTY_VsprintfD(fmt, args);
+	char *str = mty_tlocal_vsprintf(fmt, args);
 
 	va_end(args);
 
-	char *local = mty_tlocal_strcpy(str);
-	MTY_Free(str);
-
-	return local;
+	return str;
 }
 
 bool MTY_StrSearch(const char *s0, const char *s1, const char *delim)
@@ -0,0 +1,303 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#include "matoya.h"
+
+#include <string.h>
+
+#include "alloc.h"
+#include "tlocal.h"
+
+#define POOL_MAG_SIZE  64
+#define POOL_SLAB_SIZE (64 * 1024)
+#define POOL_MAX_CACHE 16
+
+// Each thread keeps two magazines (small stacks of free objects) per pool, so
+// allocating and freeing only touch thread local memory. The pool mutex is taken
+// when a thread needs to trade a full or empty magazine with the shared depot.
+// When a thread evicts a pool from its cache or exits, its magazines go back to
+// the depot so their objects can be handed out again
+
+struct pool_mag {
+	struct pool_mag *next;
+	uint32_t count;
+	void *objs[POOL_MAG_SIZE];
+};
+
+struct MTY_Pool {
+	MTY_Mutex *mutex;
+	uint64_t id;
+	size_t size;
+	size_t align;
+
+	struct pool_mag *full;
+	struct pool_mag *empty;
+
+	// Every magazine ever handed to a thread, freed on destroy
+	struct pool_mag **mags;
+	uint32_t num_mags;
+
+	uint8_t **slabs;
+	uint32_t num_slabs;
+	uint8_t *carve;
+	size_t carve_left;
+};
+
+static TLOCAL struct pool_cache {
+	MTY_Pool *pool;
+	uint64_t id;
+	struct pool_mag *loaded;
+	struct pool_mag *prev;
+} POOL_CACHE[POOL_MAX_CACHE];
+
+static MTY_Atomic64 POOL_ID;
+
+// Live pools by id, so magazines cached for a pool that has since been
+// destroyed are never handed back to it
+static MTY_Atomic32 POOL_GLOCK;
+static MTY_Hash *POOL_LIVE;
+static uint32_t POOL_NUM_LIVE;
+
+MTY_Pool *MTY_PoolCreate(size_t size, size_t align)
+{
+	MTY_Pool *ctx = MTY_Alloc(1, sizeof(MTY_Pool));
+	ctx->mutex = MTY_MutexCreate();
+	ctx->id = MTY_Atomic64Add(&POOL_ID, 1);
+	ctx->align = 16;
+
+	// Alignments that are not a power of 2 are rounded up to one
+	while (ctx->align < align && ctx->align <= SIZE_MAX / 2)
+		ctx->align *= 2;
+
+	// Objects are padded to the alignment so consecutive objects never share it
+	ctx->size = size > 0 ? size : 1;
+	ctx->size = (ctx->size + ctx->align - 1) & ~(ctx->align - 1);
+
+	MTY_GlobalLock(&POOL_GLOCK);
+
+	if (!POOL_LIVE)
+		POOL_LIVE = MTY_HashCreate(0);
+
+	MTY_HashSetInt(POOL_LIVE, ctx->id, ctx);
+	POOL_NUM_LIVE++;
+
+	MTY_GlobalUnlock(&POOL_GLOCK);
+
+	return ctx;
+}
+
+void MTY_PoolDestroy(MTY_Pool **pool)
+{
+	if (!pool || !*pool)
+		return;
+
+	MTY_Pool *ctx = *pool;
+
+	MTY_GlobalLock(&POOL_GLOCK);
+
+	MTY_HashPopInt(POOL_LIVE, ctx->id);
+
+	if (--POOL_NUM_LIVE == 0)
+		MTY_HashDestroy(&POOL_LIVE, NULL);
+
+	MTY_GlobalUnlock(&POOL_GLOCK);
+
+	for (uint32_t x = 0; x < ctx->num_mags; x++)
+		MTY_Free(ctx->mags[x]);
+
+	for (uint32_t x = 0; x < ctx->num_slabs; x++)
+		MTY_FreeAligned(ctx->slabs[x]);
+
+	MTY_Free(ctx->mags);
+	MTY_Free(ctx->slabs);
+	MTY_MutexDestroy(&ctx->mutex);
+
+	MTY_Free(ctx);
+	*pool = NULL;
+}
+
+
+// Depot, called with the pool mutex held
+
+static struct pool_mag *pool_new_mag(MTY_Pool *ctx)
+{
+	if (ctx->empty) {
+		struct pool_mag *mag = ctx->empty;
+		ctx->empty = mag->next;
+
+		return mag;
+	}
+
+	struct pool_mag *mag = MTY_Alloc(1, sizeof(struct pool_mag));
+
+	ctx->mags = MTY_Realloc(ctx->mags, ctx->num_mags + 1, sizeof(struct pool_mag *));
+	ctx->mags[ctx->num_mags++] = mag;
+
+	return mag;
+}
+
+static void pool_carve(MTY_Pool *ctx, struct pool_mag *mag)
+{
+	while (mag->count < POOL_MAG_SIZE) {
+		if (ctx->carve_left < ctx->size) {
+			size_t slab_size = ctx->size * POOL_MAG_SIZE;
+
+			if (slab_size < POOL_SLAB_SIZE)
+				slab_size = POOL_SLAB_SIZE - POOL_SLAB_SIZE % ctx->size;
+
+			ctx->carve = MTY_AllocAligned(slab_size, ctx->align);
+			ctx->carve_left = slab_size;
+
+			ctx->slabs = MTY_Realloc(ctx->slabs, ctx->num_slabs + 1, sizeof(uint8_t *));
+			ctx->slabs[ctx->num_slabs++] = ctx->carve;
+		}
+
+		mag->objs[mag->count++] = ctx->carve;
+		ctx->carve += ctx->size;
+		ctx->carve_left -= ctx->size;
+	}
+}
+
+static void pool_depot_return(MTY_Pool *ctx, struct pool_mag *mag)
+{
+	// Partially filled magazines are fine on the full list, allocations only
+	// ever take objects from the top
+	if (mag->count > 0) {
+		mag->next = ctx->full;
+		ctx->full = mag;
+
+	} else {
+		mag->next = ctx->empty;
+		ctx->empty = mag;
+	}
+}
+
+static void pool_release(struct pool_cache *c)
+{
+	if (!c->pool)
+		return;
+
+	MTY_GlobalLock(&POOL_GLOCK);
+
+	MTY_Pool *ctx = POOL_LIVE ? MTY_HashGetInt(POOL_LIVE, c->id) : NULL;
+
+	if (ctx) {
+		MTY_MutexLock(ctx->mutex);
+		pool_depot_return(ctx, c->loaded);
+		pool_depot_return(ctx, c->prev);
+		MTY_MutexUnlock(ctx->mutex);
+	}
+
+	MTY_GlobalUnlock(&POOL_GLOCK);
+
+	memset(c, 0, sizeof(struct pool_cache));
+}
+
+void mty_pool_release_thread(void)
+{
+	for (uint8_t x = 0; x < POOL_MAX_CACHE; x++)
+		pool_release(&POOL_CACHE[x]);
+}
+
+static struct pool_cache *pool_cache(MTY_Pool *ctx)
+{
+	struct pool_cache *slot = NULL;
+
+	for (uint8_t x = 0; x < POOL_MAX_CACHE; x++) {
+		struct pool_cache *c = &POOL_CACHE[x];
+
+		if (c->pool == ctx) {
+			if (c->id == ctx->id)
+				return c;
+
+			// A destroyed pool that lived at the same address
+			slot = c;
+			break;
+		}
+
+		// Once every entry is taken the last one is replaced
+		if (!slot && (!c->pool || x == POOL_MAX_CACHE - 1))
+			slot = c;
+	}
+
+	pool_release(slot);
+	mty_tlocal_track_thread();
+
+	MTY_MutexLock(ctx->mutex);
+	slot->loaded = pool_new_mag(ctx);
+	slot->prev = pool_new_mag(ctx);
+	MTY_MutexUnlock(ctx->mutex);
+
+	slot->pool = ctx;
+	slot->id = ctx->id;
+
+	return slot;
+}
+
+void *MTY_PoolAlloc(MTY_Pool *ctx)
+{
+	struct pool_cache *c = pool_cache(ctx);
+
+	if (c->loaded->count == 0) {
+		if (c->prev->count > 0) {
+			struct pool_mag *tmp = c->loaded;
+			c->loaded = c->prev;
+			c->prev = tmp;
+
+		} else {
+			MTY_MutexLock(ctx->mutex);
+
+			if (ctx->full) {
+				c->loaded->next = ctx->empty;
+				ctx->empty = c->loaded;
+
+				c->loaded = ctx->full;
+				ctx->full = c->loaded->next;
+
+			} else {
+				pool_carve(ctx, c->loaded);
+			}
+
+			MTY_MutexUnlock(ctx->mutex);
+		}
+	}
+
+	void *obj = c->loaded->objs[--c->loaded->count];
+	memset(obj, 0, ctx->size);
+
+	return obj;
+}
+
+void MTY_PoolFree(MTY_Pool *ctx, void *obj)
+{
+	if (!obj)
+		return;
+
+	struct pool_cache *c = pool_cache(ctx);
+
+	if (c->loaded->count == POOL_MAG_SIZE) {
+		if (c->prev->count < POOL_MAG_SIZE) {
+			struct pool_mag *tmp = c->loaded;
+			c->loaded = c->prev;
+			c->prev = tmp;
+
+		} else {
+			MTY_MutexLock(ctx->mutex);
+
+			c->loaded->next = ctx->full;
+			ctx->full = c->loaded;
+			c->loaded = pool_new_mag(ctx);
+			c->loaded->count = 0;
+
+			MTY_MutexUnlock(ctx->mutex);
+		}
+	}
+
+	c->loaded->objs[c->loaded->count++] = obj;
+}
+
+size_t MTY_PoolGetSize(MTY_Pool *ctx)
+{
+	return ctx->size;
+}
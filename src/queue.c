@@ -6,46 +6,85 @@
 
 #include <string.h>
 
-enum {
-	QUEUE_EMPTY = 0,
-	QUEUE_FULL  = 1,
-};
+#include "tlocal.h"
+#include "alloc.h"
+
+#define QUEUE_SPIN      256
+#define QUEUE_MAX_CLAIM 8
+
+// Each slot carries a sequence number: a slot is free for the producer at position
+// `pos` when seq == pos, and ready for the consumer when seq == pos + 1. Positions
+// are 64-bit and never wrap, so the slot index is simply pos % len
 
 struct queue_slot {
 	void *data;
 	size_t size;
 	bool ptr;
-	MTY_Atomic32 state;
+	bool skip;
+	int64_t end;
+	MTY_Atomic64 seq;
 };
 
 struct MTY_Queue {
 	size_t buf_size;
 	uint32_t len;
+	MTY_QueueFlag flags;
 
 	MTY_Waitable *pop_sync;
 	MTY_Mutex *push_mutex;
+	MTY_Atomic32 waiting;
 
 	struct queue_slot *slots;
-	uint32_t push_pos;
-	uint32_t pop_pos;
+	MTY_Atomic64 push_pos;
+	MTY_Atomic64 pop_pos;
+	int64_t claim;
+
+	// Byte ring mode: slots point into one shared buffer. `ring_head` is owned by the
+	// producer, `ring_tail` is advanced by the consumer as slots are popped
+	uint8_t *ring;
+	int64_t ring_head;
+	MTY_Atomic64 ring_tail;
 };
 
-MTY_Queue *MTY_QueueCreate(uint32_t len, size_t bufSize)
+// Multi-producer lock-free claims are made in MTY_QueueGetInputBuffer and published
+// in MTY_QueuePush, so each thread remembers the position it claimed per queue
+
+static TLOCAL struct queue_claim {
+	MTY_Queue *queue;
+	int64_t pos;
+} QUEUE_CLAIM[QUEUE_MAX_CLAIM];
+
+MTY_Queue *MTY_QueueCreate(uint32_t len, size_t bufSize, MTY_QueueFlag flags)
 {
-	MTY_Queue *ctx = MTY_Alloc(1, sizeof(MTY_Queue));
+	MTY_Queue *ctx = mty_alloc(1, sizeof(MTY_Queue), MTY_MEMORY_TAG_QUEUE);
 	ctx->len = len;
+	ctx->flags = flags;
 	ctx->buf_size = bufSize;
 
 	if (ctx->buf_size < sizeof(void *))
 		ctx->buf_size = sizeof(void *);
 
+	// Byte ranges in the ring are claimed in order, so lock-free producers fall back
+	// to the push mutex
+	if (ctx->flags & MTY_QUEUE_FLAG_RING)
+		ctx->flags &= ~MTY_QUEUE_FLAG_MPSC;
+
 	ctx->pop_sync = MTY_WaitableCreate();
-	ctx->push_mutex = MTY_MutexCreate();
 
-	ctx->slots = MTY_Alloc(ctx->len, sizeof(struct queue_slot));
+	if (!(ctx->flags & (MTY_QUEUE_FLAG_SPSC | MTY_QUEUE_FLAG_MPSC)))
+		ctx->push_mutex = MTY_MutexCreate();
+
+	ctx->slots = mty_alloc(ctx->len, sizeof(struct queue_slot), MTY_MEMORY_TAG_QUEUE);
 
-	for (uint32_t x = 0; x < ctx->len; x++)
-		ctx->slots[x].data = MTY_Alloc(ctx->buf_size, 1);
+	if (ctx->flags & MTY_QUEUE_FLAG_RING)
+		ctx->ring = mty_alloc(ctx->buf_size, 1, MTY_MEMORY_TAG_QUEUE);
+
+	for (uint32_t x = 0; x < ctx->len; x++) {
+		if (!ctx->ring)
+			ctx->slots[x].data = mty_alloc(ctx->buf_size, 1, MTY_MEMORY_TAG_QUEUE);
+
+		MTY_Atomic64Set(&ctx->slots[x].seq, x);
+	}
 
 	return ctx;
 }
@@ -57,10 +96,11 @@ void MTY_QueueDestroy(MTY_Queue **queue)
 
 	MTY_Queue *ctx = *queue;
 
-	for (uint32_t x = 0; x < ctx->len; x++)
+	for (uint32_t x = 0; x < ctx->len && !ctx->ring; x++)
 		MTY_Free(ctx->slots[x].data);
 
 	MTY_Free(ctx->slots);
+	MTY_Free(ctx->ring);
 
 	MTY_MutexDestroy(&ctx->push_mutex);
 	MTY_WaitableDestroy(&ctx->pop_sync);
@@ -71,53 +111,203 @@ void MTY_QueueDestroy(MTY_Queue **queue)
 
 uint32_t MTY_QueueGetLength(MTY_Queue *ctx)
 {
-	int32_t pos = (int32_t) ctx->push_pos - (int32_t) ctx->pop_pos;
+	int64_t len = MTY_Atomic64Get(&ctx->push_pos) - MTY_Atomic64Get(&ctx->pop_pos);
 
-	if (pos < 0)
-		pos += ctx->len;
+	if (len < 0)
+		return 0;
 
-	return (uint32_t) pos;
+	return len > ctx->len ? ctx->len : (uint32_t) len;
 }
 
-void *MTY_QueueGetInputBuffer(MTY_Queue *ctx)
+static struct queue_slot *queue_slot(MTY_Queue *ctx, int64_t pos)
 {
-	MTY_MutexLock(ctx->push_mutex);
+	return &ctx->slots[(uint64_t) pos % ctx->len];
+}
 
-	int32_t state = MTY_Atomic32Get(&ctx->slots[ctx->push_pos].state);
 
-	if (state == QUEUE_EMPTY) {
-		return ctx->slots[ctx->push_pos].data;
+// Push
 
-	} else {
-		MTY_MutexUnlock(ctx->push_mutex);
-	}
+static struct queue_claim *queue_find_claim(MTY_Queue *ctx, MTY_Queue *match)
+{
+	for (uint8_t x = 0; x < QUEUE_MAX_CLAIM; x++)
+		if (QUEUE_CLAIM[x].queue == match)
+			return &QUEUE_CLAIM[x];
+
+	if (match)
+		MTY_LogFatal("No input buffer was acquired from queue %p", (void *) ctx);
+
+	MTY_LogFatal("Too many input buffers acquired by one thread, maximum is %u",
+		QUEUE_MAX_CLAIM);
 
 	return NULL;
 }
 
-static uint32_t queue_next_pos(MTY_Queue *ctx, uint32_t pos)
+static int64_t queue_claim_mpsc(MTY_Queue *ctx, uint32_t *count)
 {
-	if (++pos == ctx->len)
-		pos = 0;
+	for (int64_t pos = MTY_Atomic64Get(&ctx->push_pos);;) {
+		int64_t avail = ctx->len - (pos - MTY_Atomic64Get(&ctx->pop_pos));
+		uint32_t n = avail < *count ? (uint32_t) avail : *count;
+
+		// The consumer releases slots in order, so if the last slot of the range is
+		// free the rest of it is too
+		if (n > 0) {
+			int64_t last = pos + n - 1;
+			int64_t seq = MTY_Atomic64Get(&queue_slot(ctx, last)->seq);
+
+			if (seq == last && MTY_Atomic64CAS(&ctx->push_pos, pos, pos + n)) {
+				*count = n;
+				return pos;
+			}
+
+			// The consumer has not released this slot yet, the queue is full
+			if (seq < last && MTY_Atomic64Get(&ctx->push_pos) == pos)
+				break;
+
+		} else if (MTY_Atomic64Get(&ctx->push_pos) == pos) {
+			break;
+		}
+
+		// Another producer claimed this position, try the next one
+		pos = MTY_Atomic64Get(&ctx->push_pos);
+	}
+
+	*count = 0;
 
-	return pos;
+	return -1;
 }
 
-static void queue_push(MTY_Queue *ctx, size_t size, bool ptr)
+static bool queue_reserve_ring(MTY_Queue *ctx, struct queue_slot *slot, size_t size)
 {
-	if (size > 0 || ptr) {
-		uint32_t lock_pos = ctx->push_pos;
-		ctx->slots[lock_pos].size = size;
+	if (size > ctx->buf_size)
+		return false;
+
+	// Spans are always contiguous, so one that would straddle the end of the ring
+	// starts over at the beginning and the tail bytes are left unused
+	int64_t start = ctx->ring_head;
+	size_t offset = (uint64_t) start % ctx->buf_size;
+
+	if (offset + size > ctx->buf_size) {
+		start += ctx->buf_size - offset;
+		offset = 0;
+	}
+
+	if (start + (int64_t) size - MTY_Atomic64Get(&ctx->ring_tail) > (int64_t) ctx->buf_size)
+		return false;
+
+	slot->data = ctx->ring + offset;
+	slot->end = start;
+
+	return true;
+}
+
+static bool queue_claim(MTY_Queue *ctx, int64_t pos, size_t size)
+{
+	struct queue_slot *slot = queue_slot(ctx, pos);
+
+	if (MTY_Atomic64Get(&slot->seq) != pos)
+		return false;
+
+	return !ctx->ring || queue_reserve_ring(ctx, slot, size);
+}
+
+static void *queue_reserve(MTY_Queue *ctx, size_t size)
+{
+	if (ctx->flags & MTY_QUEUE_FLAG_MPSC) {
+		uint32_t count = 1;
+		int64_t pos = size <= ctx->buf_size ? queue_claim_mpsc(ctx, &count) : -1;
+
+		if (pos < 0)
+			return NULL;
 
-		ctx->push_pos = queue_next_pos(ctx, ctx->push_pos);
+		struct queue_claim *claim = queue_find_claim(ctx, NULL);
+		claim->queue = ctx;
+		claim->pos = pos;
 
-		ctx->slots[lock_pos].ptr = ptr;
-		MTY_Atomic32Set(&ctx->slots[lock_pos].state, QUEUE_FULL);
+		return queue_slot(ctx, pos)->data;
+	}
+
+	if (ctx->push_mutex)
+		MTY_MutexLock(ctx->push_mutex);
+
+	// Only one producer at a time gets here, so the claim does not need a CAS
+	int64_t pos = MTY_Atomic64Get(&ctx->push_pos);
+
+	if ((ctx->ring || size <= ctx->buf_size) && queue_claim(ctx, pos, size)) {
+		ctx->claim = pos;
+
+		return queue_slot(ctx, pos)->data;
+	}
+
+	if (ctx->push_mutex)
+		MTY_MutexUnlock(ctx->push_mutex);
 
+	return NULL;
+}
+
+void *MTY_QueueGetInputBuffer(MTY_Queue *ctx)
+{
+	if (ctx->ring)
+		return NULL;
+
+	return queue_reserve(ctx, ctx->buf_size);
+}
+
+void *MTY_QueueReserve(MTY_Queue *ctx, size_t size)
+{
+	return queue_reserve(ctx, size);
+}
+
+static void queue_wake(MTY_Queue *ctx)
+{
+	// The consumer only sets this after spinning, so the signal is skipped entirely
+	// while the consumer is keeping up
+	if (MTY_Atomic32Get(&ctx->waiting) && MTY_Atomic32CAS(&ctx->waiting, 1, 0))
 		MTY_WaitableSignal(ctx->pop_sync);
+}
+
+static void queue_fill(MTY_Queue *ctx, int64_t pos, size_t size, bool ptr)
+{
+	struct queue_slot *slot = queue_slot(ctx, pos);
+	slot->size = size;
+	slot->ptr = ptr;
+	slot->skip = size == 0 && !ptr;
+
+	if (ctx->ring) {
+		slot->end += ptr ? sizeof(void *) : size;
+		ctx->ring_head = slot->end;
 	}
+}
 
-	MTY_MutexUnlock(ctx->push_mutex);
+static void queue_publish(MTY_Queue *ctx, int64_t pos)
+{
+	MTY_Atomic64Set(&queue_slot(ctx, pos)->seq, pos + 1);
+}
+
+static void queue_push(MTY_Queue *ctx, size_t size, bool ptr)
+{
+	if (ctx->flags & MTY_QUEUE_FLAG_MPSC) {
+		struct queue_claim *claim = queue_find_claim(ctx, ctx);
+		int64_t pos = claim->pos;
+		claim->queue = NULL;
+
+		// The position has already been handed out, so an empty push must still be
+		// published and is skipped over by the consumer
+		queue_fill(ctx, pos, size, ptr);
+		queue_publish(ctx, pos);
+		queue_wake(ctx);
+		return;
+	}
+
+	if (size > 0 || ptr) {
+		queue_fill(ctx, ctx->claim, size, ptr);
+
+		MTY_Atomic64Set(&ctx->push_pos, ctx->claim + 1);
+		queue_publish(ctx, ctx->claim);
+		queue_wake(ctx);
+	}
+
+	if (ctx->push_mutex)
+		MTY_MutexUnlock(ctx->push_mutex);
 }
 
 void MTY_QueuePush(MTY_Queue *ctx, size_t size)
@@ -125,32 +315,126 @@ void MTY_QueuePush(MTY_Queue *ctx, size_t size)
 	queue_push(ctx, size, false);
 }
 
-static bool queue_pop(MTY_Queue *ctx, int32_t timeout, bool last, void **buffer, size_t *size)
+uint32_t MTY_QueuePushBatch(MTY_Queue *ctx, const void * const *buffers, const size_t *sizes,
+	uint32_t count)
 {
-	begin:
+	uint32_t n = count;
+	int64_t pos = 0;
+
+	if (ctx->flags & MTY_QUEUE_FLAG_MPSC) {
+		for (uint32_t x = 0; x < count && n == count; x++)
+			if (sizes[x] > ctx->buf_size)
+				n = x;
 
-	if (MTY_Atomic32Get(&ctx->slots[ctx->pop_pos].state) == QUEUE_FULL) {
-		*buffer = ctx->slots[ctx->pop_pos].data;
+		// The whole run of slots is claimed with a single CAS
+		pos = queue_claim_mpsc(ctx, &n);
 
-		if (size)
-			*size = ctx->slots[ctx->pop_pos].size;
+	} else {
+		if (ctx->push_mutex)
+			MTY_MutexLock(ctx->push_mutex);
 
-		if (last) {
-			uint32_t next_pos = queue_next_pos(ctx, ctx->pop_pos);
+		pos = MTY_Atomic64Get(&ctx->push_pos);
 
-			if (MTY_Atomic32Get(&ctx->slots[next_pos].state) == QUEUE_FULL) {
-				MTY_QueuePop(ctx);
-				goto begin;
+		for (uint32_t x = 0; x < n; x++) {
+			if ((!ctx->ring && sizes[x] > ctx->buf_size) || !queue_claim(ctx, pos + x, sizes[x])) {
+				n = x;
+				break;
 			}
+
+			// Each span must be accounted for before the next one is reserved
+			if (ctx->ring)
+				queue_fill(ctx, pos + x, sizes[x], false);
 		}
+	}
+
+	for (uint32_t x = 0; x < n; x++) {
+		if (!ctx->ring)
+			queue_fill(ctx, pos + x, sizes[x], false);
+
+		memcpy(queue_slot(ctx, pos + x)->data, buffers[x], sizes[x]);
+	}
+
+	if (!(ctx->flags & MTY_QUEUE_FLAG_MPSC))
+		MTY_Atomic64Set(&ctx->push_pos, pos + n);
+
+	for (uint32_t x = 0; x < n; x++)
+		queue_publish(ctx, pos + x);
+
+	if (n > 0)
+		queue_wake(ctx);
+
+	if (ctx->push_mutex)
+		MTY_MutexUnlock(ctx->push_mutex);
+
+	return n;
+}
+
+
+// Pop
+
+static bool queue_ready(MTY_Queue *ctx, int64_t pos)
+{
+	return MTY_Atomic64Get(&queue_slot(ctx, pos)->seq) == pos + 1;
+}
 
+static void queue_release(MTY_Queue *ctx)
+{
+	int64_t pos = MTY_Atomic64Get(&ctx->pop_pos);
+	struct queue_slot *slot = queue_slot(ctx, pos);
+
+	if (ctx->ring)
+		MTY_Atomic64Set(&ctx->ring_tail, slot->end);
+
+	MTY_Atomic64Set(&ctx->pop_pos, pos + 1);
+	MTY_Atomic64Set(&slot->seq, pos + ctx->len);
+}
+
+static bool queue_wait(MTY_Queue *ctx, int64_t pos, int32_t timeout)
+{
+	for (uint32_t x = 0; x < QUEUE_SPIN; x++)
+		if (queue_ready(ctx, pos))
+			return true;
+
+	// Producers signal only when this flag is set, so it must be visible before the
+	// final check to avoid missing a push that lands in between
+	MTY_Atomic32Set(&ctx->waiting, 1);
+
+	if (queue_ready(ctx, pos)) {
+		MTY_Atomic32Set(&ctx->waiting, 0);
 		return true;
+	}
+
+	// A stale signal may wake this early when there is no data. Worst case the
+	// caller loops one extra time
+	bool r = MTY_WaitableWait(ctx->pop_sync, timeout);
+	MTY_Atomic32Set(&ctx->waiting, 0);
+
+	return r;
+}
+
+static bool queue_pop(MTY_Queue *ctx, int32_t timeout, bool last, void **buffer, size_t *size)
+{
+	while (true) {
+		int64_t pos = MTY_Atomic64Get(&ctx->pop_pos);
+
+		if (queue_ready(ctx, pos)) {
+			struct queue_slot *slot = queue_slot(ctx, pos);
 
-	} else if (timeout != 0) {
-		// Because of the lock free check, this may already be signaled when
-		// there is no data. Worst case the loop spins one extra time
-		if (MTY_WaitableWait(ctx->pop_sync, timeout))
-			goto begin;
+			if (slot->skip || (last && queue_ready(ctx, pos + 1))) {
+				queue_release(ctx);
+				continue;
+			}
+
+			*buffer = slot->data;
+
+			if (size)
+				*size = slot->size;
+
+			return true;
+		}
+
+		if (timeout == 0 || !queue_wait(ctx, pos, timeout))
+			break;
 	}
 
 	return false;
@@ -168,16 +452,42 @@ bool MTY_QueueGetLastOutputBuffer(MTY_Queue *ctx, int32_t timeout, void **buffer
 
 void MTY_QueuePop(MTY_Queue *ctx)
 {
-	uint32_t lock_pos = ctx->pop_pos;
+	queue_release(ctx);
+}
+
+uint32_t MTY_QueueGetOutputBuffers(MTY_Queue *ctx, int32_t timeout, void **buffers,
+	size_t *sizes, uint32_t max)
+{
+	if (max == 0 || !queue_pop(ctx, timeout, false, &buffers[0], &sizes[0]))
+		return 0;
+
+	// Everything already published past the first buffer is taken without waiting,
+	// a skipped empty push ends the batch
+	int64_t pos = MTY_Atomic64Get(&ctx->pop_pos);
+	uint32_t n = 1;
+
+	for (; n < max && n < ctx->len && queue_ready(ctx, pos + n); n++) {
+		struct queue_slot *slot = queue_slot(ctx, pos + n);
+
+		if (slot->skip)
+			break;
 
-	ctx->pop_pos = queue_next_pos(ctx, ctx->pop_pos);
+		buffers[n] = slot->data;
+		sizes[n] = slot->size;
+	}
+
+	return n;
+}
 
-	MTY_Atomic32Set(&ctx->slots[lock_pos].state, QUEUE_EMPTY);
+void MTY_QueuePopBatch(MTY_Queue *ctx, uint32_t count)
+{
+	for (uint32_t x = 0; x < count; x++)
+		queue_release(ctx);
 }
 
 bool MTY_QueuePushPtr(MTY_Queue *ctx, void *opaque, size_t size)
 {
-	void *buffer = MTY_QueueGetInputBuffer(ctx);
+	void *buffer = queue_reserve(ctx, sizeof(void *));
 
 	if (buffer) {
 		memcpy(buffer, &opaque, sizeof(void *));
@@ -206,7 +516,7 @@ bool MTY_QueuePopPtr(MTY_Queue *ctx, int32_t timeout, void **opaque, size_t *siz
 void MTY_QueueFlush(MTY_Queue *ctx, MTY_FreeFunc freeFunc)
 {
 	for (void *data = NULL; queue_pop(ctx, 0, false, (void **) &data, NULL);) {
-		struct queue_slot *slot = &ctx->slots[ctx->pop_pos];
+		struct queue_slot *slot = queue_slot(ctx, MTY_Atomic64Get(&ctx->pop_pos));
 
 		if (freeFunc && slot->ptr) {
 			void *ptr = NULL;
@@ -340,7 +340,7 @@ struct webview *mty_webview_create(MTY_App *app, MTY_Window window, const char *
 
 	steam_global_init(dir ? dir : ".");
 
-	ctx->pushq = MTY_QueueCreate(50, 0);
+	ctx->pushq = MTY_QueueCreate(50, 0, MTY_QUEUE_FLAG_NONE);
 
 	bool r = SteamAPI_InitSafe();
 	if (!r) {
@@ -2,56 +2,207 @@
 // If a copy of the MIT License was not distributed with this file,
 // You can obtain one at https://spdx.org/licenses/MIT.html.
 
-#define _DEFAULT_SOURCE // pthread_rwlock_t
+#define _DEFAULT_SOURCE // syscall
 
 #include "matoya.h"
 
 #include <string.h>
 
-#include "rwlock.h"
+#include "atomicwait.h"
 #include "tlocal.h"
 
 
 // RWLock
 
+// The lock word holds the reader count and a writer bit. Waiters sleep on `seq`, which
+// is bumped by every release that could let them through, so a wait can never miss a
+// state change that happened after the waiter looked
+
+#define RWLOCK_WRITER   0x40000000
+#define RWLOCK_MAX_HELD 64
+#define RWLOCK_SHARDS   16
+
+struct rwlock_shard {
+	MTY_Atomic32 readers;
+	uint8_t pad[60];
+};
+
+struct MTY_RWLock {
+	MTY_Atomic32 state;
+	MTY_Atomic32 writers;
+	MTY_Atomic32 waiters;
+	MTY_Atomic32 seq;
+
+	// Big reader mode: readers only touch the counter of their own shard, writers
+	// wait for all of them to drain
+	struct rwlock_shard *shards;
+};
+
+// Only the locks a thread currently holds are tracked, so lookups scan a handful of
+// entries regardless of how many locks exist
+
 static TLOCAL struct thread_rwlock {
+	MTY_RWLock *lock;
 	uint16_t taken;
 	bool read;
 	bool write;
-} RWLOCK_STATE[UINT8_MAX];
+} RWLOCK_HELD[RWLOCK_MAX_HELD];
 
-struct MTY_RWLock {
-	mty_rwlock rwlock;
-	MTY_Atomic32 yield;
-	uint8_t index;
-};
+static TLOCAL uint32_t RWLOCK_NUM_HELD;
+static TLOCAL int32_t RWLOCK_SHARD = -1;
+static MTY_Atomic32 RWLOCK_NEXT_SHARD;
+
+static struct thread_rwlock *thread_rwlock_held(MTY_RWLock *ctx)
+{
+	for (uint32_t x = 0; x < RWLOCK_NUM_HELD; x++)
+		if (RWLOCK_HELD[x].lock == ctx)
+			return &RWLOCK_HELD[x];
+
+	if (RWLOCK_NUM_HELD == RWLOCK_MAX_HELD)
+		MTY_LogFatal("Too many rwlocks held by one thread, maximum is %u", RWLOCK_MAX_HELD);
+
+	struct thread_rwlock *rw = &RWLOCK_HELD[RWLOCK_NUM_HELD++];
+	memset(rw, 0, sizeof(struct thread_rwlock));
+	rw->lock = ctx;
+
+	return rw;
+}
 
-static MTY_Atomic32 RWLOCK_INIT[UINT8_MAX];
+static void thread_rwlock_release_held(struct thread_rwlock *rw)
+{
+	*rw = RWLOCK_HELD[--RWLOCK_NUM_HELD];
+}
 
-static uint8_t thread_rwlock_index(void)
+static struct rwlock_shard *thread_rwlock_shard(MTY_RWLock *ctx)
 {
-	for (uint8_t x = 0; x < UINT8_MAX; x++)
-		if (MTY_Atomic32CAS(&RWLOCK_INIT[x], 0, 1))
-			return x;
+	if (RWLOCK_SHARD < 0)
+		RWLOCK_SHARD = MTY_Atomic32Add(&RWLOCK_NEXT_SHARD, 1) % RWLOCK_SHARDS;
 
-	MTY_LogFatal("Could not find a free rwlock slot, maximum is %u", UINT8_MAX);
+	return &ctx->shards[RWLOCK_SHARD];
+}
 
-	return 0;
+static void thread_rwlock_wait(MTY_RWLock *ctx, int32_t seq)
+{
+	MTY_Atomic32Add(&ctx->waiters, 1);
+	mty_futex_wait(&ctx->seq, seq, -1);
+	MTY_Atomic32Add(&ctx->waiters, -1);
 }
 
-static void thread_rwlock_yield(MTY_RWLock *ctx)
+static void thread_rwlock_wake(MTY_RWLock *ctx)
 {
-	// Ensure that readers will yield to writers in a tight loop
-	while (MTY_Atomic32Get(&ctx->yield) > 0)
-		MTY_Sleep(0);
+	MTY_Atomic32Add(&ctx->seq, 1);
+
+	if (MTY_Atomic32Get(&ctx->waiters) > 0)
+		mty_futex_wake(&ctx->seq, true);
+}
+
+static bool thread_rwlock_writer_active(MTY_RWLock *ctx)
+{
+	return MTY_Atomic32Get(&ctx->writers) > 0 || (MTY_Atomic32Get(&ctx->state) & RWLOCK_WRITER);
+}
+
+static bool thread_rwlock_try_reader(MTY_RWLock *ctx)
+{
+	// Writer preference: new readers stay out while any writer is waiting
+	if (ctx->shards) {
+		if (thread_rwlock_writer_active(ctx))
+			return false;
+
+		struct rwlock_shard *shard = thread_rwlock_shard(ctx);
+		MTY_Atomic32Add(&shard->readers, 1);
+
+		// A writer increments `writers` before checking the shards, so either it sees
+		// this reader or this reader sees it
+		if (!thread_rwlock_writer_active(ctx))
+			return true;
+
+		MTY_Atomic32Add(&shard->readers, -1);
+		thread_rwlock_wake(ctx);
+
+		return false;
+	}
+
+	for (int32_t state = MTY_Atomic32Get(&ctx->state); !(state & RWLOCK_WRITER);
+		state = MTY_Atomic32Get(&ctx->state))
+	{
+		if (MTY_Atomic32Get(&ctx->writers) > 0)
+			return false;
+
+		if (MTY_Atomic32CAS(&ctx->state, state, state + 1))
+			return true;
+	}
+
+	return false;
+}
+
+static void thread_rwlock_reader(MTY_RWLock *ctx)
+{
+	for (int32_t seq = MTY_Atomic32Get(&ctx->seq); !thread_rwlock_try_reader(ctx);
+		seq = MTY_Atomic32Get(&ctx->seq))
+	{
+		thread_rwlock_wait(ctx, seq);
+	}
+}
+
+static void thread_rwlock_unlock_reader(MTY_RWLock *ctx)
+{
+	if (ctx->shards) {
+		MTY_Atomic32Add(&thread_rwlock_shard(ctx)->readers, -1);
+
+		if (MTY_Atomic32Get(&ctx->writers) > 0)
+			thread_rwlock_wake(ctx);
+
+	} else if (MTY_Atomic32Add(&ctx->state, -1) == 0) {
+		thread_rwlock_wake(ctx);
+	}
+}
+
+static bool thread_rwlock_drained(MTY_RWLock *ctx)
+{
+	for (uint32_t x = 0; x < RWLOCK_SHARDS; x++)
+		if (MTY_Atomic32Get(&ctx->shards[x].readers) > 0)
+			return false;
+
+	return true;
+}
+
+static void thread_rwlock_writer(MTY_RWLock *ctx)
+{
+	MTY_Atomic32Add(&ctx->writers, 1);
+
+	for (int32_t seq = MTY_Atomic32Get(&ctx->seq); !MTY_Atomic32CAS(&ctx->state, 0, RWLOCK_WRITER);
+		seq = MTY_Atomic32Get(&ctx->seq))
+	{
+		thread_rwlock_wait(ctx, seq);
+	}
+
+	if (ctx->shards) {
+		for (int32_t seq = MTY_Atomic32Get(&ctx->seq); !thread_rwlock_drained(ctx);
+			seq = MTY_Atomic32Get(&ctx->seq))
+		{
+			thread_rwlock_wait(ctx, seq);
+		}
+	}
+
+	MTY_Atomic32Add(&ctx->writers, -1);
+}
+
+static void thread_rwlock_unlock_writer(MTY_RWLock *ctx)
+{
+	MTY_Atomic32Set(&ctx->state, 0);
+	thread_rwlock_wake(ctx);
 }
 
 MTY_RWLock *MTY_RWLockCreate(void)
 {
-	MTY_RWLock *ctx = MTY_Alloc(1, sizeof(MTY_RWLock));
-	ctx->index = thread_rwlock_index();
+	return MTY_Alloc(1, sizeof(MTY_RWLock));
+}
 
-	mty_rwlock_create(&ctx->rwlock);
+MTY_RWLock *MTY_RWLockCreateSharded(void)
+{
+	MTY_RWLock *ctx = MTY_RWLockCreate();
+	ctx->shards = MTY_AllocAligned(RWLOCK_SHARDS * sizeof(struct rwlock_shard), 64);
+	memset(ctx->shards, 0, RWLOCK_SHARDS * sizeof(struct rwlock_shard));
 
 	return ctx;
 }
@@ -63,9 +214,7 @@ void MTY_RWLockDestroy(MTY_RWLock **rwlock)
 
 	MTY_RWLock *ctx = *rwlock;
 
-	mty_rwlock_destroy(&ctx->rwlock);
-	memset(&RWLOCK_STATE[ctx->index], 0, sizeof(struct thread_rwlock));
-	MTY_Atomic32Set(&RWLOCK_INIT[ctx->index], 0);
+	MTY_FreeAligned(ctx->shards);
 
 	MTY_Free(ctx);
 	*rwlock = NULL;
@@ -73,29 +222,31 @@ void MTY_RWLockDestroy(MTY_RWLock **rwlock)
 
 bool MTY_RWTryLockReader(MTY_RWLock *ctx)
 {
-	struct thread_rwlock *rw = &RWLOCK_STATE[ctx->index];
+	struct thread_rwlock *rw = thread_rwlock_held(ctx);
 
 	bool r = true;
 
 	if (rw->taken == 0) {
-		thread_rwlock_yield(ctx);
-		r = mty_rwlock_try_reader(&ctx->rwlock);
+		r = thread_rwlock_try_reader(ctx);
 		rw->read = true;
 	}
 
-	if (r)
+	if (r) {
 		rw->taken++;
 
+	} else {
+		thread_rwlock_release_held(rw);
+	}
+
 	return r;
 }
 
 void MTY_RWLockReader(MTY_RWLock *ctx)
 {
-	struct thread_rwlock *rw = &RWLOCK_STATE[ctx->index];
+	struct thread_rwlock *rw = thread_rwlock_held(ctx);
 
 	if (rw->taken == 0) {
-		thread_rwlock_yield(ctx);
-		mty_rwlock_reader(&ctx->rwlock);
+		thread_rwlock_reader(ctx);
 		rw->read = true;
 	}
 
@@ -105,18 +256,16 @@ void MTY_RWLockReader(MTY_RWLock *ctx)
 void MTY_RWLockWriter(MTY_RWLock *ctx)
 {
 	bool relock = false;
-	struct thread_rwlock *rw = &RWLOCK_STATE[ctx->index];
+	struct thread_rwlock *rw = thread_rwlock_held(ctx);
 
 	if (rw->read) {
-		mty_rwlock_unlock_reader(&ctx->rwlock);
+		thread_rwlock_unlock_reader(ctx);
 		rw->read = false;
 		relock = true;
 	}
 
 	if (rw->taken == 0 || relock) {
-		MTY_Atomic32Add(&ctx->yield, 1);
-		mty_rwlock_writer(&ctx->rwlock);
-		MTY_Atomic32Add(&ctx->yield, -1);
+		thread_rwlock_writer(ctx);
 		rw->write = true;
 	}
 
@@ -125,37 +274,34 @@ void MTY_RWLockWriter(MTY_RWLock *ctx)
 
 void MTY_RWLockUnlock(MTY_RWLock *ctx)
 {
-	struct thread_rwlock *rw = &RWLOCK_STATE[ctx->index];
+	struct thread_rwlock *rw = thread_rwlock_held(ctx);
 
 	if (--rw->taken == 0) {
 		if (rw->read) {
-			mty_rwlock_unlock_reader(&ctx->rwlock);
-			rw->read = false;
+			thread_rwlock_unlock_reader(ctx);
 
 		} else if (rw->write) {
-			mty_rwlock_unlock_writer(&ctx->rwlock);
-			rw->write = false;
+			thread_rwlock_unlock_writer(ctx);
 		}
+
+		thread_rwlock_release_held(rw);
 	}
 }
 
 
 // Waitable
 
+// The state word is the only thing touched on the fast paths: signaling with no
+// waiters is a single CAS, and a pending signal is consumed with a single CAS
+
 struct MTY_Waitable {
-	bool signal;
-	MTY_Mutex *mutex;
-	MTY_Cond *cond;
+	MTY_Atomic32 signal;
+	MTY_Atomic32 waiters;
 };
 
 MTY_Waitable *MTY_WaitableCreate(void)
 {
-	MTY_Waitable *ctx = MTY_Alloc(1, sizeof(struct MTY_Waitable));
-
-	ctx->mutex = MTY_MutexCreate();
-	ctx->cond = MTY_CondCreate();
-
-	return ctx;
+	return MTY_Alloc(1, sizeof(struct MTY_Waitable));
 }
 
 void MTY_WaitableDestroy(MTY_Waitable **waitable)
@@ -165,68 +311,150 @@ void MTY_WaitableDestroy(MTY_Waitable **waitable)
 
 	MTY_Waitable *ctx = *waitable;
 
-	MTY_CondDestroy(&ctx->cond);
-	MTY_MutexDestroy(&ctx->mutex);
-
 	MTY_Free(ctx);
 	*waitable = NULL;
 }
 
 bool MTY_WaitableWait(MTY_Waitable *ctx, int32_t timeout)
 {
-	MTY_MutexLock(ctx->mutex);
+	if (MTY_Atomic32CAS(&ctx->signal, 1, 0))
+		return true;
 
-	if (!ctx->signal)
-		MTY_CondWait(ctx->cond, ctx->mutex, timeout);
+	if (timeout == 0)
+		return false;
 
-	bool signal = ctx->signal;
-	ctx->signal = false;
+	// The waiter count must be visible before the final check of the signal, so a
+	// concurrent MTY_WaitableSignal either sees it and wakes, or is seen here
+	MTY_Atomic32Add(&ctx->waiters, 1);
 
-	MTY_MutexUnlock(ctx->mutex);
+	MTY_Time ts = MTY_GetTime();
+	int32_t remaining = timeout;
+	bool r = false;
 
-	return signal;
-}
+	while (!(r = MTY_Atomic32CAS(&ctx->signal, 1, 0))) {
+		if (!mty_futex_wait(&ctx->signal, 0, remaining) && timeout >= 0)
+			break;
 
-void MTY_WaitableSignal(MTY_Waitable *ctx)
-{
-	MTY_MutexLock(ctx->mutex);
+		// Another waiter may have consumed the signal, keep waiting for the rest of
+		// the timeout
+		if (timeout >= 0) {
+			remaining = timeout - (int32_t) MTY_TimeDiff(ts, MTY_GetTime());
 
-	if (!ctx->signal) {
-		ctx->signal = true;
-		MTY_CondSignal(ctx->cond);
+			if (remaining <= 0)
+				break;
+		}
 	}
 
-	MTY_MutexUnlock(ctx->mutex);
+	if (!r)
+		r = MTY_Atomic32CAS(&ctx->signal, 1, 0);
+
+	MTY_Atomic32Add(&ctx->waiters, -1);
+
+	return r;
+}
+
+void MTY_WaitableSignal(MTY_Waitable *ctx)
+{
+	if (MTY_Atomic32CAS(&ctx->signal, 0, 1) && MTY_Atomic32Get(&ctx->waiters) > 0)
+		mty_futex_wake(&ctx->signal, false);
 }
 
 
 // ThreadPool
 
-struct thread_info {
+#define THREAD_POOL_MIN 8
+
+struct thread_task {
 	MTY_Async status;
 	MTY_AnonFunc func;
 	MTY_AnonFunc detach;
 	void *opaque;
-	MTY_Thread *t;
-	MTY_Mutex *m;
+	bool detached;
 };
 
 struct MTY_ThreadPool {
-	uint32_t num;
-	struct thread_info *ti;
+	MTY_Mutex *m;
+	MTY_Cond *c;
+	bool stop;
+
+	uint32_t max_threads;
+	uint32_t num_threads;
+	uint32_t num_idle;
+	MTY_Thread **threads;
+
+	// Index 0 is never handed out so it can signal failure
+	uint32_t num_tasks;
+	uint32_t num_free;
+	uint32_t *free;
+	struct thread_task *tasks;
+
+	// FIFO ring of task indexes waiting for a worker
+	uint32_t *queue;
+	uint32_t queue_size;
+	uint32_t queue_head;
+	uint32_t queue_len;
 };
 
+static void *thread_pool_worker(void *opaque)
+{
+	MTY_ThreadPool *ctx = opaque;
+
+	MTY_MutexLock(ctx->m);
+
+	while (true) {
+		while (ctx->queue_len == 0 && !ctx->stop) {
+			ctx->num_idle++;
+			MTY_CondWait(ctx->c, ctx->m, -1);
+			ctx->num_idle--;
+		}
+
+		// Pending tasks are drained before honoring a stop request
+		if (ctx->queue_len == 0)
+			break;
+
+		uint32_t index = ctx->queue[ctx->queue_head];
+		ctx->queue_head = (ctx->queue_head + 1) % ctx->queue_size;
+		ctx->queue_len--;
+
+		MTY_AnonFunc func = ctx->tasks[index].func;
+		void *task_opaque = ctx->tasks[index].opaque;
+
+		MTY_MutexUnlock(ctx->m);
+		func(task_opaque);
+		MTY_MutexLock(ctx->m);
+
+		// The task array may have been reallocated while unlocked
+		MTY_AnonFunc detach = ctx->tasks[index].detach;
+
+		if (ctx->tasks[index].detached) {
+			if (detach) {
+				MTY_MutexUnlock(ctx->m);
+				detach(task_opaque);
+				MTY_MutexLock(ctx->m);
+			}
+
+			ctx->tasks[index].status = MTY_ASYNC_DONE;
+			ctx->free[ctx->num_free++] = index;
+
+		} else {
+			ctx->tasks[index].status = MTY_ASYNC_OK;
+		}
+	}
+
+	MTY_MutexUnlock(ctx->m);
+
+	return NULL;
+}
+
 MTY_ThreadPool *MTY_ThreadPoolCreate(uint32_t maxThreads)
 {
 	MTY_ThreadPool *ctx = MTY_Alloc(1, sizeof(MTY_ThreadPool));
 
-	ctx->num = maxThreads + 1;
-	ctx->ti = MTY_Alloc(ctx->num, sizeof(struct thread_info));
+	ctx->m = MTY_MutexCreate();
+	ctx->c = MTY_CondCreate();
 
-	for (uint32_t x = 0; x < ctx->num; x++) {
-		ctx->ti[x].status = MTY_ASYNC_DONE;
-		ctx->ti[x].m = MTY_MutexCreate();
-	}
+	ctx->max_threads = maxThreads > 0 ? maxThreads : 1;
+	ctx->threads = MTY_Alloc(ctx->max_threads, sizeof(MTY_Thread *));
 
 	return ctx;
 }
@@ -238,135 +466,473 @@ void MTY_ThreadPoolDestroy(MTY_ThreadPool **pool, MTY_AnonFunc detach)
 
 	MTY_ThreadPool *ctx = *pool;
 
-	for (uint32_t x = 0; x < ctx->num; x++) {
+	for (uint32_t x = 1; x < ctx->num_tasks; x++)
 		MTY_ThreadPoolDetach(ctx, x, detach);
 
-		if (ctx->ti[x].t)
-			MTY_ThreadDestroy(&ctx->ti[x].t);
+	MTY_MutexLock(ctx->m);
+	ctx->stop = true;
+	MTY_CondSignalAll(ctx->c);
+	MTY_MutexUnlock(ctx->m);
 
-		MTY_MutexDestroy(&ctx->ti[x].m);
-	}
+	for (uint32_t x = 0; x < ctx->num_threads; x++)
+		MTY_ThreadDestroy(&ctx->threads[x]);
+
+	MTY_CondDestroy(&ctx->c);
+	MTY_MutexDestroy(&ctx->m);
+
+	MTY_Free(ctx->threads);
+	MTY_Free(ctx->tasks);
+	MTY_Free(ctx->free);
+	MTY_Free(ctx->queue);
 
-	MTY_Free(ctx->ti);
 	MTY_Free(ctx);
 	*pool = NULL;
 }
 
-static void *thread_pool_func(void *opaque)
+static uint32_t thread_pool_slot(MTY_ThreadPool *ctx)
 {
-	struct thread_info *ti = (struct thread_info *) opaque;
+	if (ctx->num_free == 0) {
+		uint32_t first = ctx->num_tasks > 0 ? ctx->num_tasks : 1;
+
+		ctx->num_tasks = ctx->num_tasks > 0 ? ctx->num_tasks * 2 : THREAD_POOL_MIN;
+		ctx->tasks = MTY_Realloc(ctx->tasks, ctx->num_tasks, sizeof(struct thread_task));
+		ctx->free = MTY_Realloc(ctx->free, ctx->num_tasks, sizeof(uint32_t));
+
+		// Push in reverse so the lowest indexes are handed out first
+		for (uint32_t x = ctx->num_tasks - 1; x >= first; x--) {
+			memset(&ctx->tasks[x], 0, sizeof(struct thread_task));
+			ctx->tasks[x].status = MTY_ASYNC_DONE;
+			ctx->free[ctx->num_free++] = x;
+		}
+	}
+
+	return ctx->free[--ctx->num_free];
+}
 
-	ti->func(ti->opaque);
+static void thread_pool_enqueue(MTY_ThreadPool *ctx, uint32_t index)
+{
+	if (ctx->queue_len == ctx->queue_size) {
+		uint32_t size = ctx->queue_size > 0 ? ctx->queue_size * 2 : THREAD_POOL_MIN;
+		uint32_t *queue = MTY_Alloc(size, sizeof(uint32_t));
+
+		for (uint32_t x = 0; x < ctx->queue_len; x++)
+			queue[x] = ctx->queue[(ctx->queue_head + x) % ctx->queue_size];
+
+		MTY_Free(ctx->queue);
+		ctx->queue = queue;
+		ctx->queue_size = size;
+		ctx->queue_head = 0;
+	}
 
-	MTY_MutexLock(ti->m);
+	ctx->queue[(ctx->queue_head + ctx->queue_len++) % ctx->queue_size] = index;
 
-	if (ti->detach) {
-		ti->detach(ti->opaque);
-		ti->status = MTY_ASYNC_DONE;
+	// Spawn a new worker only when the queue outnumbers the idle workers
+	if (ctx->queue_len > ctx->num_idle && ctx->num_threads < ctx->max_threads) {
+		ctx->threads[ctx->num_threads++] = MTY_ThreadCreate(thread_pool_worker, ctx);
 
 	} else {
-		ti->status = MTY_ASYNC_OK;
+		MTY_CondSignal(ctx->c);
 	}
+}
+
+static uint32_t thread_pool_dispatch(MTY_ThreadPool *ctx, MTY_AnonFunc func, void *opaque, bool detached)
+{
+	MTY_MutexLock(ctx->m);
 
-	MTY_MutexUnlock(ti->m);
+	uint32_t index = thread_pool_slot(ctx);
 
-	return NULL;
+	struct thread_task *task = &ctx->tasks[index];
+	task->func = func;
+	task->opaque = opaque;
+	task->detach = NULL;
+	task->detached = detached;
+	task->status = MTY_ASYNC_CONTINUE;
+
+	thread_pool_enqueue(ctx, index);
+
+	MTY_MutexUnlock(ctx->m);
+
+	return index;
 }
 
 uint32_t MTY_ThreadPoolDispatch(MTY_ThreadPool *ctx, MTY_AnonFunc func, void *opaque)
 {
-	uint32_t index = 0;
+	return thread_pool_dispatch(ctx, func, opaque, false);
+}
+
+void MTY_ThreadPoolDetach(MTY_ThreadPool *ctx, uint32_t index, MTY_AnonFunc detach)
+{
+	MTY_MutexLock(ctx->m);
 
-	for (uint32_t x = 1; x < ctx->num && index == 0; x++) {
-		struct thread_info *ti = &ctx->ti[x];
+	if (index > 0 && index < ctx->num_tasks) {
+		struct thread_task *task = &ctx->tasks[index];
 
-		MTY_MutexLock(ti->m);
+		if (task->status == MTY_ASYNC_CONTINUE) {
+			if (!task->detached) {
+				task->detach = detach;
+				task->detached = true;
+			}
 
-		if (ti->status == MTY_ASYNC_DONE) {
-			MTY_ThreadDestroy(&ti->t);
+		} else if (task->status == MTY_ASYNC_OK) {
+			if (detach)
+				detach(task->opaque);
 
-			ti->func = func;
-			ti->opaque = opaque;
-			ti->detach = NULL;
-			ti->status = MTY_ASYNC_CONTINUE;
-			ti->t = MTY_ThreadCreate(thread_pool_func, ti);
-			index = x;
+			task->status = MTY_ASYNC_DONE;
+			ctx->free[ctx->num_free++] = index;
 		}
+	}
+
+	MTY_MutexUnlock(ctx->m);
+}
 
-		MTY_MutexUnlock(ti->m);
+MTY_Async MTY_ThreadPoolPoll(MTY_ThreadPool *ctx, uint32_t index, void **opaque)
+{
+	MTY_Async status = MTY_ASYNC_DONE;
+	*opaque = NULL;
+
+	MTY_MutexLock(ctx->m);
+
+	if (index > 0 && index < ctx->num_tasks) {
+		status = ctx->tasks[index].status;
+		*opaque = ctx->tasks[index].opaque;
 	}
 
-	if (index == 0)
-		MTY_Log("Could not find available index");
+	MTY_MutexUnlock(ctx->m);
 
-	return index;
+	return status;
 }
 
-void MTY_ThreadPoolDetach(MTY_ThreadPool *ctx, uint32_t index, MTY_AnonFunc detach)
+
+// ParallelFor
+
+// Each participant owns a range of chunks packed into a single atomic as
+// (begin << 32 | end). The owner takes chunks from the front while idle
+// participants steal half of the remaining chunks from the back.
+
+#define THREAD_RANGE(begin, end) ((int64_t) ((uint64_t) (begin) << 32 | (uint32_t) (end)))
+#define THREAD_RANGE_BEGIN(r)    ((uint32_t) ((uint64_t) (r) >> 32))
+#define THREAD_RANGE_END(r)      ((uint32_t) (r))
+
+struct thread_for {
+	MTY_RangeFunc func;
+	void *opaque;
+	size_t len;
+	size_t grain;
+
+	uint32_t num_chunks;
+	uint32_t num_ranges;
+	MTY_Atomic32 next_id;
+	MTY_Atomic32 refs;
+	MTY_Atomic32 done;
+	MTY_Waitable *w;
+	MTY_Atomic64 ranges[1];
+};
+
+static bool thread_for_take(struct thread_for *pf, uint32_t id, uint32_t *chunk)
+{
+	MTY_Atomic64 *own = &pf->ranges[id];
+
+	while (true) {
+		int64_t r = MTY_Atomic64Get(own);
+		uint32_t begin = THREAD_RANGE_BEGIN(r);
+		uint32_t end = THREAD_RANGE_END(r);
+
+		if (begin >= end)
+			return false;
+
+		if (MTY_Atomic64CAS(own, r, THREAD_RANGE(begin + 1, end))) {
+			*chunk = begin;
+			return true;
+		}
+	}
+}
+
+static bool thread_for_steal(struct thread_for *pf, uint32_t id)
 {
-	struct thread_info *ti = &ctx->ti[index];
+	for (uint32_t x = 1; x < pf->num_ranges; x++) {
+		MTY_Atomic64 *victim = &pf->ranges[(id + x) % pf->num_ranges];
 
-	MTY_MutexLock(ti->m);
+		while (true) {
+			int64_t r = MTY_Atomic64Get(victim);
+			uint32_t begin = THREAD_RANGE_BEGIN(r);
+			uint32_t end = THREAD_RANGE_END(r);
 
-	if (ti->status == MTY_ASYNC_CONTINUE) {
-		ti->detach = detach;
+			if (begin >= end)
+				break;
 
-	} else if (ti->status == MTY_ASYNC_OK) {
-		if (detach)
-			detach(ti->opaque);
+			uint32_t mid = end - (end - begin + 1) / 2;
 
-		ti->status = MTY_ASYNC_DONE;
+			if (MTY_Atomic64CAS(victim, r, THREAD_RANGE(begin, mid))) {
+				// Only the owner refills its own empty range, so a plain store is safe
+				MTY_Atomic64Set(&pf->ranges[id], THREAD_RANGE(mid, end));
+				return true;
+			}
+		}
 	}
 
-	MTY_MutexUnlock(ti->m);
+	return false;
 }
 
-MTY_Async MTY_ThreadPoolPoll(MTY_ThreadPool *ctx, uint32_t index, void **opaque)
+static void thread_for_release(struct thread_for *pf)
 {
-	struct thread_info *ti = &ctx->ti[index];
+	if (MTY_Atomic32Add(&pf->refs, -1) == 0) {
+		MTY_WaitableDestroy(&pf->w);
+		MTY_Free(pf);
+	}
+}
 
-	MTY_MutexLock(ti->m);
+static void thread_for_run(struct thread_for *pf, uint32_t id)
+{
+	uint32_t chunk = 0;
+	int32_t done = 0;
 
-	MTY_Async status = ti->status;
-	*opaque = ti->opaque;
+	do {
+		while (thread_for_take(pf, id, &chunk)) {
+			size_t begin = (size_t) chunk * pf->grain;
+			size_t end = begin + pf->grain < pf->len ? begin + pf->grain : pf->len;
 
-	MTY_MutexUnlock(ti->m);
+			pf->func(begin, end, pf->opaque);
+			done++;
+		}
+	} while (thread_for_steal(pf, id));
 
-	return status;
+	if (done > 0 && MTY_Atomic32Add(&pf->done, done) == (int32_t) pf->num_chunks)
+		MTY_WaitableSignal(pf->w);
 }
 
+static void thread_for_helper(void *opaque)
+{
+	struct thread_for *pf = opaque;
 
-// Global locks
+	thread_for_run(pf, MTY_Atomic32Add(&pf->next_id, 1));
+	thread_for_release(pf);
+}
 
-static MTY_Atomic32 THREAD_GINDEX = {1};
-static mty_rwlock THREAD_GLOCKS[UINT8_MAX];
+void MTY_ParallelFor(MTY_ThreadPool *ctx, size_t len, size_t grain, MTY_RangeFunc func, void *opaque)
+{
+	if (len == 0)
+		return;
 
-void MTY_GlobalLock(MTY_Atomic32 *lock)
+	if (grain == 0)
+		grain = 1;
+
+	while ((len + grain - 1) / grain > INT32_MAX)
+		grain *= 2;
+
+	uint32_t num_chunks = (uint32_t) ((len + grain - 1) / grain);
+	uint32_t num_ranges = ctx->max_threads + 1 < num_chunks ? ctx->max_threads + 1 : num_chunks;
+
+	// Not enough work to be worth waking another thread
+	if (num_ranges == 1) {
+		func(0, len, opaque);
+		return;
+	}
+
+	struct thread_for *pf = MTY_Alloc(1, sizeof(struct thread_for) + (num_ranges - 1) * sizeof(MTY_Atomic64));
+	pf->func = func;
+	pf->opaque = opaque;
+	pf->len = len;
+	pf->grain = grain;
+	pf->num_chunks = num_chunks;
+	pf->num_ranges = num_ranges;
+	pf->w = MTY_WaitableCreate();
+
+	for (uint32_t x = 0; x < num_ranges; x++) {
+		uint64_t begin = (uint64_t) num_chunks * x / num_ranges;
+		uint64_t end = (uint64_t) num_chunks * (x + 1) / num_ranges;
+
+		MTY_Atomic64Set(&pf->ranges[x], THREAD_RANGE(begin, end));
+	}
+
+	// The shared state is reference counted since helpers may start after the work is done
+	MTY_Atomic32Set(&pf->refs, num_ranges);
+
+	for (uint32_t x = 1; x < num_ranges; x++)
+		thread_pool_dispatch(ctx, thread_for_helper, pf, true);
+
+	// The calling thread participates, so nested calls from inside the pool make progress
+	thread_for_run(pf, 0);
+
+	while (MTY_Atomic32Get(&pf->done) < (int32_t) num_chunks)
+		MTY_WaitableWait(pf->w, -1);
+
+	thread_for_release(pf);
+}
+
+
+// TaskGraph
+
+struct thread_node {
+	MTY_AnonFunc func;
+	void *opaque;
+	uint32_t num_deps;
+	uint32_t num_succ;
+	uint32_t *succ;
+	MTY_Atomic32 pending;
+};
+
+struct thread_graph_job {
+	MTY_TaskGraph *graph;
+	uint32_t node;
+};
+
+struct MTY_TaskGraph {
+	MTY_ThreadPool *pool;
+	uint32_t num_nodes;
+	struct thread_node *nodes;
+	struct thread_graph_job *jobs;
+
+	MTY_Atomic32 remaining;
+	MTY_Atomic32 finished;
+	MTY_Waitable *w;
+};
+
+MTY_TaskGraph *MTY_TaskGraphCreate(MTY_ThreadPool *pool)
+{
+	MTY_TaskGraph *ctx = MTY_Alloc(1, sizeof(MTY_TaskGraph));
+	ctx->pool = pool;
+	ctx->w = MTY_WaitableCreate();
+
+	return ctx;
+}
+
+void MTY_TaskGraphDestroy(MTY_TaskGraph **graph)
+{
+	if (!graph || !*graph)
+		return;
+
+	MTY_TaskGraph *ctx = *graph;
+
+	for (uint32_t x = 0; x < ctx->num_nodes; x++)
+		MTY_Free(ctx->nodes[x].succ);
+
+	MTY_WaitableDestroy(&ctx->w);
+
+	MTY_Free(ctx->nodes);
+	MTY_Free(ctx->jobs);
+
+	MTY_Free(ctx);
+	*graph = NULL;
+}
+
+uint32_t MTY_TaskGraphAdd(MTY_TaskGraph *ctx, MTY_AnonFunc func, void *opaque, const uint32_t *deps,
+	uint32_t numDeps)
+{
+	uint32_t id = ctx->num_nodes++;
+
+	ctx->nodes = MTY_Realloc(ctx->nodes, ctx->num_nodes, sizeof(struct thread_node));
+	ctx->jobs = MTY_Realloc(ctx->jobs, ctx->num_nodes, sizeof(struct thread_graph_job));
+
+	struct thread_node *node = &ctx->nodes[id];
+	memset(node, 0, sizeof(struct thread_node));
+	node->func = func;
+	node->opaque = opaque;
+
+	// Dependencies must already be in the graph, so cycles are impossible
+	for (uint32_t x = 0; x < numDeps; x++) {
+		if (deps[x] >= id) {
+			MTY_Log("Task %u depends on task %u which has not been added", id, deps[x]);
+			continue;
+		}
+
+		struct thread_node *dep = &ctx->nodes[deps[x]];
+		dep->succ = MTY_Realloc(dep->succ, dep->num_succ + 1, sizeof(uint32_t));
+		dep->succ[dep->num_succ++] = id;
+		node->num_deps++;
+	}
+
+	return id;
+}
+
+static void thread_graph_job(void *opaque)
 {
-	entry: {
-		uint32_t index = MTY_Atomic32Get(lock);
+	struct thread_graph_job *job = opaque;
+	MTY_TaskGraph *ctx = job->graph;
 
-		// 0 means uninitialized, 1 means currently initializing
-		if (index < 2) {
-			if (MTY_Atomic32CAS(lock, 0, 1)) {
-				index = MTY_Atomic32Add(&THREAD_GINDEX, 1);
-				if (index >= UINT8_MAX)
-					MTY_LogFatal("Global lock index of %u exceeded", UINT8_MAX);
+	for (uint32_t id = job->node; id != UINT32_MAX;) {
+		struct thread_node *node = &ctx->nodes[id];
+		node->func(node->opaque);
 
-				mty_rwlock_create(&THREAD_GLOCKS[index]);
-				MTY_Atomic32Set(lock, index);
+		// Continue inline with the first successor that becomes ready, dispatch the rest
+		uint32_t next = UINT32_MAX;
 
-			} else {
-				MTY_Sleep(0);
-				goto entry;
+		for (uint32_t x = 0; x < node->num_succ; x++) {
+			uint32_t s = node->succ[x];
+
+			if (MTY_Atomic32Add(&ctx->nodes[s].pending, -1) == 0) {
+				if (next == UINT32_MAX) {
+					next = s;
+
+				} else {
+					thread_pool_dispatch(ctx->pool, thread_graph_job, &ctx->jobs[s], true);
+				}
 			}
 		}
 
-		mty_rwlock_writer(&THREAD_GLOCKS[index]);
+		if (MTY_Atomic32Add(&ctx->remaining, -1) == 0) {
+			// The graph may be destroyed as soon as 'finished' is set
+			MTY_WaitableSignal(ctx->w);
+			MTY_Atomic32Set(&ctx->finished, 1);
+		}
+
+		id = next;
+	}
+}
+
+void MTY_TaskGraphRun(MTY_TaskGraph *ctx)
+{
+	if (ctx->num_nodes == 0)
+		return;
+
+	MTY_Atomic32Set(&ctx->remaining, ctx->num_nodes);
+	MTY_Atomic32Set(&ctx->finished, 0);
+
+	for (uint32_t x = 0; x < ctx->num_nodes; x++) {
+		ctx->jobs[x].graph = ctx;
+		ctx->jobs[x].node = x;
+		MTY_Atomic32Set(&ctx->nodes[x].pending, ctx->nodes[x].num_deps);
 	}
+
+	for (uint32_t x = 0; x < ctx->num_nodes; x++)
+		if (ctx->nodes[x].num_deps == 0)
+			thread_pool_dispatch(ctx->pool, thread_graph_job, &ctx->jobs[x], true);
+
+	while (MTY_Atomic32Get(&ctx->remaining) > 0)
+		MTY_WaitableWait(ctx->w, -1);
+
+	while (MTY_Atomic32Get(&ctx->finished) == 0)
+		MTY_Sleep(0);
+}
+
+
+// Global locks
+
+// The lock word itself is a futex: 0 is unlocked, 1 is locked, 2 is locked with
+// possible waiters, so an uncontended lock and unlock are a single atomic each
+
+static int32_t thread_glock_swap(MTY_Atomic32 *lock, int32_t value)
+{
+	while (true) {
+		int32_t prev = MTY_Atomic32Get(lock);
+
+		if (MTY_Atomic32CAS(lock, prev, value))
+			return prev;
+	}
+}
+
+void MTY_GlobalLock(MTY_Atomic32 *lock)
+{
+	if (MTY_Atomic32CAS(lock, 0, 1))
+		return;
+
+	while (thread_glock_swap(lock, 2) != 0)
+		mty_futex_wait(lock, 2, -1);
 }
 
 void MTY_GlobalUnlock(MTY_Atomic32 *lock)
 {
-	mty_rwlock_unlock_writer(&THREAD_GLOCKS[MTY_Atomic32Get(lock)]);
+	if (MTY_Atomic32Add(lock, -1) != 0) {
+		MTY_Atomic32Set(lock, 0);
+		mty_futex_wake(lock, false);
+	}
 }
@@ -8,65 +8,179 @@
 #include <string.h>
 #include <stdio.h>
 
-#define TLOCAL_MAX (8 * 1024)
+#define TLOCAL_MAX       (8 * 1024)
+#define TLOCAL_CHUNK_MAX (1024 * 1024)
+
+// Memory is handed out from two regions in turn. Once the current region has
+// TLOCAL_MAX bytes in use the other one is emptied and takes over, so a result stays
+// valid for at least TLOCAL_MAX bytes of later allocations no matter how large they
+// are. A region's first chunk is allocated on the heap the first time the thread
+// uses it, and every chunk is freed when the thread exits.
+// Inside a scope the regions are never switched, everything allocated since the
+// scope was pushed stays valid until it is popped
+
+// Positions are measured across all chunks of a region, like MTY_Arena marks
+
+struct tlocal_chunk {
+	struct tlocal_chunk *prev;
+	uint8_t *data;
+	size_t base;
+	size_t size;
+	size_t used;
+};
+
+static TLOCAL struct tlocal_region {
+	struct tlocal_chunk *chunk;
+} TLOCAL_REGION[2];
+
+static TLOCAL uint8_t TLOCAL_CURRENT;
+static TLOCAL uint32_t TLOCAL_SCOPES;
+
+static size_t tlocal_position(struct tlocal_region *r)
+{
+	return r->chunk->base + r->chunk->used;
+}
+
+static void tlocal_reset(struct tlocal_region *r, size_t mark)
+{
+	// Chunks past the mark are freed, the first chunk is kept until the thread exits
+	while (r->chunk->base > mark && r->chunk->prev) {
+		struct tlocal_chunk *chunk = r->chunk;
+		r->chunk = chunk->prev;
 
-static TLOCAL uint8_t *TLOCAL_MEM;
-static TLOCAL size_t *TLOCAL_OFFSET;
-static TLOCAL size_t TLOCAL_SIZE;
+		MTY_Free(chunk);
+	}
 
-static TLOCAL uint8_t TLOCAL_MEM_INTERNAL[TLOCAL_MAX];
-static TLOCAL size_t TLOCAL_OFFSET_INTERNAL;
-static TLOCAL size_t TLOCAL_OFFSET_EXTERNAL;
+	if (mark - r->chunk->base < r->chunk->used)
+		r->chunk->used = mark - r->chunk->base;
+}
 
-static void tlocal_check_mem(void)
+static struct tlocal_chunk *tlocal_chunk(struct tlocal_chunk *prev, size_t size)
 {
-	if (!TLOCAL_MEM) {
-		TLOCAL_MEM = TLOCAL_MEM_INTERNAL;
-		TLOCAL_OFFSET = &TLOCAL_OFFSET_INTERNAL;
-		TLOCAL_SIZE = TLOCAL_MAX;
+	struct tlocal_chunk *chunk = MTY_Alloc(sizeof(struct tlocal_chunk) + size, 1);
+	chunk->data = (uint8_t *) (chunk + 1);
+	chunk->base = prev ? prev->base + prev->size : 0;
+	chunk->size = size;
+	chunk->prev = prev;
+
+	return chunk;
+}
+
+static struct tlocal_region *tlocal_region(void)
+{
+	struct tlocal_region *r = &TLOCAL_REGION[TLOCAL_CURRENT];
+
+	if (!r->chunk) {
+		mty_tlocal_track_thread();
+		r->chunk = tlocal_chunk(NULL, TLOCAL_MAX * 2);
 	}
+
+	if (TLOCAL_SCOPES == 0 && tlocal_position(r) >= TLOCAL_MAX) {
+		TLOCAL_CURRENT ^= 1;
+		r = &TLOCAL_REGION[TLOCAL_CURRENT];
+
+		if (r->chunk) {
+			tlocal_reset(r, 0);
+
+		} else {
+			r->chunk = tlocal_chunk(NULL, TLOCAL_MAX * 2);
+		}
+	}
+
+	return r;
+}
+
+static void tlocal_grow(struct tlocal_region *r, size_t size)
+{
+	struct tlocal_chunk *prev = r->chunk;
+
+	// Outside of a scope the region is switched right after a large request, inside
+	// of one chunks double in size
+	size_t chunk_size = size;
+
+	if (TLOCAL_SCOPES > 0) {
+		chunk_size = prev->size * 2;
+
+		if (chunk_size > TLOCAL_CHUNK_MAX)
+			chunk_size = TLOCAL_CHUNK_MAX;
+
+		if (chunk_size < size)
+			chunk_size = size;
+	}
+
+	r->chunk = tlocal_chunk(prev, chunk_size);
 }
 
 void *mty_tlocal(size_t size)
 {
-	tlocal_check_mem();
+	struct tlocal_region *r = tlocal_region();
 
-	if (size > TLOCAL_SIZE)
-		MTY_LogFatal("Thread local storage heap overflow");
+	// Sizes are rounded so results stay 8 byte aligned
+	size = (size + 7) & ~(size_t) 7;
 
-	if (*TLOCAL_OFFSET + size > TLOCAL_SIZE)
-		*TLOCAL_OFFSET = 0;
+	if (r->chunk->size - r->chunk->used < size)
+		tlocal_grow(r, size);
 
-	void *ptr = TLOCAL_MEM + *TLOCAL_OFFSET;
+	void *ptr = r->chunk->data + r->chunk->used;
 	memset(ptr, 0, size);
 
-	*TLOCAL_OFFSET += size;
+	r->chunk->used += size;
 
 	return ptr;
 }
 
 char *mty_tlocal_strcpy(const char *str)
 {
-	tlocal_check_mem();
-
 	size_t len = strlen(str) + 1;
 
-	if (len > TLOCAL_SIZE)
-		len = TLOCAL_SIZE;
+	return memcpy(mty_tlocal(len), str, len);
+}
+
+char *mty_tlocal_vsprintf(const char *fmt, va_list args)
+{
+	va_list args_copy;
+	va_copy(args_copy, args);
+
+	size_t size = vsnprintf(NULL, 0, fmt, args_copy) + 1;
+
+	va_end(args_copy);
 
-	char *local = mty_tlocal(len);
-	snprintf(local, len, "%s", str);
+	char *str = mty_tlocal(size);
+	vsnprintf(str, size, fmt, args);
 
-	return local;
+	return str;
 }
 
-void mty_tlocal_set_mem(void *buf, size_t size)
+void mty_tlocal_destroy(void)
 {
-	TLOCAL_MEM = buf;
-	TLOCAL_SIZE = size;
+	for (uint8_t x = 0; x < 2; x++) {
+		struct tlocal_region *r = &TLOCAL_REGION[x];
 
-	if (buf) {
-		TLOCAL_OFFSET = &TLOCAL_OFFSET_EXTERNAL;
-		*TLOCAL_OFFSET = 0;
+		while (r->chunk) {
+			struct tlocal_chunk *chunk = r->chunk;
+			r->chunk = chunk->prev;
+
+			MTY_Free(chunk);
+		}
 	}
+
+	TLOCAL_CURRENT = 0;
+	TLOCAL_SCOPES = 0;
+}
+
+size_t MTY_PushThreadLocal(void)
+{
+	size_t mark = tlocal_position(tlocal_region());
+	TLOCAL_SCOPES++;
+
+	return mark;
+}
+
+void MTY_PopThreadLocal(size_t mark)
+{
+	if (TLOCAL_SCOPES == 0)
+		return;
+
+	tlocal_reset(&TLOCAL_REGION[TLOCAL_CURRENT], mark);
+	TLOCAL_SCOPES--;
 }
@@ -4,4 +4,4 @@
 
 #pragma once
 
-#define mty_rwlockattr_set(attr) (void) (attr)
+#include "atomicwait-cond.h"
@@ -3,6 +3,7 @@
 // You can obtain one at https://spdx.org/licenses/MIT.html.
 
 #include "matoya.h"
+#include "crypto.h"
 
 #include <CommonCrypto/CommonCryptor.h>
 #include <CommonCrypto/CommonRandom.h>
@@ -44,6 +45,76 @@ void MTY_CryptoHash(MTY_Algorithm algo, const void *input, size_t inputSize, con
 	}
 }
 
+struct digest {
+	MTY_Algorithm algo;
+
+	union {
+		CC_SHA1_CTX sha1;
+		CC_SHA256_CTX sha256;
+	};
+};
+
+static void crypto_digest_init(struct digest *ctx)
+{
+	if (ctx->algo == MTY_ALGORITHM_SHA1) {
+		CC_SHA1_Init(&ctx->sha1);
+
+	} else {
+		CC_SHA256_Init(&ctx->sha256);
+	}
+}
+
+struct digest *mty_digest_create(MTY_Algorithm algo)
+{
+	struct digest *ctx = MTY_Alloc(1, sizeof(struct digest));
+	ctx->algo = algo;
+
+	crypto_digest_init(ctx);
+
+	return ctx;
+}
+
+void mty_digest_destroy(struct digest **digest)
+{
+	if (!digest || !*digest)
+		return;
+
+	struct digest *ctx = *digest;
+
+	MTY_Free(ctx);
+	*digest = NULL;
+}
+
+void mty_digest_update(struct digest *ctx, const void *input, size_t inputSize)
+{
+	// CC_LONG is 32 bits
+	for (const uint8_t *input8 = input; inputSize > 0;) {
+		CC_LONG size = inputSize > UINT32_MAX ? UINT32_MAX : (CC_LONG) inputSize;
+
+		if (ctx->algo == MTY_ALGORITHM_SHA1) {
+			CC_SHA1_Update(&ctx->sha1, input8, size);
+
+		} else {
+			CC_SHA256_Update(&ctx->sha256, input8, size);
+		}
+
+		input8 += size;
+		inputSize -= size;
+	}
+}
+
+void mty_digest_final(struct digest *ctx, void *output)
+{
+	if (ctx->algo == MTY_ALGORITHM_SHA1) {
+		CC_SHA1_Final(output, &ctx->sha1);
+
+	} else {
+		CC_SHA256_Final(output, &ctx->sha256);
+	}
+
+	crypto_digest_init(ctx);
+}
+
 
 // Random
 
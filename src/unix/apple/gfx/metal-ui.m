@@ -9,6 +9,8 @@ GFX_UI_PROTOTYPES(_metal_)
 
 #import <Metal/Metal.h>
 
+#include "alloc.h"
+
 #include "shaders/ui.h"
 
 struct metal_ui {
@@ -22,7 +24,7 @@ struct metal_ui {
 
 struct gfx_ui *mty_metal_ui_create(MTY_Device *device)
 {
-	struct metal_ui *ctx = MTY_Alloc(1, sizeof(struct metal_ui));
+	struct metal_ui *ctx = mty_alloc(1, sizeof(struct metal_ui), MTY_MEMORY_TAG_GFX);
 	id<MTLDevice> _device = (__bridge id<MTLDevice>) device;
 
 	bool r = true;
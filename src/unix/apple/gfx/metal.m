@@ -10,6 +10,7 @@ GFX_PROTOTYPES(_metal_)
 #include "gfx/viewport.h"
 #include "gfx/fmt-metal.h"
 #include "gfx/fmt.h"
+#include "alloc.h"
 
 #include "shaders/quad.h"
 
@@ -39,7 +40,7 @@ struct metal {
 
 struct gfx *mty_metal_create(MTY_Device *device, uint8_t layer)
 {
-	struct metal *ctx = MTY_Alloc(1, sizeof(struct metal));
+	struct metal *ctx = mty_alloc(1, sizeof(struct metal), MTY_MEMORY_TAG_GFX);
 	id<MTLDevice> _device = (__bridge id<MTLDevice>) device;
 
 	bool r = true;
@@ -3,6 +3,7 @@
 // You can obtain one at https://spdx.org/licenses/MIT.html.
 
 #include "matoya.h"
+#include "crypto.h"
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -229,10 +230,9 @@ static __m128i gcm_ghash16(__m128i H, __m128i in, __m128i ghash)
 	return gcm_gfmul(ghash, H);
 }
 
-static __m128i aes_gcm(const __m128i *k, const __m128i *H, __m128i iv,
-	const P128 *x, P128 *y, const P128 *crypt, size_t size)
+static __m128i aes_gcm(const __m128i *k, const __m128i *H, __m128i iv, __m128i ghash,
+	const P128 *x, P128 *y, bool encrypt, size_t size)
 {
-	__m128i ghash = _mm_setzero_si128();
 	__m128i cb = CBINCR(iv);
 
 	size_t n4 = size / 64;
@@ -273,10 +273,10 @@ static __m128i aes_gcm(const __m128i *k, const __m128i *H, __m128i iv,
 		_mm_storeu_si128((__m128i *) &y[i * 4 + 3], yi[3]);
 
 		__m128i in[4];
-		in[0] = SWAP64(crypt == x ? xi[0] : yi[0]);
-		in[1] = SWAP64(crypt == x ? xi[1] : yi[1]);
-		in[2] = SWAP64(crypt == x ? xi[2] : yi[2]);
-		in[3] = SWAP64(crypt == x ? xi[3] : yi[3]);
+		in[0] = SWAP64(encrypt ? yi[0] : xi[0]);
+		in[1] = SWAP64(encrypt ? yi[1] : xi[1]);
+		in[2] = SWAP64(encrypt ? yi[2] : xi[2]);
+		in[3] = SWAP64(encrypt ? yi[3] : xi[3]);
 
 		in[0] = _mm_xor_si128(ghash, in[0]);
 		ghash = gcm_gfmul4(H[0], H[1], H[2], H[3], in[3], in[2], in[1], in[0]);
@@ -290,7 +290,7 @@ static __m128i aes_gcm(const __m128i *k, const __m128i *H, __m128i iv,
 		__m128i xi = _mm_loadu_si128((const __m128i *) &x[i]);
 		yi = _mm_xor_si128(yi, xi);
 		_mm_storeu_si128((__m128i *) &y[i], yi);
-		ghash = gcm_ghash16(H[0], crypt == x ? xi : yi, ghash);
+		ghash = gcm_ghash16(H[0], encrypt ? yi : xi, ghash);
 	}
 
 	// Remaining data in last block
@@ -298,9 +298,11 @@ static __m128i aes_gcm(const __m128i *k, const __m128i *H, __m128i iv,
 		__m128i tmp2 = _mm_setzero_si128();
 		__m128i tmp = aes(k, cb);
 
+		// Read before writing since `x` and `y` may be the same buffer
 		for (size_t i = 0; i < rem; i++) {
-			y[n].u8[i] = x[n].u8[i] ^ ((uint8_t *) &tmp)[i];
-			((uint8_t *) &tmp2)[i] = crypt[n].u8[i];
+			uint8_t c = x[n].u8[i];
+			y[n].u8[i] = c ^ ((uint8_t *) &tmp)[i];
+			((uint8_t *) &tmp2)[i] = encrypt ? y[n].u8[i] : c;
 		}
 
 		ghash = gcm_ghash16(H[0], tmp2, ghash);
@@ -309,17 +311,26 @@ static __m128i aes_gcm(const __m128i *k, const __m128i *H, __m128i iv,
 	return ghash;
 }
 
-static void aes_gcm_full(const __m128i *k, const __m128i *H, const P128 *nonce, const P128 *crypt,
-	const P128 *in, P128 *out, size_t size, P128 *tag)
+static void aes_gcm_full(const __m128i *k, const __m128i *H, const P128 *nonce, bool encrypt,
+	const void *aad, size_t aadSize, const P128 *in, P128 *out, size_t size, P128 *tag)
 {
 	// Set up the IV with 12 bytes from the nonce and the 4 byte counter
 	__m128i iv = _mm_set_epi32(0x01000000, nonce->u32[2], nonce->u32[1], nonce->u32[0]);
 
+	// Additional authenticated data is hashed first, zero padded to whole blocks
+	__m128i ghash = _mm_setzero_si128();
+
+	for (size_t i = 0; i < aadSize; i += 16) {
+		P128 block = {0};
+		memcpy(&block, (const uint8_t *) aad + i, MTY_MIN(aadSize - i, 16));
+		ghash = gcm_ghash16(H[0], _mm_loadu_si128((const __m128i *) &block), ghash);
+	}
+
 	// Encrypt or decrypt the data while generating the ghash
-	__m128i ghash = aes_gcm(k, H, iv, in, out, crypt, size);
+	ghash = aes_gcm(k, H, iv, ghash, in, out, encrypt, size);
 
-	// ghash needs to be multiplied by the length of the data then reversed
-	__m128i len = SWAP64(_mm_set_epi64x(0, size * 8));
+	// ghash needs to be multiplied by the lengths of the AAD and data then reversed
+	__m128i len = SWAP64(_mm_set_epi64x(aadSize * 8, size * 8));
 	ghash = gcm_ghash16(H[0], len, ghash);
 	ghash = SWAP64(ghash);
 
@@ -335,6 +346,9 @@ static void aes_gcm_full(const __m128i *k, const __m128i *H, const P128 *nonce,
 struct MTY_AESGCM {
 	__m128i k[11];
 	__m128i H[4];
+
+	uint8_t *buf;
+	size_t buf_size;
 };
 
 MTY_AESGCM *MTY_AESGCMCreate(const void *key)
@@ -360,6 +374,7 @@ void MTY_AESGCMDestroy(MTY_AESGCM **aesgcm)
 
 	MTY_AESGCM *ctx = *aesgcm;
 
+	MTY_Free(ctx->buf);
 	memset(ctx, 0, sizeof(MTY_AESGCM));
 
 	MTY_FreeAligned(ctx);
@@ -369,7 +384,7 @@ void MTY_AESGCMDestroy(MTY_AESGCM **aesgcm)
 bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
 	void *tag, void *cipherText)
 {
-	aes_gcm_full(ctx->k, ctx->H, nonce, cipherText, plainText, cipherText, size, tag);
+	aes_gcm_full(ctx->k, ctx->H, nonce, true, NULL, 0, plainText, cipherText, size, tag);
 
 	return true;
 }
@@ -378,12 +393,37 @@ bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherTex
 	const void *tag, void *plainText)
 {
 	P128 tag128;
-	aes_gcm_full(ctx->k, ctx->H, nonce, cipherText, cipherText, plainText, size, &tag128);
+	aes_gcm_full(ctx->k, ctx->H, nonce, false, NULL, 0, cipherText, plainText, size, &tag128);
 
-	const P128 *itag = tag;
+	return mty_crypto_equal(&tag128, tag, 16);
+}
 
-	if (tag128.u64[0] != itag->u64[0] || tag128.u64[1] != itag->u64[1])
-		return false;
+bool mty_aesgcm_packet(MTY_AESGCM *ctx, bool encrypt, const MTY_AESGCMPacket *pkt)
+{
+	// Multiple buffers are gathered so the blocks are contiguous
+	size_t size = mty_iov_size(pkt->iov, pkt->iovLen);
+	void *data = pkt->iovLen == 1 ? pkt->iov[0].data : NULL;
+
+	if (!data) {
+		if (size > ctx->buf_size) {
+			ctx->buf = MTY_Realloc(ctx->buf, size, 1);
+			ctx->buf_size = size;
+		}
 
-	return true;
+		data = ctx->buf;
+		mty_iov_gather(pkt->iov, pkt->iovLen, data);
+	}
+
+	P128 tag128;
+	aes_gcm_full(ctx->k, ctx->H, pkt->nonce, encrypt, pkt->aad, pkt->aadSize, data, data, size, &tag128);
+
+	if (data == ctx->buf)
+		mty_iov_scatter(pkt->iov, pkt->iovLen, data);
+
+	if (encrypt) {
+		memcpy(pkt->tag, &tag128, pkt->tagSize);
+		return true;
+	}
+
+	return mty_crypto_equal(&tag128, pkt->tag, pkt->tagSize);
 }
@@ -3,6 +3,7 @@
 // You can obtain one at https://spdx.org/licenses/MIT.html.
 
 #include "matoya.h"
+#include "crypto.h"
 
 #include <string.h>
 
@@ -17,6 +18,7 @@ enum {
 
 CCCryptorStatus CCCryptorGCMReset(CCCryptorRef cryptorRef);
 CCCryptorStatus CCCryptorGCMAddIV(CCCryptorRef cryptorRef, const void *iv, size_t ivLen);
+CCCryptorStatus CCCryptorGCMAddAAD(CCCryptorRef cryptorRef, const void *aData, size_t aDataLen);
 CCCryptorStatus CCCryptorGCMEncrypt(CCCryptorRef cryptorRef, const void *dataIn, size_t dataInLength, void *dataOut);
 CCCryptorStatus CCCryptorGCMDecrypt(CCCryptorRef cryptorRef, const void *dataIn, size_t dataInLength, void *dataOut);
 CCCryptorStatus CCCryptorGCMFinal(CCCryptorRef cryptorRef, void *tagOut, size_t *tagLength);
@@ -72,70 +74,84 @@ void MTY_AESGCMDestroy(MTY_AESGCM **aesgcm)
 	*aesgcm = NULL;
 }
 
-bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
-	void *tag, void *cipherText)
+static bool aes_gcm_crypt(MTY_AESGCM *ctx, bool encrypt, const void *nonce, const void *aad,
+	size_t aadSize, const MTY_IOVec *in, const MTY_IOVec *out, uint32_t iovLen, void *tag,
+	size_t tagSize)
 {
-	CCCryptorStatus e = CCCryptorGCMReset(ctx->enc);
+	CCCryptorRef cryptor = encrypt ? ctx->enc : ctx->dec;
+
+	CCCryptorStatus e = CCCryptorGCMReset(cryptor);
 	if (e != kCCSuccess) {
 		MTY_Log("'CCCryptorReset' failed with error %d", e);
 		return false;
 	}
 
-	e = CCCryptorGCMAddIV(ctx->enc, nonce, 12);
+	e = CCCryptorGCMAddIV(cryptor, nonce, 12);
 	if (e != kCCSuccess) {
 		MTY_Log("'CCCryptorGCMAddIV' failed with error %d", e);
 		return false;
 	}
 
-	e = CCCryptorGCMEncrypt(ctx->enc, plainText, size, cipherText);
-	if (e != kCCSuccess) {
-		MTY_Log("'CCCryptorGCMEncrypt' failed with error %d", e);
-		return false;
+	if (aadSize > 0) {
+		e = CCCryptorGCMAddAAD(cryptor, aad, aadSize);
+		if (e != kCCSuccess) {
+			MTY_Log("'CCCryptorGCMAddAAD' failed with error %d", e);
+			return false;
+		}
 	}
 
-	size_t hash_size = 16;
-	e = CCCryptorGCMFinal(ctx->enc, tag, &hash_size);
+	// Buffers are streamed through the cryptor one at a time
+	for (uint32_t x = 0; x < iovLen; x++) {
+		if (in[x].size == 0)
+			continue;
+
+		e = encrypt ? CCCryptorGCMEncrypt(cryptor, in[x].data, in[x].size, out[x].data) :
+			CCCryptorGCMDecrypt(cryptor, in[x].data, in[x].size, out[x].data);
+		if (e != kCCSuccess) {
+			MTY_Log("'%s' failed with error %d", encrypt ? "CCCryptorGCMEncrypt" : "CCCryptorGCMDecrypt", e);
+			return false;
+		}
+	}
+
+	uint8_t hashf[16];
+	size_t hashf_size = 16;
+	e = CCCryptorGCMFinal(cryptor, hashf, &hashf_size);
 	if (e != kCCSuccess) {
 		MTY_Log("'CCCryptorGCMFinal' failed with error %d", e);
 		return false;
 	}
 
-	return true;
-}
+	if (encrypt) {
+		memcpy(tag, hashf, tagSize);
 
-bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherText, size_t size,
-	const void *tag, void *plainText)
-{
-	CCCryptorStatus e = CCCryptorGCMReset(ctx->dec);
-	if (e != kCCSuccess) {
-		MTY_Log("'CCCryptorReset' failed with error %d", e);
+	} else if (hashf_size < tagSize || !mty_crypto_equal(tag, hashf, tagSize)) {
+		MTY_Log("Authentication tag mismatch");
 		return false;
 	}
 
-	e = CCCryptorGCMAddIV(ctx->dec, nonce, 12);
-	if (e != kCCSuccess) {
-		MTY_Log("'CCCryptorGCMAddIV' failed with error %d", e);
-		return false;
-	}
+	return true;
+}
 
-	e = CCCryptorGCMDecrypt(ctx->dec, cipherText, size, plainText);
-	if (e != kCCSuccess) {
-		MTY_Log("'CCCryptorGCMDecrypt' failed with error %d", e);
-		return false;
-	}
+bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
+	void *tag, void *cipherText)
+{
+	MTY_IOVec in = {(void *) plainText, size};
+	MTY_IOVec out = {cipherText, size};
 
-	uint8_t hashf[32];
-	size_t hashf_size = 32;
-	e = CCCryptorGCMFinal(ctx->dec, hashf, &hashf_size);
-	if (e != kCCSuccess) {
-		MTY_Log("'CCCryptorGCMFinal' failed with error %d", e);
-		return false;
-	}
+	return aes_gcm_crypt(ctx, true, nonce, NULL, 0, &in, &out, 1, tag, 16);
+}
 
-	if (memcmp(tag, hashf, MTY_MIN(hashf_size, 16))) {
-		MTY_Log("Authentication tag mismatch");
-		return false;
-	}
+bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherText, size_t size,
+	const void *tag, void *plainText)
+{
+	MTY_IOVec in = {(void *) cipherText, size};
+	MTY_IOVec out = {plainText, size};
 
-	return true;
+	return aes_gcm_crypt(ctx, false, nonce, NULL, 0, &in, &out, 1, (void *) tag, 16);
+}
+
+bool mty_aesgcm_packet(MTY_AESGCM *ctx, bool encrypt, const MTY_AESGCMPacket *pkt)
+{
+	return aes_gcm_crypt(ctx, encrypt, pkt->nonce, pkt->aad, pkt->aadSize, pkt->iov, pkt->iov,
+		pkt->iovLen, pkt->tag, pkt->tagSize);
 }
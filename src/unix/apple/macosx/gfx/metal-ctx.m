@@ -12,6 +12,7 @@ GFX_CTX_PROTOTYPES(_metal_)
 #include "gfx/sync.h"
 #include "display-link.h"
 #include "scale.h"
+#include "alloc.h"
 
 struct metal_ctx {
 	NSWindow *window;
@@ -42,7 +43,7 @@ struct gfx_ctx *mty_metal_ctx_create(void *native_window, bool vsync)
 	if (!device || ![device supportsFeatureSet: MTLFeatureSet_macOS_GPUFamily1_v1])
 		return NULL;
 
-	struct metal_ctx *ctx = MTY_Alloc(1, sizeof(struct metal_ctx));
+	struct metal_ctx *ctx = mty_alloc(1, sizeof(struct metal_ctx), MTY_MEMORY_TAG_GFX);
 	ctx->window = (__bridge NSWindow *) native_window;
 
 	metal_ctx_mt_block(^{
@@ -5,6 +5,7 @@
 #include "matoya.h"
 
 #include "net-common.h"
+#include "alloc.h"
 
 bool MTY_HttpRequest(const char *url, const char *method, const char *headers,
 	const void *body, size_t bodySize, const char *proxy, uint32_t timeout,
@@ -38,7 +39,7 @@ bool MTY_HttpRequest(const char *url, const char *method, const char *headers,
 			*responseSize = [data length];
 
 			if (*responseSize > 0) {
-				*response = MTY_Alloc(*responseSize + 1, 1);
+				*response = mty_alloc(*responseSize + 1, 1, MTY_MEMORY_TAG_HTTP);
 				[data getBytes:*response length:*responseSize];
 			}
 
@@ -141,7 +141,7 @@ struct webview *mty_webview_create(MTY_App *app, MTY_Window window, const char *
 	ctx->key_func = key_func;
 
 	ctx->keys = web_keymap_hash();
-	ctx->pushq = MTY_QueueCreate(50, 0);
+	ctx->pushq = MTY_QueueCreate(50, 0, MTY_QUEUE_FLAG_NONE);
 
 	// WKWebView creation, start hidden
 	#if TARGET_OS_OSX
@@ -6,6 +6,7 @@
 
 #include "objc.h"
 #include "net-common.h"
+#include "alloc.h"
 
 #define WS_PING_INTERVAL 60000.0
 #define WS_PONG_TO       (WS_PING_INTERVAL * 3)
@@ -92,7 +93,7 @@ static Class websocket_class(void)
 MTY_WebSocket *MTY_WebSocketConnect(const char *url, const char *headers, const char *proxy,
 	uint32_t timeout, uint16_t *upgradeStatus)
 {
-	MTY_WebSocket *ctx = MTY_Alloc(1, sizeof(MTY_WebSocket));
+	MTY_WebSocket *ctx = mty_alloc(1, sizeof(MTY_WebSocket), MTY_MEMORY_TAG_HTTP);
 
 	ctx->conn = MTY_WaitableCreate();
 	ctx->read = MTY_WaitableCreate();
@@ -198,7 +199,7 @@ MTY_Async MTY_WebSocketRead(MTY_WebSocket *ctx, uint32_t timeout, char *msg, siz
 
 			} else {
 				if (ws_msg.type == NSURLSessionWebSocketMessageTypeString)
-					ctx->msg = MTY_Strdup([ws_msg.string UTF8String]);
+					ctx->msg = mty_strdup([ws_msg.string UTF8String], MTY_MEMORY_TAG_HTTP);
 			}
 
 			MTY_WaitableSignal(ctx->read);
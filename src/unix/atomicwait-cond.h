@@ -0,0 +1,60 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#pragma once
+
+#include <pthread.h>
+
+// Futex emulation for platforms without a usable wait-on-address primitive. Waiters
+// sleep on a condition variable chosen by address, and the value is checked under
+// the same mutex the waker takes, so a wake can never be missed
+
+#define FUTEX_BUCKETS 64
+
+static struct futex_bucket {
+	MTY_Mutex *mutex;
+	MTY_Cond *cond;
+} FUTEX_BUCKET[FUTEX_BUCKETS];
+
+static pthread_once_t FUTEX_ONCE = PTHREAD_ONCE_INIT;
+
+static void futex_init(void)
+{
+	for (uint32_t x = 0; x < FUTEX_BUCKETS; x++) {
+		FUTEX_BUCKET[x].mutex = MTY_MutexCreate();
+		FUTEX_BUCKET[x].cond = MTY_CondCreate();
+	}
+}
+
+static struct futex_bucket *futex_bucket(MTY_Atomic32 *atomic)
+{
+	pthread_once(&FUTEX_ONCE, futex_init);
+
+	return &FUTEX_BUCKET[((uintptr_t) atomic >> 2) % FUTEX_BUCKETS];
+}
+
+static bool mty_futex_wait(MTY_Atomic32 *atomic, int32_t value, int32_t timeout)
+{
+	struct futex_bucket *b = futex_bucket(atomic);
+	bool r = true;
+
+	MTY_MutexLock(b->mutex);
+
+	if (MTY_Atomic32Get(atomic) == value)
+		r = MTY_CondWait(b->cond, b->mutex, timeout);
+
+	MTY_MutexUnlock(b->mutex);
+
+	return r;
+}
+
+static void mty_futex_wake(MTY_Atomic32 *atomic, bool all)
+{
+	struct futex_bucket *b = futex_bucket(atomic);
+
+	// Other addresses may share the bucket, so every waiter is woken to recheck
+	MTY_MutexLock(b->mutex);
+	MTY_CondSignalAll(b->cond);
+	MTY_MutexUnlock(b->mutex);
+}
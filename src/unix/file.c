@@ -21,6 +21,7 @@
 #include <sys/file.h>
 #include <dirent.h>
 
+#include "file.h"
 #include "home.h"
 #include "tlocal.h"
 
@@ -203,10 +204,10 @@ static int32_t file_compare(const void *p1, const void *p2)
 
 MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 {
-	void *tmp = MTY_Alloc(0x1000, 1);
-	mty_tlocal_set_mem(tmp, 0x1000);
+	// Keep the thread local results of the caller intact
+	size_t mark = MTY_PushThreadLocal();
 
-	MTY_FileList *fl = MTY_Alloc(1, sizeof(MTY_FileList));
+	MTY_FileList *fl = mty_file_list_create();
 	char *pathd = MTY_Strdup(path);
 
 	bool ok = false;
@@ -224,19 +225,12 @@ MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 			(ent->d_type == DT_UNKNOWN && (!strcmp(name, "..") || !strcmp(name, ".")));
 
 		if (is_dir || MTY_StrSearch(name, filter ? filter : "", "|")) {
-			fl->files = MTY_Realloc(fl->files, fl->len + 1, sizeof(MTY_FileDesc));
-
-			char *jpath = MTY_Strdup(MTY_JoinPath(pathd, name));
-
-			fl->files[fl->len].dir = is_dir;
-			fl->files[fl->len].name = MTY_Strdup(name);
-			fl->files[fl->len].path = jpath;
+			const char *jpath = MTY_JoinPath(pathd, name);
 
 			struct stat st;
-			if (!is_dir && stat(jpath, &st) == 0)
-				fl->files[fl->len].size = st.st_size;
+			uint64_t size = !is_dir && stat(jpath, &st) == 0 ? st.st_size : 0;
 
-			fl->len++;
+			mty_file_list_append(fl, name, jpath, is_dir, size);
 		}
 
 		ent = readdir(dir);
@@ -251,8 +245,7 @@ MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 	if (fl->len > 0)
 		MTY_Sort(fl->files, fl->len, sizeof(MTY_FileDesc), file_compare);
 
-	mty_tlocal_set_mem(NULL, 0);
-	MTY_Free(tmp);
+	MTY_PopThreadLocal(mark);
 
 	return fl;
 }
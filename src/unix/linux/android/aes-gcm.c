@@ -7,9 +7,10 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "crypto.h"
 #include "jnih.h"
 
-#define AES_GCM_NUM_BUFS 6
+#define AES_GCM_NUM_BUFS 7
 #define AES_GCM_MAX      (8 * 1024)
 
 #define AES_GCM_ENCRYPT  0x00000001
@@ -25,6 +26,7 @@ struct MTY_AESGCM {
 	jmethodID m_gps_constructor;
 	jmethodID m_cipher_init;
 	jmethodID m_cipher_do_final;
+	jmethodID m_cipher_update_aad;
 
 	jbyteArray buf[AES_GCM_NUM_BUFS];
 };
@@ -58,6 +60,7 @@ MTY_AESGCM *MTY_AESGCMCreate(const void *key)
 	ctx->m_cipher_init = (*env)->GetMethodID(env, ctx->cls_cipher, "init", "(ILjava/security/Key;Ljava/security/spec/AlgorithmParameterSpec;)V");
 
 	ctx->m_cipher_do_final = (*env)->GetMethodID(env, ctx->cls_cipher, "doFinal", "([BII[B)I");
+	ctx->m_cipher_update_aad = (*env)->GetMethodID(env, ctx->cls_cipher, "updateAAD", "([BII)V");
 
 	// Preallocate byte buffers
 	for (uint8_t x = 0; x < AES_GCM_NUM_BUFS; x++) {
@@ -139,3 +142,70 @@ bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherTex
 
 	return r;
 }
+
+bool mty_aesgcm_packet(MTY_AESGCM *ctx, bool encrypt, const MTY_AESGCMPacket *pkt)
+{
+	size_t size = mty_iov_size(pkt->iov, pkt->iovLen);
+
+	if (size + pkt->tagSize > AES_GCM_MAX || pkt->aadSize > AES_GCM_MAX) {
+		MTY_Log("Packet is larger than %d bytes", AES_GCM_MAX);
+		return false;
+	}
+
+	JNIEnv *env = MTY_GetJNIEnv();
+
+	// Encryption uses buffers 0 to 2, decryption 3 to 5
+	jbyteArray jnonce = ctx->buf[encrypt ? 0 : 3];
+	jbyteArray jin = ctx->buf[encrypt ? 1 : 4];
+	jbyteArray jout = ctx->buf[encrypt ? 2 : 5];
+
+	(*env)->SetByteArrayRegion(env, jnonce, 0, 12, pkt->nonce);
+
+	// The buffers are copied directly into the contiguous Java array
+	size_t offset = 0;
+	for (uint32_t x = 0; x < pkt->iovLen; x++) {
+		(*env)->SetByteArrayRegion(env, jin, offset, pkt->iov[x].size, pkt->iov[x].data);
+		offset += pkt->iov[x].size;
+	}
+
+	// The tag follows the cipher text on input to decryption
+	if (!encrypt)
+		(*env)->SetByteArrayRegion(env, jin, size, pkt->tagSize, pkt->tag);
+
+	jobject spec = (*env)->NewObject(env, ctx->cls_gps, ctx->m_gps_constructor, (jint) (pkt->tagSize * 8),
+		jnonce, 0, 12);
+
+	(*env)->CallVoidMethod(env, ctx->gcm, ctx->m_cipher_init, encrypt ? AES_GCM_ENCRYPT : AES_GCM_DECRYPT,
+		ctx->key, spec);
+
+	bool r = mty_jni_ok(env);
+
+	if (r && pkt->aadSize > 0) {
+		(*env)->SetByteArrayRegion(env, ctx->buf[6], 0, pkt->aadSize, pkt->aad);
+		(*env)->CallVoidMethod(env, ctx->gcm, ctx->m_cipher_update_aad, ctx->buf[6], 0, (jint) pkt->aadSize);
+
+		r = mty_jni_ok(env);
+	}
+
+	if (r) {
+		(*env)->CallIntMethod(env, ctx->gcm, ctx->m_cipher_do_final, jin, 0,
+			(jint) (encrypt ? size : size + pkt->tagSize), jout);
+
+		r = mty_jni_ok(env);
+	}
+
+	if (r) {
+		offset = 0;
+		for (uint32_t x = 0; x < pkt->iovLen; x++) {
+			(*env)->GetByteArrayRegion(env, jout, offset, pkt->iov[x].size, pkt->iov[x].data);
+			offset += pkt->iov[x].size;
+		}
+
+		if (encrypt)
+			(*env)->GetByteArrayRegion(env, jout, size, pkt->tagSize, pkt->tag);
+	}
+
+	mty_jni_free(env, spec);
+
+	return r;
+}
@@ -160,7 +160,7 @@ JNIEXPORT void JNICALL Java_group_matoya_lib_Matoya_app_1start(JNIEnv *env, jobj
 	CTX.input = MTY_INPUT_MODE_TOUCHSCREEN;
 	CTX.obj = (*env)->NewGlobalRef(env, obj);
 
-	CTX.events = MTY_QueueCreate(500, sizeof(MTY_Event));
+	CTX.events = MTY_QueueCreate(500, sizeof(MTY_Event), MTY_QUEUE_FLAG_NONE);
 	CTX.ctrls = MTY_HashCreate(0);
 	CTX.deduper = MTY_HashCreate(0);
 	CTX.ctrl_mutex = MTY_MutexCreate();
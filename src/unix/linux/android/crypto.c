@@ -3,6 +3,7 @@
 // You can obtain one at https://spdx.org/licenses/MIT.html.
 
 #include "matoya.h"
+#include "crypto.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -89,41 +90,76 @@ void MTY_CryptoHash(MTY_Algorithm algo, const void *input, size_t inputSize, con
 	}
 }
 
+struct digest {
+	jobject md;
+	size_t size;
+};
 
-// Random
+struct digest *mty_digest_create(MTY_Algorithm algo)
+{
+	JNIEnv *env = MTY_GetJNIEnv();
 
-void MTY_GetRandomBytes(void *buf, size_t size)
+	struct digest *ctx = MTY_Alloc(1, sizeof(struct digest));
+	ctx->size = algo == MTY_ALGORITHM_SHA1 ? MTY_SHA1_SIZE : MTY_SHA256_SIZE;
+
+	jstring jalg = mty_jni_strdup(env, algo == MTY_ALGORITHM_SHA1 ? "SHA-1" : "SHA-256");
+	ctx->md = mty_jni_static_obj(env, "java/security/MessageDigest", "getInstance", "(Ljava/lang/String;)Ljava/security/MessageDigest;", jalg);
+	mty_jni_retain(env, &ctx->md);
+
+	mty_jni_free(env, jalg);
+
+	return ctx;
+}
+
+void mty_digest_destroy(struct digest **digest)
 {
+	if (!digest || !*digest)
+		return;
+
+	struct digest *ctx = *digest;
+
 	JNIEnv *env = MTY_GetJNIEnv();
+	mty_jni_release(env, &ctx->md);
 
-	jobject obj = mty_jni_new(env, "java/security/SecureRandom", "()V");
+	MTY_Free(ctx);
+	*digest = NULL;
+}
 
-	jbyteArray b = mty_jni_alloc(env, size);
-	mty_jni_void(env, obj, "nextBytes", "([B)V", b);
+void mty_digest_update(struct digest *ctx, const void *input, size_t inputSize)
+{
+	JNIEnv *env = MTY_GetJNIEnv();
 
-	mty_jni_memcpy(env, buf, b, size);
+	jobject bb = mty_jni_wrap(env, (void *) input, inputSize);
+	mty_jni_void(env, ctx->md, "update", "(Ljava/nio/ByteBuffer;)V", bb);
+
+	mty_jni_free(env, bb);
+}
+
+void mty_digest_final(struct digest *ctx, void *output)
+{
+	JNIEnv *env = MTY_GetJNIEnv();
+
+	// MessageDigest.digest also resets the digest
+	jbyteArray b = mty_jni_obj(env, ctx->md, "digest", "()[B");
+	mty_jni_memcpy(env, output, b, ctx->size);
 
 	mty_jni_free(env, b);
-	mty_jni_free(env, obj);
 }
 
 
-// Base64
+// Random
 
-void MTY_BytesToBase64(const void *bytes, size_t size, char *base64, size_t base64Size)
+void MTY_GetRandomBytes(void *buf, size_t size)
 {
 	JNIEnv *env = MTY_GetJNIEnv();
 
-	jbyteArray jbuf = mty_jni_dup(env, bytes, size);
-
-	jint Base64_NO_WRAP = 0x00000002;
+	jobject obj = mty_jni_new(env, "java/security/SecureRandom", "()V");
 
-	jstring str = mty_jni_static_obj(env, "android/util/Base64", "encodeToString",
-		"([BI)Ljava/lang/String;", jbuf, Base64_NO_WRAP);
+	jbyteArray b = mty_jni_alloc(env, size);
+	mty_jni_void(env, obj, "nextBytes", "([B)V", b);
 
-	if (mty_jni_strcpy(env, base64, base64Size, str) >= (ssize_t) base64Size)
-		MTY_Log("'base64Size' is too small");
+	mty_jni_memcpy(env, buf, b, size);
 
-	mty_jni_free(env, str);
-	mty_jni_free(env, jbuf);
+	mty_jni_free(env, b);
+	mty_jni_free(env, obj);
 }
@@ -6,6 +6,7 @@
 
 #include "jnih.h"
 #include "http.h"
+#include "alloc.h"
 
 struct request_parse_args {
 	bool ua_found;
@@ -118,7 +119,7 @@ bool MTY_HttpRequest(const char *url, const char *method, const char *headers,
 	if (jdata) {
 		*responseSize = mty_jni_array_get_size(env, jdata);
 
-		*response = MTY_Alloc(*responseSize + 1, 1);
+		*response = mty_alloc(*responseSize + 1, 1, MTY_MEMORY_TAG_HTTP);
 		mty_jni_memcpy(env, *response, jdata, *responseSize);
 	}
 
@@ -0,0 +1,37 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#pragma once
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static bool mty_futex_wait(MTY_Atomic32 *atomic, int32_t value, int32_t timeout)
+{
+	struct timespec ts = {0};
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000 * 1000;
+
+	// Returns immediately with EAGAIN if the value has already changed
+	long r = syscall(SYS_futex, &atomic->value, FUTEX_WAIT_PRIVATE, value,
+		timeout < 0 ? NULL : &ts, NULL, 0);
+
+	if (r != 0 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+		MTY_LogFatal("'FUTEX_WAIT' failed with errno %d", errno);
+
+	return r == 0 || errno != ETIMEDOUT;
+}
+
+static void mty_futex_wake(MTY_Atomic32 *atomic, bool all)
+{
+	long r = syscall(SYS_futex, &atomic->value, FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1,
+		NULL, NULL, 0);
+
+	if (r < 0)
+		MTY_LogFatal("'FUTEX_WAKE' failed with errno %d", errno);
+}
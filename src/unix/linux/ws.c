@@ -10,6 +10,7 @@
 
 #include "net.h"
 #include "http.h"
+#include "alloc.h"
 
 enum {
 	WS_OPCODE_CONTINUE = 0x0,
@@ -55,8 +56,8 @@ struct http_header {
 
 static struct http_header *http_parse_header(const char *header)
 {
-	struct http_header *h = MTY_Alloc(1, sizeof(struct http_header));
-	char *dup = MTY_Strdup(header);
+	struct http_header *h = mty_alloc(1, sizeof(struct http_header), MTY_MEMORY_TAG_HTTP);
+	char *dup = mty_strdup(header, MTY_MEMORY_TAG_HTTP);
 
 	// HTTP header lines are delimited by "\r\n"
 	char *ptr = NULL;
@@ -66,21 +67,21 @@ static struct http_header *http_parse_header(const char *header)
 
 		// First line is special and is stored seperately
 		if (first) {
-			h->first_line = MTY_Strdup(line);
+			h->first_line = mty_strdup(line, MTY_MEMORY_TAG_HTTP);
 
 		// All lines following the first are in the "key: val" format
 		} else {
 			char *delim = strpbrk(line, ": ");
 
 			if (delim) {
-				h->pairs = MTY_Realloc(h->pairs, h->npairs + 1, sizeof(struct http_pair));
+				h->pairs = mty_realloc(h->pairs, h->npairs + 1, sizeof(struct http_pair), MTY_MEMORY_TAG_HTTP);
 
 				// Place a null character to separate the line
 				char save = delim[0];
 				delim[0] = '\0';
 
 				// Save the key and remove the null character
-				h->pairs[h->npairs].key = MTY_Strdup(line);
+				h->pairs[h->npairs].key = mty_strdup(line, MTY_MEMORY_TAG_HTTP);
 				delim[0] = save;
 
 				// Advance the val past whitespace or the : character
@@ -88,7 +89,7 @@ static struct http_header *http_parse_header(const char *header)
 					delim++;
 
 				// Store the val and increment npairs
-				h->pairs[h->npairs].val = MTY_Strdup(delim);
+				h->pairs[h->npairs].val = mty_strdup(delim, MTY_MEMORY_TAG_HTTP);
 				h->npairs++;
 			}
 		}
@@ -123,7 +124,7 @@ static void http_header_destroy(struct http_header **header)
 static bool http_get_status_code(struct http_header *h, uint16_t *status_code)
 {
 	bool r = true;
-	char *dup = MTY_Strdup(h->first_line);
+	char *dup = mty_strdup(h->first_line, MTY_MEMORY_TAG_HTTP);
 
 	char *ptr = NULL;
 	char *tok = MTY_Strtok(dup, " ", &ptr);
@@ -164,14 +165,14 @@ static void http_set_header_str(char **header, const char *name, const char *val
 	size_t len = *header ? strlen(*header) : 0;
 	size_t new_len = len + strlen(name) + strlen(val) + 32;
 
-	*header = MTY_Realloc(*header, new_len, 1);
+	*header = mty_realloc(*header, new_len, 1, MTY_MEMORY_TAG_HTTP);
 	snprintf(*header + len, new_len, "%s: %s\r\n", name, val);
 }
 
 static struct http_header *http_read_header(struct net *net, uint32_t timeout)
 {
 	bool r = false;
-	char *h = MTY_Alloc(HTTP_HEADER_MAX, 1);
+	char *h = mty_alloc(HTTP_HEADER_MAX, 1, MTY_MEMORY_TAG_HTTP);
 
 	for (uint32_t x = 0; x < HTTP_HEADER_MAX - 1; x++) {
 		if (!mty_net_read(net, h + x, 1, timeout))
@@ -208,18 +209,18 @@ static bool http_parse_url(const char *url, char **host, char **path)
 	}
 
 	// Host + port
-	*host = MTY_Strdup(url);
+	*host = mty_strdup(url, MTY_MEMORY_TAG_HTTP);
 
 	// Path + query
 	char *end = strchr(*host, '/');
 	end = end ? end + 1 : strchr(*host, '?');
 
 	if (end) {
-		*path = MTY_Strdup(end);
+		*path = mty_strdup(end, MTY_MEMORY_TAG_HTTP);
 		*end = '\0';
 
 	} else {
-		*path = MTY_Strdup("");
+		*path = mty_strdup("", MTY_MEMORY_TAG_HTTP);
 	}
 
 	// Remove port
@@ -352,7 +353,7 @@ static bool ws_write(MTY_WebSocket *ctx, const void *buf, size_t size, uint8_t o
 	// Resize the serialized buffer if necessary
 	if (size + WS_HEADER_SIZE > ctx->size) {
 		ctx->size = size + WS_HEADER_SIZE;
-		ctx->buf = MTY_Realloc(ctx->buf, ctx->size, 1);
+		ctx->buf = mty_realloc(ctx->buf, ctx->size, 1, MTY_MEMORY_TAG_HTTP);
 	}
 
 	// Serialize the payload into a websocket conformant message
@@ -443,7 +444,7 @@ MTY_WebSocket *MTY_WebSocketConnect(const char *url, const char *headers, const
 
 	char *furl = mty_http_fix_scheme(url);
 
-	MTY_WebSocket *ctx = MTY_Alloc(1, sizeof(MTY_WebSocket));
+	MTY_WebSocket *ctx = mty_alloc(1, sizeof(MTY_WebSocket), MTY_MEMORY_TAG_HTTP);
 
 	ctx->net = mty_net_connect(furl, proxy, timeout);
 	if (!ctx->net) {
@@ -4,21 +4,511 @@
 
 #include "matoya.h"
 
+#include <string.h>
+
+#include "crypto.h"
 #include "dl/libcrypto.c"
 
+#if defined(__x86_64__)
+	#define AES_GCM_NI
+	#include <cpuid.h>
+	#include <immintrin.h>
+
+	#define AES_GCM_TARGET      __attribute__((target("aes,pclmul,sse4.1")))
+	#define AES_GCM_TARGET_VAES __attribute__((target("aes,pclmul,sse4.1,avx2,vaes,vpclmulqdq")))
+#endif
+
+#define AES_GCM_TAG_SIZE 16
+
+
+// AES-NI, PCLMULQDQ
+
+// When the CPU supports it AES-GCM is done here without libcrypto. Eight blocks are
+// encrypted at a time so the AES rounds of independent blocks overlap, and their
+// GHASH multiplications share a single reduction using precomputed powers of H. With
+// VAES and VPCLMULQDQ the same eight blocks are handled two per 256-bit register
+
+#if defined(AES_GCM_NI)
+
+#define AES_GCM_BLOCKS 8
+
+struct aes_gcm_ni {
+	__m128i k[11];
+	__m128i h[AES_GCM_BLOCKS];  // H^1 to H^8, byte reversed
+	__m128i hk[AES_GCM_BLOCKS]; // Low ^ high halves of each power for Karatsuba
+
+	// Pairs of powers in the order they multiply blocks, H^8 and H^7 first
+	__m256i h2[AES_GCM_BLOCKS / 2];
+	__m256i hk2[AES_GCM_BLOCKS / 2];
+	bool vaes;
+};
+
+struct aes_gcm_stream {
+	__m128i ghash;
+	__m128i ctr;          // Next counter block, byte reversed so the counter can be added
+	__m128i ks;           // Key stream of a partially used block
+	uint8_t partial[16];  // Cipher text of a partially used block
+	size_t used;          // Bytes of `ks` and `partial` that have been used
+	uint64_t size;
+	uint64_t aad_size;
+};
+
+static bool aes_gcm_ni_supported(void)
+{
+	uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+	__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+
+	// PCLMULQDQ, SSSE3, SSE4.1, AES
+	return (ecx & (1 << 1)) && (ecx & (1 << 9)) && (ecx & (1 << 19)) && (ecx & (1 << 25));
+}
+
+static bool aes_gcm_vaes_supported(void)
+{
+	uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+	__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+
+	// OSXSAVE and AVX, then the OS must be saving the YMM registers
+	if (!(ecx & (1 << 27)) || !(ecx & (1 << 28)))
+		return false;
+
+	uint32_t xcr0 = 0, xcr0_hi = 0;
+	__asm__ volatile ("xgetbv" : "=a" (xcr0), "=d" (xcr0_hi) : "c" (0));
+
+	if ((xcr0 & 0x6) != 0x6)
+		return false;
+
+	// AVX2, VAES, VPCLMULQDQ
+	__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+
+	return (ebx & (1 << 5)) && (ecx & (1 << 9)) && (ecx & (1 << 10));
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_swap(__m128i v)
+{
+	return _mm_shuffle_epi8(v, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_load(const uint8_t *buf, size_t size)
+{
+	uint8_t block[16] = {0};
+	memcpy(block, buf, size);
+
+	return _mm_loadu_si128((const __m128i *) block);
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_key_assist(__m128i k, __m128i keygen)
+{
+	keygen = _mm_shuffle_epi32(keygen, _MM_SHUFFLE(3, 3, 3, 3));
+
+	k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+	k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+	k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+
+	return _mm_xor_si128(k, keygen);
+}
+
+AES_GCM_TARGET
+static void aes_gcm_key_expansion(const void *key, __m128i *k)
+{
+	// The round constant must be an immediate
+	k[0] = _mm_loadu_si128((const __m128i *) key);
+	k[1] = aes_gcm_key_assist(k[0], _mm_aeskeygenassist_si128(k[0], 0x01));
+	k[2] = aes_gcm_key_assist(k[1], _mm_aeskeygenassist_si128(k[1], 0x02));
+	k[3] = aes_gcm_key_assist(k[2], _mm_aeskeygenassist_si128(k[2], 0x04));
+	k[4] = aes_gcm_key_assist(k[3], _mm_aeskeygenassist_si128(k[3], 0x08));
+	k[5] = aes_gcm_key_assist(k[4], _mm_aeskeygenassist_si128(k[4], 0x10));
+	k[6] = aes_gcm_key_assist(k[5], _mm_aeskeygenassist_si128(k[5], 0x20));
+	k[7] = aes_gcm_key_assist(k[6], _mm_aeskeygenassist_si128(k[6], 0x40));
+	k[8] = aes_gcm_key_assist(k[7], _mm_aeskeygenassist_si128(k[7], 0x80));
+	k[9] = aes_gcm_key_assist(k[8], _mm_aeskeygenassist_si128(k[8], 0x1B));
+	k[10] = aes_gcm_key_assist(k[9], _mm_aeskeygenassist_si128(k[9], 0x36));
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_aes(const __m128i *k, __m128i block)
+{
+	block = _mm_xor_si128(block, k[0]);
+
+	for (uint8_t x = 1; x < 10; x++)
+		block = _mm_aesenc_si128(block, k[x]);
+
+	return _mm_aesenclast_si128(block, k[10]);
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+	// Fold the Karatsuba middle term into the 256-bit product
+	mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+	lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+	hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+	// The operands are bit reflected, so the product is shifted left by one
+	__m128i t0 = _mm_srli_epi32(lo, 31);
+	__m128i t1 = _mm_srli_epi32(hi, 31);
+	lo = _mm_slli_epi32(lo, 1);
+	hi = _mm_slli_epi32(hi, 1);
+
+	__m128i t2 = _mm_srli_si128(t0, 12);
+	t1 = _mm_slli_si128(t1, 4);
+	t0 = _mm_slli_si128(t0, 4);
+	lo = _mm_or_si128(lo, t0);
+	hi = _mm_or_si128(hi, t1);
+	hi = _mm_or_si128(hi, t2);
+
+	// Reduce modulo x^128 + x^7 + x^2 + x + 1
+	t0 = _mm_slli_epi32(lo, 31);
+	t1 = _mm_slli_epi32(lo, 30);
+	t2 = _mm_slli_epi32(lo, 25);
+	t0 = _mm_xor_si128(t0, t1);
+	t0 = _mm_xor_si128(t0, t2);
+	t1 = _mm_srli_si128(t0, 4);
+	t0 = _mm_slli_si128(t0, 12);
+	lo = _mm_xor_si128(lo, t0);
+
+	t0 = _mm_srli_epi32(lo, 1);
+	t2 = _mm_srli_epi32(lo, 2);
+	__m128i t3 = _mm_srli_epi32(lo, 7);
+	t0 = _mm_xor_si128(t0, t2);
+	t0 = _mm_xor_si128(t0, t3);
+	t0 = _mm_xor_si128(t0, t1);
+	lo = _mm_xor_si128(lo, t0);
+
+	return _mm_xor_si128(hi, lo);
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_karatsuba(__m128i h)
+{
+	return _mm_xor_si128(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_mul(__m128i a, __m128i b)
+{
+	__m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+	__m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+	__m128i mid = _mm_clmulepi64_si128(aes_gcm_karatsuba(a), aes_gcm_karatsuba(b), 0x00);
+
+	return aes_gcm_reduce(lo, mid, hi);
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_ghash(const struct aes_gcm_ni *ctx, __m128i ghash, __m128i block)
+{
+	return aes_gcm_mul(_mm_xor_si128(ghash, aes_gcm_swap(block)), ctx->h[0]);
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_ghash8(const struct aes_gcm_ni *ctx, __m128i ghash, const __m128i *blocks)
+{
+	__m128i lo = _mm_setzero_si128();
+	__m128i mid = _mm_setzero_si128();
+	__m128i hi = _mm_setzero_si128();
+
+	// ((((g ^ b0) * H ^ b1) * H ...) * H expanded to (g ^ b0) * H^8 ^ b1 * H^7 ...
+	for (uint8_t x = 0; x < AES_GCM_BLOCKS; x++) {
+		__m128i b = aes_gcm_swap(blocks[x]);
+
+		if (x == 0)
+			b = _mm_xor_si128(b, ghash);
+
+		const __m128i h = ctx->h[AES_GCM_BLOCKS - 1 - x];
+
+		lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(b, h, 0x00));
+		hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(b, h, 0x11));
+		mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(aes_gcm_karatsuba(b),
+			ctx->hk[AES_GCM_BLOCKS - 1 - x], 0x00));
+	}
+
+	return aes_gcm_reduce(lo, mid, hi);
+}
+
+AES_GCM_TARGET
+static void aes_gcm_ni_init(struct aes_gcm_ni *ctx, const void *key)
+{
+	aes_gcm_key_expansion(key, ctx->k);
+
+	ctx->h[0] = aes_gcm_swap(aes_gcm_aes(ctx->k, _mm_setzero_si128()));
+
+	for (uint8_t x = 1; x < AES_GCM_BLOCKS; x++)
+		ctx->h[x] = aes_gcm_mul(ctx->h[x - 1], ctx->h[0]);
+
+	for (uint8_t x = 0; x < AES_GCM_BLOCKS; x++)
+		ctx->hk[x] = aes_gcm_karatsuba(ctx->h[x]);
+}
+
+AES_GCM_TARGET_VAES
+static void aes_gcm_vaes_init(struct aes_gcm_ni *ctx)
+{
+	// Block 2 * x is in the low half of a register and multiplied by H^(8 - 2 * x)
+	for (uint8_t x = 0; x < AES_GCM_BLOCKS / 2; x++) {
+		ctx->h2[x] = _mm256_set_m128i(ctx->h[AES_GCM_BLOCKS - 2 - x * 2], ctx->h[AES_GCM_BLOCKS - 1 - x * 2]);
+		ctx->hk2[x] = _mm256_set_m128i(ctx->hk[AES_GCM_BLOCKS - 2 - x * 2], ctx->hk[AES_GCM_BLOCKS - 1 - x * 2]);
+	}
+
+	ctx->vaes = true;
+}
+
+AES_GCM_TARGET_VAES
+static __m128i aes_gcm_ghash8_vaes(const struct aes_gcm_ni *ctx, __m128i ghash, const __m256i *blocks)
+{
+	const __m256i swap = _mm256_set_epi8(
+		0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+		0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	__m256i lo = _mm256_setzero_si256();
+	__m256i mid = _mm256_setzero_si256();
+	__m256i hi = _mm256_setzero_si256();
+
+	for (uint8_t x = 0; x < AES_GCM_BLOCKS / 2; x++) {
+		__m256i b = _mm256_shuffle_epi8(blocks[x], swap);
+
+		if (x == 0)
+			b = _mm256_xor_si256(b, _mm256_inserti128_si256(_mm256_setzero_si256(), ghash, 0));
+
+		__m256i bk = _mm256_xor_si256(b, _mm256_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2)));
+
+		lo = _mm256_xor_si256(lo, _mm256_clmulepi64_epi128(b, ctx->h2[x], 0x00));
+		hi = _mm256_xor_si256(hi, _mm256_clmulepi64_epi128(b, ctx->h2[x], 0x11));
+		mid = _mm256_xor_si256(mid, _mm256_clmulepi64_epi128(bk, ctx->hk2[x], 0x00));
+	}
+
+	// Sum the two halves then reduce once
+	return aes_gcm_reduce(
+		_mm_xor_si128(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1)),
+		_mm_xor_si128(_mm256_castsi256_si128(mid), _mm256_extracti128_si256(mid, 1)),
+		_mm_xor_si128(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1)));
+}
+
+AES_GCM_TARGET_VAES
+static size_t aes_gcm_bulk_vaes(const struct aes_gcm_ni *ctx, struct aes_gcm_stream *s, bool encrypt,
+	const uint8_t *in, uint8_t *out, size_t size)
+{
+	__m256i k[11];
+	for (uint8_t x = 0; x < 11; x++)
+		k[x] = _mm256_broadcastsi128_si256(ctx->k[x]);
+
+	__m128i ghash = s->ghash;
+	__m128i ctr = s->ctr;
+	size_t x = 0;
+
+	for (; size - x >= AES_GCM_BLOCKS * 16; x += AES_GCM_BLOCKS * 16) {
+		__m256i b[AES_GCM_BLOCKS / 2];
+		__m256i d[AES_GCM_BLOCKS / 2];
+
+		for (uint8_t y = 0; y < AES_GCM_BLOCKS / 2; y++) {
+			__m128i c0 = aes_gcm_swap(ctr);
+			__m128i c1 = aes_gcm_swap(_mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 1)));
+			ctr = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 2));
+
+			b[y] = _mm256_xor_si256(_mm256_set_m128i(c1, c0), k[0]);
+		}
+
+		for (uint8_t r = 1; r < 10; r++)
+			for (uint8_t y = 0; y < AES_GCM_BLOCKS / 2; y++)
+				b[y] = _mm256_aesenc_epi128(b[y], k[r]);
+
+		for (uint8_t y = 0; y < AES_GCM_BLOCKS / 2; y++) {
+			d[y] = _mm256_loadu_si256((const __m256i *) (in + x + y * 32));
+			b[y] = _mm256_xor_si256(_mm256_aesenclast_epi128(b[y], k[10]), d[y]);
+		}
+
+		for (uint8_t y = 0; y < AES_GCM_BLOCKS / 2; y++)
+			_mm256_storeu_si256((__m256i *) (out + x + y * 32), b[y]);
+
+		ghash = aes_gcm_ghash8_vaes(ctx, ghash, encrypt ? b : d);
+	}
+
+	s->ghash = ghash;
+	s->ctr = ctr;
+
+	return x;
+}
+
+AES_GCM_TARGET
+static __m128i aes_gcm_next_ctr(struct aes_gcm_stream *s)
+{
+	// Only the low 32 bits of the counter are incremented, wrapping like GCM specifies
+	__m128i ctr = aes_gcm_swap(s->ctr);
+	s->ctr = _mm_add_epi32(s->ctr, _mm_set_epi32(0, 0, 0, 1));
+
+	return ctr;
+}
+
+AES_GCM_TARGET
+static void aes_gcm_begin(const struct aes_gcm_ni *ctx, struct aes_gcm_stream *s,
+	const void *nonce, const void *aad, size_t aadSize)
+{
+	memset(s, 0, sizeof(struct aes_gcm_stream));
+
+	// J0 is the 12 byte nonce followed by a 32-bit counter of 1, data starts at 2
+	uint8_t j0[16] = {0};
+	memcpy(j0, nonce, 12);
+	j0[15] = 2;
+
+	s->ctr = aes_gcm_swap(_mm_loadu_si128((const __m128i *) j0));
+	s->aad_size = aadSize;
+
+	const uint8_t *aad8 = aad;
+
+	for (size_t x = 0; x < aadSize; x += 16) {
+		size_t n = aadSize - x < 16 ? aadSize - x : 16;
+		s->ghash = aes_gcm_ghash(ctx, s->ghash, aes_gcm_load(aad8 + x, n));
+	}
+}
+
+AES_GCM_TARGET
+static size_t aes_gcm_bulk(const struct aes_gcm_ni *ctx, struct aes_gcm_stream *s, bool encrypt,
+	const uint8_t *in, uint8_t *out, size_t size)
+{
+	// State is kept in locals since stores to `out` could alias `ctx` and `s`
+	__m128i k[11];
+	for (uint8_t x = 0; x < 11; x++)
+		k[x] = ctx->k[x];
+
+	__m128i ghash = s->ghash;
+	__m128i ctr = s->ctr;
+	size_t x = 0;
+
+	// The input is always loaded before the output is stored so buffers may overlap exactly
+	for (; size - x >= AES_GCM_BLOCKS * 16; x += AES_GCM_BLOCKS * 16) {
+		__m128i b[AES_GCM_BLOCKS];
+		__m128i d[AES_GCM_BLOCKS];
+
+		for (uint8_t y = 0; y < AES_GCM_BLOCKS; y++) {
+			b[y] = _mm_xor_si128(aes_gcm_swap(ctr), k[0]);
+			ctr = _mm_add_epi32(ctr, _mm_set_epi32(0, 0, 0, 1));
+		}
+
+		for (uint8_t r = 1; r < 10; r++)
+			for (uint8_t y = 0; y < AES_GCM_BLOCKS; y++)
+				b[y] = _mm_aesenc_si128(b[y], k[r]);
+
+		for (uint8_t y = 0; y < AES_GCM_BLOCKS; y++) {
+			d[y] = _mm_loadu_si128((const __m128i *) (in + x + y * 16));
+			b[y] = _mm_xor_si128(_mm_aesenclast_si128(b[y], k[10]), d[y]);
+		}
+
+		for (uint8_t y = 0; y < AES_GCM_BLOCKS; y++)
+			_mm_storeu_si128((__m128i *) (out + x + y * 16), b[y]);
+
+		ghash = aes_gcm_ghash8(ctx, ghash, encrypt ? b : d);
+	}
+
+	s->ghash = ghash;
+	s->ctr = ctr;
+
+	return x;
+}
+
+AES_GCM_TARGET
+static void aes_gcm_update(const struct aes_gcm_ni *ctx, struct aes_gcm_stream *s, bool encrypt,
+	const void *in, void *out, size_t size)
+{
+	const uint8_t *in8 = in;
+	uint8_t *out8 = out;
+	size_t x = 0;
+
+	s->size += size;
+
+	// Finish a block left partially used by the previous call
+	for (; s->used > 0 && x < size; x++) {
+		uint8_t c = in8[x];
+		uint8_t p = c ^ ((uint8_t *) &s->ks)[s->used];
+
+		out8[x] = p;
+		s->partial[s->used++] = encrypt ? p : c;
+
+		if (s->used == 16) {
+			s->ghash = aes_gcm_ghash(ctx, s->ghash, _mm_loadu_si128((const __m128i *) s->partial));
+			s->used = 0;
+		}
+	}
+
+	x += ctx->vaes ? aes_gcm_bulk_vaes(ctx, s, encrypt, in8 + x, out8 + x, size - x) :
+		aes_gcm_bulk(ctx, s, encrypt, in8 + x, out8 + x, size - x);
+
+	for (; size - x >= 16; x += 16) {
+		__m128i d = _mm_loadu_si128((const __m128i *) (in8 + x));
+		__m128i b = _mm_xor_si128(aes_gcm_aes(ctx->k, aes_gcm_next_ctr(s)), d);
+
+		_mm_storeu_si128((__m128i *) (out8 + x), b);
+		s->ghash = aes_gcm_ghash(ctx, s->ghash, encrypt ? b : d);
+	}
+
+	// Start a partial block that the next call or aes_gcm_end completes
+	if (x < size) {
+		s->ks = aes_gcm_aes(ctx->k, aes_gcm_next_ctr(s));
+
+		for (; x < size; x++) {
+			uint8_t c = in8[x];
+			uint8_t p = c ^ ((uint8_t *) &s->ks)[s->used];
+
+			out8[x] = p;
+			s->partial[s->used++] = encrypt ? p : c;
+		}
+	}
+}
+
+AES_GCM_TARGET
+static void aes_gcm_end(const struct aes_gcm_ni *ctx, struct aes_gcm_stream *s, const void *nonce,
+	uint8_t *tag)
+{
+	if (s->used > 0)
+		s->ghash = aes_gcm_ghash(ctx, s->ghash, aes_gcm_load(s->partial, s->used));
+
+	// Lengths in bits, big endian, after the byte reversal
+	__m128i len = _mm_set_epi64x(s->aad_size * 8, s->size * 8);
+	s->ghash = aes_gcm_mul(_mm_xor_si128(s->ghash, len), ctx->h[0]);
+
+	uint8_t j0[16] = {0};
+	memcpy(j0, nonce, 12);
+	j0[15] = 1;
+
+	__m128i t = aes_gcm_aes(ctx->k, _mm_loadu_si128((const __m128i *) j0));
+	_mm_storeu_si128((__m128i *) tag, _mm_xor_si128(t, aes_gcm_swap(s->ghash)));
+}
+
+#endif
+
+
+// AESGCM
+
 struct MTY_AESGCM {
 	EVP_CIPHER_CTX *enc;
 	EVP_CIPHER_CTX *dec;
+
+	#if defined(AES_GCM_NI)
+		struct aes_gcm_ni *ni;
+	#endif
 };
 
 MTY_AESGCM *MTY_AESGCMCreate(const void *key)
 {
-	if (!libcrypto_global_init())
-		return NULL;
-
 	MTY_AESGCM *ctx = MTY_Alloc(1, sizeof(MTY_AESGCM));
 	bool r = true;
 
+	#if defined(AES_GCM_NI)
+		if (aes_gcm_ni_supported()) {
+			ctx->ni = MTY_AllocAligned(sizeof(struct aes_gcm_ni), 32);
+			aes_gcm_ni_init(ctx->ni, key);
+
+			if (aes_gcm_vaes_supported())
+				aes_gcm_vaes_init(ctx->ni);
+
+			return ctx;
+		}
+	#endif
+
+	if (!libcrypto_global_init()) {
+		r = false;
+		goto except;
+	}
+
 	const EVP_CIPHER *cipher = EVP_aes_128_gcm();
 
 	ctx->enc = EVP_CIPHER_CTX_new();
@@ -64,6 +554,13 @@ void MTY_AESGCMDestroy(MTY_AESGCM **aesgcm)
 
 	MTY_AESGCM *ctx = *aesgcm;
 
+	#if defined(AES_GCM_NI)
+		if (ctx->ni) {
+			memset(ctx->ni, 0, sizeof(struct aes_gcm_ni));
+			MTY_FreeAligned(ctx->ni);
+		}
+	#endif
+
 	if (ctx->dec)
 		EVP_CIPHER_CTX_free(ctx->dec);
 
@@ -74,64 +571,125 @@ void MTY_AESGCMDestroy(MTY_AESGCM **aesgcm)
 	*aesgcm = NULL;
 }
 
-bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
-	void *tag, void *cipherText)
+static bool aes_gcm_evp_crypt(MTY_AESGCM *ctx, bool encrypt, const void *nonce, const void *aad,
+	size_t aadSize, const MTY_IOVec *in, const MTY_IOVec *out, uint32_t iovLen, void *tag,
+	size_t tagSize)
 {
-	int32_t e = EVP_CipherInit_ex(ctx->enc, NULL, NULL, NULL, nonce, 1);
+	EVP_CIPHER_CTX *evp = encrypt ? ctx->enc : ctx->dec;
+
+	int32_t e = EVP_CipherInit_ex(evp, NULL, NULL, NULL, nonce, encrypt);
 	if (e != 1) {
-		MTY_Log("'EVP_CipherInit' failed with error %d", e);
+		MTY_Log("'EVP_CipherInit_ex' failed with error %d", e);
 		return false;
 	}
 
 	int32_t len = 0;
-	e = EVP_EncryptUpdate(ctx->enc, cipherText, &len, plainText, size);
-	if (e != 1) {
-		MTY_Log("'EVP_EncryptUpdate' failed with error %d", e);
-		return false;
+	uint8_t final[AES_GCM_TAG_SIZE];
+
+	// AAD is passed in with a NULL output buffer
+	if (aadSize > 0) {
+		e = encrypt ? EVP_EncryptUpdate(evp, NULL, &len, aad, (int32_t) aadSize) :
+			EVP_DecryptUpdate(evp, NULL, &len, aad, (int32_t) aadSize);
+		if (e != 1) {
+			MTY_Log("'EVP_CipherUpdate' failed with error %d", e);
+			return false;
+		}
 	}
 
-	e = EVP_EncryptFinal_ex(ctx->enc, cipherText, &len);
-	if (e != 1) {
-		MTY_Log("'EVP_EncryptFinal_ex' failed with error %d", e);
-		return false;
+	for (uint32_t x = 0; x < iovLen; x++) {
+		if (in[x].size == 0)
+			continue;
+
+		e = encrypt ? EVP_EncryptUpdate(evp, out[x].data, &len, in[x].data, (int32_t) in[x].size) :
+			EVP_DecryptUpdate(evp, out[x].data, &len, in[x].data, (int32_t) in[x].size);
+		if (e != 1) {
+			MTY_Log("'EVP_CipherUpdate' failed with error %d", e);
+			return false;
+		}
 	}
 
-	e = EVP_CIPHER_CTX_ctrl(ctx->enc, EVP_CTRL_GCM_GET_TAG, 16, tag);
-	if (e != 1) {
-		MTY_Log("'EVP_CIPHER_CTX_ctrl' failed with error %d", e);
-		return false;
+	if (encrypt) {
+		e = EVP_EncryptFinal_ex(evp, final, &len);
+		if (e != 1) {
+			MTY_Log("'EVP_EncryptFinal_ex' failed with error %d", e);
+			return false;
+		}
+
+		e = EVP_CIPHER_CTX_ctrl(evp, EVP_CTRL_GCM_GET_TAG, (int32_t) tagSize, tag);
+		if (e != 1) {
+			MTY_Log("'EVP_CIPHER_CTX_ctrl' failed with error %d", e);
+			return false;
+		}
+
+	} else {
+		e = EVP_CIPHER_CTX_ctrl(evp, EVP_CTRL_GCM_SET_TAG, (int32_t) tagSize, tag);
+		if (e != 1) {
+			MTY_Log("'EVP_CIPHER_CTX_ctrl' failed with error %d", e);
+			return false;
+		}
+
+		e = EVP_DecryptFinal_ex(evp, final, &len);
+		if (e != 1) {
+			MTY_Log("'EVP_DecryptFinal_ex' failed with error %d", e);
+			return false;
+		}
 	}
 
 	return true;
 }
 
-bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherText, size_t size,
-	const void *tag, void *plainText)
+static bool aes_gcm_crypt(MTY_AESGCM *ctx, bool encrypt, const void *nonce, const void *aad,
+	size_t aadSize, const MTY_IOVec *in, const MTY_IOVec *out, uint32_t iovLen, void *tag,
+	size_t tagSize)
 {
-	int32_t e = EVP_CipherInit_ex(ctx->dec, NULL, NULL, NULL, nonce, 0);
-	if (e != 1) {
-		MTY_Log("'EVP_CipherInit' failed with error %d", e);
-		return false;
-	}
+	#if defined(AES_GCM_NI)
+		if (ctx->ni) {
+			struct aes_gcm_stream s;
+			aes_gcm_begin(ctx->ni, &s, nonce, aad, aadSize);
 
-	int32_t len = 0;
-	e = EVP_DecryptUpdate(ctx->dec, plainText, &len, cipherText, size);
-	if (e != 1) {
-		MTY_Log("'EVP_DecryptUpdate' failed with error %d", e);
-		return false;
-	}
+			for (uint32_t x = 0; x < iovLen; x++)
+				aes_gcm_update(ctx->ni, &s, encrypt, in[x].data, out[x].data, in[x].size);
 
-	e = EVP_CIPHER_CTX_ctrl(ctx->dec, EVP_CTRL_GCM_SET_TAG, 16, (void *) tag);
-	if (e != 1) {
-		MTY_Log("'EVP_CIPHER_CTX_ctrl' failed with error %d", e);
-		return false;
-	}
+			uint8_t full[AES_GCM_TAG_SIZE];
+			aes_gcm_end(ctx->ni, &s, nonce, full);
 
-	e = EVP_DecryptFinal_ex(ctx->dec, plainText, &len);
-	if (e != 1) {
-		MTY_Log("'EVP_DecryptFinal_ex' failed with error %d", e);
-		return false;
-	}
+			if (encrypt) {
+				memcpy(tag, full, tagSize);
+				return true;
+			}
 
-	return true;
+			if (!mty_crypto_equal(full, tag, tagSize)) {
+				MTY_Log("Authentication tag mismatch");
+				return false;
+			}
+
+			return true;
+		}
+	#endif
+
+	return aes_gcm_evp_crypt(ctx, encrypt, nonce, aad, aadSize, in, out, iovLen, tag, tagSize);
+}
+
+bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
+	void *tag, void *cipherText)
+{
+	MTY_IOVec in = {(void *) plainText, size};
+	MTY_IOVec out = {cipherText, size};
+
+	return aes_gcm_crypt(ctx, true, nonce, NULL, 0, &in, &out, 1, tag, AES_GCM_TAG_SIZE);
+}
+
+bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherText, size_t size,
+	const void *tag, void *plainText)
+{
+	MTY_IOVec in = {(void *) cipherText, size};
+	MTY_IOVec out = {plainText, size};
+
+	return aes_gcm_crypt(ctx, false, nonce, NULL, 0, &in, &out, 1, (void *) tag, AES_GCM_TAG_SIZE);
+}
+
+bool mty_aesgcm_packet(MTY_AESGCM *ctx, bool encrypt, const MTY_AESGCMPacket *pkt)
+{
+	return aes_gcm_crypt(ctx, encrypt, pkt->nonce, pkt->aad, pkt->aadSize, pkt->iov, pkt->iov,
+		pkt->iovLen, pkt->tag, pkt->tagSize);
 }
@@ -3,6 +3,7 @@
 // You can obtain one at https://spdx.org/licenses/MIT.html.
 
 #include "matoya.h"
+#include "crypto.h"
 
 #include "dl/libcrypto.c"
 
@@ -53,33 +54,66 @@ void MTY_CryptoHash(MTY_Algorithm algo, const void *input, size_t inputSize, con
 	}
 }
 
+struct digest {
+	EVP_MD_CTX *ctx;
+	const EVP_MD *md;
+};
 
-// Random
+struct digest *mty_digest_create(MTY_Algorithm algo)
+{
+	if (!libcrypto_global_init() || !EVP_MD_CTX_new)
+		return NULL;
 
-void MTY_GetRandomBytes(void *buf, size_t size)
+	struct digest *ctx = MTY_Alloc(1, sizeof(struct digest));
+	ctx->md = algo == MTY_ALGORITHM_SHA1 ? EVP_sha1() : EVP_sha256();
+
+	ctx->ctx = EVP_MD_CTX_new();
+	if (!ctx->ctx || !EVP_DigestInit_ex(ctx->ctx, ctx->md, NULL)) {
+		MTY_Log("'EVP_DigestInit_ex' failed");
+		mty_digest_destroy(&ctx);
+	}
+
+	return ctx;
+}
+
+void mty_digest_destroy(struct digest **digest)
 {
-	if (!libcrypto_global_init())
+	if (!digest || !*digest)
 		return;
 
-	int32_t e = RAND_bytes(buf, size);
-	if (e != 1)
-		MTY_Log("'RAND_bytes' failed with error %d", e);
-}
+	struct digest *ctx = *digest;
+
+	if (ctx->ctx)
+		EVP_MD_CTX_free(ctx->ctx);
 
+	MTY_Free(ctx);
+	*digest = NULL;
+}
 
-// Base64
+void mty_digest_update(struct digest *ctx, const void *input, size_t inputSize)
+{
+	if (!EVP_DigestUpdate(ctx->ctx, input, inputSize))
+		MTY_Log("'EVP_DigestUpdate' failed");
+}
 
-void MTY_BytesToBase64(const void *bytes, size_t size, char *base64, size_t base64Size)
+void mty_digest_final(struct digest *ctx, void *output)
 {
-	size_t needed = (4 * size / 3 + 3) & ~3;
+	if (!EVP_DigestFinal_ex(ctx->ctx, output, NULL))
+		MTY_Log("'EVP_DigestFinal_ex' failed");
+
+	if (!EVP_DigestInit_ex(ctx->ctx, ctx->md, NULL))
+		MTY_Log("'EVP_DigestInit_ex' failed");
+}
 
-	if (base64Size <= needed) {
-		MTY_Log("'base64Size' is too small");
-		return;
-	}
 
+// Random
+
+void MTY_GetRandomBytes(void *buf, size_t size)
+{
 	if (!libcrypto_global_init())
 		return;
 
-	EVP_EncodeBlock((void *) base64, bytes, size);
+	int32_t e = RAND_bytes(buf, size);
+	if (e != 1)
+		MTY_Log("'RAND_bytes' failed with error %d", e);
 }
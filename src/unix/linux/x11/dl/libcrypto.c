@@ -23,12 +23,16 @@ static int (*EVP_DecryptFinal_ex)(EVP_CIPHER_CTX *ctx, unsigned char *outm, int
 static int (*EVP_CIPHER_CTX_ctrl)(EVP_CIPHER_CTX *ctx, int type, int arg, void *ptr);
 static const EVP_MD *(*EVP_sha1)(void);
 static const EVP_MD *(*EVP_sha256)(void);
+static EVP_MD_CTX *(*EVP_MD_CTX_new)(void);
+static void (*EVP_MD_CTX_free)(EVP_MD_CTX *ctx);
+static int (*EVP_DigestInit_ex)(EVP_MD_CTX *ctx, const EVP_MD *type, ENGINE *impl);
+static int (*EVP_DigestUpdate)(EVP_MD_CTX *ctx, const void *d, size_t cnt);
+static int (*EVP_DigestFinal_ex)(EVP_MD_CTX *ctx, unsigned char *md, unsigned int *s);
 static unsigned char *(*SHA1)(const unsigned char *d, size_t n, unsigned char *md);
 static unsigned char *(*SHA256)(const unsigned char *d, size_t n, unsigned char *md);
 static unsigned char *(*HMAC)(const EVP_MD *evp_md, const void *key, int key_len,
 	const unsigned char *d, size_t n, unsigned char *md, unsigned int *md_len);
 static int (*RAND_bytes)(unsigned char *buf, int num);
-static int (*EVP_EncodeBlock)(unsigned char *t, const unsigned char *f, int n);
 
 static MTY_Atomic32 LIBCRYPTO_LOCK;
 static MTY_SO *LIBCRYPTO_SO;
@@ -74,11 +78,22 @@ static bool libcrypto_global_init(void)
 		LOAD_SYM(LIBCRYPTO_SO, EVP_CIPHER_CTX_ctrl);
 		LOAD_SYM(LIBCRYPTO_SO, EVP_sha1);
 		LOAD_SYM(LIBCRYPTO_SO, EVP_sha256);
+		LOAD_SYM(LIBCRYPTO_SO, EVP_DigestInit_ex);
+		LOAD_SYM(LIBCRYPTO_SO, EVP_DigestUpdate);
+		LOAD_SYM(LIBCRYPTO_SO, EVP_DigestFinal_ex);
 		LOAD_SYM(LIBCRYPTO_SO, SHA1);
 		LOAD_SYM(LIBCRYPTO_SO, SHA256);
 		LOAD_SYM(LIBCRYPTO_SO, HMAC);
 		LOAD_SYM(LIBCRYPTO_SO, RAND_bytes);
-		LOAD_SYM(LIBCRYPTO_SO, EVP_EncodeBlock);
+
+		// Named EVP_MD_CTX_create/destroy before OpenSSL 1.1
+		LOAD_SYM_OPT(LIBCRYPTO_SO, EVP_MD_CTX_new);
+		LOAD_SYM_OPT(LIBCRYPTO_SO, EVP_MD_CTX_free);
+
+		if (!EVP_MD_CTX_new || !EVP_MD_CTX_free) {
+			EVP_MD_CTX_new = MTY_SOGetSymbol(LIBCRYPTO_SO, "EVP_MD_CTX_create");
+			EVP_MD_CTX_free = MTY_SOGetSymbol(LIBCRYPTO_SO, "EVP_MD_CTX_destroy");
+		}
 
 		except:
 
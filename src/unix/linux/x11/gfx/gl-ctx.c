@@ -7,6 +7,7 @@ GFX_CTX_PROTOTYPES(_gl_)
 
 #include "gfx/gl/glproc.c"
 #include "dl/libx11.c"
+#include "alloc.h"
 
 struct gl_ctx {
 	Display *display;
@@ -26,7 +27,7 @@ struct gfx_ctx *mty_gl_ctx_create(void *native_window, bool vsync)
 
 	bool r = true;
 
-	struct gl_ctx *ctx = MTY_Alloc(1, sizeof(struct gl_ctx));
+	struct gl_ctx *ctx = mty_alloc(1, sizeof(struct gl_ctx), MTY_MEMORY_TAG_GFX);
 	struct xinfo *info = (struct xinfo *) native_window;
 	ctx->display = info->display;
 	ctx->vis = info->vis;
@@ -9,6 +9,7 @@
 #include "net.h"
 #include "http.h"
 #include "net-common.h"
+#include "alloc.h"
 
 struct request_parse_args {
 	struct curl_slist **slist;
@@ -35,7 +36,7 @@ static size_t request_write_func(char *ptr, size_t size, size_t nmemb, void *use
 	size_t realsize = size * nmemb;
 	struct request_response *res = userdata;
 
-	res->data = MTY_Realloc(res->data, res->size + realsize + 1, 1);
+	res->data = mty_realloc(res->data, res->size + realsize + 1, 1, MTY_MEMORY_TAG_HTTP);
 
 	memcpy(res->data + res->size, ptr, realsize);
 	res->size += realsize;
@@ -11,21 +11,16 @@
 #include <wchar.h>
 
 #include "matoya.h"
+#include "alloc.h"
 
-void *MTY_AllocAligned(size_t size, size_t align)
+void *mty_sys_alloc_aligned(size_t size, size_t align)
 {
 	void *mem = NULL;
-	int32_t e = posix_memalign(&mem, align, size);
 
-	if (e != 0)
-		MTY_LogFatal("'posix_memalign' failed with error %d", e);
-
-	memset(mem, 0, size);
-
-	return mem;
+	return posix_memalign(&mem, align, size) == 0 ? mem : NULL;
 }
 
-void MTY_FreeAligned(void *mem)
+void mty_sys_free_aligned(void *mem)
 {
 	free(mem);
 }
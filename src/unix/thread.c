@@ -13,6 +13,53 @@
 
 #include <pthread.h>
 
+#include "alloc.h"
+#include "tlocal.h"
+
+
+// Thread exit
+
+static MTY_Atomic32 THREAD_EXIT_LOCK;
+static pthread_key_t THREAD_EXIT_KEY;
+static bool THREAD_EXIT_INIT;
+static TLOCAL bool THREAD_EXIT_TRACKED;
+
+static void thread_exit(void *opaque)
+{
+	// Cleanup may use thread local memory again, which tracks the thread once more
+	THREAD_EXIT_TRACKED = false;
+
+	mty_pool_release_thread();
+	mty_log_destroy();
+	mty_tlocal_destroy();
+}
+
+void mty_tlocal_track_thread(void)
+{
+	if (THREAD_EXIT_TRACKED)
+		return;
+
+	// Set first so logging a failure below does not end up back here
+	THREAD_EXIT_TRACKED = true;
+
+	MTY_GlobalLock(&THREAD_EXIT_LOCK);
+
+	if (!THREAD_EXIT_INIT) {
+		int32_t e = pthread_key_create(&THREAD_EXIT_KEY, thread_exit);
+		if (e != 0)
+			MTY_LogFatal("'pthread_key_create' failed with error %d", e);
+
+		THREAD_EXIT_INIT = true;
+	}
+
+	MTY_GlobalUnlock(&THREAD_EXIT_LOCK);
+
+	// Destructors only run for keys holding a value other than NULL
+	int32_t e = pthread_setspecific(THREAD_EXIT_KEY, &THREAD_EXIT_INIT);
+	if (e != 0)
+		MTY_LogFatal("'pthread_setspecific' failed with error %d", e);
+}
+
 
 // Thread
 
@@ -102,8 +149,20 @@ int64_t MTY_ThreadGetID(MTY_Thread *ctx)
 
 // Mutex
 
+#if defined(__x86_64__) || defined(__i386__)
+	#define mutex_pause() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+	#define mutex_pause() __asm__ __volatile__("yield")
+#else
+	#define mutex_pause()
+#endif
+
 struct MTY_Mutex {
 	pthread_mutex_t mutex;
+	uint32_t spin;
+
+	// Only a heuristic, so relaxed loads and stores are enough
+	MTY_Atomic32 spin_avg;
 };
 
 MTY_Mutex *MTY_MutexCreate(void)
@@ -132,8 +191,40 @@ void MTY_MutexDestroy(MTY_Mutex **mutex)
 	*mutex = NULL;
 }
 
+void MTY_MutexSetSpin(MTY_Mutex *ctx, uint32_t spin)
+{
+	ctx->spin = spin;
+}
+
+static bool mutex_spin(MTY_Mutex *ctx)
+{
+	// Spin for up to twice as long as it has recently taken to acquire the lock, so a
+	// lock that is usually held briefly is spun on and one that is not quickly stops
+	int32_t avg = __atomic_load_n(&ctx->spin_avg.value, __ATOMIC_RELAXED);
+	int32_t max = avg * 2 + 10;
+
+	if ((uint32_t) max > ctx->spin)
+		max = ctx->spin;
+
+	int32_t x = 0;
+
+	for (; x < max; x++) {
+		if (pthread_mutex_trylock(&ctx->mutex) == 0)
+			break;
+
+		mutex_pause();
+	}
+
+	__atomic_store_n(&ctx->spin_avg.value, avg + (x - avg) / 8, __ATOMIC_RELAXED);
+
+	return x < max;
+}
+
 void MTY_MutexLock(MTY_Mutex *ctx)
 {
+	if (ctx->spin > 0 && mutex_spin(ctx))
+		return;
+
 	int32_t e = pthread_mutex_lock(&ctx->mutex);
 	if (e != 0)
 		MTY_LogFatal("'pthread_mutex_lock' failed with error %d", e);
@@ -6,6 +6,17 @@
 
 #define TLOCAL __thread
 
+#include <stdarg.h>
+
 void *mty_tlocal(size_t size);
 char *mty_tlocal_strcpy(const char *str);
-void mty_tlocal_set_mem(void *buf, size_t size);
+char *mty_tlocal_vsprintf(const char *fmt, va_list args);
+void mty_tlocal_destroy(void);
+
+// Implemented per platform next to MTY_Thread. Once called, mty_pool_release_thread,
+// mty_log_destroy and mty_tlocal_destroy run when the calling thread exits, whoever
+// created it
+void mty_tlocal_track_thread(void);
+
+// Frees the calling thread's last log message, implemented in log.c
+void mty_log_destroy(void);
@@ -4,7 +4,4 @@
 
 #pragma once
 
-// Apple platforms prevent writer starvation by default, so no need
-// to fool with rwlock attributes
-
-#define mty_rwlockattr_set(attr)
+#include "atomicwait-cond.h"
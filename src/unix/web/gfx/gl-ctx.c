@@ -6,6 +6,7 @@
 GFX_CTX_PROTOTYPES(_gl_)
 
 #include "../web.h"
+#include "alloc.h"
 
 struct gl_ctx {
 	MTY_App *app;
@@ -15,7 +16,7 @@ struct gl_ctx {
 
 struct gfx_ctx *mty_gl_ctx_create(void *native_window, bool vsync)
 {
-	struct gl_ctx *ctx = MTY_Alloc(1, sizeof(struct gl_ctx));
+	struct gl_ctx *ctx = mty_alloc(1, sizeof(struct gl_ctx), MTY_MEMORY_TAG_GFX);
 
 	ctx->app = native_window;
 	ctx->vsync = vsync;
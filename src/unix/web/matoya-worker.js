@@ -639,19 +639,18 @@ const MTY_IMAGE_API = {
 const MTY_CRYPTO_API = {
 	MTY_CryptoHash: function (algo, input, inputSize, key, keySize, output, outputSize) {
 	},
+	mty_digest_create: function (algo) {
+		return 0;
+	},
+	mty_digest_destroy: function (digest) {
+	},
+	mty_digest_update: function (ctx, input, inputSize) {
+	},
+	mty_digest_final: function (ctx, output) {
+	},
 	MTY_GetRandomBytes: function (buf, size) {
 		mty_memcpy(buf, crypto.getRandomValues(new Uint8Array(size)));
 	},
-	MTY_BytesToBase64: function (bytes, size, base64, base64Size) {
-		const jbytes = new Uint8Array(MTY_MEMORY.buffer, bytes, size);
-
-		try {
-			mty_str_to_c(mty_buf_to_b64(jbytes), base64, base64Size);
-
-		} catch (e) {
-			console.error("'base64Size' is too small");
-		}
-	},
 };
 
 
@@ -3,6 +3,7 @@
 // You can obtain one at https://spdx.org/licenses/MIT.html.
 
 #include "matoya.h"
+#include "crypto.h"
 
 #include <ntstatus.h>
 
@@ -13,6 +14,9 @@
 struct MTY_AESGCM {
 	BCRYPT_ALG_HANDLE ahandle;
 	BCRYPT_KEY_HANDLE khandle;
+
+	uint8_t *buf;
+	size_t buf_size;
 };
 
 MTY_AESGCM *MTY_AESGCMCreate(const void *key)
@@ -63,6 +67,7 @@ void MTY_AESGCMDestroy(MTY_AESGCM **aesgcm)
 	if (ctx->ahandle)
 		BCryptCloseAlgorithmProvider(ctx->ahandle, 0);
 
+	MTY_Free(ctx->buf);
 	MTY_Free(ctx);
 	*aesgcm = NULL;
 }
@@ -100,3 +105,45 @@ bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherTex
 
 	return e == STATUS_SUCCESS;
 }
+
+bool mty_aesgcm_packet(MTY_AESGCM *ctx, bool encrypt, const MTY_AESGCMPacket *pkt)
+{
+	// BCrypt works on contiguous buffers, multiple buffers are gathered first
+	size_t size = mty_iov_size(pkt->iov, pkt->iovLen);
+	uint8_t *data = pkt->iovLen == 1 ? pkt->iov[0].data : NULL;
+
+	if (!data) {
+		if (size > ctx->buf_size) {
+			ctx->buf = MTY_Realloc(ctx->buf, size, 1);
+			ctx->buf_size = size;
+		}
+
+		data = ctx->buf;
+		mty_iov_gather(pkt->iov, pkt->iovLen, data);
+	}
+
+	BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO info = {0};
+	BCRYPT_INIT_AUTH_MODE_INFO(info);
+	info.pbNonce = (UCHAR *) pkt->nonce;
+	info.cbNonce = 12;
+	info.pbAuthData = (UCHAR *) pkt->aad;
+	info.cbAuthData = (ULONG) pkt->aadSize;
+	info.pbTag = pkt->tag;
+	info.cbTag = pkt->tagSize;
+
+	// Input and output may be the same buffer
+	ULONG output = 0;
+	NTSTATUS e = encrypt ?
+		BCryptEncrypt(ctx->khandle, data, (ULONG) size, &info, NULL, 0, data, (ULONG) size, &output, 0) :
+		BCryptDecrypt(ctx->khandle, data, (ULONG) size, &info, NULL, 0, data, (ULONG) size, &output, 0);
+
+	if (e != STATUS_SUCCESS) {
+		MTY_Log("'%s' failed with error 0x%X", encrypt ? "BCryptEncrypt" : "BCryptDecrypt", e);
+		return false;
+	}
+
+	if (data == ctx->buf)
+		mty_iov_scatter(pkt->iov, pkt->iovLen, data);
+
+	return true;
+}
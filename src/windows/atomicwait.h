@@ -0,0 +1,32 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#pragma once
+
+#include <windows.h>
+
+#pragma comment(lib, "synchronization")
+
+static bool mty_futex_wait(MTY_Atomic32 *atomic, int32_t value, int32_t timeout)
+{
+	if (!WaitOnAddress(&atomic->value, &value, sizeof(int32_t), timeout < 0 ? INFINITE : timeout)) {
+		DWORD e = GetLastError();
+		if (e != ERROR_TIMEOUT)
+			MTY_LogFatal("'WaitOnAddress' failed with error 0x%X", e);
+
+		return false;
+	}
+
+	return true;
+}
+
+static void mty_futex_wake(MTY_Atomic32 *atomic, bool all)
+{
+	if (all) {
+		WakeByAddressAll((void *) &atomic->value);
+
+	} else {
+		WakeByAddressSingle((void *) &atomic->value);
+	}
+}
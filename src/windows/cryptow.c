@@ -3,6 +3,7 @@
 // You can obtain one at https://spdx.org/licenses/MIT.html.
 
 #include "matoya.h"
+#include "crypto.h"
 
 #include <stdio.h>
 
@@ -10,7 +11,6 @@
 
 #define WIN32_NO_STATUS
 #include <windows.h>
-#include <wincrypt.h>
 #include <bcrypt.h>
 
 
@@ -93,24 +93,102 @@ void MTY_CryptoHash(MTY_Algorithm algo, const void *input, size_t inputSize, con
 	}
 }
 
+struct digest {
+	BCRYPT_ALG_HANDLE ahandle;
+	BCRYPT_HASH_HANDLE hhandle;
+	ULONG size;
+};
 
-// Random
+static bool crypto_digest_begin(struct digest *ctx)
+{
+	NTSTATUS e = BCryptCreateHash(ctx->ahandle, &ctx->hhandle, NULL, 0, NULL, 0, 0);
+	if (e != STATUS_SUCCESS) {
+		MTY_Log("'BCryptCreateHash' failed with error 0x%X", e);
+		return false;
+	}
 
-void MTY_GetRandomBytes(void *buf, size_t size)
+	return true;
+}
+
+struct digest *mty_digest_create(MTY_Algorithm algo)
 {
-	NTSTATUS e = BCryptGenRandom(NULL, buf, (ULONG) size, BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+	struct digest *ctx = MTY_Alloc(1, sizeof(struct digest));
+	ctx->size = algo == MTY_ALGORITHM_SHA1 ? MTY_SHA1_SIZE : MTY_SHA256_SIZE;
+
+	const wchar_t *alg_id = algo == MTY_ALGORITHM_SHA1 ? BCRYPT_SHA1_ALGORITHM : BCRYPT_SHA256_ALGORITHM;
+
+	NTSTATUS e = BCryptOpenAlgorithmProvider(&ctx->ahandle, alg_id, NULL, 0);
+	if (e != STATUS_SUCCESS) {
+		MTY_Log("'BCryptOpenAlgorithmProvider' failed with error 0x%X", e);
+		goto except;
+	}
+
+	if (!crypto_digest_begin(ctx))
+		goto except;
+
+	return ctx;
+
+	except:
+
+	mty_digest_destroy(&ctx);
+
+	return NULL;
+}
+
+void mty_digest_destroy(struct digest **digest)
+{
+	if (!digest || !*digest)
+		return;
+
+	struct digest *ctx = *digest;
+
+	if (ctx->hhandle)
+		BCryptDestroyHash(ctx->hhandle);
+
+	if (ctx->ahandle)
+		BCryptCloseAlgorithmProvider(ctx->ahandle, 0);
+
+	MTY_Free(ctx);
+	*digest = NULL;
+}
+
+void mty_digest_update(struct digest *ctx, const void *input, size_t inputSize)
+{
+	// BCryptHashData takes a ULONG size
+	for (const uint8_t *input8 = input; inputSize > 0;) {
+		ULONG size = inputSize > UINT32_MAX ? UINT32_MAX : (ULONG) inputSize;
+
+		NTSTATUS e = BCryptHashData(ctx->hhandle, (UCHAR *) input8, size, 0);
+		if (e != STATUS_SUCCESS) {
+			MTY_Log("'BCryptHashData' failed with error 0x%X", e);
+			break;
+		}
+
+		input8 += size;
+		inputSize -= size;
+	}
+}
 
+void mty_digest_final(struct digest *ctx, void *output)
+{
+	NTSTATUS e = BCryptFinishHash(ctx->hhandle, output, ctx->size, 0);
 	if (e != STATUS_SUCCESS)
-		MTY_Log("'BCryptGenRandom' failed with error 0x%X", e);
+		MTY_Log("'BCryptFinishHash' failed with error 0x%X", e);
+
+	// A finished hash handle can not be reused before Windows 8
+	BCryptDestroyHash(ctx->hhandle);
+	ctx->hhandle = NULL;
+
+	crypto_digest_begin(ctx);
 }
 
 
-// Base64
+// Random
 
-void MTY_BytesToBase64(const void *bytes, size_t size, char *base64, size_t base64Size)
+void MTY_GetRandomBytes(void *buf, size_t size)
 {
-	DWORD dsize = (DWORD) base64Size;
+	NTSTATUS e = BCryptGenRandom(NULL, buf, (ULONG) size, BCRYPT_USE_SYSTEM_PREFERRED_RNG);
 
-	if (!CryptBinaryToStringA(bytes, (DWORD) size, CRYPT_STRING_BASE64 | CRYPT_STRING_NOCRLF, base64, &dsize))
-		MTY_Log("'CryptBinaryToString' failed with error 0x%X", GetLastError());
+	if (e != STATUS_SUCCESS)
+		MTY_Log("'BCryptGenRandom' failed with error 0x%X", e);
 }
@@ -10,7 +10,7 @@
 #include <shlwapi.h>
 #include <shlobj_core.h>
 
-#include "tlocal.h"
+#include "file.h"
 
 bool MTY_DeleteFile(const char *path)
 {
@@ -234,10 +234,10 @@ static int32_t file_compare(const void *p1, const void *p2)
 
 MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 {
-	void *tmp = MTY_Alloc(0x1000, 1);
-	mty_tlocal_set_mem(tmp, 0x1000);
+	// Keep the thread local results of the caller intact
+	size_t mark = MTY_PushThreadLocal();
 
-	MTY_FileList *fl = MTY_Alloc(1, sizeof(MTY_FileList));
+	MTY_FileList *fl = mty_file_list_create();
 	char *pathd = MTY_Strdup(path);
 
 	WIN32_FIND_DATA ent;
@@ -252,18 +252,11 @@ MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 
 		bool is_dir = ent.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
 
-		if (is_dir || MTY_StrSearch(name, filter ? filter : "", "|")) {
-			fl->files = MTY_Realloc(fl->files, fl->len + 1, sizeof(MTY_FileDesc));
+		if (is_dir || MTY_StrSearch(name, filter ? filter : "", "|"))
+			mty_file_list_append(fl, name, MTY_JoinPath(pathd, name), is_dir,
+				(uint64_t) ent.nFileSizeHigh << 32 | ent.nFileSizeLow);
 
-			fl->files[fl->len].name = name;
-			fl->files[fl->len].path = MTY_Strdup(MTY_JoinPath(pathd, name));
-			fl->files[fl->len].dir = is_dir;
-			fl->files[fl->len].size = (uint64_t) ent.nFileSizeHigh << 32 | ent.nFileSizeLow;
-			fl->len++;
-
-		} else {
-			MTY_Free(name);
-		}
+		MTY_Free(name);
 
 		ok = FindNextFile(dir, &ent);
 
@@ -276,8 +269,7 @@ MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 	if (fl->len > 0)
 		MTY_Sort(fl->files, fl->len, sizeof(MTY_FileDesc), file_compare);
 
-	mty_tlocal_set_mem(NULL, 0);
-	MTY_Free(tmp);
+	MTY_PopThreadLocal(mark);
 
 	return fl;
 }
@@ -10,6 +10,7 @@ GFX_CTX_PROTOTYPES(_d3d11_)
 #include <dxgi1_5.h>
 
 #include "gfx/sync.h"
+#include "alloc.h"
 #include "dxgi-sync.h"
 
 #define DXGI_FATAL(e) ( \
@@ -195,7 +196,7 @@ static bool d3d11_ctx_init(struct d3d11_ctx *ctx)
 
 struct gfx_ctx *mty_d3d11_ctx_create(void *native_window, bool vsync)
 {
-	struct d3d11_ctx *ctx = MTY_Alloc(1, sizeof(struct d3d11_ctx));
+	struct d3d11_ctx *ctx = mty_alloc(1, sizeof(struct d3d11_ctx), MTY_MEMORY_TAG_GFX);
 	ctx->hwnd = (HWND) native_window;
 
 	if (vsync)
@@ -11,6 +11,8 @@ GFX_UI_PROTOTYPES(_d3d11_)
 #define COBJMACROS
 #include <d3d11.h>
 
+#include "alloc.h"
+
 static
 #include "shaders/psui.h"
 
@@ -43,7 +45,7 @@ struct d3d11_ui_cb {
 
 struct gfx_ui *mty_d3d11_ui_create(MTY_Device *device)
 {
-	struct d3d11_ui *ctx = MTY_Alloc(1, sizeof(struct d3d11_ui));
+	struct d3d11_ui *ctx = mty_alloc(1, sizeof(struct d3d11_ui), MTY_MEMORY_TAG_GFX);
 	ID3D11Device *_device = (ID3D11Device *) device;
 
 	// Create vertex, pixel shaders from precompiled data from headers
@@ -11,6 +11,7 @@ GFX_PROTOTYPES(_d3d11_)
 #include "gfx/viewport.h"
 #include "gfx/fmt-dxgi.h"
 #include "gfx/fmt.h"
+#include "alloc.h"
 
 static
 #include "shaders/ps.h"
@@ -49,7 +50,7 @@ struct d3d11 {
 
 struct gfx *mty_d3d11_create(MTY_Device *device, uint8_t layer)
 {
-	struct d3d11 *ctx = MTY_Alloc(1, sizeof(struct d3d11));
+	struct d3d11 *ctx = mty_alloc(1, sizeof(struct d3d11), MTY_MEMORY_TAG_GFX);
 	ID3D11Device *_device = (ID3D11Device *) device;
 
 	HRESULT e = ID3D11Device_CreateVertexShader(_device, vs, sizeof(vs), NULL, &ctx->vs);
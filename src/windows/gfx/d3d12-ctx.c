@@ -10,6 +10,7 @@ GFX_CTX_PROTOTYPES(_d3d12_)
 #include <dxgi1_4.h>
 
 #include "gfx/sync.h"
+#include "alloc.h"
 #include "dxgi-sync.h"
 
 #define DXGI_FATAL(e) ( \
@@ -281,7 +282,7 @@ static void d3d12_ctx_get_size(struct d3d12_ctx *ctx, uint32_t *width, uint32_t
 
 struct gfx_ctx *mty_d3d12_ctx_create(void *native_window, bool vsync)
 {
-	struct d3d12_ctx *ctx = MTY_Alloc(1, sizeof(struct d3d12_ctx));
+	struct d3d12_ctx *ctx = mty_alloc(1, sizeof(struct d3d12_ctx), MTY_MEMORY_TAG_GFX);
 
 	bool r = true;
 
@@ -11,6 +11,8 @@ GFX_UI_PROTOTYPES(_d3d12_)
 #define COBJMACROS
 #include <d3d12.h>
 
+#include "alloc.h"
+
 static
 #include "shaders/psui.h"
 
@@ -49,7 +51,7 @@ struct d3d12_ui_cb {
 
 struct gfx_ui *mty_d3d12_ui_create(MTY_Device *device)
 {
-	struct d3d12_ui *ctx = MTY_Alloc(1, sizeof(struct d3d12_ui));
+	struct d3d12_ui *ctx = mty_alloc(1, sizeof(struct d3d12_ui), MTY_MEMORY_TAG_GFX);
 
 	ID3D12Device *_device = (ID3D12Device *) device;
 
@@ -165,7 +167,7 @@ struct gfx_ui *mty_d3d12_ui_create(MTY_Device *device)
 	}
 
 	// Dummy clear texture
-	void *rgba = MTY_Alloc(256 * 256, 4);
+	void *rgba = mty_alloc(256 * 256, 4, MTY_MEMORY_TAG_GFX);
 	ctx->clear_tex = mty_d3d12_ui_create_texture((struct gfx_ui *) ctx, device, rgba, 256, 256);
 	MTY_Free(rgba);
 
@@ -427,7 +429,7 @@ bool mty_d3d12_ui_render(struct gfx_ui *gfx_ui, MTY_Device *device, MTY_Context
 void *mty_d3d12_ui_create_texture(struct gfx_ui *gfx_ui, MTY_Device *device, const void *rgba,
 	uint32_t width, uint32_t height)
 {
-	struct d3d12_ui_texture *tex = MTY_Alloc(1, sizeof(struct d3d12_ui_texture));
+	struct d3d12_ui_texture *tex = mty_alloc(1, sizeof(struct d3d12_ui_texture), MTY_MEMORY_TAG_GFX);
 
 	ID3D12Device *_device = (ID3D12Device *) device;
 
@@ -11,6 +11,7 @@ GFX_PROTOTYPES(_d3d12_)
 #include "gfx/viewport.h"
 #include "gfx/fmt-dxgi.h"
 #include "gfx/fmt.h"
+#include "alloc.h"
 
 static
 #include "shaders/ps.h"
@@ -203,7 +204,7 @@ static HRESULT d3d12_pipeline(ID3D12Device *device, ID3D12RootSignature *rs, ID3
 
 struct gfx *mty_d3d12_create(MTY_Device *device, uint8_t layer)
 {
-	struct d3d12 *ctx = MTY_Alloc(1, sizeof(struct d3d12));
+	struct d3d12 *ctx = mty_alloc(1, sizeof(struct d3d12), MTY_MEMORY_TAG_GFX);
 
 	ID3D12Device *_device = (ID3D12Device *) device;
 
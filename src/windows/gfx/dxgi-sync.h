@@ -81,7 +81,7 @@ static void *dxgi_sync_thread(void *opaque)
 
 static struct dxgi_sync *dxgi_sync_create(HWND hwnd)
 {
-	struct dxgi_sync *ctx = MTY_Alloc(1, sizeof(struct dxgi_sync));
+	struct dxgi_sync *ctx = mty_alloc(1, sizeof(struct dxgi_sync), MTY_MEMORY_TAG_GFX);
 
 	ctx->event = CreateEvent(NULL, TRUE, FALSE, NULL);
 	if (!ctx->event) {
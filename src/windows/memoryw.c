@@ -10,19 +10,14 @@
 #include <winsock2.h>
 #include <shlwapi.h>
 
-void *MTY_AllocAligned(size_t size, size_t align)
-{
-	void *mem = _aligned_malloc(size, align);
-
-	if (!mem)
-		MTY_LogFatal("'_aligned_malloc' failed");
+#include "alloc.h"
 
-	memset(mem, 0, size);
-
-	return mem;
+void *mty_sys_alloc_aligned(size_t size, size_t align)
+{
+	return _aligned_malloc(size, align);
 }
 
-void MTY_FreeAligned(void *mem)
+void mty_sys_free_aligned(void *mem)
 {
 	_aligned_free(mem);
 }
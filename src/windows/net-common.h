@@ -8,6 +8,7 @@
 #include <winhttp.h>
 
 #include "http.h"
+#include "alloc.h"
 
 #define NET_WS_PING_INTERVAL 60000
 
@@ -26,7 +27,7 @@ static void net_append_header(char **header, const char *name, const char *val)
 	size_t len = *header ? strlen(*header) : 0;
 	size_t new_len = len + strlen(name) + strlen(val) + 32;
 
-	*header = MTY_Realloc(*header, new_len, 1);
+	*header = mty_realloc(*header, new_len, 1, MTY_MEMORY_TAG_HTTP);
 	snprintf(*header + len, new_len, "%s: %s\r\n", name, val);
 }
 
@@ -83,10 +84,10 @@ static bool net_make_args(const char *url, const char *headers, struct net_args
 		return false;
 	}
 
-	args->host = MTY_Alloc(cmp.dwHostNameLength + 1, sizeof(WCHAR));
+	args->host = mty_alloc(cmp.dwHostNameLength + 1, sizeof(WCHAR), MTY_MEMORY_TAG_HTTP);
 	memcpy(args->host, cmp.lpszHostName, cmp.dwHostNameLength * sizeof(WCHAR));
 
-	args->path = MTY_Alloc(cmp.dwUrlPathLength + cmp.dwExtraInfoLength + 1, sizeof(WCHAR));
+	args->path = mty_alloc(cmp.dwUrlPathLength + cmp.dwExtraInfoLength + 1, sizeof(WCHAR), MTY_MEMORY_TAG_HTTP);
 	memcpy(args->path, cmp.lpszUrlPath, cmp.dwUrlPathLength * sizeof(WCHAR));
 	memcpy(args->path + cmp.dwUrlPathLength, cmp.lpszExtraInfo, cmp.dwExtraInfoLength * sizeof(WCHAR));
 
@@ -8,6 +8,7 @@
 #include <stdio.h>
 
 #include "net-common.h"
+#include "alloc.h"
 
 bool MTY_HttpRequest(const char *url, const char *method, const char *headers,
 	const void *body, size_t bodySize, const char *proxy, uint32_t timeout,
@@ -54,7 +55,7 @@ bool MTY_HttpRequest(const char *url, const char *method, const char *headers,
 			goto except;
 		}
 
-		*response = MTY_Realloc(*response, *responseSize + available + 1, 1);
+		*response = mty_realloc(*response, *responseSize + available + 1, 1, MTY_MEMORY_TAG_HTTP);
 
 		DWORD read = 0;
 		r = WinHttpReadData(request, (uint8_t *) *response + *responseSize, available, &read);
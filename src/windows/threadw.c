@@ -8,6 +8,49 @@
 
 #include <windows.h>
 
+#include "alloc.h"
+#include "tlocal.h"
+
+
+// Thread exit
+
+static MTY_Atomic32 THREAD_EXIT_LOCK;
+static DWORD THREAD_EXIT_FLS = FLS_OUT_OF_INDEXES;
+static TLOCAL bool THREAD_EXIT_TRACKED;
+
+static VOID WINAPI thread_exit(PVOID opaque)
+{
+	// Cleanup may use thread local memory again, which tracks the thread once more
+	THREAD_EXIT_TRACKED = false;
+
+	mty_pool_release_thread();
+	mty_log_destroy();
+	mty_tlocal_destroy();
+}
+
+void mty_tlocal_track_thread(void)
+{
+	if (THREAD_EXIT_TRACKED)
+		return;
+
+	// Set first so logging a failure below does not end up back here
+	THREAD_EXIT_TRACKED = true;
+
+	MTY_GlobalLock(&THREAD_EXIT_LOCK);
+
+	if (THREAD_EXIT_FLS == FLS_OUT_OF_INDEXES) {
+		THREAD_EXIT_FLS = FlsAlloc(thread_exit);
+		if (THREAD_EXIT_FLS == FLS_OUT_OF_INDEXES)
+			MTY_LogFatal("'FlsAlloc' failed with error 0x%X", GetLastError());
+	}
+
+	MTY_GlobalUnlock(&THREAD_EXIT_LOCK);
+
+	// Callbacks only run for slots holding a value other than NULL
+	if (!FlsSetValue(THREAD_EXIT_FLS, &THREAD_EXIT_FLS))
+		MTY_LogFatal("'FlsSetValue' failed with error 0x%X", GetLastError());
+}
+
 
 // Thread
 
@@ -123,6 +166,11 @@ void MTY_MutexDestroy(MTY_Mutex **mutex)
 	*mutex = NULL;
 }
 
+void MTY_MutexSetSpin(MTY_Mutex *ctx, uint32_t spin)
+{
+	SetCriticalSectionSpinCount(&ctx->mutex, spin);
+}
+
 void MTY_MutexLock(MTY_Mutex *ctx)
 {
 	EnterCriticalSection(&ctx->mutex);
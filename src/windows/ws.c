@@ -8,6 +8,7 @@
 #include <stdio.h>
 
 #include "net-common.h"
+#include "alloc.h"
 
 #define WS_ALLOC_CHUNK   2048
 
@@ -67,7 +68,7 @@ static void WINAPI ws_async(HINTERNET hInternet, DWORD_PTR dwContext, DWORD dwIn
 			// Add additional buffer space
 			if (status->dwBytesTransferred == ctx->len - ctx->pos) {
 				ctx->len += WS_ALLOC_CHUNK;
-				ctx->buf = MTY_Realloc(ctx->buf, ctx->len, 1);
+				ctx->buf = mty_realloc(ctx->buf, ctx->len, 1, MTY_MEMORY_TAG_HTTP);
 			}
 
 			// Discard binary data
@@ -115,14 +116,14 @@ static void WINAPI ws_async(HINTERNET hInternet, DWORD_PTR dwContext, DWORD dwIn
 MTY_WebSocket *MTY_WebSocketConnect(const char *url, const char *headers, const char *proxy,
 	uint32_t timeout, uint16_t *upgradeStatus)
 {
-	MTY_WebSocket *ctx = MTY_Alloc(1, sizeof(MTY_WebSocket));
+	MTY_WebSocket *ctx = mty_alloc(1, sizeof(MTY_WebSocket), MTY_MEMORY_TAG_HTTP);
 
 	ctx->read_event = MTY_WaitableCreate();
 	ctx->write_event = MTY_WaitableCreate();
 	ctx->close_event = MTY_WaitableCreate();
 
 	ctx->len = WS_ALLOC_CHUNK;
-	ctx->buf = MTY_Alloc(ctx->len, 1);
+	ctx->buf = mty_alloc(ctx->len, 1, MTY_MEMORY_TAG_HTTP);
 
 	HINTERNET session = NULL;
 	HINTERNET connect = NULL;
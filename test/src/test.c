@@ -18,6 +18,7 @@
 
 /// Modules
 #include "test/memory.h"
+#include "test/compress.h"
 #include "test/json.h"
 #include "test/version.h"
 #include "test/time.h"
@@ -40,6 +41,9 @@ int32_t main(int32_t argc, char **argv)
 
 	MTY_SetLogFunc(main_log, NULL);
 
+	// Tests that measure memory read the statistics of the default allocator
+	MTY_SetAllocator(NULL, true);
+
 	if (!json_main())
 		return 1;
 
@@ -61,6 +65,9 @@ int32_t main(int32_t argc, char **argv)
 	if (!memory_main())
 		return 1;
 
+	if (!compress_main())
+		return 1;
+
 	if (!log_main())
 		return 1;
 
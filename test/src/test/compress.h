@@ -0,0 +1,256 @@
+// This Source Code Form is subject to the terms of the MIT License.
+// If a copy of the MIT License was not distributed with this file,
+// You can obtain one at https://spdx.org/licenses/MIT.html.
+
+#define COMPRESS_TEST_SIZE (8 * 1024 * 1024)
+
+static uint32_t compress_test_rand(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+
+	return *state >> 16;
+}
+
+static uint8_t *compress_test_text(size_t size)
+{
+	const char *words[] = {"matoya", "window", "{\"key\": ", "true, ", "frame", "\n",
+		"audio ", "the ", "and ", "1234", "renderer", "compress", "\t", "event"};
+
+	uint8_t *buf = MTY_Alloc(size, 1);
+	uint32_t state = 1;
+
+	for (size_t x = 0; x < size;) {
+		const char *word = words[compress_test_rand(&state) % (sizeof(words) / sizeof(char *))];
+
+		for (size_t y = 0; word[y] && x < size; y++)
+			buf[x++] = word[y];
+	}
+
+	return buf;
+}
+
+static bool compress_roundtrip(MTY_Compression method, const void *buf, size_t size)
+{
+	size_t csize = 0;
+	void *cbuf = MTY_Compress(method, buf, size, &csize);
+	test_cmp("MTY_Compress", cbuf != NULL);
+
+	size_t dsize = 0;
+	void *dbuf = MTY_Decompress(cbuf, csize, &dsize);
+	bool ok = dbuf && dsize == size && !memcmp(buf, dbuf, size);
+
+	MTY_Free(dbuf);
+	MTY_Free(cbuf);
+
+	test_cmp("MTY_Decompress", ok);
+
+	return true;
+}
+
+static bool compress_bench(const char *name, MTY_Compression method, const void *buf, size_t size)
+{
+	int64_t ts = MTY_GetTime();
+	size_t csize = 0;
+	void *cbuf = MTY_Compress(method, buf, size, &csize);
+	float ctime = MTY_TimeDiff(ts, MTY_GetTime());
+
+	ts = MTY_GetTime();
+	size_t dsize = 0;
+	void *dbuf = MTY_Decompress(cbuf, csize, &dsize);
+	float dtime = MTY_TimeDiff(ts, MTY_GetTime());
+
+	bool ok = dbuf && dsize == size && !memcmp(buf, dbuf, size);
+
+	MTY_Free(dbuf);
+	MTY_Free(cbuf);
+
+	float mb = (float) size / (1024.0f * 1024.0f);
+	char label[64];
+
+	test_cmp(name, ok);
+
+	snprintf(label, 64, "%s Ratio", name);
+	test_cmpf(label, csize < size, (double) size / csize);
+
+	snprintf(label, 64, "%s Compress MB/s", name);
+	test_cmpf(label, true, mb / (ctime > 0.0f ? ctime / 1000.0f : 0.001f));
+
+	snprintf(label, 64, "%s Decompress MB/s", name);
+	test_cmpf(label, true, mb / (dtime > 0.0f ? dtime / 1000.0f : 0.001f));
+
+	return true;
+}
+
+static bool compress_stream(uint8_t *text)
+{
+	// A large input produced and consumed in chunks, never held in memory at once
+	size_t total = 64 * 1024 * 1024;
+	size_t chunk = 100003;
+
+	MTY_Compressor *c = MTY_CompressorCreate(MTY_COMPRESSION_FAST);
+	MTY_Decompressor *d = MTY_DecompressorCreate();
+	test_cmp("MTY_CompressorCreate", c != NULL && d != NULL);
+
+	uint8_t cbuf[7777];
+	uint8_t dbuf[5003];
+	uint32_t in_crc = 0;
+	uint32_t out_crc = 0;
+	size_t out_size = 0;
+	size_t csize = 0;
+	bool ok = true;
+
+	for (size_t x = 0, n = chunk; n > 0 && ok; x += n) {
+		n = total - x < chunk ? total - x : chunk;
+
+		const uint8_t *in = text + (x % (COMPRESS_TEST_SIZE - chunk));
+		in_crc = MTY_CRC32(in_crc, in, n);
+
+		if (n == 0)
+			MTY_CompressorFlush(c);
+
+		for (size_t o = 0, pulled = 1; (o < n || n == 0) && pulled > 0 && ok;) {
+			o += MTY_CompressorPush(c, in + o, n - o);
+			pulled = MTY_CompressorPull(c, cbuf, sizeof(cbuf));
+			csize += pulled;
+
+			for (size_t p = 0; p < pulled && ok;) {
+				size_t consumed = 0;
+				ok = MTY_DecompressorPush(d, cbuf + p, pulled - p, &consumed);
+				p += consumed;
+
+				for (size_t y = 1; y > 0;) {
+					y = MTY_DecompressorPull(d, dbuf, sizeof(dbuf));
+					out_crc = MTY_CRC32(out_crc, dbuf, y);
+					out_size += y;
+				}
+			}
+		}
+	}
+
+	test_cmp("MTY_DecompressorPush", ok);
+	test_cmp("MTY_DecompressorDone", MTY_DecompressorDone(d));
+	test_cmp("MTY_DecompressorPull", out_size == total && out_crc == in_crc);
+	test_cmpf("MTY_Compressor Ratio", csize < total, (double) total / csize);
+
+	MTY_DecompressorDestroy(&d);
+	MTY_CompressorDestroy(&c);
+	test_cmp("MTY_CompressorDestroy", c == NULL && d == NULL);
+
+	// Streaming output is readable by MTY_Decompress
+	size_t size = 300000;
+	uint8_t *frame = MTY_Alloc(size, 1);
+	c = MTY_CompressorCreate(MTY_COMPRESSION_HIGH);
+	csize = 0;
+
+	for (size_t o = 0; o < size;) {
+		o += MTY_CompressorPush(c, text + o, size - o);
+		csize += MTY_CompressorPull(c, frame + csize, size - csize);
+	}
+
+	MTY_CompressorFlush(c);
+	test_cmp("MTY_CompressorPush", MTY_CompressorPush(c, text, size) == 0);
+
+	csize += MTY_CompressorPull(c, frame + csize, size - csize);
+	test_cmp("MTY_CompressorPull", MTY_CompressorPull(c, frame, size) == 0);
+	MTY_CompressorDestroy(&c);
+
+	size_t dsize = 0;
+	uint8_t *out = MTY_Decompress(frame, csize, &dsize);
+	ok = out && dsize == size && !memcmp(out, text, size);
+	MTY_Free(out);
+	test_cmp("MTY_Decompress", ok);
+
+	// MTY_Compress output is readable by an MTY_Decompressor, corruption is detected
+	MTY_Free(frame);
+	frame = MTY_Compress(MTY_COMPRESSION_FAST, text, size, &csize);
+	frame[csize - 1] ^= 0x01;
+
+	d = MTY_DecompressorCreate();
+	out = MTY_Alloc(size, 1);
+	dsize = 0;
+
+	for (size_t p = 0; p < csize && ok;) {
+		size_t consumed = 0;
+		ok = MTY_DecompressorPush(d, frame + p, csize - p, &consumed);
+		p += consumed;
+		dsize += MTY_DecompressorPull(d, out + dsize, size - dsize);
+	}
+
+	test_cmp("MTY_DecompressorPush", !ok && !MTY_DecompressorDone(d));
+	test_cmp("MTY_DecompressorPull", dsize == size && !memcmp(out, text, size));
+
+	MTY_DecompressorDestroy(&d);
+	MTY_Free(frame);
+	MTY_Free(out);
+
+	return true;
+}
+
+static bool compress_main(void)
+{
+	uint8_t *text = compress_test_text(COMPRESS_TEST_SIZE);
+
+	// Edge cases
+	if (!compress_roundtrip(MTY_COMPRESSION_FAST, text, 0))
+		return false;
+
+	if (!compress_roundtrip(MTY_COMPRESSION_FAST, text, 1))
+		return false;
+
+	if (!compress_roundtrip(MTY_COMPRESSION_HIGH, text, 7))
+		return false;
+
+	uint8_t *zeros = MTY_Alloc(300000, 1);
+	bool r = compress_roundtrip(MTY_COMPRESSION_HIGH, zeros, 300000);
+	MTY_Free(zeros);
+
+	if (!r)
+		return false;
+
+	// Incompressible data is stored and still roundtrips
+	uint8_t *noise = MTY_Alloc(200000, 1);
+	uint32_t state = 7;
+
+	for (size_t x = 0; x < 200000; x++)
+		noise[x] = (uint8_t) compress_test_rand(&state);
+
+	size_t csize = 0;
+	void *cbuf = MTY_Compress(MTY_COMPRESSION_FAST, noise, 200000, &csize);
+	test_cmp("MTY_Compress", csize < 200000 + 64);
+	MTY_Free(cbuf);
+
+	r = compress_roundtrip(MTY_COMPRESSION_HIGH, noise, 200000);
+	MTY_Free(noise);
+
+	if (!r)
+		return false;
+
+	// Corruption is detected
+	cbuf = MTY_Compress(MTY_COMPRESSION_FAST, text, 100000, &csize);
+	((uint8_t *) cbuf)[csize / 2] ^= 0x55;
+
+	size_t dsize = 0;
+	void *dbuf = MTY_Decompress(cbuf, csize, &dsize);
+	test_cmp("MTY_Decompress", dbuf == NULL);
+
+	dbuf = MTY_Decompress(cbuf, 10, &dsize);
+	test_cmp("MTY_Decompress", dbuf == NULL);
+
+	dbuf = MTY_Decompress(text, 1000, &dsize);
+	test_cmp("MTY_Decompress", dbuf == NULL);
+	MTY_Free(cbuf);
+
+	if (!compress_stream(text))
+		return false;
+
+	// Throughput
+	if (!compress_bench("MTY_COMPRESSION_FAST", MTY_COMPRESSION_FAST, text, COMPRESS_TEST_SIZE))
+		return false;
+
+	if (!compress_bench("MTY_COMPRESSION_HIGH", MTY_COMPRESSION_HIGH, text, COMPRESS_TEST_SIZE))
+		return false;
+
+	MTY_Free(text);
+
+	return true;
+}
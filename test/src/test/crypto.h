@@ -81,6 +81,197 @@ static bool validate_aesgcm()
 	return true;
 }
 
+static bool validate_aesgcm_batch()
+{
+	// Test Case 4 from "The Galois/Counter Mode of Operation (GCM)"
+	uint8_t key[16];
+	uint8_t nonce[12];
+	uint8_t plain[60];
+	uint8_t aad[20];
+	uint8_t cipher[60];
+	uint8_t tag[16];
+
+	MTY_HexToBytes("feffe9928665731c6d6a8f9467308308", key, 16);
+	MTY_HexToBytes("cafebabefacedbaddecaf888", nonce, 12);
+	MTY_HexToBytes("feedfacedeadbeeffeedfacedeadbeefabaddad2", aad, 20);
+	MTY_HexToBytes("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+		"1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39", plain, 60);
+	MTY_HexToBytes("42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+		"21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091", cipher, 60);
+	MTY_HexToBytes("5bc94fbc3221a5db94fae95ae7121a47", tag, 16);
+
+	MTY_AESGCM *aes = MTY_AESGCMCreate(key);
+	test_cmp("MTY_AESGCMCreate", aes != NULL);
+
+	// Split across buffers that do not line up with AES blocks
+	uint8_t data[60];
+	memcpy(data, plain, 60);
+
+	MTY_IOVec iov[3] = {{data, 7}, {data + 7, 0}, {data + 7, 53}};
+	uint8_t ptag[16];
+
+	MTY_AESGCMPacket pkt = {0};
+	pkt.nonce = nonce;
+	pkt.aad = aad;
+	pkt.aadSize = 20;
+	pkt.iov = iov;
+	pkt.iovLen = 3;
+	pkt.tag = ptag;
+	pkt.tagSize = 16;
+
+	bool ok = MTY_AESGCMEncryptBatch(aes, &pkt, 1);
+	test_cmp("MTY_AESGCMEncryptBatch", ok && pkt.ok && !memcmp(data, cipher, 60) && !memcmp(ptag, tag, 16));
+
+	ok = MTY_AESGCMDecryptBatch(aes, &pkt, 1);
+	test_cmp("MTY_AESGCMDecryptBatch", ok && pkt.ok && !memcmp(data, plain, 60));
+
+	// Truncated tags are a prefix of the full tag
+	pkt.tagSize = 12;
+	MTY_AESGCMEncryptBatch(aes, &pkt, 1);
+	test_cmp("MTY_AESGCMEncryptBatch (Truncated)", pkt.ok && !memcmp(ptag, tag, 12));
+
+	// Modified AAD -- fail
+	aad[0] = ~aad[0];
+	ok = MTY_AESGCMDecryptBatch(aes, &pkt, 1);
+	test_cmp("MTY_AESGCMDecryptBatch (AAD)", !ok && !pkt.ok);
+	aad[0] = ~aad[0];
+
+	pkt.tagSize = 11;
+	ok = MTY_AESGCMEncryptBatch(aes, &pkt, 1);
+	test_cmp("MTY_AESGCMEncryptBatch (Tag Size)", !ok && !pkt.ok);
+
+	// Sizes around the 8 block (128 byte) bulk loop, tags from OpenSSL's EVP_aes_128_gcm
+	// with the same key and nonce. Each packet runs once whole and once split mid block
+	const struct {
+		size_t size;
+		size_t aadSize;
+		const char *tag;
+	} long_vectors[] = {
+		{127, 20,  "f90bfa692a7abe15fb87512b684b9f5a"},
+		{128, 45,  "94eef604007c90c73dfa85abc0f39bbe"},
+		{129, 45,  "3b1e96474b0000b971925f953945dc67"},
+		{255, 0,   "65885937d965ce6262f1035fafc52ce3"},
+		{256, 200, "1402b9f4f1673162fda2e38c6e00de53"},
+		{257, 45,  "3471f4240157fb1a190ec60896d87d58"},
+		{1000, 45, "230d3040693940170506d8caf7943a16"},
+	};
+
+	uint8_t long_plain[1000];
+	uint8_t long_data[1000];
+	uint8_t long_aad[200];
+
+	for (uint32_t x = 0; x < 1000; x++)
+		long_plain[x] = (uint8_t) (x * 31 + 7);
+
+	for (uint32_t x = 0; x < 200; x++)
+		long_aad[x] = (uint8_t) (x * 13 + 1);
+
+	bool long_ok = true;
+
+	for (uint32_t x = 0; x < sizeof(long_vectors) / sizeof(long_vectors[0]); x++) {
+		size_t size = long_vectors[x].size;
+		MTY_HexToBytes(long_vectors[x].tag, tag, 16);
+
+		for (uint32_t y = 0; y < 2; y++) {
+			memcpy(long_data, long_plain, size);
+
+			MTY_IOVec liov[2] = {{long_data, y == 0 ? size : 7}, {long_data + 7, y == 0 ? 0 : size - 7}};
+
+			pkt.aad = long_vectors[x].aadSize > 0 ? long_aad : NULL;
+			pkt.aadSize = long_vectors[x].aadSize;
+			pkt.iov = liov;
+			pkt.iovLen = 2;
+			pkt.tagSize = 16;
+
+			long_ok = long_ok && MTY_AESGCMEncryptBatch(aes, &pkt, 1) && !memcmp(ptag, tag, 16);
+			long_ok = long_ok && MTY_AESGCMDecryptBatch(aes, &pkt, 1) && !memcmp(long_data, long_plain, size);
+		}
+	}
+
+	test_cmp("MTY_AESGCMEncryptBatch (Long)", long_ok);
+
+	// Packets from a batch match single calls, one bad packet does not affect the rest
+	const uint32_t BATCH_PACKETS = 64;
+	const size_t BATCH_SIZE = 1200;
+
+	uint8_t *bufs = MTY_Alloc(BATCH_PACKETS, BATCH_SIZE);
+	uint8_t *single = MTY_Alloc(BATCH_PACKETS, BATCH_SIZE);
+	uint8_t *nonces = MTY_Alloc(BATCH_PACKETS, 12);
+	uint8_t *tags = MTY_Alloc(BATCH_PACKETS, 16);
+	uint8_t *stags = MTY_Alloc(BATCH_PACKETS, 16);
+	MTY_IOVec *piov = MTY_Alloc(BATCH_PACKETS, sizeof(MTY_IOVec));
+	MTY_AESGCMPacket *pkts = MTY_Alloc(BATCH_PACKETS, sizeof(MTY_AESGCMPacket));
+
+	MTY_GetRandomBytes(bufs, BATCH_PACKETS * BATCH_SIZE);
+	MTY_GetRandomBytes(nonces, BATCH_PACKETS * 12);
+
+	bool match = true;
+
+	for (uint32_t x = 0; x < BATCH_PACKETS; x++) {
+		piov[x].data = bufs + x * BATCH_SIZE;
+		piov[x].size = BATCH_SIZE - x;
+
+		pkts[x].nonce = nonces + x * 12;
+		pkts[x].iov = &piov[x];
+		pkts[x].iovLen = 1;
+		pkts[x].tag = tags + x * 16;
+		pkts[x].tagSize = 16;
+
+		MTY_AESGCMEncrypt(aes, pkts[x].nonce, piov[x].data, piov[x].size, stags + x * 16, single + x * BATCH_SIZE);
+	}
+
+	ok = MTY_AESGCMEncryptBatch(aes, pkts, BATCH_PACKETS);
+
+	for (uint32_t x = 0; x < BATCH_PACKETS; x++)
+		match = match && !memcmp(bufs + x * BATCH_SIZE, single + x * BATCH_SIZE, piov[x].size) &&
+			!memcmp(tags + x * 16, stags + x * 16, 16);
+
+	test_cmp("MTY_AESGCMEncryptBatch", ok && match);
+
+	tags[5 * 16] ^= 1;
+	ok = MTY_AESGCMDecryptBatch(aes, pkts, BATCH_PACKETS);
+
+	bool others = true;
+	for (uint32_t x = 0; x < BATCH_PACKETS; x++)
+		others = others && (x == 5 ? !pkts[x].ok : pkts[x].ok);
+
+	test_cmp("MTY_AESGCMDecryptBatch", !ok && others);
+
+	// Throughput
+	for (uint32_t x = 0; x < BATCH_PACKETS; x++)
+		piov[x].size = BATCH_SIZE;
+
+	const uint32_t iters = 2000;
+	MTY_Time ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < iters; x++)
+		MTY_AESGCMEncryptBatch(aes, pkts, BATCH_PACKETS);
+
+	float batch_ms = MTY_TimeDiff(ts, MTY_GetTime());
+	ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < iters; x++)
+		for (uint32_t y = 0; y < BATCH_PACKETS; y++)
+			MTY_AESGCMEncrypt(aes, pkts[y].nonce, piov[y].data, BATCH_SIZE, pkts[y].tag, single + y * BATCH_SIZE);
+
+	float single_ms = MTY_TimeDiff(ts, MTY_GetTime());
+
+	test_cmpf("MTY_AESGCMEncryptBatch 1200 bytes (Mpkt/s)", true, BATCH_PACKETS * iters / batch_ms / 1000.0f);
+	test_cmpf("MTY_AESGCMEncrypt 1200 bytes (Mpkt/s)", true, BATCH_PACKETS * iters / single_ms / 1000.0f);
+
+	MTY_Free(bufs);
+	MTY_Free(single);
+	MTY_Free(nonces);
+	MTY_Free(tags);
+	MTY_Free(stags);
+	MTY_Free(piov);
+	MTY_Free(pkts);
+
+	MTY_AESGCMDestroy(&aes);
+
+	return true;
+}
+
 static bool validate_random()
 {
 	int32_t random_size = 1 * 1024 * 1024;
@@ -246,6 +437,223 @@ static bool validate_cryptohash()
 	return true;
 }
 
+static bool validate_hashctx()
+{
+	const MTY_Algorithm algos[] = {MTY_ALGORITHM_SHA1, MTY_ALGORITHM_SHA256, MTY_ALGORITHM_SHA256_HEX};
+
+	// Keys shorter and longer than the block size
+	uint8_t key[131];
+	for (uint8_t x = 0; x < 131; x++)
+		key[x] = x;
+
+	const size_t key_sizes[] = {0, 20, 131};
+
+	size_t size = 100003;
+	uint8_t *buf = MTY_Alloc(size, 1);
+	MTY_GetRandomBytes(buf, size);
+
+	bool ok = true;
+
+	for (uint8_t x = 0; x < 3; x++) {
+		for (uint8_t y = 0; y < 3; y++) {
+			char expected[MTY_SHA256_HEX_MAX] = {0};
+			MTY_CryptoHash(algos[x], buf, size, key, key_sizes[y], expected, MTY_SHA256_HEX_MAX);
+
+			MTY_HashCtx *ctx = MTY_HashCtxCreate(algos[x], key, key_sizes[y]);
+
+			// Finalizing resets the context, so the second pass must give the same result
+			for (uint8_t z = 0; z < 2; z++) {
+				for (size_t offset = 0, n = 1; offset < size; offset += n, n = n * 3 + 1) {
+					if (n > size - offset)
+						n = size - offset;
+
+					MTY_HashCtxUpdate(ctx, buf + offset, n);
+				}
+
+				char output[MTY_SHA256_HEX_MAX] = {0};
+				MTY_HashCtxFinal(ctx, output, MTY_SHA256_HEX_MAX);
+
+				ok = ok && !memcmp(expected, output, MTY_SHA256_HEX_MAX);
+			}
+
+			MTY_HashCtxDestroy(&ctx);
+		}
+	}
+
+	test_cmp("MTY_HashCtxUpdate", ok);
+
+	char hmac[MTY_SHA256_HEX_MAX] = {0};
+	MTY_HashCtx *ctx = MTY_HashCtxCreate(MTY_ALGORITHM_SHA256_HEX, "Jefe", 4);
+	MTY_HashCtxUpdate(ctx, "what do ya want ", 16);
+	MTY_HashCtxUpdate(ctx, "for nothing?", 12);
+	MTY_HashCtxFinal(ctx, hmac, MTY_SHA256_HEX_MAX);
+	MTY_HashCtxDestroy(&ctx);
+	test_cmp_("MTY_HashCtxFinal", !strcmp(hmac, "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"), hmac, ": \"%s\"");
+
+	// Files are hashed in chunks
+	const char *path = "test_hash.bin";
+
+	MTY_WriteFile(path, "", 0);
+	ok = MTY_CryptoHashFile(MTY_ALGORITHM_SHA1_HEX, path, NULL, 0, hmac, MTY_SHA256_HEX_MAX);
+	test_cmp_("MTY_CryptoHashFile (Empty)", ok && !strcmp(hmac, "da39a3ee5e6b4b0d3255bfef95601890afd80709"), hmac, ": \"%s\"");
+
+	MTY_Free(buf);
+	size = 64 * 1024 * 1024 + 3;
+	buf = MTY_Alloc(size, 1);
+	MTY_GetRandomBytes(buf, 1024 * 1024);
+
+	for (size_t x = 1024 * 1024; x < size; x++)
+		buf[x] = buf[x - 1024 * 1024] ^ (uint8_t) (x >> 20);
+
+	MTY_WriteFile(path, buf, size);
+
+	uint8_t expected[MTY_SHA256_SIZE] = {0};
+	uint8_t output[MTY_SHA256_SIZE] = {0};
+	MTY_CryptoHash(MTY_ALGORITHM_SHA256, buf, size, key, 20, expected, MTY_SHA256_SIZE);
+	MTY_Free(buf);
+
+	MTY_Time ts = MTY_GetTime();
+	ok = MTY_CryptoHashFile(MTY_ALGORITHM_SHA256, path, key, 20, output, MTY_SHA256_SIZE);
+	float ms = MTY_TimeDiff(ts, MTY_GetTime());
+
+	MTY_DeleteFile(path);
+
+	test_cmp("MTY_CryptoHashFile", ok && !memcmp(expected, output, MTY_SHA256_SIZE));
+	test_cmpf("MTY_CryptoHashFile (MB/s)", true, 64.0 / (ms / 1000.0));
+
+	return true;
+}
+
+static const struct {
+	size_t size;
+	uint64_t seed;
+	uint64_t h64;
+	uint64_t h128[2];
+} HASH64_VECTORS[] = {
+	{0, 0x0000000000000000ull, 0x2D06800538D394C2ull, {0x6001C324468D497Full, 0x99AA06D3014798D8ull}},
+	{1, 0x0000000000000000ull, 0x324714F62FCA15CEull, {0x324714F62FCA15CEull, 0xF5950428E527E5BAull}},
+	{3, 0x0000000000000000ull, 0xBA1F63906A243FE3ull, {0xBA1F63906A243FE3ull, 0x9E43192BAA7C6AC5ull}},
+	{4, 0x0000000000000000ull, 0x485DC06788E22938ull, {0xC1F521BBE4D6CEA7ull, 0x8046BC63DFCC2087ull}},
+	{8, 0x0000000000000000ull, 0xFC9C51157F9DC270ull, {0xAB75705D5F1601D0ull, 0xFB68A18F00D5A259ull}},
+	{9, 0x0000000000000000ull, 0x488CC492D0C67CAEull, {0xCA75836A063D7F5Aull, 0xB7B32F87E3967CADull}},
+	{16, 0x0000000000000000ull, 0xF36A7B9E4142BEFBull, {0x0B5AA12589656B9Dull, 0xB9A9DA162F904509ull}},
+	{17, 0x0000000000000000ull, 0x09556BC305612284ull, {0xE554430AC879D960ull, 0xC2F808C0CB50A0FAull}},
+	{128, 0x0000000000000000ull, 0xFBDE93D30EDBA066ull, {0x54BDBD51C69322B6ull, 0xAA14E5172F0993E2ull}},
+	{129, 0x0000000000000000ull, 0x7ABFF83234EEC985ull, {0x4E749970AA17B857ull, 0x43E94C4A81AEAEE0ull}},
+	{240, 0x0000000000000000ull, 0x5C2EA2814DFD07D9ull, {0xD9DE4149DC8E6783ull, 0x7EA8CBDE183E55A3ull}},
+	{241, 0x0000000000000000ull, 0x713A7042EA992FCCull, {0x713A7042EA992FCCull, 0x66254C63F3889C75ull}},
+	{1024, 0x0000000000000000ull, 0x2B86D47A4334DAE8ull, {0x2B86D47A4334DAE8ull, 0xD71909AC3456ACFAull}},
+	{1025, 0x0000000000000000ull, 0x29B36D87F48EFAA2ull, {0x29B36D87F48EFAA2ull, 0x2AE48D71D47CB5C4ull}},
+	{4096, 0x0000000000000000ull, 0xD18BBD493556B42Cull, {0xD18BBD493556B42Cull, 0xC834335B7F4BDCA2ull}},
+	{100000, 0x0000000000000000ull, 0x295F7A524D12F953ull, {0x295F7A524D12F953ull, 0x0276836E42522F36ull}},
+	{0, 0x9E3779B97F4A7C15ull, 0x602B0E2CD6662C8Bull, {0x4CA5176998171787ull, 0xD142977A2CCA554Bull}},
+	{1, 0x9E3779B97F4A7C15ull, 0xB9173778BA46D55Dull, {0xB9173778BA46D55Dull, 0xEDA9A492B0498300ull}},
+	{3, 0x9E3779B97F4A7C15ull, 0x99F6815BD998E883ull, {0x99F6815BD998E883ull, 0x39666567A9B2D3CBull}},
+	{4, 0x9E3779B97F4A7C15ull, 0x1C644774EF2D47C6ull, {0x28731FA3DAA59953ull, 0x5EDD106A9B037954ull}},
+	{8, 0x9E3779B97F4A7C15ull, 0x053A7C44D4054A32ull, {0xB7C92E9BE5ADB69Eull, 0xE95DB3CBF964234Aull}},
+	{9, 0x9E3779B97F4A7C15ull, 0xD5A79E11EEB2CE38ull, {0x38513F1D7C84B30Bull, 0x92202209C8AEDC8Dull}},
+	{16, 0x9E3779B97F4A7C15ull, 0x4A3D1A29B5607A21ull, {0x26EA8F960AF53ED4ull, 0xFD7CFD63C50E7013ull}},
+	{17, 0x9E3779B97F4A7C15ull, 0xC5B71552456AC26Full, {0xA0A62481AE8E1C31ull, 0x5F93BE360DFA9013ull}},
+	{128, 0x9E3779B97F4A7C15ull, 0xDCB313FCF57E4AC0ull, {0x55FFCB823A77EB26ull, 0xAF66ABFA2BA36690ull}},
+	{129, 0x9E3779B97F4A7C15ull, 0x15D97BE63B76FF25ull, {0x01BF7BC8A64B126Aull, 0x97006A51E7D87AE3ull}},
+	{240, 0x9E3779B97F4A7C15ull, 0xCC6E9FB6086CFEFEull, {0xA21B398A232B6D13ull, 0x5CEED905859D36B2ull}},
+	{241, 0x9E3779B97F4A7C15ull, 0xF3C29E7945D7932Bull, {0xF3C29E7945D7932Bull, 0xCA17B104E407398Cull}},
+	{1024, 0x9E3779B97F4A7C15ull, 0xD9A308A1DB330A01ull, {0xD9A308A1DB330A01ull, 0xCB43FFC357061AF9ull}},
+	{1025, 0x9E3779B97F4A7C15ull, 0x243487A45F849B98ull, {0x243487A45F849B98ull, 0x375A6BBC6BE7CA8Full}},
+	{4096, 0x9E3779B97F4A7C15ull, 0xFE7E4EA9AF5D37F4ull, {0xFE7E4EA9AF5D37F4ull, 0xF378F2E76DA2261Cull}},
+	{100000, 0x9E3779B97F4A7C15ull, 0x155BEDCEA08764EEull, {0x155BEDCEA08764EEull, 0xE8352EFF409F98DAull}},
+};
+
+static bool validate_hash64()
+{
+	// Same byte sequence as was used to generate the vectors with xxHash
+	size_t size = 100000;
+	uint8_t *buf = MTY_Alloc(size + 1, 1);
+
+	uint64_t state = 0;
+	for (size_t x = 0; x < size; x++) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		buf[x] = (uint8_t) (state >> 56);
+	}
+
+	bool ok64 = true;
+	bool ok128 = true;
+	bool ok_stream = true;
+
+	MTY_HashStream *stream = MTY_HashStreamCreate(0);
+
+	for (size_t x = 0; x < sizeof(HASH64_VECTORS) / sizeof(HASH64_VECTORS[0]); x++) {
+		size_t n = HASH64_VECTORS[x].size;
+		uint64_t seed = HASH64_VECTORS[x].seed;
+
+		uint64_t h128[2] = {0};
+		MTY_Hash128(buf, n, seed, h128);
+
+		ok64 = ok64 && MTY_Hash64(buf, n, seed) == HASH64_VECTORS[x].h64;
+		ok128 = ok128 && h128[0] == HASH64_VECTORS[x].h128[0] && h128[1] == HASH64_VECTORS[x].h128[1];
+
+		// Uneven pieces cross the internal buffer and block boundaries
+		MTY_HashStreamReset(stream, seed);
+
+		for (size_t offset = 0, chunk = 1; offset < n; offset += chunk, chunk = chunk * 2 + 7) {
+			if (chunk > n - offset)
+				chunk = n - offset;
+
+			MTY_HashStreamUpdate(stream, buf + offset, chunk);
+		}
+
+		MTY_HashStreamGet128(stream, h128);
+
+		ok_stream = ok_stream && MTY_HashStreamGet64(stream) == HASH64_VECTORS[x].h64 &&
+			h128[0] == HASH64_VECTORS[x].h128[0] && h128[1] == HASH64_VECTORS[x].h128[1];
+	}
+
+	test_cmp("MTY_Hash64", ok64);
+	test_cmp("MTY_Hash128", ok128);
+
+	// Every size one byte at a time and all at once
+	MTY_HashStreamReset(stream, 7);
+
+	for (size_t x = 0; x < 3000 && ok_stream; x++) {
+		ok_stream = MTY_HashStreamGet64(stream) == MTY_Hash64(buf, x, 7);
+		MTY_HashStreamUpdate(stream, buf + x, 1);
+	}
+
+	MTY_HashStreamDestroy(&stream);
+	test_cmp("MTY_HashStreamUpdate", ok_stream && !stream);
+
+	// Throughput against MTY_DJB2 on long keys
+	const size_t key_size = 4096;
+	const uint32_t iters = 20000;
+
+	for (size_t x = 0; x < key_size; x++)
+		buf[x] = 'a' + buf[x] % 26;
+
+	buf[key_size] = '\0';
+
+	uint64_t sink = 0;
+	MTY_Time ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < iters; x++)
+		sink += MTY_DJB2((char *) buf + (x & 7));
+
+	float djb2_ms = MTY_TimeDiff(ts, MTY_GetTime());
+	ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < iters; x++)
+		sink += MTY_Hash64(buf + (x & 7), key_size - (x & 7), 0);
+
+	float hash64_ms = MTY_TimeDiff(ts, MTY_GetTime());
+
+	float gbs = (float) key_size * iters / (hash64_ms / 1000.0f) / (1024.0f * 1024.0f * 1024.0f);
+	test_cmpf("MTY_Hash64 4KB keys (GB/s)", sink != 0, gbs);
+	test_cmpf("MTY_Hash64 vs MTY_DJB2 (x)", true, djb2_ms / hash64_ms);
+
+	MTY_Free(buf);
+
+	return true;
+}
+
 static bool validate_djb2()
 {
 	uint32_t crc = MTY_DJB2("123456789");
@@ -259,6 +667,20 @@ static bool validate_djb2()
 
 }
 
+static uint32_t crc_bitwise(uint32_t poly, uint32_t crc, const uint8_t *buf, size_t size)
+{
+	crc = ~crc;
+
+	for (size_t x = 0; x < size; x++) {
+		crc ^= buf[x];
+
+		for (uint8_t y = 0; y < 8; y++)
+			crc = crc & 1 ? crc >> 1 ^ poly : crc >> 1;
+	}
+
+	return ~crc;
+}
+
 static bool validate_crc32()
 {
 	uint32_t crc = MTY_CRC32(0, "123456789", 9);
@@ -268,6 +690,205 @@ static bool validate_crc32()
 	crc = MTY_CRC32(0, "", 0);
 	test_cmp_("CRC32 3", crc == 0x00000000, "", ": \"%s\"");
 
+	crc = MTY_CRC32C(0, "123456789", 9);
+	test_cmp_("CRC32C 1", crc == 0xe3069283, "123456789", ": \"%s\"");
+	crc = MTY_CRC32C(0, "The quick brown fox jumps over the lazy dog", 43);
+	test_cmp_("CRC32C 2", crc == 0x22620404, "The quick brown fox jumps over the lazy dog", ": \"%s\"");
+	crc = MTY_CRC32C(0, "", 0);
+	test_cmp_("CRC32C 3", crc == 0x00000000, "", ": \"%s\"");
+
+	// Every size and alignment matches a bit at a time, as does chaining calls
+	uint8_t *buf = MTY_Alloc(8 * 1024 * 1024 + 16, 1);
+	MTY_GetRandomBytes(buf, 8 * 1024 * 1024 + 16);
+
+	bool ok = true;
+	for (size_t x = 0; x < 2000 && ok; x++) {
+		uint32_t seed = (uint32_t) x * 0x9E3779B9;
+		const uint8_t *in = buf + x % 16;
+
+		ok = MTY_CRC32(seed, in, x) == crc_bitwise(0xEDB88320, seed, in, x);
+		ok = ok && MTY_CRC32C(seed, in, x) == crc_bitwise(0x82F63B78, seed, in, x);
+		ok = ok && MTY_CRC32(MTY_CRC32(seed, in, x / 3), in + x / 3, x - x / 3) == MTY_CRC32(seed, in, x);
+		ok = ok && MTY_CRC32C(MTY_CRC32C(seed, in, x / 3), in + x / 3, x - x / 3) == MTY_CRC32C(seed, in, x);
+	}
+
+	test_cmp("MTY_CRC32", ok && MTY_CRC32(0, buf, 100003) == crc_bitwise(0xEDB88320, 0, buf, 100003));
+	test_cmp("MTY_CRC32C", ok && MTY_CRC32C(0, buf, 100003) == crc_bitwise(0x82F63B78, 0, buf, 100003));
+
+	// Throughput
+	const size_t sizes[] = {64, 1024, 64 * 1024, 8 * 1024 * 1024};
+
+	for (uint8_t x = 0; x < 4; x++) {
+		size_t n = 256 * 1024 * 1024 / sizes[x];
+		float ms[2] = {0};
+
+		for (uint8_t y = 0; y < 2; y++) {
+			MTY_Time ts = MTY_GetTime();
+
+			for (size_t z = 0; z < n; z++)
+				crc = y == 0 ? MTY_CRC32(crc, buf, sizes[x]) : MTY_CRC32C(crc, buf, sizes[x]);
+
+			ms[y] = MTY_TimeDiff(ts, MTY_GetTime());
+		}
+
+		char label[64];
+		snprintf(label, 64, "MTY_CRC32 %zu bytes (GB/s)", sizes[x]);
+		test_cmpf(label, true, 0.25 / (ms[0] / 1000.0));
+
+		snprintf(label, 64, "MTY_CRC32C %zu bytes (GB/s)", sizes[x]);
+		test_cmpf(label, true, 0.25 / (ms[1] / 1000.0));
+	}
+
+	MTY_Free(buf);
+
+	return true;
+}
+
+static void base64_ref(const uint8_t *in, size_t size, char *out)
+{
+	const char *table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	for (size_t x = 0; x < size; x += 3) {
+		size_t n = size - x < 3 ? size - x : 3;
+		uint32_t v = in[x] << 16 | (n > 1 ? in[x + 1] << 8 : 0) | (n > 2 ? in[x + 2] : 0);
+
+		*out++ = table[v >> 18];
+		*out++ = table[v >> 12 & 0x3F];
+		*out++ = n > 1 ? table[v >> 6 & 0x3F] : '=';
+		*out++ = n > 2 ? table[v & 0x3F] : '=';
+	}
+
+	*out = '\0';
+}
+
+static bool validate_encoding()
+{
+	// RFC 4648 test vectors
+	const char *vectors[7][2] = {
+		{"", ""},
+		{"f", "Zg=="},
+		{"fo", "Zm8="},
+		{"foo", "Zm9v"},
+		{"foob", "Zm9vYg=="},
+		{"fooba", "Zm9vYmE="},
+		{"foobar", "Zm9vYmFy"},
+	};
+
+	for (uint8_t x = 0; x < 7; x++) {
+		char b64[16];
+		MTY_BytesToBase64(vectors[x][0], strlen(vectors[x][0]), b64, 16);
+		test_cmp_("MTY_BytesToBase64", !strcmp(b64, vectors[x][1]), b64, ": \"%s\"");
+
+		char out[16] = {0};
+		size_t written = 0;
+		bool ok = MTY_Base64ToBytes(vectors[x][1], out, 16, &written);
+		test_cmp_("MTY_Base64ToBytes", ok && written == strlen(vectors[x][0]) && !strcmp(out, vectors[x][0]), out, ": \"%s\"");
+	}
+
+	uint8_t out[8];
+	size_t written = 0;
+	test_cmp("MTY_Base64ToBytes (Unpadded)", MTY_Base64ToBytes("Zm9vYmE", out, 8, &written) && written == 5 && !memcmp(out, "fooba", 5));
+	test_cmp("MTY_Base64ToBytes (Invalid)", !MTY_Base64ToBytes("Zm9v*mFy", out, 8, NULL));
+	test_cmp("MTY_Base64ToBytes (Length)", !MTY_Base64ToBytes("Zm9vY", out, 8, NULL));
+	test_cmp("MTY_Base64ToBytes (Padding)", !MTY_Base64ToBytes("Zg=", out, 8, NULL));
+	test_cmp("MTY_Base64ToBytes (Size)", !MTY_Base64ToBytes("Zm9vYmFy", out, 5, NULL));
+
+	char hex[16];
+	MTY_BytesToHex("\x01\xAB\xFF", 3, hex, 16);
+	test_cmp_("MTY_BytesToHex", !strcmp(hex, "01abff"), hex, ": \"%s\"");
+	MTY_BytesToHex("\x01\xAB\xFF", 3, hex, 6);
+	test_cmp_("MTY_BytesToHex (Truncated)", !strcmp(hex, "01ab"), hex, ": \"%s\"");
+
+	memset(out, 0, 8);
+	MTY_HexToBytes("01aBfF", out, 8);
+	test_cmp("MTY_HexToBytes", !memcmp(out, "\x01\xAB\xFF", 3));
+
+	// Every size across the SIMD block boundaries at unaligned offsets
+	const size_t max = 300;
+	uint8_t *buf = MTY_Alloc(max + 16, 1);
+	uint8_t *dec = MTY_Alloc(max + 16, 1);
+	char *enc = MTY_Alloc(max * 2 + 16, 1);
+	char *ref = MTY_Alloc(max * 2 + 16, 1);
+	MTY_GetRandomBytes(buf, max + 16);
+
+	bool ok_b64 = true;
+	bool ok_hex = true;
+
+	for (size_t x = 0; x <= max; x++) {
+		const uint8_t *in = buf + x % 16;
+
+		base64_ref(in, x, ref);
+		MTY_BytesToBase64(in, x, enc + x % 7, max * 2 + 9);
+		ok_b64 = ok_b64 && !strcmp(enc + x % 7, ref);
+		ok_b64 = ok_b64 && MTY_Base64ToBytes(enc + x % 7, dec + x % 5, x, &written);
+		ok_b64 = ok_b64 && written == x && !memcmp(dec + x % 5, in, x);
+
+		MTY_BytesToHex(in, x, enc + x % 7, max * 2 + 9);
+		ok_hex = ok_hex && strlen(enc + x % 7) == x * 2;
+		MTY_HexToBytes(enc + x % 7, dec + x % 5, x);
+		ok_hex = ok_hex && !memcmp(dec + x % 5, in, x);
+	}
+
+	test_cmp("MTY_Base64ToBytes (Round Trip)", ok_b64);
+	test_cmp("MTY_HexToBytes (Round Trip)", ok_hex);
+
+	// An invalid character deep inside of a long string
+	base64_ref(buf, 240, ref);
+	ref[200] = '.';
+	test_cmp("MTY_Base64ToBytes (Invalid)", !MTY_Base64ToBytes(ref, dec, max, NULL));
+
+	MTY_Free(buf);
+	MTY_Free(dec);
+	MTY_Free(enc);
+	MTY_Free(ref);
+
+	// Throughput
+	const size_t size = 64 * 1024;
+	const uint32_t iters = 4000;
+
+	buf = MTY_Alloc(size, 1);
+	enc = MTY_Alloc(size * 2 + 1, 1);
+	MTY_GetRandomBytes(buf, size);
+
+	float ms[4] = {0};
+	MTY_Time ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < iters; x++)
+		MTY_BytesToBase64(buf, size, enc, size * 2 + 1);
+
+	ms[0] = MTY_TimeDiff(ts, MTY_GetTime());
+	ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < iters; x++)
+		MTY_Base64ToBytes(enc, buf, size, NULL);
+
+	ms[1] = MTY_TimeDiff(ts, MTY_GetTime());
+	ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < iters; x++)
+		MTY_BytesToHex(buf, size, enc, size * 2 + 1);
+
+	ms[2] = MTY_TimeDiff(ts, MTY_GetTime());
+	ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < iters; x++)
+		MTY_HexToBytes(enc, buf, size);
+
+	ms[3] = MTY_TimeDiff(ts, MTY_GetTime());
+
+	const char *labels[4] = {
+		"MTY_BytesToBase64 (GB/s)",
+		"MTY_Base64ToBytes (GB/s)",
+		"MTY_BytesToHex (GB/s)",
+		"MTY_HexToBytes (GB/s)",
+	};
+
+	for (uint8_t x = 0; x < 4; x++)
+		test_cmpf(labels[x], true, (float) size * iters / (ms[x] / 1000.0f) / (1024.0f * 1024.0f * 1024.0f));
+
+	MTY_Free(buf);
+	MTY_Free(enc);
+
 	return true;
 }
 
@@ -279,14 +900,26 @@ static bool crypto_main()
 	if (!validate_djb2())
 		return false;
 
+	if (!validate_hash64())
+		return false;
+
+	if (!validate_encoding())
+		return false;
+
 	if (!validate_cryptohash())
 		return false;
 
+	if (!validate_hashctx())
+		return false;
+
 	if (!validate_random())
 		return false;
 
 	if (!validate_aesgcm())
 		return false;
 
+	if (!validate_aesgcm_batch())
+		return false;
+
 	return true;
 }
@@ -218,6 +218,1078 @@ static bool json_utf16(void)
 	return true;
 }
 
+static bool json_arena_roundtrip(const char *str)
+{
+	MTY_JSON *j = MTY_JSONParseArena(str);
+	char *str2 = MTY_JSONSerialize(j);
+	bool ok = j && !strcmp(str, str2);
+	MTY_Free(str2);
+	MTY_JSONDestroy(&j);
+
+	char *buf = MTY_Strdup(str);
+	j = MTY_JSONParseInPlace(buf);
+	str2 = MTY_JSONSerialize(j);
+	ok = ok && j && !strcmp(str, str2);
+	MTY_Free(str2);
+	MTY_JSONDestroy(&j);
+	MTY_Free(buf);
+
+	return ok;
+}
+
+static char *json_bench_doc(size_t *size)
+{
+	size_t n = 40000;
+	size_t len = 0;
+	char *doc = MTY_Alloc(n * 200 + 3, 1);
+
+	doc[len++] = '[';
+
+	for (size_t x = 0; x < n; x++) {
+		len += snprintf(doc + len, 200, "%s{\"id\": %u, \"name\": \"user_%u\", \"score\": %u.%u, "
+			"\"active\": %s, \"tags\": [\"a\", \"b\\n\"], \"parent\": null}", x > 0 ? ", " : "",
+			(unsigned) x, (unsigned) x, (unsigned) (x % 1000), (unsigned) (x % 7), x % 2 ? "true" : "false");
+	}
+
+	doc[len++] = ']';
+	doc[len] = '\0';
+	*size = len;
+
+	return doc;
+}
+
+static bool json_arena(void)
+{
+	bool ok = true;
+
+	for (uint32_t x = 0; x < JSON_ITER / 4 && ok; x++) {
+		uint32_t n = 0;
+		MTY_JSON *j = json_random(&n);
+		char *str = MTY_JSONSerialize(j);
+
+		ok = json_arena_roundtrip(str);
+
+		MTY_Free(str);
+		MTY_JSONDestroy(&j);
+	}
+
+	test_cmp("MTY_JSONParseArena", ok);
+
+	// Strings with escapes are unescaped in place
+	char *buf = MTY_Strdup(JSON_UTF16);
+	MTY_JSON *j = MTY_JSONParseInPlace(buf);
+	test_cmp("MTY_JSONParseInPlace", j && !strcmp(MTY_JSONStringPtr(j), (const char *) JSON_UTF8));
+	MTY_JSONDestroy(&j);
+	MTY_Free(buf);
+
+	// Large objects, duplicate keys, read-only items
+	const char *obj = "{\"k0\": 0, \"k1\": 1, \"k2\": 2, \"k3\": 3, \"k4\": 4, \"k5\": 5, "
+		"\"k6\": 6, \"k7\": 7, \"k8\": 8, \"k9\": 9, \"k3\": 33}";
+
+	j = MTY_JSONParseArena(obj);
+	MTY_JSON *heap = MTY_JSONParse(obj);
+
+	for (int32_t x = 0; x < 10 && ok; x++) {
+		char key[8];
+		snprintf(key, 8, "k%d", x);
+
+		int32_t v0 = -1;
+		int32_t v1 = -1;
+		ok = MTY_JSONObjGetInt(j, key, &v0) && MTY_JSONObjGetInt(heap, key, &v1) &&
+			v0 == v1 && v0 == (x == 3 ? 33 : x);
+	}
+
+	test_cmp("MTY_JSONObjGetItem", ok && !MTY_JSONObjGetItem(j, "k10"));
+
+	uint64_t iter = 0;
+	const char *key = NULL;
+	uint32_t nkeys = 0;
+
+	while (MTY_JSONObjGetNextKey(j, &iter, &key))
+		nkeys++;
+
+	test_cmp("MTY_JSONObjGetNextKey", nkeys == 10);
+	MTY_JSON *b = MTY_JSONBoolCreate(true);
+	test_cmp("MTY_JSONObjSetItem", !MTY_JSONObjSetItem(j, "k0", b));
+	MTY_JSONDestroy(&b);
+
+	MTY_JSONObjSetItem(heap, "k3", NULL);
+	test_cmp("MTY_JSONObjSetItem", !MTY_JSONObjGetItem(heap, "k3") && MTY_JSONObjGetItem(heap, "k9"));
+
+	// An arena document attached to a heap item is freed along with it
+	MTY_MemoryStats before = {0};
+	MTY_MemoryStats after = {0};
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &before);
+
+	MTY_JSON *arr = MTY_JSONArrayCreate(1);
+	MTY_JSONArraySetItem(arr, 0, MTY_JSONParseArena(obj));
+	MTY_JSONDestroy(&arr);
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &after);
+
+	test_cmp("MTY_JSONDestroy", after.live == before.live);
+
+	MTY_JSONDestroy(&heap);
+	MTY_JSONDestroy(&j);
+
+	// Invalid documents
+	const char *bad[] = {"", "[", "[1,]", "{\"a\" 1}", "{\"a\": 1,}", "[1] [2]", "\"\\x\"",
+		"\"\\u12\"", "{\"a\": [}", "nul", "[\"a\tb\"]", "{1: 2}", "[1 2]", "-", "[01]"};
+
+	MTY_DisableLog(true);
+
+	for (uint32_t x = 0; x < sizeof(bad) / sizeof(char *) && ok; x++) {
+		buf = MTY_Strdup(bad[x]);
+		ok = !MTY_JSONParse(bad[x]) && !MTY_JSONParseArena(bad[x]) && !MTY_JSONParseInPlace(buf);
+		MTY_Free(buf);
+	}
+
+	MTY_DisableLog(false);
+
+	test_cmp("MTY_JSONParseArena", ok);
+
+	// Large document
+	size_t size = 0;
+	char *doc = json_bench_doc(&size);
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &before);
+	MTY_Time ts = MTY_GetTime();
+	j = MTY_JSONParse(doc);
+	float heap_ms = MTY_TimeDiff(ts, MTY_GetTime());
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &after);
+	size_t heap_kb = (after.live - before.live) / 1024;
+
+	ok = j && MTY_JSONArrayGetLength(j) == 40000;
+	MTY_JSONDestroy(&j);
+
+	ts = MTY_GetTime();
+	j = MTY_JSONParseArena(doc);
+	float arena_ms = MTY_TimeDiff(ts, MTY_GetTime());
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &after);
+	size_t arena_kb = (after.live - before.live) / 1024;
+
+	const MTY_JSON *item = MTY_JSONArrayGetItem(j, 39999);
+	ok = ok && j && !strcmp(MTY_JSONObjGetStringPtr(item, "name"), "user_39999");
+	ok = ok && !strcmp(MTY_JSONStringPtr(MTY_JSONArrayGetItem(MTY_JSONObjGetItem(item, "tags"), 1)), "b\n");
+	MTY_JSONDestroy(&j);
+
+	// The in-place document is built around the caller's buffer, no copy is made
+	char *copy = MTY_Strdup(doc);
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &before);
+	ts = MTY_GetTime();
+	j = MTY_JSONParseInPlace(copy);
+	float inplace_ms = MTY_TimeDiff(ts, MTY_GetTime());
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &after);
+	size_t inplace_kb = (after.live - before.live) / 1024;
+
+	ok = ok && j && MTY_JSONArrayGetLength(j) == 40000;
+	MTY_JSONDestroy(&j);
+	MTY_Free(copy);
+
+	test_cmp("MTY_JSONParseArena", ok);
+	test_cmpf("MTY_JSONParse (MB/s)", true, size / 1024.0 / 1024.0 / (heap_ms / 1000.0));
+	test_cmpf("MTY_JSONParseArena (MB/s)", true, size / 1024.0 / 1024.0 / (arena_ms / 1000.0));
+	test_cmpf("MTY_JSONParseInPlace (MB/s)", true, size / 1024.0 / 1024.0 / (inplace_ms / 1000.0));
+	test_cmpi64("MTY_JSONParse (KB)", true, heap_kb);
+	test_cmpi64("MTY_JSONParseArena (KB)", arena_kb < heap_kb, arena_kb);
+	test_cmpi64("MTY_JSONParseInPlace (KB)", inplace_kb < arena_kb, inplace_kb);
+
+	MTY_Free(doc);
+
+	return true;
+}
+
+static char *json_scan_corpus(uint32_t type, size_t *size)
+{
+	size_t n = 40000;
+	size_t len = 0;
+	char *doc = MTY_Alloc(n * 400 + 3, 1);
+
+	doc[len++] = '[';
+
+	for (size_t x = 0; x < n; x++) {
+		const char *sep = x > 0 ? "," : "";
+
+		switch (type) {
+			// Pretty printed records
+			case 0:
+				len += snprintf(doc + len, 400, "%s\n\t{\n\t\t\"id\": %u,\n\t\t\"name\": \"user_%u\",\n"
+					"\t\t\"active\": %s,\n\t\t\"tags\": [\n\t\t\t\"a\",\n\t\t\t\"b\"\n\t\t]\n\t}",
+					sep, (unsigned) x, (unsigned) x, x % 2 ? "true" : "false");
+				break;
+
+			// Long strings with the occasional escape
+			case 1:
+				len += snprintf(doc + len, 400, "%s\"Lorem ipsum dolor sit amet, consectetur adipiscing "
+					"elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua %u. Ut enim ad "
+					"minim veniam, quis nostrud \\\"exercitation\\\" ullamco laboris nisi ut aliquip ex ea "
+					"commodo consequat.\"", sep, (unsigned) x);
+				break;
+
+			// Numbers
+			case 2:
+				len += snprintf(doc + len, 400, "%s%u,%d.%u,-%u.%ue%u,%u", sep, (unsigned) x, (int) x - 20000,
+					(unsigned) (x % 997), (unsigned) (x % 13), (unsigned) (x % 89), (unsigned) (x % 7), (unsigned) (x * 31));
+				break;
+		}
+	}
+
+	doc[len++] = ']';
+	doc[len] = '\0';
+	*size = len;
+
+	return doc;
+}
+
+static bool json_scan(void)
+{
+	// Escapes, literals and strings shifted across every position of a 64 byte block
+	bool ok = true;
+
+	for (uint32_t x = 0; x < 130 && ok; x++) {
+		char doc[512];
+		memset(doc, ' ', x);
+		snprintf(doc + x, 512 - x, "[\"%.*s\\\\\\\"\", true, \"x\\\\\", -1.5e3, null, {\"k\": \"v\"}, false]",
+			(int) (x % 7), "aaaaaaa");
+
+		char expected[16];
+		snprintf(expected, 16, "%.*s\\\"", (int) (x % 7), "aaaaaaa");
+
+		MTY_JSON *j = MTY_JSONParse(doc);
+		const char *str = MTY_JSONStringPtr(MTY_JSONArrayGetItem(j, 0));
+		const char *str2 = MTY_JSONStringPtr(MTY_JSONArrayGetItem(j, 2));
+
+		char *ser = MTY_JSONSerialize(j);
+
+		ok = j && MTY_JSONArrayGetLength(j) == 7 && str && !strcmp(str, expected) &&
+			str2 && !strcmp(str2, "x\\") && json_arena_roundtrip(ser);
+
+		MTY_Free(ser);
+		MTY_JSONDestroy(&j);
+	}
+
+	test_cmp("MTY_JSONParse", ok);
+
+	// A string that spans many scan windows
+	size_t len = 100000;
+	char *long_str = MTY_Alloc(len + 1, 1);
+
+	for (size_t x = 0; x < len; x++)
+		long_str[x] = x % 1000 == 999 ? '"' : x % 777 == 776 ? '\\' : 'a' + x % 26;
+
+	MTY_JSON *j = MTY_JSONStringCreate(long_str);
+	char *doc = MTY_JSONSerialize(j);
+	MTY_JSONDestroy(&j);
+
+	j = MTY_JSONParse(doc);
+	test_cmp("MTY_JSONParse", j && !strcmp(MTY_JSONStringPtr(j), long_str));
+	MTY_JSONDestroy(&j);
+	MTY_Free(doc);
+	MTY_Free(long_str);
+
+	// Invalid documents the scan has to catch
+	const char *bad[] = {"[truex]", "[\"a\x01" "b\"]", "[\"a\" \"b\"]", "{\"a\": 1}x", "[\"abc]",
+		"\"abc\\\"", "[nul]", "[1]\x01", "[\"a\"x]", "[true false]", "[null1]", "[1] \"\x02\""};
+
+	MTY_DisableLog(true);
+
+	for (uint32_t x = 0; x < sizeof(bad) / sizeof(char *) && ok; x++)
+		ok = !MTY_JSONParse(bad[x]);
+
+	MTY_DisableLog(false);
+
+	test_cmp("MTY_JSONParse", ok);
+
+	// Throughput
+	const char *names[] = {"records", "pretty", "strings", "numbers"};
+
+	for (uint32_t x = 0; x < 4; x++) {
+		size_t size = 0;
+		char *corpus = x == 0 ? json_bench_doc(&size) : json_scan_corpus(x - 1, &size);
+
+		MTY_Time ts = MTY_GetTime();
+		j = MTY_JSONParse(corpus);
+		float ms = MTY_TimeDiff(ts, MTY_GetTime());
+
+		char label[64];
+		snprintf(label, 64, "MTY_JSONParse %s (MB/s)", names[x]);
+		test_cmpf(label, j != NULL, size / 1024.0 / 1024.0 / (ms / 1000.0));
+
+		MTY_JSONDestroy(&j);
+		MTY_Free(corpus);
+	}
+
+	return true;
+}
+
+static char *json_number_doc(uint32_t type, uint32_t n, size_t *size)
+{
+	// 0: fixed point telemetry, 1: full precision doubles, 2: 64-bit integers
+	char *doc = MTY_Alloc(n * 32 + 3, 1);
+	uint32_t state = 3;
+	size_t len = 0;
+
+	doc[len++] = '[';
+
+	for (uint32_t x = 0; x < n; x++) {
+		uint64_t r = (uint64_t) compress_test_rand(&state) << 32 | compress_test_rand(&state) << 16 |
+			compress_test_rand(&state);
+
+		if (x > 0)
+			doc[len++] = ',';
+
+		if (type == 0) {
+			len += snprintf(doc + len, 32, "%.3f", (double) (r % 2000000) / 1000.0 - 1000.0);
+
+		} else if (type == 1) {
+			len += snprintf(doc + len, 32, "%.17g", ldexp((double) (r & 0xFFFFFFFFFFFF), -40 + (int32_t) (x % 80)));
+
+		} else {
+			len += snprintf(doc + len, 32, "%" PRId64, (int64_t) (r * 0x9E3779B97F4A7C15));
+		}
+	}
+
+	doc[len++] = ']';
+	doc[len] = '\0';
+	*size = len;
+
+	return doc;
+}
+
+static bool json_number(void)
+{
+	// Doubles survive serialization exactly
+	bool ok = true;
+
+	for (uint32_t x = 0; x < 100000 && ok; x++) {
+		double num = 0;
+		MTY_GetRandomBytes(&num, sizeof(double));
+
+		if (isnan(num) || isinf(num))
+			continue;
+
+		MTY_JSON *j = MTY_JSONNumberCreate(num);
+		char *str = MTY_JSONSerialize(j);
+		MTY_JSON *j2 = MTY_JSONParse(str);
+
+		double num2 = 0;
+		ok = MTY_JSONNumber(j2, &num2) && !memcmp(&num, &num2, sizeof(double));
+
+		MTY_JSONDestroy(&j2);
+		MTY_JSONDestroy(&j);
+		MTY_Free(str);
+	}
+
+	test_cmp("MTY_JSONNumberCreate", ok);
+
+	// The shortest digits are printed, notation follows "%.15g"
+	const double values[] = {0.1, 1e23, 5e-324, 1.7976931348623157e308, -0.0, 100, 1e15, 123456789012345.6,
+		0.0001, 0.00001, 2.2250738585072014e-308, 9007199254740993.0, 1.0 / 3.0};
+	const char *expected[] = {"0.1", "1e+23", "5e-324", "1.7976931348623157e+308", "-0", "100", "1e+15",
+		"123456789012345.6", "0.0001", "1e-05", "2.2250738585072014e-308", "9.007199254740992e+15",
+		"0.3333333333333333"};
+
+	for (uint32_t x = 0; x < sizeof(values) / sizeof(double) && ok; x++) {
+		MTY_JSON *j = MTY_JSONNumberCreate(values[x]);
+		char *str = MTY_JSONSerialize(j);
+		ok = !strcmp(str, expected[x]);
+
+		MTY_JSONDestroy(&j);
+		MTY_Free(str);
+	}
+
+	test_cmp("MTY_JSONSerialize", ok);
+
+	// Parsing is correctly rounded, including halfway cases and long inputs
+	const char *inputs[] = {"2.2250738585072011e-308", "4.9406564584124654e-324", "2.4703282292062328e-324",
+		"1.7976931348623158e308", "9007199254740993.0", "7.2057594037927933e16", "1e-400", "0.1e1",
+		"123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890.0e-70",
+		"2.22507385850720113605740979670913197593481954635164564e-308", "-1E+2", "0.000000000000000000000000000001e30"};
+	const double outputs[] = {2.2250738585072011e-308, 4.9406564584124654e-324, 4.9406564584124654e-324,
+		1.7976931348623157e308, 9007199254740992.0, 72057594037927936.0, 0, 1,
+		1.2345678901234568e19, 2.2250738585072009e-308, -100, 1};
+
+	for (uint32_t x = 0; x < sizeof(inputs) / sizeof(char *) && ok; x++) {
+		MTY_JSON *j = MTY_JSONParse(inputs[x]);
+		double num = 0;
+		ok = MTY_JSONNumber(j, &num) && num == outputs[x];
+
+		MTY_JSONDestroy(&j);
+	}
+
+	test_cmp("MTY_JSONParse", ok);
+
+	// Long numbers right next to a halfway point take the slow path, which must not
+	// depend on the decimal separator of the current locale
+	char *prev = MTY_Strdup(setlocale(LC_NUMERIC, NULL));
+	const char *locales[] = {"de_DE.UTF-8", "de_DE", "de-DE"};
+
+	for (uint32_t x = 0; x < sizeof(locales) / sizeof(char *); x++)
+		if (setlocale(LC_NUMERIC, locales[x]))
+			break;
+
+	const char *slow_inputs[] = {"9007199254740993.00000000001", "9007199254740992.99999999999",
+		"9007199254740993.000000000000000000000000000000000000000000000000000000000000",
+		"-9007199254740995.000000000000000000000000000000000000000000000000000000000000",
+		"2.4703282292062327208828439643411068618252990130716238221279284125033775363510437593264991818081"
+		"799618989828234772285886546332835517796989819938739800539093906315035659515570226392290858392449"
+		"105184435931802849936536152500319370457678249219365623669863658480757001585769269903706311928279"
+		"558551332927834338409351978015531246597263579574622766465272827220056374006485499977096599470454"
+		"020828166226237857393450736339007967761930577506740176324673600968951340535537458516661134223766"
+		"678604162159680461914467291840300530057530849048765391711386591646239524912623653881879636239373"
+		"280423891018672348497668235089863388587925628302755995657524455507255189313690836254779186948667"
+		"994968324049705821028513185451396213837722826145437693412532098591327667236328125e-324"};
+	const double slow_outputs[] = {9007199254740994.0, 9007199254740992.0, 9007199254740992.0,
+		-9007199254740996.0, 0};
+
+	for (uint32_t x = 0; x < sizeof(slow_inputs) / sizeof(char *) && ok; x++) {
+		MTY_JSON *j = MTY_JSONParse(slow_inputs[x]);
+		double num = 1;
+		ok = MTY_JSONNumber(j, &num) && num == slow_outputs[x];
+
+		MTY_JSONDestroy(&j);
+	}
+
+	setlocale(LC_NUMERIC, prev);
+	MTY_Free(prev);
+
+	test_cmp("MTY_JSONParse (locale)", ok);
+
+	// 64-bit integers are exact
+	MTY_JSON *j = MTY_JSONParse("[9223372036854775807, -9223372036854775808, 9223372036854775808, -0, 1.0]");
+	int64_t i64[5] = {0};
+
+	for (uint32_t x = 0; x < 5; x++)
+		MTY_JSONInt64(MTY_JSONArrayGetItem(j, x), &i64[x]);
+
+	char *str = MTY_JSONSerialize(j);
+	ok = i64[0] == INT64_MAX && i64[1] == INT64_MIN && i64[3] == 0 && i64[4] == 1;
+	ok = ok && !strcmp(str, "[9223372036854775807,-9223372036854775808,9.223372036854776e+18,0,1]");
+	MTY_JSONDestroy(&j);
+	MTY_Free(str);
+
+	j = MTY_JSONObjCreate();
+	MTY_JSONObjSetInt64(j, "a", INT64_MIN + 1);
+	MTY_JSONObjSetInt(j, "b", -5);
+
+	int32_t i32 = 0;
+	ok = ok && MTY_JSONObjGetInt64(j, "a", &i64[0]) && i64[0] == INT64_MIN + 1;
+	ok = ok && MTY_JSONObjGetInt(j, "b", &i32) && i32 == -5;
+
+	str = MTY_JSONSerialize(j);
+	ok = ok && !strcmp(str, "{\"a\":-9223372036854775807,\"b\":-5}");
+	MTY_JSONDestroy(&j);
+	MTY_Free(str);
+
+	test_cmp("MTY_JSONInt64", ok);
+
+	// Numeric arrays
+	const char *names[] = {"telemetry", "doubles", "int64"};
+
+	for (uint32_t x = 0; x < 3; x++) {
+		size_t size = 0;
+		char *doc = json_number_doc(x, 500000, &size);
+
+		MTY_Time ts = MTY_GetTime();
+		j = MTY_JSONParse(doc);
+		float parse_ms = MTY_TimeDiff(ts, MTY_GetTime());
+
+		ts = MTY_GetTime();
+		str = MTY_JSONSerialize(j);
+		float serial_ms = MTY_TimeDiff(ts, MTY_GetTime());
+
+		// Doubles print with the fewest digits that read back the same, integers are
+		// printed back exactly as generated
+		ok = j && (x < 2 ? strlen(str) <= size : !strcmp(str, doc));
+
+		char label[64];
+		snprintf(label, 64, "MTY_JSONParse %s (MB/s)", names[x]);
+		test_cmpf(label, ok, size / 1024.0 / 1024.0 / (parse_ms / 1000.0));
+
+		snprintf(label, 64, "MTY_JSONSerialize %s (MB/s)", names[x]);
+		test_cmpf(label, ok, strlen(str) / 1024.0 / 1024.0 / (serial_ms / 1000.0));
+
+		MTY_JSONDestroy(&j);
+		MTY_Free(str);
+		MTY_Free(doc);
+	}
+
+	return true;
+}
+
+struct json_packed_reader {
+	const MTY_JSON *json;
+	const MTY_JSON *items[4];
+};
+
+static void *json_packed_thread(void *opaque)
+{
+	struct json_packed_reader *r = opaque;
+
+	for (uint32_t x = 0; x < 4; x++)
+		r->items[x] = MTY_JSONArrayGetItem(MTY_JSONArrayGetItem(r->json, x), 1);
+
+	return NULL;
+}
+
+static bool json_packed(void)
+{
+	// Homogeneous arrays of numbers or booleans are packed
+	const char *docs[] = {"[1.5,-2,300]", "[1,-2,300]", "[true,false,true]", "[1,true]", "[1,null]",
+		"[9007199254740993,0.5]", "[9007199254740993,1]", "[]", "[[1,2],[0.5]]"};
+	const uint8_t kinds[] = {1, 2, 3, 0, 0, 0, 2, 0, 0};
+	bool ok = true;
+
+	for (uint32_t x = 0; x < sizeof(docs) / sizeof(char *) && ok; x++) {
+		MTY_JSON *j = MTY_JSONParse(docs[x]);
+		const double *d = NULL;
+		const int64_t *i = NULL;
+		const bool *b = NULL;
+		uint32_t len = 0;
+
+		uint8_t kind = MTY_JSONArrayGetNumbers(j, &d, &len) ? 1 : MTY_JSONArrayGetInt64s(j, &i, &len) ? 2 :
+			MTY_JSONArrayGetBools(j, &b, &len) ? 3 : 0;
+
+		char *str = MTY_JSONSerialize(j);
+		ok = kind == kinds[x] && !strcmp(str, docs[x]);
+
+		MTY_JSONDestroy(&j);
+		MTY_Free(str);
+	}
+
+	test_cmp("MTY_JSONArrayGetNumbers", ok);
+
+	MTY_JSON *j = MTY_JSONParse("{\"a\":[0.25,-1,2.5],\"b\":[5,-9223372036854775807],\"c\":[false,true]}");
+	const double *d = NULL;
+	const int64_t *i = NULL;
+	const bool *b = NULL;
+	uint32_t len[3] = {0};
+
+	ok = MTY_JSONArrayGetNumbers(MTY_JSONObjGetItem(j, "a"), &d, &len[0]) && len[0] == 3;
+	ok = ok && d[0] == 0.25 && d[1] == -1 && d[2] == 2.5;
+	ok = ok && MTY_JSONArrayGetInt64s(MTY_JSONObjGetItem(j, "b"), &i, &len[1]) && len[1] == 2;
+	ok = ok && i[0] == 5 && i[1] == -INT64_MAX;
+	ok = ok && MTY_JSONArrayGetBools(MTY_JSONObjGetItem(j, "c"), &b, &len[2]) && len[2] == 2;
+	ok = ok && !b[0] && b[1];
+	ok = ok && !MTY_JSONArrayGetNumbers(MTY_JSONObjGetItem(j, "b"), &d, &len[0]) && !d;
+	ok = ok && !MTY_JSONArrayGetBools(j, &b, &len[0]) && !b;
+
+	test_cmp("MTY_JSONArrayGetInt64s", ok);
+
+	// Items are still available one at a time, and stay valid when the array is modified
+	MTY_JSON *arr = (MTY_JSON *) MTY_JSONObjGetItem(j, "a");
+	const MTY_JSON *item = MTY_JSONArrayGetItem(arr, 2);
+	int32_t i32 = 0;
+	double num = 0;
+
+	ok = MTY_JSONNumber(item, &num) && num == 2.5 && MTY_JSONArrayGetItem(arr, 2) == item;
+	ok = ok && MTY_JSONInt32(MTY_JSONArrayGetItem(arr, 1), &i32) && i32 == -1;
+	ok = ok && !MTY_JSONArrayGetItem(arr, 3);
+	ok = ok && MTY_JSONArraySetString(arr, 0, "x") && !MTY_JSONArrayGetNumbers(arr, &d, &len[0]);
+	ok = ok && MTY_JSONArrayGetItem(arr, 2) == item && MTY_JSONNumber(item, &num) && num == 2.5;
+
+	char *str = MTY_JSONSerialize(j);
+	ok = ok && !strcmp(str, "{\"a\":[\"x\",-1,2.5],\"b\":[5,-9223372036854775807],\"c\":[false,true]}");
+	MTY_Free(str);
+
+	// Items are freed along with a packed array
+	ok = ok && MTY_JSONArrayGetItem(MTY_JSONObjGetItem(j, "b"), 0);
+	MTY_JSONDestroy(&j);
+
+	test_cmp("MTY_JSONArrayGetItem", ok);
+
+	// Arena documents
+	char in_place[] = "[[1,2,3],[0.5,1.5],[true]]";
+
+	for (uint32_t x = 0; x < 2 && ok; x++) {
+		j = x == 0 ? MTY_JSONParseArena(in_place) : MTY_JSONParseInPlace(in_place);
+
+		ok = MTY_JSONArrayGetInt64s(MTY_JSONArrayGetItem(j, 0), &i, &len[0]) && len[0] == 3 && i[2] == 3;
+		ok = ok && MTY_JSONArrayGetNumbers(MTY_JSONArrayGetItem(j, 1), &d, &len[1]) && d[1] == 1.5;
+		ok = ok && MTY_JSONArrayGetBools(MTY_JSONArrayGetItem(j, 2), &b, &len[2]) && b[0];
+		ok = ok && MTY_JSONNumber(MTY_JSONArrayGetItem(MTY_JSONArrayGetItem(j, 1), 0), &num) && num == 0.5;
+		ok = ok && !MTY_JSONArraySetItem((MTY_JSON *) MTY_JSONArrayGetItem(j, 0), 0, NULL);
+
+		str = MTY_JSONSerialize(j);
+		ok = ok && !strcmp(str, "[[1,2,3],[0.5,1.5],[true]]");
+		MTY_Free(str);
+
+		MTY_JSONDestroy(&j);
+	}
+
+	test_cmp("MTY_JSONParseArena", ok);
+
+	// A packed array in an arena document attached to a heap item
+	MTY_JSON *heap = MTY_JSONArrayCreate(1);
+	MTY_JSONArraySetItem(heap, 0, MTY_JSONParseArena("{\"a\":[4,5,6]}"));
+
+	const MTY_JSON *packed = MTY_JSONObjGetItem(MTY_JSONArrayGetItem(heap, 0), "a");
+	ok = MTY_JSONInt32(MTY_JSONArrayGetItem(packed, 2), &i32) && i32 == 6;
+	MTY_JSONDestroy(&heap);
+
+	test_cmp("MTY_JSONArrayGetItem", ok);
+
+	// Threads reading the same packed array see the same items
+	struct json_packed_reader readers[4] = {0};
+	MTY_Thread *threads[4] = {0};
+
+	for (uint32_t x = 0; x < 2 && ok; x++) {
+		char packed_doc[] = "[[1,2,3],[4,5,6],[7,8,9],[true,false]]";
+		j = x == 0 ? MTY_JSONParse(packed_doc) : MTY_JSONParseArena(packed_doc);
+
+		for (uint32_t y = 0; y < 4; y++) {
+			readers[y].json = j;
+			threads[y] = MTY_ThreadCreate(json_packed_thread, &readers[y]);
+		}
+
+		for (uint32_t y = 0; y < 4; y++)
+			MTY_ThreadDestroy(&threads[y]);
+
+		for (uint32_t y = 0; y < 4 && ok; y++)
+			ok = !memcmp(readers[y].items, readers[0].items, sizeof(readers[0].items)) &&
+				readers[y].items[3] == MTY_JSONArrayGetItem(MTY_JSONArrayGetItem(j, 3), 1);
+
+		MTY_JSONDestroy(&j);
+	}
+
+	test_cmp("MTY_JSONArrayGetItem", ok);
+
+	// Memory and speed compared to an array with an item per value
+	size_t size = 0;
+	char *doc = json_number_doc(0, 100000, &size);
+	MTY_MemoryStats before = {0};
+	MTY_MemoryStats after = {0};
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &before);
+	MTY_Time ts = MTY_GetTime();
+	j = MTY_JSONParse(doc);
+	float packed_ms = MTY_TimeDiff(ts, MTY_GetTime());
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &after);
+	size_t packed_kb = (after.live - before.live) / 1024;
+
+	ok = MTY_JSONArrayGetNumbers(j, &d, &len[0]) && len[0] == 100000;
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &before);
+	MTY_JSON *unpacked = MTY_JSONArrayCreate(len[0]);
+
+	for (uint32_t x = 0; x < len[0]; x++)
+		MTY_JSONArraySetItem(unpacked, x, MTY_JSONNumberCreate(d[x]));
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &after);
+	size_t unpacked_kb = (after.live - before.live) / 1024;
+
+	str = MTY_JSONSerialize(j);
+	char *str2 = MTY_JSONSerialize(unpacked);
+	ok = ok && !strcmp(str, str2);
+	MTY_Free(str2);
+	MTY_Free(str);
+
+	MTY_JSONDestroy(&unpacked);
+	MTY_JSONDestroy(&j);
+
+	MTY_Free(doc);
+
+	test_cmpi64("MTY_JSONArrayGetNumbers (KB)", ok && packed_kb * 4 < unpacked_kb, (int64_t) packed_kb);
+	test_cmpi64("MTY_JSONArrayCreate (KB)", ok, (int64_t) unpacked_kb);
+	test_cmpf("MTY_JSONParse packed (MB/s)", ok, size / 1024.0 / 1024.0 / (packed_ms / 1000.0));
+
+	return true;
+}
+
+static bool json_path(void)
+{
+	// RFC 6901 examples
+	const char *doc = "{\"foo\":[\"bar\",\"baz\"],\"\":0,\"a/b\":1,\"c%d\":2,\"e^f\":3,\"g|h\":4,"
+		"\"i\\\\j\":5,\"k\\\"l\":6,\" \":7,\"m~n\":8,\"01\":9}";
+	const char *paths[] = {"/foo/0", "/", "/a~1b", "/c%d", "/e^f", "/g|h", "/i\\j", "/k\"l", "/ ", "/m~0n",
+		"/01", "/foo/1", "/foo/2", "/foo/-", "/foo/01", "/bar", "/foo/0/x", "/m~1n"};
+	const int32_t expected[] = {-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -2, -3, -3, -3, -3, -3, -3};
+
+	MTY_JSON *j = MTY_JSONParse(doc);
+	MTY_JSONPath *batch = MTY_JSONPathCompileBatch(paths, sizeof(paths) / sizeof(char *));
+	const MTY_JSON *items[sizeof(paths) / sizeof(char *)] = {0};
+
+	uint32_t found = MTY_JSONPathGetItems(j, batch, items);
+	bool ok = batch && found == 12;
+
+	for (uint32_t x = 0; x < sizeof(paths) / sizeof(char *) && ok; x++) {
+		MTY_JSONPath *path = MTY_JSONPathCompile(paths[x]);
+		const MTY_JSON *item = MTY_JSONPathGetItem(j, path);
+		const char *str = MTY_JSONStringPtr(item);
+		int32_t i32 = 0;
+
+		ok = path && item == items[x];
+		ok = ok && (expected[x] == -1 ? str && !strcmp(str, "bar") : expected[x] == -2 ? str && !strcmp(str, "baz") :
+			expected[x] == -3 ? !item : MTY_JSONInt32(item, &i32) && i32 == expected[x]);
+
+		MTY_JSONPathDestroy(&path);
+	}
+
+	MTY_JSONPathDestroy(&batch);
+	test_cmp("MTY_JSONPathGetItems", ok && !batch);
+
+	// The empty path is the whole document, invalid paths fail to compile
+	MTY_JSONPath *path = MTY_JSONPathCompile("");
+	ok = MTY_JSONPathGetItem(j, path) == j;
+	MTY_JSONPathDestroy(&path);
+
+	const char *invalid[] = {"foo", "/foo/~2", "/foo~"};
+
+	for (uint32_t x = 0; x < 3 && ok; x++)
+		ok = !MTY_JSONPathCompile(invalid[x]);
+
+	ok = ok && !MTY_JSONPathCompileBatch(invalid, 3);
+	MTY_JSONDestroy(&j);
+
+	test_cmp("MTY_JSONPathCompile", ok);
+
+	// Packed arrays and arena documents
+	const char *telemetry = "{\"frames\":[{\"t\":[1,2,3],\"ok\":[true,false]},{\"t\":[0.5]}],\"id\":\"x\"}";
+	const char *fields[] = {"/frames/0/t/2", "/frames/0/ok/1", "/frames/1/t/0", "/id", "/frames/2/t/0"};
+	path = MTY_JSONPathCompileBatch(fields, 5);
+
+	for (uint32_t x = 0; x < 2 && ok; x++) {
+		j = x == 0 ? MTY_JSONParse(telemetry) : MTY_JSONParseArena(telemetry);
+
+		int32_t i32 = 0;
+		bool b = true;
+		double num = 0;
+
+		ok = MTY_JSONPathGetItems(j, path, items) == 4 && !items[4];
+		ok = ok && MTY_JSONInt32(items[0], &i32) && i32 == 3 && MTY_JSONBool(items[1], &b) && !b;
+		ok = ok && MTY_JSONNumber(items[2], &num) && num == 0.5 && !strcmp(MTY_JSONStringPtr(items[3]), "x");
+		ok = ok && MTY_JSONPathGetItem(j, path) == items[0];
+
+		MTY_JSONDestroy(&j);
+	}
+
+	ok = ok && MTY_JSONPathGetItems(NULL, path, items) == 0 && !items[0];
+	MTY_JSONPathDestroy(&path);
+
+	test_cmp("MTY_JSONPathGetItem", ok);
+
+	// Extracting fields from many messages
+	MTY_JSON *msgs[64];
+	const char *keys[] = {"/header/session/id", "/header/session/seq", "/body/input/x", "/body/input/y"};
+	MTY_JSONPath *compiled = MTY_JSONPathCompileBatch(keys, 4);
+	int64_t sum[2] = {0};
+	float ms[2] = {0};
+
+	for (int32_t x = 0; x < 64; x++) {
+		char msg[256];
+		snprintf(msg, sizeof(msg), "{\"header\":{\"type\":\"input\",\"session\":{\"id\":%d,\"seq\":%d}},"
+			"\"body\":{\"input\":{\"x\":%d,\"y\":%d,\"buttons\":[]}}}", x, x + 1, x * 2, -x);
+
+		msgs[x] = MTY_JSONParse(msg);
+	}
+
+	for (uint32_t x = 0; x < 2; x++) {
+		MTY_Time ts = MTY_GetTime();
+
+		for (uint32_t y = 0; y < 1000000; y++) {
+			j = msgs[y % 64];
+			int32_t v[4] = {0};
+
+			if (x == 0) {
+				const MTY_JSON *header = MTY_JSONObjGetItem(MTY_JSONObjGetItem(j, "header"), "session");
+				const MTY_JSON *input = MTY_JSONObjGetItem(MTY_JSONObjGetItem(j, "body"), "input");
+
+				MTY_JSONObjGetInt(header, "id", &v[0]);
+				MTY_JSONObjGetInt(header, "seq", &v[1]);
+				MTY_JSONObjGetInt(input, "x", &v[2]);
+				MTY_JSONObjGetInt(input, "y", &v[3]);
+
+			} else {
+				MTY_JSONPathGetItems(j, compiled, items);
+
+				for (uint32_t z = 0; z < 4; z++)
+					MTY_JSONInt32(items[z], &v[z]);
+			}
+
+			sum[x] += v[0] + v[1] + v[2] + v[3];
+		}
+
+		ms[x] = MTY_TimeDiff(ts, MTY_GetTime());
+	}
+
+	for (uint32_t x = 0; x < 64; x++)
+		MTY_JSONDestroy(&msgs[x]);
+
+	MTY_JSONPathDestroy(&compiled);
+
+	test_cmpf("MTY_JSONObjGetItem (ms)", true, ms[0]);
+	test_cmpf("MTY_JSONPathGetItems (ms)", sum[0] == sum[1], ms[1]);
+
+	return true;
+}
+
+struct json_stream_ctx {
+	MTY_JSONWriter *writer;
+	uint32_t top;
+	uint32_t events;
+	bool ok;
+};
+
+static bool json_stream_event(const MTY_JSONEvent *evt, void *opaque)
+{
+	struct json_stream_ctx *ctx = opaque;
+	MTY_JSONWriter *w = ctx->writer;
+	bool ok = true;
+
+	ctx->events++;
+
+	if (evt->depth == 0 && evt->type != MTY_JSON_EVENT_OBJECT_BEGIN && evt->type != MTY_JSON_EVENT_ARRAY_BEGIN)
+		ctx->top++;
+
+	if (!w)
+		return true;
+
+	switch (evt->type) {
+		case MTY_JSON_EVENT_OBJECT_BEGIN: ok = MTY_JSONWriterObjectBegin(w); break;
+		case MTY_JSON_EVENT_OBJECT_END:   ok = MTY_JSONWriterObjectEnd(w);   break;
+		case MTY_JSON_EVENT_ARRAY_BEGIN:  ok = MTY_JSONWriterArrayBegin(w);  break;
+		case MTY_JSON_EVENT_ARRAY_END:    ok = MTY_JSONWriterArrayEnd(w);    break;
+		case MTY_JSON_EVENT_KEY:          ok = MTY_JSONWriterKey(w, evt->string); break;
+		case MTY_JSON_EVENT_VALUE:
+			switch (evt->value) {
+				case MTY_JSON_NULL:   ok = MTY_JSONWriterNull(w);                break;
+				case MTY_JSON_BOOL:   ok = MTY_JSONWriterBool(w, evt->boolean);  break;
+				case MTY_JSON_NUMBER:
+					ok = evt->isint ? MTY_JSONWriterInt64(w, evt->integer) : MTY_JSONWriterNumber(w, evt->number);
+					break;
+				case MTY_JSON_STRING: ok = MTY_JSONWriterString(w, evt->string); break;
+				default:              ok = false;                                break;
+			}
+			break;
+		default:
+			ok = false;
+			break;
+	}
+
+	ctx->ok = ctx->ok && ok;
+
+	return true;
+}
+
+static bool json_trace_event(const MTY_JSONEvent *evt, void *opaque)
+{
+	// One character per event, in the order of MTY_JSONEventType
+	char *trace = opaque;
+	size_t len = strlen(trace);
+
+	if (len < 31) {
+		trace[len] = "{}[]kv"[evt->type];
+		trace[len + 1] = '\0';
+	}
+
+	return true;
+}
+
+struct json_stream_out {
+	char *buf;
+	size_t len;
+	size_t json_live;
+};
+
+static bool json_stream_write(const void *buf, size_t size, void *opaque)
+{
+	struct json_stream_out *out = opaque;
+
+	out->buf = MTY_Realloc(out->buf, out->len + size + 1, 1);
+	memcpy(out->buf + out->len, buf, size);
+	out->len += size;
+	out->buf[out->len] = '\0';
+
+	MTY_MemoryStats stats = {0};
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &stats);
+
+	if (stats.live > out->json_live)
+		out->json_live = stats.live;
+
+	return true;
+}
+
+static bool json_stream_roundtrip(const char *doc, size_t chunk)
+{
+	// Reader events are fed straight back into a writer, the output must match
+	// the serialized document
+	MTY_JSON *j = MTY_JSONParse(doc);
+	char *expected = MTY_JSONSerialize(j);
+	MTY_JSONDestroy(&j);
+
+	size_t size = strlen(expected) + 1;
+	char *out = MTY_Alloc(size, 1);
+
+	struct json_stream_ctx ctx = {.ok = true};
+	ctx.writer = MTY_JSONWriterCreateBuffer(out, size);
+
+	MTY_JSONReader *r = MTY_JSONReaderCreate(json_stream_event, &ctx);
+	bool ok = true;
+
+	for (size_t x = 0, len = strlen(doc); x < len && ok; x += chunk)
+		ok = MTY_JSONReaderPush(r, doc + x, len - x < chunk ? len - x : chunk);
+
+	ok = ok && MTY_JSONReaderFinish(r) && MTY_JSONWriterFinish(ctx.writer) && ctx.ok;
+	ok = ok && ctx.top == 1 && !strcmp(out, expected);
+	ok = ok && MTY_JSONWriterGetSize(ctx.writer) == size - 1;
+
+	MTY_JSONReaderDestroy(&r);
+	MTY_JSONWriterDestroy(&ctx.writer);
+	MTY_Free(expected);
+	MTY_Free(out);
+
+	return ok;
+}
+
+static bool json_stream(void)
+{
+	const char *doc = "{\"a\": [1, -2.5, 3e2, true, false, null, \"x\\u00e9\\ny\"], \"b\\\"\": {}, "
+		"\"c\": [], \"d\": {\"e\": [[{\"f\": 0}]], \"g\": \"\"}}";
+
+	bool ok = true;
+
+	for (size_t chunk = 1; chunk < 20 && ok; chunk++)
+		ok = json_stream_roundtrip(doc, chunk);
+
+	ok = ok && json_stream_roundtrip("\"top\"", 1) && json_stream_roundtrip(" 12.5 ", 2);
+	ok = ok && json_stream_roundtrip("[-0.5, 9223372036854775807, 1e400]", 1);
+	test_cmp("MTY_JSONReaderPush", ok);
+
+	// Line-delimited values
+	struct json_stream_ctx ctx = {.ok = true};
+	MTY_JSONReader *r = MTY_JSONReaderCreate(json_stream_event, &ctx);
+	const char *nd = "1 {\"a\": [true, null]}\n\"x\"\r\n[]\nfalse 2";
+
+	ok = MTY_JSONReaderPush(r, nd, strlen(nd)) && ctx.top == 5;
+	ok = ok && MTY_JSONReaderFinish(r) && ctx.top == 6 && ctx.events == 13;
+	test_cmp("MTY_JSONReaderFinish", ok);
+
+	// A reader can be reused after finishing, and stopped by its callback
+	ctx.top = 0;
+	ok = MTY_JSONReaderPush(r, "[1][2]", 6) && MTY_JSONReaderFinish(r) && ctx.top == 2;
+	MTY_JSONReaderDestroy(&r);
+	test_cmp("MTY_JSONReaderDestroy", ok && r == NULL);
+
+	// Invalid streams
+	const char *bad[] = {"[", "[1,]", "{\"a\" 1}", "{\"a\": 1,}", "\"\\x\"", "\"\\u12\"", "{\"a\": [}",
+		"nul", "[\"a\tb\"]", "{1: 2}", "[1 2]", "-", "[01]", "truex", "1a", "}", "[1}", "\"abc", "{\"a\"}"};
+
+	MTY_DisableLog(true);
+
+	for (uint32_t x = 0; x < sizeof(bad) / sizeof(char *) && ok; x++) {
+		for (size_t chunk = 1; chunk <= 2 && ok; chunk++) {
+			r = MTY_JSONReaderCreate(json_stream_event, &ctx);
+
+			bool valid = true;
+
+			for (size_t y = 0, len = strlen(bad[x]); y < len && valid; y += chunk)
+				valid = MTY_JSONReaderPush(r, bad[x] + y, len - y < chunk ? len - y : chunk);
+
+			ok = !(valid && MTY_JSONReaderFinish(r));
+			MTY_JSONReaderDestroy(&r);
+		}
+	}
+
+	// Missing separators fail where they occur, no container is closed early
+	const char *seps[] = {"[1 2]", "[1 2 3", "[{}x]", "{\"a\":1 \"b\":2}", "[{}-5", "[true[,1]]"};
+	const char *traces[] = {"[v", "[v", "[{}", "{kv", "[{}", "[v"};
+
+	for (uint32_t x = 0; x < sizeof(seps) / sizeof(char *) && ok; x++) {
+		char trace[32] = {0};
+		r = MTY_JSONReaderCreate(json_trace_event, trace);
+
+		ok = !MTY_JSONReaderPush(r, seps[x], strlen(seps[x])) && !MTY_JSONReaderFinish(r);
+		ok = ok && !strcmp(trace, traces[x]);
+
+		MTY_JSONReaderDestroy(&r);
+	}
+
+	MTY_DisableLog(false);
+
+	test_cmp("MTY_JSONReaderPush", ok);
+
+	// Writer misuse is rejected without changing the output
+	char buf[64];
+	MTY_JSONWriter *w = MTY_JSONWriterCreateBuffer(buf, sizeof(buf));
+
+	ok = MTY_JSONWriterObjectBegin(w) && !MTY_JSONWriterInt(w, 1) && !MTY_JSONWriterArrayEnd(w);
+	ok = ok && MTY_JSONWriterKey(w, "k") && !MTY_JSONWriterKey(w, "k") && !MTY_JSONWriterObjectEnd(w);
+	ok = ok && MTY_JSONWriterArrayBegin(w) && !MTY_JSONWriterKey(w, "k") && MTY_JSONWriterInt(w, -7);
+	ok = ok && MTY_JSONWriterString(w, "\x01\t") && !MTY_JSONWriterFinish(w);
+	ok = ok && MTY_JSONWriterArrayEnd(w) && MTY_JSONWriterObjectEnd(w) && MTY_JSONWriterBool(w, true);
+	ok = ok && MTY_JSONWriterFinish(w) && !strcmp(buf, "{\"k\":[-7,\"\\u0001\\t\"]}\ntrue");
+	MTY_JSONWriterDestroy(&w);
+	test_cmp("MTY_JSONWriterCreateBuffer", ok && w == NULL);
+
+	// Output that does not fit fails, and the buffer stays terminated
+	w = MTY_JSONWriterCreateBuffer(buf, 8);
+
+	MTY_DisableLog(true);
+	ok = MTY_JSONWriterString(w, "0123456789") && !MTY_JSONWriterFinish(w) && strlen(buf) == 7;
+	MTY_DisableLog(false);
+
+	MTY_JSONWriterDestroy(&w);
+	test_cmp("MTY_JSONWriterFinish", ok);
+
+	// Large document through a callback and a file, read back in chunks
+	size_t size = 0;
+	char *big = json_bench_doc(&size);
+	MTY_JSON *j = MTY_JSONParse(big);
+	char *expected = MTY_JSONSerialize(j);
+
+	// The item is streamed, the writer never holds more than its stage
+	MTY_MemoryStats before = {0};
+	struct json_stream_out out = {0};
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &before);
+
+	w = MTY_JSONWriterCreate(json_stream_write, &out);
+	ok = MTY_JSONWriterItem(w, j) && MTY_JSONWriterFinish(w) && !strcmp(out.buf, expected);
+	MTY_JSONWriterDestroy(&w);
+	MTY_Free(out.buf);
+
+	test_cmp("MTY_JSONWriterCreate", ok);
+	test_cmpi64("MTY_JSONWriterItem (KB)", (out.json_live - before.live) / 1024 < 16,
+		(int64_t) (out.json_live - before.live) / 1024);
+
+	const char *path = "test_stream.json";
+
+	w = MTY_JSONWriterCreateFile(path, false);
+	ok = w && MTY_JSONWriterItem(w, j) && MTY_JSONWriterItem(w, j) && MTY_JSONWriterFinish(w);
+	MTY_JSONWriterDestroy(&w);
+	MTY_JSONDestroy(&j);
+	test_cmp("MTY_JSONWriterCreateFile", ok);
+
+	MTY_MemoryStats after = {0};
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &before);
+
+	memset(&ctx, 0, sizeof(struct json_stream_ctx));
+	r = MTY_JSONReaderCreate(json_stream_event, &ctx);
+
+	MTY_Time ts = MTY_GetTime();
+	ok = MTY_JSONReaderReadFile(r, path) && ctx.top == 2;
+	float file_ms = MTY_TimeDiff(ts, MTY_GetTime());
+
+	// Memory held by the reader does not depend on the size of the input
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &after);
+	size_t reader_kb = (after.live - before.live) / 1024;
+	MTY_JSONReaderDestroy(&r);
+
+	MTY_DeleteFile(path);
+
+	test_cmp("MTY_JSONReaderReadFile", ok);
+	test_cmpf("MTY_JSONReaderReadFile (MB/s)", true, 2 * strlen(expected) / 1024.0 / 1024.0 / (file_ms / 1000.0));
+	test_cmpi64("MTY_JSONReader (KB)", reader_kb < 4, reader_kb);
+
+	MTY_Free(expected);
+	MTY_Free(big);
+
+	return true;
+}
+
 static bool json_main(void)
 {
 	json_test_suite();
@@ -231,5 +1303,23 @@ static bool json_main(void)
 	if (!json_utf16())
 		return false;
 
+	if (!json_arena())
+		return false;
+
+	if (!json_scan())
+		return false;
+
+	if (!json_number())
+		return false;
+
+	if (!json_packed())
+		return false;
+
+	if (!json_path())
+		return false;
+
+	if (!json_stream())
+		return false;
+
 	return true;
 }
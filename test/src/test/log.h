@@ -53,6 +53,21 @@ static bool log_main(void)
 	const char *last_log = (char *) MTY_GetLog();
 	test_cmp("MTY_GetLog", last_log != NULL && strlen(last_log));
 
+	// Messages longer than 8 KB are kept whole
+	char *long_msg = MTY_Alloc(16 * 1024 + 1, 1);
+	memset(long_msg, 'a', 16 * 1024);
+
+	MTY_DisableLog(true);
+	MTY_LogParams("FunkyFunc", "%s", long_msg);
+	MTY_DisableLog(false);
+
+	last_log = MTY_GetLog();
+	bool long_ok = strlen(last_log) == strlen("FunkyFunc: ") + 16 * 1024 &&
+		!strcmp(last_log + strlen("FunkyFunc: "), long_msg);
+	MTY_Free(long_msg);
+
+	test_cmp("MTY_GetLog (Long)", long_ok);
+
 	// LogFatalParams is untestable.
 	test_num = 2;
 	MTY_DisableLog(true);
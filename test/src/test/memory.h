@@ -7,7 +7,7 @@
 static bool test_specific_printf(const char *function, char *buffer, const char *compare)
 {
 	int32_t cmp_val = strcmp(buffer, compare);
-	free(buffer);
+	MTY_Free(buffer);
 	test_cmp_(function, cmp_val == 0, compare, ": %s");
 	return true;
 }
@@ -101,6 +101,468 @@ static bool memory_printf(void)
 	return true;
 }
 
+static bool memory_arena(void)
+{
+	MTY_Arena *arena = MTY_ArenaCreate(256);
+	test_cmp("MTY_ArenaCreate", arena != NULL && MTY_ArenaGetMark(arena) == 0);
+
+	bool ok = true;
+	for (uint32_t x = 1; x < 2000 && ok; x++) {
+		uint8_t *mem = MTY_ArenaAlloc(arena, x % 97, 1);
+		ok = ((uintptr_t) mem & 0xF) == 0 && (x % 97 == 0 || (mem[0] == 0 && mem[x % 97 - 1] == 0));
+		memset(mem, 0xFF, x % 97);
+	}
+
+	test_cmp("MTY_ArenaAlloc", ok);
+
+	// Allocations larger than a chunk get a chunk of their own
+	uint8_t *big = MTY_ArenaAlloc(arena, 1024 * 1024, 1);
+	test_cmp("MTY_ArenaAlloc", big[0] == 0 && big[1024 * 1024 - 1] == 0);
+
+	// Resetting to a mark frees only what came after it, and reused memory is zeroed
+	const char *str = MTY_ArenaStrdup(arena, "kept");
+	size_t mark = MTY_ArenaGetMark(arena);
+	size_t size = MTY_ArenaGetSize(arena);
+
+	for (uint32_t x = 0; x < 100; x++)
+		memset(MTY_ArenaAlloc(arena, 1000, 1), 0xFF, 1000);
+
+	MTY_ArenaReset(arena, mark);
+	test_cmp("MTY_ArenaReset", MTY_ArenaGetMark(arena) == mark && !strcmp(str, "kept"));
+
+	ok = true;
+	for (uint32_t x = 0; x < 100 && ok; x++) {
+		uint8_t *mem = MTY_ArenaAlloc(arena, 1000, 1);
+		ok = mem[0] == 0 && mem[999] == 0;
+	}
+
+	test_cmp("MTY_ArenaReset", ok);
+
+	size_t reused = MTY_ArenaGetSize(arena);
+	MTY_ArenaReset(arena, 0);
+	test_cmp("MTY_ArenaGetSize", reused >= size && MTY_ArenaGetMark(arena) == 0);
+
+	MTY_ArenaDestroy(&arena);
+	test_cmp("MTY_ArenaDestroy", arena == NULL);
+
+	// Many small allocations freed together
+	const uint32_t n = 1000000;
+	void **ptrs = MTY_Alloc(n, sizeof(void *));
+
+	MTY_Time ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < n; x++)
+		ptrs[x] = MTY_Alloc(1, 24 + x % 16);
+
+	for (uint32_t x = 0; x < n; x++)
+		MTY_Free(ptrs[x]);
+
+	float heap_ms = MTY_TimeDiff(ts, MTY_GetTime());
+	ts = MTY_GetTime();
+
+	arena = MTY_ArenaCreate(0);
+
+	for (uint32_t x = 0; x < n; x++)
+		ptrs[x] = MTY_ArenaAlloc(arena, 1, 24 + x % 16);
+
+	MTY_ArenaDestroy(&arena);
+
+	float arena_ms = MTY_TimeDiff(ts, MTY_GetTime());
+
+	test_cmpf("MTY_Alloc (ms)", true, heap_ms);
+	test_cmpf("MTY_ArenaAlloc (ms)", true, arena_ms);
+
+	MTY_Free(ptrs);
+
+	return true;
+}
+
+static void *memory_tlocal_thread(void *opaque)
+{
+	// Memory beyond the thread local buffers is freed when the thread exits
+	MTY_PushThreadLocal();
+
+	for (uint32_t x = 0; x < 1000; x++)
+		MTY_SprintfDL("%0500u", x);
+
+	MTY_SprintfDL("%0100000u", 0);
+
+	return NULL;
+}
+
+static bool memory_tlocal(void)
+{
+	// Results stay valid for at least 8 KB of later results, however large
+	const char *first = MTY_SprintfDL("first %d", 1);
+	const char *big = MTY_SprintfDL("%0100000d", 7);
+	const char *path = MTY_JoinPath("a", "b");
+
+	bool ok = !strcmp(first, "first 1") && strlen(big) == 100000 && big[99999] == '7';
+	ok = ok && path[0] == 'a' && path[2] == 'b' && path[3] == '\0';
+
+	for (uint32_t x = 0; x < 40 && ok; x++)
+		ok = strlen(MTY_SprintfDL("%0150u", x)) == 150 && !strcmp(first, "first 1") && big[0] == '0';
+
+	test_cmp("MTY_SprintfDL", ok);
+
+	// Every result in a scope stays valid until it ends
+	const char *results[5000];
+	size_t mark = MTY_PushThreadLocal();
+
+	for (uint32_t x = 0; x < 5000; x++)
+		results[x] = MTY_SprintfDL("%u", x);
+
+	size_t inner = MTY_PushThreadLocal();
+	MTY_SprintfDL("%0100000d", 0);
+	MTY_PopThreadLocal(inner);
+
+	ok = true;
+	for (uint32_t x = 0; x < 5000 && ok; x++)
+		ok = (uint32_t) atoi(results[x]) == x;
+
+	MTY_PopThreadLocal(mark);
+	ok = ok && MTY_PushThreadLocal() == mark;
+	MTY_PopThreadLocal(mark);
+
+	test_cmp("MTY_PushThreadLocal", ok);
+
+	// The log is not affected by scopes
+	mark = MTY_PushThreadLocal();
+	MTY_JSONParse("x");
+	MTY_PopThreadLocal(mark);
+
+	MTY_SprintfDL("%01000d", 0);
+	test_cmp("MTY_PopThreadLocal", strstr(MTY_GetLog(), "Parse error") != NULL);
+
+	MTY_Time ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < 1000000; x++)
+		MTY_SprintfDL("%u", x);
+
+	test_cmpf("MTY_SprintfDL (ms)", true, MTY_TimeDiff(ts, MTY_GetTime()));
+
+	return true;
+}
+
+#ifdef _WIN32
+#include <windows.h>
+
+static DWORD WINAPI memory_foreign_thread(LPVOID opaque)
+{
+	memory_tlocal_thread(opaque);
+
+	return 0;
+}
+
+static void memory_foreign_run(void)
+{
+	HANDLE thread = CreateThread(NULL, 0, memory_foreign_thread, NULL, 0, NULL);
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+#else
+#include <pthread.h>
+
+static void memory_foreign_run(void)
+{
+	pthread_t thread;
+	pthread_create(&thread, NULL, memory_tlocal_thread, NULL);
+	pthread_join(thread, NULL);
+}
+#endif
+
+static bool memory_tlocal_exit(void)
+{
+	MTY_MemoryStats before = {0};
+	MTY_MemoryStats after = {0};
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_NONE, &before);
+
+	MTY_Thread *thread = MTY_ThreadCreate(memory_tlocal_thread, NULL);
+	MTY_ThreadDestroy(&thread);
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_NONE, &after);
+	test_cmp("MTY_ThreadDestroy", after.live == before.live);
+
+	// Threads not created by libmatoya free their thread local memory as well
+	memory_foreign_run();
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_NONE, &after);
+	test_cmp("MTY_SprintfDL (thread exit)", after.live == before.live);
+
+	return true;
+}
+
+static MTY_Atomic64 MEMORY_CALLS;
+
+static void *memory_test_alloc(size_t size, void *opaque)
+{
+	MTY_Atomic64Add(&MEMORY_CALLS, 1);
+
+	return malloc(size);
+}
+
+static void *memory_test_realloc(void *mem, size_t size, void *opaque)
+{
+	MTY_Atomic64Add(&MEMORY_CALLS, 1);
+
+	return realloc(mem, size);
+}
+
+static void memory_test_free(void *mem, void *opaque)
+{
+	free(mem);
+}
+
+static void *memory_test_alloc_aligned(size_t size, size_t align, void *opaque)
+{
+	MTY_Atomic64Add(&MEMORY_CALLS, 1);
+
+	// The original pointer is stored just before the aligned one
+	uint8_t *base = malloc(size + align + sizeof(void *));
+	uintptr_t mem = ((uintptr_t) (base + sizeof(void *)) + align - 1) & ~((uintptr_t) align - 1);
+	((void **) mem)[-1] = base;
+
+	return (void *) mem;
+}
+
+static void memory_test_free_aligned(void *mem, void *opaque)
+{
+	if (mem)
+		free(((void **) mem)[-1]);
+}
+
+static void memory_set_allocator(void)
+{
+	MTY_Allocator allocator = {
+		.alloc = memory_test_alloc,
+		.realloc = memory_test_realloc,
+		.free = memory_test_free,
+		.allocAligned = memory_test_alloc_aligned,
+		.freeAligned = memory_test_free_aligned,
+	};
+
+	MTY_SetAllocator(&allocator, true);
+}
+
+static bool memory_stats(void)
+{
+	MTY_MemoryStats before = {0};
+	MTY_MemoryStats after = {0};
+
+	test_cmp("MTY_GetMemoryStats", MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &before));
+	test_cmp("MTY_GetMemoryStats", !MTY_GetMemoryStats(MTY_MEMORY_TAG_MAX, &after));
+
+	// Module allocations are attributed to the module and released on destroy
+	MTY_JSON *j = MTY_JSONParse("{\"a\": [1, 2, 3], \"b\": \"string\"}");
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &after);
+	test_cmp("MTY_MEMORY_TAG_JSON", after.live > before.live && after.allocs > before.allocs);
+	test_cmp("MTY_MEMORY_TAG_JSON", after.peak >= after.live);
+
+	MTY_JSONDestroy(&j);
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_JSON, &after);
+	test_cmp("MTY_MEMORY_TAG_JSON", after.live == before.live && after.allocs - before.allocs == after.frees - before.frees);
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_QUEUE, &before);
+	MTY_Queue *q = MTY_QueueCreate(4, 1000, MTY_QUEUE_FLAG_NONE);
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_QUEUE, &after);
+	test_cmp("MTY_MEMORY_TAG_QUEUE", after.live - before.live >= 4000);
+
+	MTY_QueueDestroy(&q);
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_QUEUE, &after);
+	test_cmp("MTY_MEMORY_TAG_QUEUE", after.live == before.live);
+
+	// Untagged allocations, including realloc and aligned memory
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_NONE, &before);
+	int64_t calls = MTY_Atomic64Get(&MEMORY_CALLS);
+
+	uint8_t *mem = MTY_Alloc(100, 1);
+	mem = MTY_Realloc(mem, 300, 1);
+	uint8_t *aligned = MTY_AllocAligned(100, 64);
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_NONE, &after);
+	test_cmp("MTY_MEMORY_TAG_NONE", after.live - before.live == 400 && ((uintptr_t) aligned & 0x3F) == 0);
+	test_cmp("MTY_SetAllocator", MTY_Atomic64Get(&MEMORY_CALLS) - calls == 3);
+
+	MTY_Free(mem);
+	MTY_FreeAligned(aligned);
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_NONE, &after);
+	test_cmp("MTY_MEMORY_TAG_NONE", after.live == before.live);
+
+	// Blocks are freed the way they were allocated when the setting changes in between,
+	// including the library's own thread local chunks
+	size_t mark = MTY_PushThreadLocal();
+	MTY_SprintfDL("%0100000d", 0);
+	mem = MTY_Alloc(100, 1);
+	aligned = MTY_AllocAligned(100, 64);
+
+	MTY_SetAllocator(NULL, false);
+	MTY_SprintfDL("%0100000d", 1);
+	uint8_t *plain = MTY_Alloc(100, 1);
+	mem = MTY_Realloc(mem, 300, 1);
+	MTY_PopThreadLocal(mark);
+
+	memory_set_allocator();
+	MTY_Free(plain);
+	MTY_Free(mem);
+	MTY_FreeAligned(aligned);
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_NONE, &after);
+	test_cmp("MTY_SetAllocator (switch)", after.live == before.live);
+
+	return true;
+}
+
+#define POOL_THREADS 4
+#define POOL_BATCH   256
+#define POOL_ROUNDS  2000
+
+struct pool_churn {
+	MTY_Pool *pool;
+	uint32_t id;
+	bool ok;
+};
+
+static void *memory_pool_thread(void *opaque)
+{
+	struct pool_churn *p = opaque;
+	uint32_t *objs[POOL_BATCH];
+
+	for (uint32_t x = 0; x < POOL_ROUNDS; x++) {
+		for (uint32_t y = 0; y < POOL_BATCH; y++) {
+			objs[y] = p->pool ? MTY_PoolAlloc(p->pool) : calloc(1, 48);
+			objs[y][0] = p->id;
+			objs[y][11] = y;
+		}
+
+		for (uint32_t y = POOL_BATCH; y > 0; y--) {
+			if (objs[y - 1][0] != p->id || objs[y - 1][11] != y - 1)
+				p->ok = false;
+
+			if (p->pool) {
+				MTY_PoolFree(p->pool, objs[y - 1]);
+
+			} else {
+				free(objs[y - 1]);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static float memory_pool_churn(MTY_Pool *pool, bool *ok)
+{
+	MTY_Thread *threads[POOL_THREADS];
+	struct pool_churn p[POOL_THREADS];
+
+	MTY_Time ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < POOL_THREADS; x++) {
+		p[x].pool = pool;
+		p[x].id = x + 1;
+		p[x].ok = true;
+		threads[x] = MTY_ThreadCreate(memory_pool_thread, &p[x]);
+	}
+
+	for (uint32_t x = 0; x < POOL_THREADS; x++) {
+		MTY_ThreadDestroy(&threads[x]);
+		*ok = *ok && p[x].ok;
+	}
+
+	return MTY_TimeDiff(ts, MTY_GetTime());
+}
+
+static bool memory_pool(void)
+{
+	MTY_Pool *pool = MTY_PoolCreate(40, 64);
+	test_cmp("MTY_PoolCreate", pool != NULL && MTY_PoolGetSize(pool) == 64);
+
+	// Objects are aligned, zeroed, and handed back out after being freed
+	uint8_t *objs[1000];
+	bool ok = true;
+
+	for (uint32_t x = 0; x < 1000; x++) {
+		objs[x] = MTY_PoolAlloc(pool);
+		ok = ok && ((uintptr_t) objs[x] & 0x3F) == 0 && objs[x][0] == 0 && objs[x][63] == 0;
+		memset(objs[x], 0xFF, 64);
+	}
+
+	test_cmp("MTY_PoolAlloc", ok);
+
+	for (uint32_t x = 0; x < 1000; x++)
+		MTY_PoolFree(pool, objs[x]);
+
+	MTY_PoolFree(pool, NULL);
+
+	uint8_t *obj = MTY_PoolAlloc(pool);
+	test_cmp("MTY_PoolFree", obj == objs[999] && obj[0] == 0 && obj[63] == 0);
+	MTY_PoolFree(pool, obj);
+
+	MTY_PoolDestroy(&pool);
+	test_cmp("MTY_PoolDestroy", pool == NULL);
+
+	// Lists sharing one pool
+	pool = MTY_PoolCreate(sizeof(MTY_ListNode), 0);
+	MTY_List *l0 = MTY_ListCreateFromPool(pool);
+	MTY_List *l1 = MTY_ListCreateFromPool(pool);
+
+	for (uintptr_t x = 0; x < 500; x++) {
+		MTY_ListAppend(x % 2 ? l1 : l0, (void *) x);
+
+		if (x % 3 == 0)
+			MTY_ListRemove(l0, MTY_ListGetFirst(l0));
+	}
+
+	uintptr_t sum = 0;
+	for (MTY_ListNode *n = MTY_ListGetFirst(l1); n; n = n->next)
+		sum += (uintptr_t) n->value;
+
+	test_cmp("MTY_ListCreateFromPool", sum == 250 * 250);
+
+	MTY_ListDestroy(&l0, NULL);
+	MTY_ListDestroy(&l1, NULL);
+	MTY_PoolDestroy(&pool);
+
+	// Cycling through more pools than a thread caches reuses the same objects
+	MTY_Pool *pools[20];
+	for (uint32_t x = 0; x < 20; x++)
+		pools[x] = MTY_PoolCreate(48, 24);
+
+	test_cmp("MTY_PoolCreate", MTY_PoolGetSize(pools[0]) == 64);
+
+	MTY_MemoryStats before = {0};
+	MTY_MemoryStats after = {0};
+
+	for (uint32_t x = 0; x < 1000; x++) {
+		if (x == 10)
+			MTY_GetMemoryStats(MTY_MEMORY_TAG_NONE, &before);
+
+		for (uint32_t y = 0; y < 20; y++)
+			MTY_PoolFree(pools[y], MTY_PoolAlloc(pools[y]));
+	}
+
+	MTY_GetMemoryStats(MTY_MEMORY_TAG_NONE, &after);
+	test_cmp("MTY_PoolFree", after.live == before.live);
+
+	for (uint32_t x = 0; x < 20; x++)
+		MTY_PoolDestroy(&pools[x]);
+
+	// Multithreaded churn compared to the system allocator
+	ok = true;
+	float heap_ms = memory_pool_churn(NULL, &ok);
+
+	pool = MTY_PoolCreate(48, 0);
+	float pool_ms = memory_pool_churn(pool, &ok);
+	MTY_PoolDestroy(&pool);
+
+	test_cmp("MTY_PoolAlloc", ok);
+	test_cmpf("calloc (ms)", true, heap_ms);
+	test_cmpf("MTY_PoolAlloc (ms)", true, pool_ms);
+
+	return true;
+}
+
 static bool memory_main(void)
 {
 	bool failed = false;
@@ -262,5 +724,26 @@ static bool memory_main(void)
 
 	failed = !memory_printf();
 
+	if (!failed)
+		failed = !memory_arena();
+
+	if (!failed)
+		failed = !memory_tlocal();
+
+	// The counting allocator is only installed for the tests that read memory
+	// statistics, blocks allocated with it are still freed through it afterwards
+	memory_set_allocator();
+
+	if (!failed)
+		failed = !memory_tlocal_exit();
+
+	if (!failed)
+		failed = !memory_pool();
+
+	if (!failed)
+		failed = !memory_stats();
+
+	MTY_SetAllocator(NULL, true);
+
 	return !failed;
 }
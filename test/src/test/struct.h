@@ -19,6 +19,300 @@ static void* struct_thread(void* opaque)
 };
 */
 
+static bool struct_hash_str(void)
+{
+	const uint32_t n = 200000;
+	char key[32];
+
+	MTY_Hash *h = MTY_HashCreate(0);
+	int64_t ts = MTY_GetTime();
+
+	// Lookups interleaved with inserts exercise the incremental rehash
+	bool ok = true;
+	for (uint32_t x = 0; x < n && ok; x++) {
+		snprintf(key, 32, "key-%u", x);
+		MTY_HashSet(h, key, (void *) (uintptr_t) (x + 1));
+
+		snprintf(key, 32, "key-%u", x / 2);
+		ok = MTY_HashGet(h, key) == (void *) (uintptr_t) (x / 2 + 1);
+	}
+
+	test_cmp("MTY_HashSet (Resize)", ok);
+	test_cmpf("MTY_HashSet (ms)", true, MTY_TimeDiff(ts, MTY_GetTime()));
+
+	// Insertion order is preserved and pops during iteration are safe
+	uint32_t count = 0;
+	const char *k = NULL;
+	for (uint64_t i = 0; MTY_HashGetNextKey(h, &i, &k) && ok; count++) {
+		snprintf(key, 32, "key-%u", count);
+		ok = !strcmp(k, key);
+
+		if (count % 2 == 0)
+			MTY_HashPop(h, k);
+	}
+
+	test_cmp("MTY_HashGetNextKey (Order)", ok && count == n);
+
+	// New keys compact the tombstones left behind
+	for (uint32_t x = n; x < n + 1000; x++) {
+		snprintf(key, 32, "key-%u", x);
+		MTY_HashSet(h, key, (void *) (uintptr_t) (x + 1));
+	}
+
+	for (uint32_t x = 0; x < n + 1000 && ok; x++) {
+		snprintf(key, 32, "key-%u", x);
+		void *val = MTY_HashGet(h, key);
+		ok = (x % 2 == 0 && x < n) ? val == NULL : val == (void *) (uintptr_t) (x + 1);
+	}
+
+	test_cmp("MTY_HashPop (Compact)", ok);
+
+	MTY_HashDestroy(&h, NULL);
+
+	return true;
+}
+
+static bool struct_hash_int(void)
+{
+	const int64_t n = 200000;
+	MTY_Hash *h = MTY_HashCreate(0);
+
+	for (int64_t x = 0; x < n; x++)
+		MTY_HashSetInt(h, x * 7919 - n, (void *) (uintptr_t) (x + 1));
+
+	bool ok = true;
+	for (int64_t x = 0; x < n && ok; x++)
+		ok = MTY_HashGetInt(h, x * 7919 - n) == (void *) (uintptr_t) (x + 1);
+
+	test_cmp("MTY_HashGetInt (Resize)", ok && !MTY_HashGetInt(h, 1));
+
+	// Popping during iteration visits every key exactly once
+	int64_t count = 0;
+	for (int64_t key = 0, i = 0; MTY_HashGetNextKeyInt(h, (uint64_t *) &i, &key); count++)
+		if (count % 2 == 0)
+			MTY_HashPopInt(h, key);
+
+	int64_t remaining = 0;
+	for (int64_t key = 0, i = 0; MTY_HashGetNextKeyInt(h, (uint64_t *) &i, &key);)
+		remaining++;
+
+	test_cmp("MTY_HashPopInt (Iterate)", count == n && remaining == n / 2);
+
+	MTY_HashDestroy(&h, NULL);
+
+	// Compare against string formatted integer keys
+	const int64_t bench_n = 50000;
+	h = MTY_HashCreate(0);
+	MTY_Hash *hs = MTY_HashCreate(0);
+	char key_str[32];
+
+	int64_t ts = MTY_GetTime();
+
+	for (int64_t x = 0; x < bench_n; x++) {
+		MTY_HashSetInt(h, x, h);
+		MTY_HashGetInt(h, x);
+	}
+
+	float int_time = MTY_TimeDiff(ts, MTY_GetTime());
+	ts = MTY_GetTime();
+
+	for (int64_t x = 0; x < bench_n; x++) {
+		snprintf(key_str, 32, "#%" PRIx64, x);
+		MTY_HashSet(hs, key_str, hs);
+		MTY_HashGet(hs, key_str);
+	}
+
+	float str_time = MTY_TimeDiff(ts, MTY_GetTime());
+
+	test_cmpf("MTY_HashSetInt (ms)", true, int_time);
+	test_cmpf("MTY_HashSet Formatted (ms)", true, str_time);
+
+	MTY_HashDestroy(&hs, NULL);
+	MTY_HashDestroy(&h, NULL);
+
+	return true;
+}
+
+#define STRUCT_QUEUE_ITEMS 100000
+
+struct struct_queue_producer {
+	MTY_Queue *q;
+	uint32_t id;
+};
+
+static void *struct_queue_thread(void *opaque)
+{
+	struct struct_queue_producer *p = opaque;
+
+	for (uint32_t x = 0; x < STRUCT_QUEUE_ITEMS;) {
+		uint32_t *buf = MTY_QueueGetInputBuffer(p->q);
+
+		if (!buf) {
+			MTY_Sleep(0);
+			continue;
+		}
+
+		buf[0] = p->id;
+		buf[1] = x++;
+		MTY_QueuePush(p->q, 2 * sizeof(uint32_t));
+	}
+
+	return NULL;
+}
+
+static bool struct_queue(const char *name, MTY_QueueFlag flags, uint32_t producers)
+{
+	MTY_Queue *q = MTY_QueueCreate(64, 2 * sizeof(uint32_t), flags);
+
+	// Empty pushes are released, GetLastOutputBuffer skips to the newest buffer
+	MTY_QueueGetInputBuffer(q);
+	MTY_QueuePush(q, 0);
+
+	for (uint32_t x = 0; x < 3; x++) {
+		uint32_t *buf = MTY_QueueGetInputBuffer(q);
+		buf[0] = x;
+		MTY_QueuePush(q, sizeof(uint32_t));
+	}
+
+	test_cmp("MTY_QueueGetLength", MTY_QueueGetLength(q) >= 3);
+
+	void *out = NULL;
+	size_t size = 0;
+	bool r = MTY_QueueGetLastOutputBuffer(q, 0, &out, &size);
+	test_cmp("MTY_QueueGetLastOutputBuffer", r && size == sizeof(uint32_t) && *(uint32_t *) out == 2);
+	MTY_QueuePop(q);
+
+	test_cmp("MTY_QueueGetOutputBuffer", !MTY_QueueGetOutputBuffer(q, 1, &out, &size));
+
+	// Each producer's items arrive complete and in order
+	struct struct_queue_producer p[8] = {0};
+	MTY_Thread *threads[8] = {0};
+	uint32_t next[8] = {0};
+
+	int64_t ts = MTY_GetTime();
+
+	for (uint32_t x = 0; x < producers; x++) {
+		p[x].q = q;
+		p[x].id = x;
+		threads[x] = MTY_ThreadCreate(struct_queue_thread, &p[x]);
+	}
+
+	bool ok = true;
+
+	for (uint32_t x = 0; x < producers * STRUCT_QUEUE_ITEMS && ok; x++) {
+		ok = MTY_QueueGetOutputBuffer(q, 5000, &out, &size);
+
+		if (ok) {
+			uint32_t *buf = out;
+			ok = size == 2 * sizeof(uint32_t) && buf[0] < producers && buf[1] == next[buf[0]]++;
+			MTY_QueuePop(q);
+		}
+	}
+
+	float ms = MTY_TimeDiff(ts, MTY_GetTime());
+
+	for (uint32_t x = 0; x < producers; x++)
+		MTY_ThreadDestroy(&threads[x]);
+
+	test_cmp(name, ok && MTY_QueueGetLength(q) == 0);
+
+	char label[64];
+	snprintf(label, 64, "%s Items/ms", name);
+	test_cmpf(label, true, producers * STRUCT_QUEUE_ITEMS / (ms > 0.0f ? ms : 1.0f));
+
+	MTY_QueueDestroy(&q);
+
+	return true;
+}
+
+static void *struct_ring_thread(void *opaque)
+{
+	MTY_Queue *q = opaque;
+
+	for (uint32_t x = 0; x < STRUCT_QUEUE_ITEMS;) {
+		size_t size = 1 + (x * 7919) % 1500;
+		uint8_t *buf = MTY_QueueReserve(q, size);
+
+		if (!buf) {
+			MTY_Sleep(0);
+			continue;
+		}
+
+		memset(buf, (uint8_t) x++, size);
+		MTY_QueuePush(q, size);
+	}
+
+	return NULL;
+}
+
+static bool struct_queue_batch(void)
+{
+	// Variable sized spans in a ring much smaller than len * largest item
+	MTY_Queue *q = MTY_QueueCreate(256, 16 * 1024, MTY_QUEUE_FLAG_RING | MTY_QUEUE_FLAG_SPSC);
+	test_cmp("MTY_QueueGetInputBuffer", !MTY_QueueGetInputBuffer(q));
+	test_cmp("MTY_QueueReserve", !MTY_QueueReserve(q, 16 * 1024 + 1));
+
+	MTY_Thread *thread = MTY_ThreadCreate(struct_ring_thread, q);
+
+	void *bufs[32];
+	size_t sizes[32];
+	uint32_t batches = 0;
+	bool ok = true;
+
+	for (uint32_t x = 0; x < STRUCT_QUEUE_ITEMS && ok; batches++) {
+		uint32_t n = MTY_QueueGetOutputBuffers(q, 5000, bufs, sizes, 32);
+		ok = n > 0;
+
+		for (uint32_t y = 0; y < n && ok; y++, x++) {
+			const uint8_t *buf = bufs[y];
+			ok = sizes[y] == 1 + (x * 7919) % 1500 && buf[0] == (uint8_t) x &&
+				buf[sizes[y] - 1] == (uint8_t) x;
+		}
+
+		MTY_QueuePopBatch(q, n);
+	}
+
+	MTY_ThreadDestroy(&thread);
+
+	test_cmp("MTY_QUEUE_FLAG_RING", ok && MTY_QueueGetLength(q) == 0);
+	test_cmpi32("MTY_QueueGetOutputBuffers", batches <= STRUCT_QUEUE_ITEMS, batches);
+
+	MTY_QueueDestroy(&q);
+
+	// Batches are pushed in order up to the queue length
+	MTY_QueueFlag flags[] = {MTY_QUEUE_FLAG_NONE, MTY_QUEUE_FLAG_MPSC, MTY_QUEUE_FLAG_RING};
+
+	for (uint8_t x = 0; x < 3; x++) {
+		q = MTY_QueueCreate(8, 64, flags[x]);
+
+		uint32_t vals[10] = {0};
+		const void *in[10];
+		size_t in_sizes[10];
+
+		for (uint32_t y = 0; y < 10; y++) {
+			vals[y] = y;
+			in[y] = &vals[y];
+			in_sizes[y] = sizeof(uint32_t);
+		}
+
+		uint32_t pushed = MTY_QueuePushBatch(q, in, in_sizes, 10);
+		test_cmp("MTY_QueuePushBatch", pushed == 8);
+
+		uint32_t n = MTY_QueueGetOutputBuffers(q, 0, bufs, sizes, 32);
+		ok = n == 8;
+
+		for (uint32_t y = 0; y < n && ok; y++)
+			ok = sizes[y] == sizeof(uint32_t) && *(uint32_t *) bufs[y] == y;
+
+		MTY_QueuePopBatch(q, n);
+		test_cmp("MTY_QueuePopBatch", ok && MTY_QueueGetLength(q) == 0);
+
+		MTY_QueueDestroy(&q);
+	}
+
+	return true;
+}
+
 static bool struct_main(void)
 {
 	char stringkey[] = "I'm a test string key!";
@@ -49,17 +343,18 @@ static bool struct_main(void)
 	int64_t popintkey = 0;
 	const char* popkey;
 	bool r = MTY_HashGetNextKey(hashctx, &iter, &popkey);
-	test_cmpi64("MTY_HashGetNextKey (I)", r, iter);
+	test_cmpi64("MTY_HashGetNextKey (S)", r && popkey && !strcmp(popkey, stringkey), iter);
 
-	r = MTY_HashGetNextKey(hashctx, &iter, &popkey);
-	test_cmpi64("MTY_HashGetNextKey (S)", r, iter);
+	const char *endkey = NULL;
+	r = MTY_HashGetNextKey(hashctx, &iter, &endkey);
+	test_cmpi64("MTY_HashGetNextKey (End)", !r, iter);
 
-	iter = 0; //have to reset since the KeyInt function will fail on the normal string key
+	iter = 0; // String and integer keys are iterated separately
 	r = MTY_HashGetNextKeyInt(hashctx, &iter, &popintkey);
-	test_cmpi64("MTY_HashGetNextKeyInt (I)", r, iter);
+	test_cmpi64("MTY_HashGetNextKeyInt (I)", r && popintkey == 1, iter);
 
 	r = MTY_HashGetNextKeyInt(hashctx, &iter, &popintkey);
-	test_cmpi64("MTY_HashGetNextKeyInt (S)", !r, iter);
+	test_cmpi64("MTY_HashGetNextKeyInt (End)", !r, iter);
 
 	value = MTY_HashPop(hashctx, popkey);
 	test_cmp("MTY_HashPop", value && !strcmp(stringkey, value));
@@ -70,7 +365,25 @@ static bool struct_main(void)
 	MTY_HashDestroy(&hashctx, NULL);
 	test_cmp("MTY_HashDestroy", hashctx == NULL);
 
-	MTY_Queue* queuectx = MTY_QueueCreate(2, 4);
+	if (!struct_hash_str())
+		return false;
+
+	if (!struct_hash_int())
+		return false;
+
+	if (!struct_queue("MTY_QUEUE_FLAG_NONE", MTY_QUEUE_FLAG_NONE, 4))
+		return false;
+
+	if (!struct_queue("MTY_QUEUE_FLAG_SPSC", MTY_QUEUE_FLAG_SPSC, 1))
+		return false;
+
+	if (!struct_queue("MTY_QUEUE_FLAG_MPSC", MTY_QUEUE_FLAG_MPSC, 4))
+		return false;
+
+	if (!struct_queue_batch())
+		return false;
+
+	MTY_Queue* queuectx = MTY_QueueCreate(2, 4, MTY_QUEUE_FLAG_NONE);
 	test_cmp("MTY_QueueCreate", queuectx != NULL);
 
 	/*
@@ -59,6 +59,174 @@ static bool test_threadpools()
 	return true;
 }
 
+static void test_threadpool_queue_thread(void *opaque)
+{
+	MTY_Atomic32Add((MTY_Atomic32 *) opaque, 1);
+}
+
+static bool test_threadpool_queue()
+{
+	const uint32_t num_tasks = 10000;
+
+	MTY_Atomic32 count = {0};
+	MTY_ThreadPool *pool = MTY_ThreadPoolCreate(4);
+	uint32_t *index = MTY_Alloc(num_tasks, sizeof(uint32_t));
+
+	int64_t ts = MTY_GetTime();
+
+	// Far more tasks than workers are queued rather than rejected
+	bool ok = true;
+	for (uint32_t x = 0; x < num_tasks && ok; x++) {
+		index[x] = MTY_ThreadPoolDispatch(pool, test_threadpool_queue_thread, &count);
+		ok = index[x] > 0;
+	}
+
+	test_cmp("MTY_ThreadPoolDispatch", ok);
+
+	for (uint32_t x = 0; x < num_tasks; x++) {
+		void *opaque = NULL;
+		while (MTY_ThreadPoolPoll(pool, index[x], &opaque) == MTY_ASYNC_CONTINUE)
+			MTY_Sleep(0);
+
+		ok = ok && opaque == &count;
+		MTY_ThreadPoolDetach(pool, index[x], NULL);
+	}
+
+	test_cmpf("MTY_ThreadPoolDispatch (ms)", ok && MTY_Atomic32Get(&count) == (int32_t) num_tasks,
+		MTY_TimeDiff(ts, MTY_GetTime()));
+
+	MTY_ThreadPoolDestroy(&pool, NULL);
+	MTY_Free(index);
+
+	return true;
+}
+
+struct test_parallel_data {
+	MTY_ThreadPool *pool;
+	uint8_t *visits;
+	double *values;
+};
+
+struct test_graph_node {
+	MTY_Atomic32 *order;
+	int32_t result;
+};
+
+static void test_parallel_visit(size_t begin, size_t end, void *opaque)
+{
+	struct test_parallel_data *data = opaque;
+
+	for (size_t x = begin; x < end; x++)
+		data->visits[x]++;
+}
+
+static void test_parallel_work(size_t begin, size_t end, void *opaque)
+{
+	struct test_parallel_data *data = opaque;
+
+	for (size_t x = begin; x < end; x++)
+		data->values[x] = sqrt((double) x) * sin((double) x);
+}
+
+static void test_parallel_nested(size_t begin, size_t end, void *opaque)
+{
+	struct test_parallel_data *data = opaque;
+
+	// Each outer index visits its own slice so inner loops never touch the same bytes
+	for (size_t x = begin; x < end; x++) {
+		struct test_parallel_data slice = *data;
+		slice.visits += x * 1000;
+
+		MTY_ParallelFor(data->pool, 1000, 10, test_parallel_visit, &slice);
+	}
+}
+
+static void test_graph_stage(void *opaque)
+{
+	struct test_graph_node *node = opaque;
+
+	MTY_Sleep(1);
+	node->result = MTY_Atomic32Add(node->order, 1);
+}
+
+static bool test_parallel()
+{
+	const size_t len = 1000003;
+
+	struct test_parallel_data data = {0};
+	data.pool = MTY_ThreadPoolCreate(8);
+	data.visits = MTY_Alloc(len, 1);
+	data.values = MTY_Alloc(len, sizeof(double));
+
+	// Every index is visited exactly once
+	MTY_ParallelFor(data.pool, len, 1000, test_parallel_visit, &data);
+
+	bool ok = true;
+	for (size_t x = 0; x < len && ok; x++)
+		ok = data.visits[x] == 1;
+
+	test_cmp("MTY_ParallelFor", ok);
+
+	// Nested calls from inside the pool make progress
+	memset(data.visits, 0, len);
+	MTY_ParallelFor(data.pool, 64, 1, test_parallel_nested, &data);
+
+	for (size_t x = 0; x < 64 * 1000 && ok; x++)
+		ok = data.visits[x] == 1;
+
+	test_cmp("MTY_ParallelFor (Nested)", ok);
+
+	// Scaling with the number of threads
+	for (uint32_t threads = 1; threads <= 8; threads *= 2) {
+		MTY_ThreadPool *pool = MTY_ThreadPoolCreate(threads);
+		MTY_ParallelFor(pool, len, 4096, test_parallel_work, &data);
+
+		int64_t ts = MTY_GetTime();
+
+		for (uint8_t x = 0; x < 10; x++)
+			MTY_ParallelFor(pool, len, 4096, test_parallel_work, &data);
+
+		char name[64];
+		snprintf(name, 64, "MTY_ParallelFor %u Workers (ms)", threads);
+		test_cmpf(name, true, MTY_TimeDiff(ts, MTY_GetTime()));
+
+		MTY_ThreadPoolDestroy(&pool, NULL);
+	}
+
+	// Diamond: 0 -> (1, 2) -> 3
+	MTY_Atomic32 order = {0};
+	struct test_graph_node nodes[4] = {{&order, 0}, {&order, 0}, {&order, 0}, {&order, 0}};
+
+	MTY_TaskGraph *graph = MTY_TaskGraphCreate(data.pool);
+	test_cmp("MTY_TaskGraphCreate", graph != NULL);
+
+	uint32_t a = MTY_TaskGraphAdd(graph, test_graph_stage, &nodes[0], NULL, 0);
+	uint32_t b = MTY_TaskGraphAdd(graph, test_graph_stage, &nodes[1], &a, 1);
+	uint32_t c = MTY_TaskGraphAdd(graph, test_graph_stage, &nodes[2], &a, 1);
+	uint32_t deps[2] = {b, c};
+	MTY_TaskGraphAdd(graph, test_graph_stage, &nodes[3], deps, 2);
+
+	for (uint8_t run = 0; run < 2 && ok; run++) {
+		MTY_Atomic32Set(&order, 0);
+		MTY_TaskGraphRun(graph);
+
+		// Each node records the order it finished in, starting at 1
+		ok = nodes[0].result == 1 && nodes[3].result == 4 &&
+			nodes[1].result + nodes[2].result == 5;
+	}
+
+	test_cmp("MTY_TaskGraphRun", ok);
+
+	MTY_TaskGraphDestroy(&graph);
+	test_cmp("MTY_TaskGraphDestroy", graph == NULL);
+
+	MTY_ThreadPoolDestroy(&data.pool, NULL);
+	MTY_Free(data.visits);
+	MTY_Free(data.values);
+
+	return true;
+}
+
 struct test_rw_lock_data {
 	int32_t counter;
 	MTY_Cond *cond;
@@ -167,6 +335,95 @@ static bool test_rw_locks()
 	return true;
 }
 
+struct test_rw_shared_data {
+	MTY_RWLock *lock;
+	MTY_Atomic32 stop;
+	MTY_Atomic32 torn;
+	int32_t a;
+	int32_t b;
+};
+
+static void *test_thread_rw_shared_read(void *opaque)
+{
+	struct test_rw_shared_data *data = (struct test_rw_shared_data *) opaque;
+
+	while (!MTY_Atomic32Get(&data->stop)) {
+		MTY_RWLockReader(data->lock);
+		MTY_RWLockReader(data->lock);
+
+		if (data->a != data->b)
+			MTY_Atomic32Add(&data->torn, 1);
+
+		MTY_RWLockUnlock(data->lock);
+		MTY_RWLockUnlock(data->lock);
+		MTY_Sleep(0);
+	}
+
+	return NULL;
+}
+
+static bool test_rw_locks_many()
+{
+	// More locks than the old per-thread slot table allowed, several held at once
+	MTY_RWLock *locks[1000] = {0};
+
+	for (int32_t x = 0; x < 1000; x++)
+		locks[x] = MTY_RWLockCreate();
+
+	for (int32_t x = 0; x < 1000; x += 100) {
+		MTY_RWLockReader(locks[x]);
+		MTY_RWLockWriter(locks[x + 1]);
+	}
+
+	test_cmp("MTY_RWTryLockReader", MTY_RWTryLockReader(locks[0]) && MTY_RWTryLockReader(locks[1]));
+
+	MTY_RWLockUnlock(locks[1]);
+	MTY_RWLockUnlock(locks[0]);
+
+	for (int32_t x = 0; x < 1000; x += 100) {
+		MTY_RWLockUnlock(locks[x]);
+		MTY_RWLockUnlock(locks[x + 1]);
+	}
+
+	for (int32_t x = 0; x < 1000; x++)
+		MTY_RWLockDestroy(&locks[x]);
+
+	test_cmp("MTY_RWLockDestroy", locks[999] == NULL);
+
+	// Readers never observe a half finished write
+	for (int32_t sharded = 0; sharded < 2; sharded++) {
+		struct test_rw_shared_data data = {0};
+		data.lock = sharded ? MTY_RWLockCreateSharded() : MTY_RWLockCreate();
+
+		MTY_Thread *readers[4] = {0};
+		for (int32_t x = 0; x < 4; x++)
+			readers[x] = MTY_ThreadCreate(test_thread_rw_shared_read, &data);
+
+		MTY_Time ts = MTY_GetTime();
+
+		for (int32_t x = 0; x < 2000; x++) {
+			MTY_RWLockWriter(data.lock);
+			data.a++;
+			MTY_Sleep(0);
+			data.b++;
+			MTY_RWLockUnlock(data.lock);
+		}
+
+		float ms = MTY_TimeDiff(ts, MTY_GetTime());
+		MTY_Atomic32Set(&data.stop, 1);
+
+		for (int32_t x = 0; x < 4; x++)
+			MTY_ThreadDestroy(&readers[x]);
+
+		test_cmpf(sharded ? "MTY_RWLockCreateSharded (ms)" : "MTY_RWLockCreate (ms)",
+			MTY_Atomic32Get(&data.torn) == 0 && data.a == 2000 && data.b == 2000, ms);
+
+		MTY_RWLockDestroy(&data.lock);
+	}
+
+	return true;
+}
+
 struct test_waitable_data {
 	MTY_Waitable *wait;
 	MTY_Atomic32 atomic_32;
@@ -400,6 +657,107 @@ static bool test_mutexes() {
 	return true;
 }
 
+#define test_contention_iters 100000
+
+static void *test_thread_contention(void *opaque)
+{
+	struct test_mutex_data *data = (struct test_mutex_data *) opaque;
+
+	for (int32_t x = 0; x < test_contention_iters; x++) {
+		MTY_MutexLock(data->mutex);
+		data->counter++;
+		MTY_MutexUnlock(data->mutex);
+	}
+
+	return NULL;
+}
+
+struct test_pingpong_data {
+	MTY_Waitable *ping;
+	MTY_Waitable *pong;
+	int32_t rounds;
+};
+
+static void *test_thread_pingpong(void *opaque)
+{
+	struct test_pingpong_data *data = (struct test_pingpong_data *) opaque;
+
+	for (int32_t x = 0; x < data->rounds; x++) {
+		while (!MTY_WaitableWait(data->ping, -1));
+		MTY_WaitableSignal(data->pong);
+	}
+
+	return NULL;
+}
+
+static bool test_contention()
+{
+	// Contended mutex, blocking vs. adaptive spinning
+	for (uint32_t spin = 0; spin <= 1000; spin += 1000) {
+		struct test_mutex_data data = {0};
+		data.mutex = MTY_MutexCreate();
+		MTY_MutexSetSpin(data.mutex, spin);
+
+		MTY_Thread *t_test[4] = {0};
+		MTY_Time ts = MTY_GetTime();
+
+		for (int32_t i = 0; i < 4; i++)
+			t_test[i] = MTY_ThreadCreate(test_thread_contention, &data);
+
+		for (int32_t i = 0; i < 4; i++)
+			MTY_ThreadDestroy(&t_test[i]);
+
+		float ms = MTY_TimeDiff(ts, MTY_GetTime());
+		test_cmpf(spin > 0 ? "MTY_MutexSetSpin (ms)" : "MTY_MutexLock (ms)",
+			data.counter == 4 * test_contention_iters, ms);
+
+		MTY_MutexDestroy(&data.mutex);
+	}
+
+	// Signaling with nobody waiting never enters the kernel
+	struct test_pingpong_data data = {0};
+	data.ping = MTY_WaitableCreate();
+	data.pong = MTY_WaitableCreate();
+	data.rounds = 10000;
+
+	MTY_Time ts = MTY_GetTime();
+
+	for (int32_t x = 0; x < 1000000; x++) {
+		MTY_WaitableSignal(data.ping);
+		MTY_WaitableWait(data.ping, 0);
+	}
+
+	test_cmpf("MTY_WaitableSignal (ns)", !MTY_WaitableWait(data.ping, 0),
+		MTY_TimeDiff(ts, MTY_GetTime()) * 1000.0f * 1000.0f / 1000000.0f);
+
+	// Round trips between two threads that block every time
+	MTY_Thread *t = MTY_ThreadCreate(test_thread_pingpong, &data);
+	ts = MTY_GetTime();
+
+	bool ok = true;
+	for (int32_t x = 0; x < data.rounds && ok; x++) {
+		MTY_WaitableSignal(data.ping);
+		ok = MTY_WaitableWait(data.pong, 5000);
+	}
+
+	test_cmpf("MTY_WaitableWait Round Trip (us)", ok,
+		MTY_TimeDiff(ts, MTY_GetTime()) * 1000.0f / data.rounds);
+
+	MTY_ThreadDestroy(&t);
+	MTY_WaitableDestroy(&data.pong);
+	MTY_WaitableDestroy(&data.ping);
+
+	// Timeouts still expire when nothing signals
+	MTY_Waitable *w = MTY_WaitableCreate();
+	ts = MTY_GetTime();
+	ok = !MTY_WaitableWait(w, 50);
+	float ms = MTY_TimeDiff(ts, MTY_GetTime());
+	test_cmpf("MTY_WaitableWait Timeout (ms)", ok && ms >= 45.0f, ms);
+	MTY_WaitableDestroy(&w);
+
+	return true;
+}
+
 struct test_thread_data {
 	bool executed;
 };
@@ -453,12 +811,24 @@ static bool thread_main()
 	if (!test_threadpools())
 		return false;
 
+	if (!test_threadpool_queue())
+		return false;
+
+	if (!test_parallel())
+		return false;
+
 	if (!test_rw_locks())
 		return false;
 
+	if (!test_rw_locks_many())
+		return false;
+
 	if (!test_waitables())
 		return false;
 
+	if (!test_contention())
+		return false;
+
 	MTY_RevertTimerResolution(1);
 
 	return true;